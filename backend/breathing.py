@@ -1,3 +1,5 @@
+import os
+import ctypes
 import numpy as np
 import pandas as pd
 from scipy import signal
@@ -10,28 +12,43 @@ from scipy.signal import (
     correlate,
     find_peaks,
     sosfiltfilt,
+    sosfilt,
+    sosfilt_zi,
     butter,
 )
 from hampel import hampel
 
+# Band view subcarriers averaged into the breathing signal: -8..1 of the
+# primary channel, subcarriers 20-29 of an HT20 frame (see csi_frame.band())
+BAND_FIRST = 18
+BAND_LAST = 28
+
 """
 Computes the breathing rate for a given list of CSI data
-Expects a 15 second window of CSI Data (therefore len(csi_data) == 1500)
-The raw data of 234 readings should be converted to a list of 117 complex numbers
+Expects a 15 second window of CSI Data (therefore len(csi_data) == 1500) as
+band view rows of 106 readings (csi_frame.band()), whatever the frame layout
 Returns int/float representing breathing rate in BPM
 """
 
 
 def get_br(csi_data, fs=100):
+    return acf_br(br_acf(csi_data), fs)
+
+
+"""
+Normalised autocorrelation of the filtered breathing signal of get_br(), for
+non-negative lags
+"""
+
+
+def br_acf(csi_data):
 
     # -----------------------------------------------------------
     # PRE-PROCESS DATA
     # -----------------------------------------------------------
 
-    csi_data = make_csi_complex(csi_data)
-
-    # Get the average readings of subcarriers 20-50 (total = 1500x1 entries in list)
-    s_t_complex = [np.mean(csi_row[20:30]) for csi_row in csi_data]
+    # Get the average readings of the breathing band (total = 1500x1 entries in list)
+    s_t_complex = subcarrier_band_mean(csi_data, BAND_FIRST, BAND_LAST)
 
     # Perform np.diff to help normalize or sum shit?
     s_t_complex = np.diff(s_t_complex)
@@ -56,13 +73,23 @@ def get_br(csi_data, fs=100):
     acf = correlate(s_filt, s_filt, mode="full")
     acf /= np.max(acf)
     acf = acf[acf.size // 2 :]
+    return acf
+
 
+"""
+Breathing rate from the normalised ACF of get_br(), by its first peak
+The thresholds and the plausible range are parameters so that
+csi_trace.br_check() can tell decisions on their edge apart
+"""
+
+
+def acf_br(acf, fs=100, height=0.01, prominence=0.05, plausible=(8, 25)):
     # Get peaks in acf to determine bpm
     try:
-        x, _ = find_peaks(acf, height=0.01, prominence=0.05)
+        x, _ = find_peaks(acf, height=height, prominence=prominence)
         br = fs / x[0] * 60
         if (
-            br < 8 or br > 25
+            br < plausible[0] or br > plausible[1]
         ):  # For unrealistic values, try next peak or default to reasonable guess
             if len(x) > 1:
                 br = fs / x[1] * 60
@@ -78,16 +105,604 @@ def get_br(csi_data, fs=100):
 
 """
 Converts the raw list of CSI data:  [ [50, 92, 5, 10, ...],     [15, 20, 19, 31,...],       ...]
-into a list of complex values:      [ [92 + 50i, 10 + 5i, ...], [20 + 15i, 31 + 19i, ...],  ...]
+into an array of complex values:    [ [92 + 50i, 10 + 5i, ...], [20 + 15i, 31 + 19i, ...],  ...]
+The float64 copy of the rows is reinterpreted as complex128 (imag + real*i) and
+flipped with 1j * conj(), so no per-element Python work is done
 """
 
 
 def make_csi_complex(csi_data):
-    csi_processed = []
+    rows = np.asarray(csi_data)
+    if _kernel and rows.dtype == np.int8 and rows.ndim == 2:
+        rows = np.ascontiguousarray(rows)
+        out = np.empty((rows.shape[0], rows.shape[1] // 2), dtype=np.complex128)
+        _kernel.csi_to_complex(
+            rows.ctypes.data, rows.shape[0], rows.shape[1], out.ctypes.data
+        )
+        return out
 
-    for csi_row in csi_data:
-        csi_processed.append(
-            [complex(csi_row[i + 1], csi_row[i]) for i in range(0, len(csi_row), 2)]
+    swapped = np.ascontiguousarray(rows, dtype=np.float64).view(np.complex128)
+    return 1j * np.conj(swapped)
+
+
+"""
+Complex mean of subcarriers [first, last) for each CSI row, straight from the
+interleaved I/Q values without building the full complex matrix
+Row views with contiguous columns, as decoded with probe sequence numbers or
+cut by csi_frame.band(), are read in place by the native kernel
+"""
+
+
+def subcarrier_band_mean(csi_data, first=BAND_FIRST, last=BAND_LAST):
+    rows = np.asarray(csi_data)
+    if _kernel and rows.dtype == np.int8 and rows.ndim == 2:
+        if rows.strides[1] != 1 or rows.strides[0] < rows.shape[1]:
+            rows = np.ascontiguousarray(rows)
+        out = np.empty(rows.shape[0], dtype=np.complex128)
+        _kernel.csi_band_mean(
+            rows.ctypes.data,
+            rows.shape[0],
+            rows.strides[0],
+            first,
+            last,
+            out.ctypes.data,
         )
+        return out
+
+    band = rows[:, 2 * first : 2 * last].reshape(len(rows), last - first, 2)
+    imag, real = band.mean(axis=1, dtype=np.float64).T
+    return real + 1j * imag
+
+
+"""
+Complex mean of the subcarriers listed in `index` for each CSI row
+A contiguous run of subcarriers goes through subcarrier_band_mean()
+"""
+
+
+def subcarrier_select_mean(csi_data, index):
+    index = np.asarray(index)
+    if np.all(np.diff(index) == 1):
+        return subcarrier_band_mean(csi_data, int(index[0]), int(index[-1]) + 1)
+    rows = np.asarray(csi_data)
+    imag = rows[:, 2 * index].mean(axis=1, dtype=np.float64)
+    real = rows[:, 2 * index + 1].mean(axis=1, dtype=np.float64)
+    return real + 1j * imag
+
+
+"""
+Loads the optional native kernels (csi_kernel.c) if libcsi_kernel.so was built
+next to this file, or from `path`
+"""
+
+
+def _load_kernel(path=None):
+    if path is None:
+        path = os.path.join(
+            os.path.dirname(os.path.abspath(__file__)), "libcsi_kernel.so"
+        )
+    try:
+        lib = ctypes.CDLL(path)
+    except OSError:
+        return None
+
+    size_t = ctypes.c_size_t
+    lib.csi_to_complex.argtypes = [ctypes.c_void_p, size_t, size_t, ctypes.c_void_p]
+    lib.csi_to_complex.restype = None
+    lib.csi_band_mean.argtypes = [
+        ctypes.c_void_p,
+        size_t,
+        size_t,
+        size_t,
+        size_t,
+        ctypes.c_void_p,
+    ]
+    lib.csi_band_mean.restype = None
+    return lib
+
+
+_kernel = _load_kernel()
+
+
+"""
+Online ranking of band view subcarriers for the breathing estimate, the same
+algorithm as esp32c5/csi_recv/main/sc_rank.c
+The power of every subcarrier is summed over `decimate` frames, then split
+into breathing band (0.15-0.5 Hz) and noise (above 1 Hz) components by two
+small IIR filters at the decimated rate. Exponentially weighted energies of
+both are tracked, and a subcarrier's score is their ratio. Every `period`
+decimated samples after `warmup`, the `k` best subcarriers replace the
+current selection if their summed score beats it by `switch` times.
+update() returns True when the selection changed
+"""
+
+SC_RANK_SOS_BAND = np.array(
+    [
+        [0.01043241337109341, 0.02086482674218682, 0.01043241337109341, 1.0]
+        + [-1.7304945831048948, 0.7992966334636966],
+        [1.0, -2.0, 1.0, 1.0, -1.905772844034958, 0.9167135199814352],
+    ]
+)
+SC_RANK_SOS_NOISE = np.array(
+    [
+        [0.6389455251590224, -1.2778910503180447, 0.6389455251590224, 1.0]
+        + [-1.1429805025399011, 0.41280159809618877],
+    ]
+)
+
+
+class SubcarrierRanker:
+    def __init__(
+        self,
+        subcarriers=53,
+        k=10,
+        decimate=10,
+        alpha=1 / 64,
+        period=100,
+        warmup=150,
+        switch=1.25,
+    ):
+        self.k = k
+        self.decimate = decimate
+        self.alpha = alpha
+        self.period = period
+        self.warmup = warmup
+        self.switch = switch
+        self.selected = np.arange(BAND_FIRST, BAND_LAST)
+
+        self.acc = np.zeros(subcarriers)
+        self.count = 0
+        self.samples = 0
+        self.zi_band = None
+        self.zi_noise = None
+        self.e_band = np.zeros(subcarriers)
+        self.e_noise = np.zeros(subcarriers)
+        self.score = np.zeros(subcarriers)
+        self.reranks = 0
+
+    def _decimated(self, rows):
+        rows = np.asarray(rows, dtype=np.float64)
+        power = rows[:, 0::2] ** 2 + rows[:, 1::2] ** 2
+        # Complete the pending block, then whole blocks, keep the rest
+        head = min(len(power), self.decimate - self.count)
+        self.acc += power[:head].sum(axis=0)
+        self.count += head
+        if self.count < self.decimate:
+            return power[:0]
+        blocks = [self.acc]
+        rest = power[head:]
+        whole = len(rest) // self.decimate * self.decimate
+        if whole:
+            blocks.extend(
+                rest[:whole].reshape(-1, self.decimate, power.shape[1]).sum(axis=1)
+            )
+        self.acc = rest[whole:].sum(axis=0)
+        self.count = len(rest) - whole
+        return np.vstack(blocks)
+
+    def _rank(self, e_band, e_noise):
+        self.score = e_band / (e_noise + 1.0)
+        # Best first, lower index first among equal scores
+        best = np.sort(np.argsort(-self.score, kind="stable")[: self.k])
+        if np.array_equal(best, self.selected):
+            return False
+        if self.score[best].sum() <= self.switch * self.score[self.selected].sum():
+            return False
+        self.selected = best
+        self.reranks += 1
+        return True
+
+    @staticmethod
+    def _filter(sos, zi, x):
+        # Transposed direct form II, one sample of every subcarrier; a batch
+        # usually holds a single decimated sample, too few for sosfilt()
+        for (b0, b1, b2, _, a1, a2), z in zip(sos, zi):
+            y = b0 * x + z[0]
+            z[0] = b1 * x - a1 * y + z[1]
+            z[1] = b2 * x - a2 * y
+            x = y
+        return x
+
+    def update(self, rows):
+        changed = False
+        for x in self._decimated(rows):
+            if self.zi_band is None:
+                # Filters start in steady state for the first sample
+                self.zi_band = sosfilt_zi(SC_RANK_SOS_BAND)[:, :, None] * x
+                self.zi_noise = sosfilt_zi(SC_RANK_SOS_NOISE)[:, :, None] * x
+            y_band = self._filter(SC_RANK_SOS_BAND, self.zi_band, x)
+            y_noise = self._filter(SC_RANK_SOS_NOISE, self.zi_noise, x)
+            self.e_band += self.alpha * (y_band**2 - self.e_band)
+            self.e_noise += self.alpha * (y_noise**2 - self.e_noise)
+            self.samples += 1
+            since = self.samples - self.warmup
+            if since >= 0 and since % self.period == 0:
+                changed |= self._rank(self.e_band, self.e_noise)
+        return changed
+
+
+"""
+Streaming breathing rate estimator for a continuous CSI stream
+Keeps a fixed window of band-passed samples and a sliding DFT over a bank of
+frequencies in the breathing band, so each update costs O(hop * bins) instead
+of re-running get_br() on the whole window
+Feed it band view rows (N x 106) with update(); it returns a new BPM every
+`hop` frames once the window is full, otherwise None; an estimate whose
+`quality` stays under `floor` is None as well, as is `bpm` until the next one
+Receivers in the decimated publish mode send the breathing signal itself,
+|diff of the band mean| low-passed and decimated to `fs` Hz (see
+esp32c5/csi_recv/main/csi_stream.h); feed it to update_signal() of an
+estimator built with that `fs`
+With `adaptive`, a SubcarrierRanker picks the subcarriers that are averaged;
+each first difference is taken with a single selection, so a re-rank leaves
+no step in the signal
+`quality` is the confidence of the last estimate on the scale of
+estimate_vitals(): the share of the band's power within one bin of a plain
+transform of the window around the strongest bin, rescaled so a flat
+spectrum scores 0. Without a taper a pure tone keeps about 0.9 of its power
+in that lobe. It compares estimates of the same person seen over different
+links, raw or decimated. Without a taper or detrend the spectrum leaks more
+than that of estimate_vitals(), so the default `floor` sits just above
+what random-walk noise alone reaches in 1 of 20 windows here.
+"""
+
+
+class StreamingBreathing:
+    def __init__(
+        self,
+        fs=100,
+        window_s=15,
+        hop=100,
+        band=(0.15, 0.5),
+        resolution=0.005,
+        resync_windows=10,
+        adaptive=True,
+        floor=0.8,
+    ):
+        self.fs = fs
+        self.window = int(window_s * fs)
+        self.hop = hop
+        self.floor = floor
+        self.freqs = np.arange(band[0], band[1] + resolution / 2, resolution)
+        # Bins of the bank per bin of a plain transform of the window
+        self.lobe = max(int(round(1 / (window_s * resolution))), 1)
+        self.omega = 2 * np.pi * self.freqs / fs
+        # Sliding sums drift with rounding, rebuild them from the window
+        # every `resync_windows` windows
+        self.resync = resync_windows * self.window
+
+        self.sos = butter(3, band, "band", fs=fs, output="sos")
+        self.zi = None
+        self.prev = None
+        self.prev_row = None
+        self.ranker = SubcarrierRanker() if adaptive else None
+        self.selected = np.arange(BAND_FIRST, BAND_LAST)
+
+        self.samples = np.zeros(self.window)
+        self.n = 0  # total samples seen, also the write position
+        self.bins = np.zeros(len(self.freqs), dtype=complex)
+        self.since_emit = 0
+        self.since_resync = 0
+        self.bpm = None
+        self.quality = None
+
+    def _band_signal(self, csi_rows):
+        band = subcarrier_select_mean(csi_rows, self.selected)
+        if self.prev is not None:
+            band = np.concatenate(([self.prev], band))
+        if len(csi_rows):
+            self.prev = band[-1]
+            self.prev_row = np.array(csi_rows[-1:])
+        if self.ranker and self.ranker.update(csi_rows):
+            # The next difference starts from the last frame seen through the
+            # new selection
+            self.selected = self.ranker.selected
+            self.prev = subcarrier_select_mean(self.prev_row, self.selected)[0]
+        return np.abs(np.diff(band))
+
+    def _slide(self, s):
+        idx = self.n + np.arange(len(s))
+        pos = idx % self.window
+        old = self.samples[pos]
+        # Samples older than the window start out as zeros, so the same
+        # add/remove form holds while the window is filling
+        phase = np.exp(-1j * np.outer(self.omega, idx))
+        phase_old = np.exp(-1j * np.outer(self.omega, idx - self.window))
+        self.bins += phase @ s - phase_old @ old
+        self.samples[pos] = s
+        self.n += len(s)
+
+    def _resync(self):
+        idx = self.n - self.window + np.arange(self.window)
+        window = self.samples[idx % self.window]
+        self.bins = np.exp(-1j * np.outer(self.omega, idx)) @ window
+
+    def _estimate(self):
+        power = np.abs(self.bins) ** 2
+        total = power.sum()
+        self.quality = 0.0
+        if total <= 0:
+            return None
+        k = int(np.argmax(power))
+        share = power[max(k - self.lobe, 0) : k + self.lobe + 1].sum() / total
+        flat = min((2 * self.lobe + 1) / len(power), 1.0)
+        if flat < 1:
+            self.quality = float(min(max((share - flat) / (1 - flat), 0.0), 1.0))
+        if self.quality < self.floor:
+            return None
+        # Parabolic interpolation around the strongest bin
+        f = self.freqs[k]
+        if 0 < k < len(power) - 1:
+            a, b, c = power[k - 1], power[k], power[k + 1]
+            denom = a - 2 * b + c
+            if denom != 0:
+                f += 0.5 * (a - c) / denom * (self.freqs[1] - self.freqs[0])
+        return f * 60
+
+    def update(self, csi_rows):
+        return self.update_signal(self._band_signal(csi_rows))
+
+    def update_signal(self, s):
+        s = np.asarray(s, dtype=np.float64)
+        if len(s) == 0:
+            return None
+        if self.zi is None:
+            self.zi = sosfilt_zi(self.sos) * s[0]
+        s, self.zi = sosfilt(self.sos, s, zi=self.zi)
+
+        emitted = None
+        # Walk the batch in hop-sized steps so a large batch still emits at
+        # every hop boundary
+        while len(s):
+            step = min(len(s), self.hop - self.since_emit)
+            self._slide(s[:step])
+            s = s[step:]
+            self.since_emit += step
+            self.since_resync += step
+
+            if self.since_resync >= self.resync:
+                self._resync()
+                self.since_resync = 0
+
+            if self.since_emit >= self.hop:
+                self.since_emit = 0
+                if self.n >= self.window:
+                    self.bpm = emitted = self._estimate()
+        return emitted
+
+
+"""
+Frequency bands of the vital signs estimate_vitals() reports, in Hz
+"""
+
+VITAL_BANDS = {"breathing": (0.1, 0.5), "heart": (0.8, 2.0)}
+
+# Confidence below which estimate_vitals() reports no rate for a band, about
+# what white or random-walk noise alone reaches in 1 of 20 windows of 15 s:
+# the breathing band holds fewer bins, so chance peaks score higher there
+VITAL_FLOORS = {"breathing": 0.6, "heart": 0.4}
+
+
+"""
+Rates of every band in `bands` from one windowed FFT of the signal `s`
+sampled at `fs`
+The signal is detrended, Hann-windowed and transformed once, zero-padded to
+at least twice its length; each band then takes its strongest local maximum,
+refined by a parabola through the log power of its neighbours. `confidence`
+is the share of the band's power within one bin of the unpadded transform
+around the peak, rescaled so a flat spectrum scores 0 and a pure tone 1; it
+compares across links. As a cross-check, the autocorrelation of the
+band-limited signal comes from the same transform (the inverse FFT of the
+band's power), and its strongest lag within the band's periods gives
+`acf_bpm`; `agree` tells whether both are within half a bin of the unpadded
+transform. The ACF does not change the estimate
+Returns {band: {"bpm", "confidence", "acf_bpm", "agree"}}. A band without
+power or without a peak inside it (only a slope up to an edge) has None rates
+and 0 confidence; one whose confidence stays under `floors` has None rates
+and that confidence, as there is no rate to tell apart from noise
+"""
+
+
+def estimate_vitals(s, fs=100, bands=VITAL_BANDS, floors=VITAL_FLOORS):
+    s = np.asarray(s, dtype=np.float64)
+    n = len(s)
+    plan = _vital_plan(n, fs, tuple(bands.items()))
+    ramp, taper, nfft, freqs, slices, envelope = plan
+    # Least-squares line through the window, taken out before the taper
+    x = s - s.mean()
+    x -= ramp * (ramp @ x)
+    power = np.abs(np.fft.rfft(x * taper, nfft)) ** 2
+    # Bins of the padded transform per bin of the unpadded one
+    lobe = nfft // n
+    tolerance = 30 * fs / n
+
+    limited = np.zeros((len(slices), len(power)))
+    for i, band in enumerate(slices):
+        limited[i, band] = power[band]
+    acfs = np.fft.irfft(limited, nfft)
+
+    vitals = {}
+    for (name, (low, high)), band, p, acf in zip(bands.items(), slices, limited, acfs):
+        p = p[band]
+        total = p.sum()
+        vitals[name] = {
+            "bpm": None,
+            "confidence": 0.0,
+            "acf_bpm": None,
+            "agree": False,
+        }
+        # The strongest local maximum inside the band: an edge bin only sees
+        # the skirt of a peak beyond it, or of the noise rising towards DC
+        inner = p[1:-1]
+        peaks = np.flatnonzero((inner > p[:-2]) & (inner >= p[2:])) + 1
+        # Nor a sidelobe of a line outside the band: the peak has to stand
+        # twice above what the taper leaks from there. Candidates go
+        # strongest first, the first one usually stands
+        k = None
+        if total > 0 and len(peaks):
+            outside = power.copy()
+            outside[band] = 0
+            bins = np.arange(len(power))
+            for candidate in peaks[np.argsort(-p[peaks])]:
+                distance = np.abs(bins - (band.start + candidate))
+                if p[candidate] > 2 * np.max(outside * envelope[distance]):
+                    k = int(candidate)
+                    break
+        if k is None:
+            continue
+
+        f = freqs[band.start + k]
+        if p[k - 1] > 0 and p[k + 1] > 0:
+            a, b, c = np.log(p[k - 1 : k + 2])
+            denom = a - 2 * b + c
+            if denom < 0:
+                f += 0.5 * (a - c) / denom * (freqs[1] - freqs[0])
+        share = p[max(k - lobe, 0) : k + lobe + 1].sum() / total
+        flat = min((2 * lobe + 1) / len(p), 1.0)
+        confidence = (share - flat) / (1 - flat) if flat < 1 else 0.0
+        confidence = float(min(max(confidence, 0.0), 1.0))
+        vitals[name]["confidence"] = confidence
+        if confidence < floors.get(name, 0.0):
+            continue
+
+        first = int(fs / high)
+        last = min(int(np.ceil(fs / low)), n - 1)
+        acf_bpm = None
+        if first < last:
+            lag = first + int(np.argmax(acf[first : last + 1]))
+            if first < lag < last:
+                a, b, c = acf[lag - 1 : lag + 2]
+                denom = a - 2 * b + c
+                shift = 0.5 * (a - c) / denom if denom < 0 else 0.0
+                acf_bpm = float(60 * fs / (lag + shift))
+
+        vitals[name] = {
+            "bpm": float(f * 60),
+            "confidence": confidence,
+            "acf_bpm": acf_bpm,
+            "agree": bool(acf_bpm is not None and abs(acf_bpm - f * 60) <= tolerance),
+        }
+    return vitals
+
+
+# Window length, rate and bands -> (unit ramp for the detrend, Hann taper,
+# FFT size, bin frequencies, bin slice of every band, leakage envelope); a
+# stream estimates the same window shape every hop. The envelope is the
+# power the taper passes at a distance of so many padded bins, relative to
+# the line itself, made non-increasing
+_vital_plans = {}
+
+
+def _vital_plan(n, fs, bands):
+    plan = _vital_plans.get((n, fs, bands))
+    if plan is None:
+        ramp = np.arange(n) - (n - 1) / 2
+        ramp /= np.sqrt(ramp @ ramp) if n > 1 else 1
+        nfft = 1 << int(np.ceil(np.log2(2 * n)))
+        freqs = np.fft.rfftfreq(nfft, 1 / fs)
+        slices = [
+            slice(*np.searchsorted(freqs, [low, high], side="left"))
+            for _, (low, high) in bands
+        ]
+        taper = np.hanning(n)
+        kernel = np.abs(np.fft.rfft(taper, nfft)) ** 2
+        envelope = np.maximum.accumulate(kernel[::-1])[::-1] / kernel[0]
+        plan = ramp, taper, nfft, freqs, slices, envelope
+        _vital_plans[(n, fs, bands)] = plan
+    return plan
+
+
+"""
+Vital signs of band view rows (N x 106) over a whole window, e.g. the 15 s
+get_br() takes; the signal is the amplitude of the mean of the breathing
+subcarriers (subcarrier_band_mean()), so rates come out at their own
+frequency rather than doubled by the |diff| of get_br()'s front end
+"""
+
+
+def get_vitals(csi_data, fs=100, bands=VITAL_BANDS):
+    s = np.abs(subcarrier_band_mean(csi_data, BAND_FIRST, BAND_LAST))
+    return estimate_vitals(s, fs, bands)
+
+
+"""
+Streaming vital signs of a continuous CSI stream: breathing and heart rate
+(VITAL_BANDS) from a single windowed FFT per hop, where a filter chain per
+vital sign would band-pass and autocorrelate the window once for each
+Feed it band view rows (N x 106) with update(); once the window is full it
+returns estimate_vitals() of the window every `hop` frames, otherwise None.
+`vitals` keeps the last result, `bpm` and `quality` the breathing rate and
+its confidence as in StreamingBreathing; `bpm` is None while the confidence
+is under its floor (VITAL_FLOORS)
+The signal is the amplitude of the mean of the selected subcarriers. With
+`adaptive`, a SubcarrierRanker picks them; a re-rank would step the
+amplitude, so the jump seen on the last frame is taken out of every later
+sample
+"""
+
+
+class VitalSigns:
+    def __init__(
+        self,
+        fs=100,
+        window_s=15,
+        hop=100,
+        bands=VITAL_BANDS,
+        floors=VITAL_FLOORS,
+        adaptive=True,
+    ):
+        self.fs = fs
+        self.window = int(window_s * fs)
+        self.hop = hop
+        self.bands = bands
+        self.floors = floors
+        self.ranker = SubcarrierRanker() if adaptive else None
+        self.selected = np.arange(BAND_FIRST, BAND_LAST)
+        self.offset = 0.0
+
+        self.samples = np.zeros(self.window)
+        self.n = 0  # total samples seen, also the write position
+        self.since_emit = 0
+        self.vitals = None
+        self.bpm = None
+        self.quality = None
+
+    def _amplitude(self, csi_rows):
+        s = np.abs(subcarrier_select_mean(csi_rows, self.selected)) - self.offset
+        if self.ranker and self.ranker.update(csi_rows):
+            last = np.asarray(csi_rows[-1:])
+            before = np.abs(subcarrier_select_mean(last, self.selected))[0]
+            self.selected = self.ranker.selected
+            after = np.abs(subcarrier_select_mean(last, self.selected))[0]
+            self.offset += after - before
+        return s
+
+    def _estimate(self):
+        window = np.roll(self.samples, -(self.n % self.window))
+        self.vitals = estimate_vitals(window, self.fs, self.bands, self.floors)
+        breath = self.vitals.get("breathing")
+        if breath:
+            self.bpm = breath["bpm"]
+            self.quality = breath["confidence"]
+        return self.vitals
+
+    def update(self, csi_rows):
+        if len(csi_rows) == 0:
+            return None
+        return self.update_signal(self._amplitude(csi_rows))
 
-    return csi_processed
+    def update_signal(self, s):
+        s = np.asarray(s, dtype=np.float64)
+        emitted = None
+        while len(s):
+            step = min(len(s), self.hop - self.since_emit)
+            pos = (self.n + np.arange(step)) % self.window
+            self.samples[pos] = s[:step]
+            self.n += step
+            s = s[step:]
+            self.since_emit += step
+            if self.since_emit >= self.hop:
+                self.since_emit = 0
+                if self.n >= self.window:
+                    emitted = self._estimate()
+        return emitted
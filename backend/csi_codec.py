@@ -0,0 +1,260 @@
+import ctypes
+import os
+import numpy as np
+
+"""
+Decoder for coded CSI frames (see esp32c5/csi_recv/main/csi_codec.h), the
+payload of binary messages with csi_frame.FLAG_CODED
+Every frame is a mode byte (bits 7-6 the mode, bits 2-0 the Rice parameter
+k) and, for the intra and inter modes, one Rice code per value, most
+significant bit first and padded to a byte. The code is the zigzag mapped
+difference, modulo 256, from the previous frame of the same layout (inter)
+or from the same component of the previous subcarrier (intra); stored frames
+are the raw bytes. With per-frame sequence numbers every frame is preceded
+by a LEB128 varint: the number itself for the first frame of a message, the
+zigzag-coded step minus 1 for the others
+"""
+
+MODE_INTRA = 0
+MODE_INTER = 1
+MODE_STORED = 2
+ESCAPE = 12
+REFS = 5
+SEQ_SIZE = 5
+
+
+class _Header(ctypes.Structure):
+    # csi_frame_header_t
+    _fields_ = [
+        ("version", ctypes.c_uint8),
+        ("flags", ctypes.c_uint8),
+        ("rssi", ctypes.c_int8),
+        ("seq", ctypes.c_uint32),
+        ("timestamp_us", ctypes.c_int64),
+        ("frame_count", ctypes.c_uint16),
+        ("subcarriers", ctypes.c_uint16),
+        ("motion_confidence", ctypes.c_uint8),
+        ("layout", ctypes.c_uint8),
+        ("link", ctypes.c_uint8),
+    ]
+
+
+"""
+Loads the firmware's decoder from libcsi_kernel.so (csi_kernel.c) if it was
+built, None otherwise
+"""
+
+
+def _load_kernel():
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "libcsi_kernel.so")
+    try:
+        lib = ctypes.CDLL(path)
+        decode = lib.csi_frame_decode_coded
+    except (OSError, AttributeError):
+        return None
+
+    lib.csi_codec_size.argtypes = []
+    lib.csi_codec_size.restype = ctypes.c_size_t
+    lib.csi_codec_init.argtypes = [ctypes.c_void_p]
+    lib.csi_codec_init.restype = None
+    decode.argtypes = [
+        ctypes.POINTER(_Header),
+        ctypes.c_void_p,
+        ctypes.c_size_t,
+        ctypes.c_void_p,
+        ctypes.c_void_p,
+        ctypes.c_void_p,
+        ctypes.c_void_p,
+    ]
+    decode.restype = ctypes.c_bool
+    return lib
+
+
+_kernel = _load_kernel()
+
+
+def _varint(buf, pos):
+    value = 0
+    for n in range(SEQ_SIZE):
+        if pos + n >= len(buf):
+            break
+        value |= (buf[pos + n] & 0x7F) << (7 * n)
+        if not buf[pos + n] & 0x80:
+            return value, pos + n + 1
+    raise ValueError("Bad sequence number in coded CSI frame")
+
+
+def _unzigzag(z):
+    return (z >> 1) ^ -(z & 1)
+
+
+"""
+Reads n Rice codes of parameter k from an ASCII bit string, starting at bit p
+Returns (values, bit position after the last code)
+"""
+
+
+def _rice(bits, p, n, k):
+    values = np.empty(n, dtype=np.int64)
+    end = len(bits)
+    for i in range(n):
+        zero = bits.find(b"0", p, p + ESCAPE)
+        if zero < 0:
+            if p + ESCAPE + 8 > end:
+                raise ValueError("Truncated coded CSI frame")
+            v = int(bits[p + ESCAPE : p + ESCAPE + 8], 2)
+            p += ESCAPE + 8
+        else:
+            v = (zero - p) << k
+            p = zero + 1 + k
+            if k:
+                if p > end:
+                    raise ValueError("Truncated coded CSI frame")
+                v |= int(bits[p - k : p], 2)
+            if v > 255:
+                raise ValueError("Bad code in coded CSI frame")
+        values[i] = v
+    return values, p
+
+
+"""
+Per-device decoder state: the reference frame of every layout
+decode() must see a device's messages in order. A skipped message sequence
+number resets the references, and inter frames are then reported invalid
+until the next keyframe of their layout; a repeated sequence number (a QoS 1
+redelivery) yields no frames
+Uses the native decoder when libcsi_kernel.so is built, numpy otherwise
+"""
+
+
+class Decoder:
+    def __init__(self, native=True):
+        self.last_seq = None
+        self.resets = 0
+        self.duplicates = 0
+        self.skipped = 0
+        self._native = None
+        if native and _kernel:
+            self._native = ctypes.create_string_buffer(_kernel.csi_codec_size())
+        self.reset()
+
+    def reset(self):
+        if self._native is not None:
+            _kernel.csi_codec_init(self._native)
+        self._refs = {}
+
+    """
+    Decodes the frames of one message from payload[offset:]
+    Returns (csi, probe_seq, valid): csi is a (frame_count, subcarriers * 2)
+    int8 array, probe_seq the per-frame sequence numbers or None without
+    has_seq, and valid a bool array of the frames that could be decoded
+    """
+
+    def decode(
+        self, seq, has_seq, layout_id, frame_count, subcarriers, payload, offset
+    ):
+        row = subcarriers * 2
+        if row == 0 and frame_count:
+            raise ValueError("Coded CSI frame without subcarriers")
+        if self.last_seq is not None:
+            step = (seq - self.last_seq) % 2**32
+            if step == 0:
+                self.duplicates += 1
+                empty = np.zeros((0, row), dtype=np.int8)
+                return (
+                    empty,
+                    np.zeros(0, np.uint32) if has_seq else None,
+                    np.zeros(0, bool),
+                )
+            if step != 1:
+                self.resets += 1
+                self.reset()
+        self.last_seq = seq
+
+        if self._native is not None:
+            csi, probe_seq, valid = self._decode_native(
+                has_seq, layout_id, frame_count, subcarriers, payload, offset
+            )
+        else:
+            csi, probe_seq, valid = self._decode_numpy(
+                has_seq, layout_id, frame_count, row, memoryview(payload)[offset:]
+            )
+        self.skipped += int(frame_count - valid.sum())
+        return csi, probe_seq, valid
+
+    def _decode_native(
+        self, has_seq, layout_id, frame_count, subcarriers, payload, offset
+    ):
+        hdr = _Header(
+            flags=0x02 if has_seq else 0,
+            frame_count=frame_count,
+            subcarriers=subcarriers,
+            layout=layout_id,
+        )
+        data = np.frombuffer(payload, dtype=np.uint8, offset=offset)
+        csi = np.empty((frame_count, subcarriers * 2), dtype=np.int8)
+        probe_seq = np.empty(frame_count, dtype=np.uint32)
+        valid = np.empty(frame_count, dtype=np.uint8)
+        if not _kernel.csi_frame_decode_coded(
+            ctypes.byref(hdr),
+            data.ctypes.data,
+            len(data),
+            self._native,
+            csi.ctypes.data,
+            probe_seq.ctypes.data,
+            valid.ctypes.data,
+        ):
+            self.reset()
+            raise ValueError("Malformed coded CSI frame")
+        return csi, probe_seq if has_seq else None, valid.astype(bool)
+
+    def _decode_numpy(self, has_seq, layout_id, frame_count, row, buf):
+        slot = layout_id if layout_id < REFS else 0
+        bits = None
+        csi = np.zeros((frame_count, row), dtype=np.int8)
+        probe_seq = np.empty(frame_count, dtype=np.uint32) if has_seq else None
+        valid = np.zeros(frame_count, dtype=bool)
+        pos = 0
+        try:
+            for f in range(frame_count):
+                if has_seq:
+                    code, pos = _varint(buf, pos)
+                    if f:
+                        code = int(probe_seq[f - 1]) + 1 + _unzigzag(code)
+                    probe_seq[f] = code & 0xFFFFFFFF
+                if pos >= len(buf):
+                    raise ValueError("Truncated coded CSI frame")
+                mode, k = buf[pos] >> 6, buf[pos] & 0x07
+                if mode == MODE_STORED:
+                    if pos + 1 + row > len(buf):
+                        raise ValueError("Truncated coded CSI frame")
+                    frame = np.frombuffer(buf, dtype=np.int8, count=row, offset=pos + 1)
+                    pos += 1 + row
+                elif mode in (MODE_INTRA, MODE_INTER):
+                    if bits is None:
+                        # One ASCII '0'/'1' per bit, so str methods find codes
+                        raw = np.frombuffer(buf, dtype=np.uint8)
+                        bits = (np.unpackbits(raw) + ord("0")).tobytes()
+                    z, end = _rice(bits, (pos + 1) * 8, row, k)
+                    pos = (end + 7) // 8
+                    d = _unzigzag(z)
+                    if mode == MODE_INTER:
+                        ref = self._refs.get(slot)
+                        if ref is None or len(ref) != row:
+                            self._refs.pop(slot, None)
+                            continue
+                        frame = ((ref + d) & 0xFF).astype(np.uint8).view(np.int8)
+                    else:
+                        x = np.empty(row, dtype=np.int64)
+                        x[0::2] = np.cumsum(d[0::2])
+                        x[1::2] = np.cumsum(d[1::2])
+                        frame = (x & 0xFF).astype(np.uint8).view(np.int8)
+                else:
+                    raise ValueError(f"Bad coded CSI frame mode {mode}")
+                csi[f] = frame
+                valid[f] = True
+                self._refs[slot] = frame.astype(np.int64)
+        except ValueError:
+            self.reset()
+            raise
+        return csi, probe_seq, valid
@@ -0,0 +1,324 @@
+import struct
+from collections import namedtuple
+import numpy as np
+
+"""
+Decoder for the binary CSI MQTT payload (see esp32c5/csi_recv/main/csi_frame.h)
+
+Header (little-endian, 24 bytes):
+    magic u8, version u8, flags u8, rssi i8, seq u32, timestamp_us i64,
+    frame_count u16, subcarriers u16, motion_confidence u8, layout u8,
+    link u8, 1 reserved byte
+followed by frame_count * subcarriers * 2 int8 I/Q values, all in the frame
+layout named by the layout byte (see csi_layout.h). With FLAG_SEQ set,
+every frame is prefixed by the u32 sequence number of the ESP-NOW probe it was
+measured on. Version 1 headers stop after subcarriers (20 bytes) and carry no
+confidence. The link byte tells the transmitters of a receiver apart (see
+csi_link.h); it is 0 for a single one and for senders that predate it.
+With FLAG_CODED the frames are compressed, see csi_codec.py.
+"""
+
+MAGIC = 0xC5
+VERSION = 2
+FLAG_MOTION = 0x01
+FLAG_SEQ = 0x02
+FLAG_FIRST_WORD_INVALID = 0x04
+FLAG_CODED = 0x08
+
+HEADER = struct.Struct("<BBBbIqHHBBBx")
+HEADER_V1 = struct.Struct("<BBBbIqHH")
+
+
+def is_binary(payload):
+    return len(payload) > 0 and payload[0] == MAGIC
+
+
+"""
+Decimated stream messages (see esp32c5/csi_recv/main/csi_stream.h), sent on
+the same topic by receivers in the decimated publish mode
+Header (little-endian, 24 bytes):
+    magic u8, version u8, flags u8, rssi i8, seq u32, timestamp_us i64,
+    sample_count u16, channel_count u8, motion_confidence u8,
+    rate_centihz u16, link u8, 1 reserved byte
+followed by one channel id per channel and sample_count * channel_count int16
+samples, sample-major, in 1/256 of a raw CSI unit
+"""
+
+STREAM_MAGIC = 0xC6
+STREAM_VERSION = 1
+STREAM_FLAG_MOTION = 0x01
+STREAM_CHANNEL_BREATHING = 0xFF
+STREAM_HEADER = struct.Struct("<BBBbIqHBBHBx")
+STREAM_SCALE = 256
+
+
+def is_stream(payload):
+    return len(payload) > 0 and payload[0] == STREAM_MAGIC
+
+
+"""
+Link byte of a binary or stream payload without decoding it, 0 for text
+payloads and version 1 headers
+"""
+
+
+def link(payload):
+    if len(payload) < HEADER.size:
+        return 0
+    if (payload[0] == MAGIC and payload[1] == VERSION) or (
+        payload[0] == STREAM_MAGIC and payload[1] == STREAM_VERSION
+    ):
+        return payload[22]
+    return 0
+
+
+"""
+Decodes one stream payload
+Returns (header dict, channels, samples): channels is the list of channel ids
+(STREAM_CHANNEL_BREATHING or the band view position of an amplitude), samples
+a float (sample_count, channel_count) array in raw CSI units
+"""
+
+
+def decode_stream(payload):
+    if len(payload) < STREAM_HEADER.size:
+        raise ValueError("CSI stream shorter than header")
+    magic, version, flags, rssi, seq, timestamp_us, count, channels, *rest = (
+        STREAM_HEADER.unpack_from(payload)
+    )
+    conf, rate, link_id = rest
+    if magic != STREAM_MAGIC:
+        raise ValueError(f"Bad CSI stream magic {magic:#x}")
+    if version != STREAM_VERSION:
+        raise ValueError(f"Unsupported CSI stream version {version}")
+    if rate == 0:
+        raise ValueError("CSI stream without a sample rate")
+    offset = STREAM_HEADER.size
+    if len(payload) < offset + channels + 2 * count * channels:
+        raise ValueError("CSI stream shorter than its samples")
+
+    ids = list(payload[offset : offset + channels])
+    samples = np.frombuffer(
+        payload, dtype="<i2", count=count * channels, offset=offset + channels
+    ).reshape(count, channels)
+    header = {
+        "version": version,
+        "seq": seq,
+        "timestamp_us": timestamp_us,
+        "rssi": rssi,
+        "motion_detect": int(bool(flags & STREAM_FLAG_MOTION)),
+        "motion_confidence": conf / 255,
+        "sample_count": count,
+        "fs": rate / 100,
+        "link": link_id,
+    }
+    return header, ids, samples / STREAM_SCALE
+
+
+"""
+Frame layouts, mirroring the table in csi_layout.c
+Subcarriers are stored in ascending order; band_offset is the pair index of
+subcarrier -26 of the primary 20 MHz channel, where the band view starts
+"""
+
+Layout = namedtuple("Layout", "id name subcarriers bandwidth second band_offset")
+
+LAYOUT_UNKNOWN = 0
+LAYOUT_LLTF = 1
+LAYOUT_HT20 = 2
+LAYOUT_HT40_ABOVE = 3
+LAYOUT_HT40_BELOW = 4
+
+LAYOUTS = {
+    LAYOUT_LLTF: Layout(LAYOUT_LLTF, "lltf", 53, 20, 0, 0),
+    LAYOUT_HT20: Layout(LAYOUT_HT20, "ht20", 57, 20, 0, 2),
+    LAYOUT_HT40_ABOVE: Layout(LAYOUT_HT40_ABOVE, "ht40+", 117, 40, 1, 0),
+    LAYOUT_HT40_BELOW: Layout(LAYOUT_HT40_BELOW, "ht40-", 117, 40, 2, 64),
+}
+LAYOUT_NAMES = {layout.name: layout for layout in LAYOUTS.values()}
+
+BAND_FIRST = -26
+BAND_SUBCARRIERS = 53
+
+
+"""
+Layout of frames with `subcarriers` pairs, None if unknown or ambiguous
+"""
+
+
+def lookup_layout(subcarriers, second=0):
+    for layout in LAYOUTS.values():
+        if layout.subcarriers == subcarriers and (
+            layout.bandwidth == 20 or layout.second == second
+        ):
+            return layout
+    return None
+
+
+"""
+Subcarrier of every pair of a layout, relative to the primary channel centre
+"""
+
+
+def subcarrier_index(layout):
+    return np.arange(layout.subcarriers) - layout.band_offset + BAND_FIRST
+
+
+"""
+Band view of decoded frames: subcarriers -26..26 of the primary channel, the
+same 53 subcarriers for every layout, as analysed on the device
+A strided view into `csi`, no copy is made, unless the first word is
+invalid and falls inside the band; those pairs are then copied from the
+nearest valid one as the firmware does
+"""
+
+
+def band(csi, layout, first_word_invalid=False):
+    start = 2 * layout.band_offset
+    view = csi[:, start : start + 2 * BAND_SUBCARRIERS]
+    if first_word_invalid and layout.band_offset < 2:
+        valid = 2 - layout.band_offset
+        view = view.copy()
+        view[:, : 2 * valid] = np.tile(view[:, 2 * valid : 2 * valid + 2], valid)
+    return view
+
+
+"""
+Decodes one binary payload
+Returns (header dict, csi) where csi is a read-only (frame_count, subcarriers * 2)
+int8 view into the payload, no copy is made
+Coded payloads (FLAG_CODED) need the device's csi_codec.Decoder as `codec`;
+their csi is a new array without the frames the decoder could not restore,
+and header["skipped"] counts those
+header["probe_seq"] is a uint32 view of the per-frame sequence numbers, or
+None if the frames carry none
+header["layout"] is the frame Layout, inferred from the subcarrier count when
+the sender did not state it, or None if unknown
+"""
+
+
+def decode(payload, codec=None):
+    if len(payload) < HEADER_V1.size:
+        raise ValueError("CSI frame shorter than header")
+
+    version = payload[1]
+    if version == VERSION:
+        fmt = HEADER
+    elif version == 1:
+        fmt = HEADER_V1
+    else:
+        raise ValueError(f"Unsupported CSI frame version {version}")
+    if len(payload) < fmt.size:
+        raise ValueError("CSI frame shorter than header")
+
+    magic, _, flags, rssi, seq, timestamp_us, frame_count, subcarriers, *rest = (
+        fmt.unpack_from(payload)
+    )
+    if magic != MAGIC:
+        raise ValueError(f"Bad CSI frame magic {magic:#x}")
+
+    row = subcarriers * 2
+    layout_id = rest[1] if rest else LAYOUT_UNKNOWN
+    probe_seq = None
+    skipped = 0
+    if flags & FLAG_CODED:
+        if codec is None:
+            raise ValueError("Coded CSI frame without a decoder")
+        csi, probe_seq, valid = codec.decode(
+            seq,
+            bool(flags & FLAG_SEQ),
+            layout_id,
+            frame_count,
+            subcarriers,
+            payload,
+            fmt.size,
+        )
+        skipped = len(valid) - int(valid.sum())
+        if skipped:
+            csi = csi[valid]
+            probe_seq = probe_seq[valid] if probe_seq is not None else None
+    elif flags & FLAG_SEQ:
+        # Strided views into the payload, still without a copy
+        frames = np.frombuffer(
+            payload,
+            dtype=[("seq", "<u4"), ("iq", "i1", row)],
+            count=frame_count,
+            offset=fmt.size,
+        )
+        probe_seq, csi = frames["seq"], frames["iq"]
+    else:
+        csi = np.frombuffer(
+            payload, dtype=np.int8, count=frame_count * row, offset=fmt.size
+        ).reshape(frame_count, row)
+
+    if layout_id == LAYOUT_UNKNOWN:
+        layout = lookup_layout(subcarriers)
+    else:
+        layout = LAYOUTS.get(layout_id)
+        if layout is not None and layout.subcarriers != subcarriers:
+            raise ValueError(
+                f"CSI frame of {subcarriers} subcarriers in layout {layout.name}"
+            )
+
+    header = {
+        "version": version,
+        "seq": seq,
+        "timestamp_us": timestamp_us,
+        "rssi": rssi,
+        "motion_detect": int(bool(flags & FLAG_MOTION)),
+        "motion_confidence": rest[0] / 255 if rest else None,
+        "frame_count": frame_count,
+        "subcarriers": subcarriers,
+        "probe_seq": probe_seq,
+        "layout": layout,
+        "first_word_invalid": bool(flags & FLAG_FIRST_WORD_INVALID),
+        "skipped": skipped,
+        "link": rest[2] if rest else 0,
+    }
+    return header, csi
+
+
+"""
+Encodes frames in the same format as the firmware, used by the simulator
+"""
+
+
+def encode(
+    csi,
+    seq=0,
+    timestamp_us=0,
+    rssi=0,
+    motion_detect=0,
+    motion_confidence=0,
+    probe_seq=None,
+    layout=None,
+    first_word_invalid=False,
+    link=0,
+):
+    csi = np.ascontiguousarray(csi, dtype=np.int8)
+    frame_count, row = csi.shape
+    flags = FLAG_MOTION if motion_detect else 0
+    if probe_seq is not None:
+        flags |= FLAG_SEQ
+    if first_word_invalid:
+        flags |= FLAG_FIRST_WORD_INVALID
+    header = HEADER.pack(
+        MAGIC,
+        VERSION,
+        flags,
+        int(rssi),
+        seq & 0xFFFFFFFF,
+        int(timestamp_us),
+        frame_count,
+        row // 2,
+        round(min(max(motion_confidence, 0), 1) * 255),
+        layout.id if layout else LAYOUT_UNKNOWN,
+        link,
+    )
+    if probe_seq is None:
+        return header + csi.tobytes()
+
+    frames = np.empty(frame_count, dtype=[("seq", "<u4"), ("iq", "i1", row)])
+    frames["seq"] = np.asarray(probe_seq, dtype=np.int64) & 0xFFFFFFFF
+    frames["iq"] = csi
+    return header + frames.tobytes()
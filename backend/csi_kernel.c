@@ -0,0 +1,57 @@
+/* Native CSI conversion kernels for breathing.py
+
+   Optional: breathing.py loads this through ctypes when the shared library
+   has been built next to it and falls back to numpy otherwise. The library
+   also carries the firmware's frame decoder for csi_codec.py.
+
+   Build:
+       M=../esp32c5/csi_recv/main
+       cc -O3 -shared -fPIC -I$M -o libcsi_kernel.so csi_kernel.c \
+          $M/csi_codec.c $M/csi_frame.c
+
+   Raw frames are interleaved int8 (imag, real) pairs, as sent by csi_recv.
+*/
+#include "csi_codec.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief sizeof(csi_codec_t), for callers that allocate the decoder state
+ */
+size_t csi_codec_size(void) { return sizeof(csi_codec_t); }
+
+/**
+ * @brief Convert `frames` rows of `row_len` int8 values to complex
+ * @param[out] out interleaved (real, imag) doubles, frames * row_len values,
+ *             i.e. the memory layout of a numpy complex128 array
+ */
+void csi_to_complex(const int8_t *iq, size_t frames, size_t row_len,
+                    double *out) {
+  size_t n = frames * row_len;
+  for (size_t i = 0; i + 1 < n; i += 2) {
+    out[i] = iq[i + 1];
+    out[i + 1] = iq[i];
+  }
+}
+
+/**
+ * @brief Complex mean of subcarriers [first, last) for each row
+ * @param[in] row_len distance between row starts in bytes, may exceed the
+ *            row itself for strided views
+ * @param[out] out interleaved (real, imag) doubles, one pair per frame
+ */
+void csi_band_mean(const int8_t *iq, size_t frames, size_t row_len,
+                   size_t first, size_t last, double *out) {
+  double scale = 1.0 / (double)(last - first);
+  for (size_t f = 0; f < frames; f++) {
+    const int8_t *row = iq + f * row_len;
+    int re = 0, im = 0;
+    for (size_t k = first; k < last; k++) {
+      im += row[2 * k];
+      re += row[2 * k + 1];
+    }
+    out[2 * f] = re * scale;
+    out[2 * f + 1] = im * scale;
+  }
+}
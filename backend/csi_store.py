@@ -0,0 +1,588 @@
+import os
+import re
+import glob
+import mmap
+import time
+import struct
+import argparse
+import numpy as np
+import csi_frame
+
+"""
+Persistent CSI time-series store
+Every device gets a directory of append-only segment files. A segment is a
+64-byte header followed by fixed-width records (RECORD, 128 bytes): the
+frame's wall-clock timestamp, probe sequence number, RSSI, motion flag and
+confidence, layout id and the band view I/Q (csi_frame.band()), so frames of
+every layout line up and rows read back are what the breathing code expects.
+Segments are preallocated for SEGMENT_RECORDS records and memory-mapped;
+appends write straight into the mapping and then bump the record count in
+the header, so a reader in another process never sees a partial record.
+Full segments, and the open one when the store is closed, are sealed:
+flushed and truncated to their records.
+Reads are numpy views into the mappings, no copy is made, and the "iq" field
+of a read goes to breathing.get_br() as is. Timestamps never decrease within
+a device, and a sparse index of every INDEX_STRIDE-th timestamp per segment
+narrows a range lookup to one block before a binary search.
+Retention deletes sealed segments older than retention_s when a segment is
+sealed; compaction merges runs of small sealed segments, as left by
+restarts, into full ones when a device is opened for writing. A crashed
+writer leaves its segment unsealed, and the next one appends to it.
+A merge writes MERGE_TMP, lists the segments it absorbs after the first in
+MERGE_LOG and only then renames MERGE_TMP over the first, so a crash leaves
+either the sources untouched or the merged segment plus sources the log
+names; readers skip those and the next writer deletes them.
+"""
+
+MAGIC = b"CSISEG\x00\x00"
+VERSION = 1
+HEADER = struct.Struct("<8sHHIIqq28x")
+RECORD = np.dtype(
+    [
+        ("timestamp_us", "<i8"),
+        ("probe_seq", "<u4"),
+        ("rssi", "i1"),
+        ("motion", "u1"),
+        ("confidence", "u1"),
+        ("layout", "u1"),
+        ("iq", "i1", (2 * csi_frame.BAND_SUBCARRIERS,)),
+        ("reserved", "V6"),
+    ]
+)
+# 2^16 records, 8 MB and about 11 minutes of one device at 100 Hz
+SEGMENT_RECORDS = 1 << 16
+INDEX_STRIDE = 1024
+MERGE_TMP = "merge.tmp"
+MERGE_LOG = "merge.log"
+
+
+def _device_dir(root, device):
+    return os.path.join(root, re.sub(r"[^A-Za-z0-9_.-]", "_", device))
+
+
+"""
+One segment file, mapped read-only or, while it is being written, read-write
+records[:count] are valid; `index` holds every INDEX_STRIDE-th timestamp
+"""
+
+
+class Segment:
+    def __init__(self, path, writable=False):
+        self.path = path
+        with open(path, "r+b" if writable else "rb") as f:
+            self._map = mmap.mmap(
+                f.fileno(),
+                0,
+                access=mmap.ACCESS_WRITE if writable else mmap.ACCESS_READ,
+            )
+        magic, version, record_size, capacity, count, first, last = HEADER.unpack_from(
+            self._map
+        )
+        if magic != MAGIC or version != VERSION or record_size != RECORD.itemsize:
+            raise ValueError(f"{path}: not a version {VERSION} CSI segment")
+        self.capacity = capacity
+        self.count = count
+        self.first_us = first
+        self.last_us = last
+        self.writable = writable
+        self.records = np.frombuffer(
+            self._map, dtype=RECORD, count=capacity, offset=HEADER.size
+        )
+        self.index = self.records["timestamp_us"][:count:INDEX_STRIDE].copy()
+
+    @classmethod
+    def create(cls, path, capacity):
+        with open(path, "wb") as f:
+            f.write(HEADER.pack(MAGIC, VERSION, RECORD.itemsize, capacity, 0, 0, 0))
+            f.truncate(HEADER.size + capacity * RECORD.itemsize)
+        return cls(path, writable=True)
+
+    @property
+    def full(self):
+        return self.count == self.capacity
+
+    def append(self, batch):
+        """Copies as many records of `batch` as fit, returns how many"""
+        n = min(len(batch), self.capacity - self.count)
+        if n == 0:
+            return 0
+        start = self.count
+        self.records[start : start + n] = batch[:n]
+        if start == 0:
+            self.first_us = int(batch["timestamp_us"][0])
+        self.last_us = int(batch["timestamp_us"][n - 1])
+        self.count = start + n
+        HEADER.pack_into(
+            self._map,
+            0,
+            MAGIC,
+            VERSION,
+            RECORD.itemsize,
+            self.capacity,
+            self.count,
+            self.first_us,
+            self.last_us,
+        )
+        first_block = -(-start // INDEX_STRIDE)
+        last_block = -(-self.count // INDEX_STRIDE)
+        if last_block > first_block:
+            fresh = self.records["timestamp_us"][
+                first_block * INDEX_STRIDE : self.count : INDEX_STRIDE
+            ]
+            self.index = np.concatenate([self.index, fresh])
+        return n
+
+    def refresh(self):
+        """Picks up records appended by a writer in another process"""
+        count, first, last = struct.unpack_from("<Iqq", self._map, 16)
+        if count > self.count:
+            self.count, self.first_us, self.last_us = count, first, last
+            self.index = self.records["timestamp_us"][:count:INDEX_STRIDE].copy()
+
+    def search(self, t_us):
+        """Position of the first record at or after t_us"""
+        block = int(np.searchsorted(self.index, t_us, side="right")) - 1
+        if block < 0:
+            return 0
+        start = block * INDEX_STRIDE
+        end = min(start + INDEX_STRIDE, self.count)
+        ts = self.records["timestamp_us"][start:end]
+        return start + int(np.searchsorted(ts, t_us, side="left"))
+
+    def view(self, start_us, end_us):
+        """Records with start_us <= timestamp < end_us, a view"""
+        return self.records[self.search(start_us) : self.search(end_us)]
+
+    def seal(self):
+        """
+        Flushes and truncates the file to its records, reopening it read-only
+        The capacity becomes the count, so a sealed segment is full
+        """
+        self._map.flush()
+        self._unmap()
+        size = HEADER.size + self.count * RECORD.itemsize
+        with open(self.path, "r+b") as f:
+            f.write(
+                HEADER.pack(
+                    MAGIC,
+                    VERSION,
+                    RECORD.itemsize,
+                    self.count,
+                    self.count,
+                    self.first_us,
+                    self.last_us,
+                )
+            )
+            f.truncate(size)
+        self.__init__(self.path)
+
+    def close(self):
+        """Seals a segment being written, then unmaps it"""
+        if self.writable:
+            self.seal()
+        self._unmap()
+
+    def _unmap(self):
+        self.records = self.index = None
+        try:
+            self._map.close()
+        except BufferError:
+            # Views from read() are still alive, the mapping goes with them
+            pass
+
+
+"""
+Store of one device
+append() is for the single writer of a device, the ingest worker it is
+routed to; any number of read-only instances, in other processes too, can
+scan() and read() at the same time and call refresh() to see new data
+"""
+
+
+class DeviceStore:
+    def __init__(
+        self,
+        root,
+        device,
+        writable=False,
+        segment_records=SEGMENT_RECORDS,
+        retention_s=None,
+    ):
+        self.device = device
+        self.dir = _device_dir(root, device)
+        self.writable = writable
+        self.segment_records = segment_records
+        self.retention_s = retention_s
+        if writable:
+            os.makedirs(self.dir, exist_ok=True)
+            self.compact()
+        self.segments = []
+        self._load()
+
+    def _paths(self):
+        leftovers = self._leftovers()
+        paths = glob.glob(os.path.join(self.dir, "*.seg"))
+        return sorted(p for p in paths if p not in leftovers)
+
+    def _leftovers(self):
+        """Sources of an interrupted merge that its result already holds"""
+        log = os.path.join(self.dir, MERGE_LOG)
+        if not os.path.exists(log) or os.path.exists(os.path.join(self.dir, MERGE_TMP)):
+            return set()
+        with open(log) as f:
+            return {os.path.join(self.dir, name) for name in f.read().split()}
+
+    def _recover(self):
+        """Finishes or rolls back an interrupted merge"""
+        for path in self._leftovers():
+            if os.path.exists(path):
+                os.remove(path)
+        for name in (MERGE_TMP, MERGE_LOG):
+            path = os.path.join(self.dir, name)
+            if os.path.exists(path):
+                os.remove(path)
+
+    def _load(self):
+        paths = self._paths()
+        self.segments = []
+        for i, path in enumerate(paths):
+            segment = Segment(path)
+            # Only the newest segment takes more records
+            if self.writable and i == len(paths) - 1 and not segment.full:
+                segment = Segment(path, writable=True)
+            self.segments.append(segment)
+
+    @property
+    def last_us(self):
+        for segment in reversed(self.segments):
+            if segment.count:
+                return segment.last_us
+        return None
+
+    def refresh(self):
+        """Picks up records and segments added by the writer"""
+        known = {segment.path for segment in self.segments}
+        for segment in self.segments:
+            segment.refresh()
+        for path in self._paths():
+            if path not in known:
+                self.segments.append(Segment(path))
+        self.segments = [s for s in self.segments if os.path.exists(s.path)]
+
+    def append(
+        self,
+        timestamps_us,
+        rows,
+        rssi=0,
+        motion=0,
+        confidence=0.0,
+        layout=csi_frame.LAYOUT_UNKNOWN,
+        probe_seq=None,
+    ):
+        """
+        Stores band view `rows` with their wall-clock timestamps; a timestamp
+        below the device's last one is raised to it
+        """
+        n = len(rows)
+        if n == 0:
+            return
+        batch = np.zeros(n, dtype=RECORD)
+        t = np.asarray(timestamps_us, dtype=np.int64)
+        last = self.last_us
+        if last is not None:
+            t = np.maximum(t, last)
+        batch["timestamp_us"] = np.maximum.accumulate(t)
+        if probe_seq is not None:
+            batch["probe_seq"] = probe_seq
+        batch["rssi"] = rssi
+        batch["motion"] = motion
+        batch["confidence"] = round(min(max(confidence or 0.0, 0.0), 1.0) * 255)
+        batch["layout"] = layout
+        batch["iq"] = rows
+
+        done = 0
+        while done < n:
+            segment = self.segments[-1] if self.segments else None
+            if segment is None or not segment.writable:
+                name = f"{int(batch['timestamp_us'][done]):020d}.seg"
+                path = os.path.join(self.dir, name)
+                if os.path.exists(path):
+                    # Same start time as a sealed segment, keep both
+                    path = path[:-4] + f"-{len(self.segments)}.seg"
+                segment = Segment.create(path, self.segment_records)
+                self.segments.append(segment)
+            done += segment.append(batch[done:])
+            if segment.full:
+                segment.seal()
+                if self.retention_s is not None:
+                    self.retain(self.retention_s)
+
+    def scan(self, start_us, end_us):
+        """Views of the records in [start_us, end_us), one per segment"""
+        views = []
+        for segment in self.segments:
+            if segment.count == 0 or segment.last_us < start_us:
+                continue
+            if segment.first_us >= end_us:
+                break
+            view = segment.view(start_us, end_us)
+            if len(view):
+                views.append(view)
+        return views
+
+    def read(self, start_us, end_us):
+        """
+        Records in [start_us, end_us) as one array: a view into the mapping
+        when they lie in one segment, a copy when they span several
+        """
+        views = self.scan(start_us, end_us)
+        if len(views) == 1:
+            return views[0]
+        if not views:
+            return np.zeros(0, dtype=RECORD)
+        return np.concatenate(views)
+
+    def rows(self, start_us, end_us):
+        """Band view rows in [start_us, end_us), ready for breathing.get_br()"""
+        return self.read(start_us, end_us)["iq"]
+
+    def retain(self, max_age_s, now_us=None):
+        """Deletes sealed segments whose newest record is older than max_age_s"""
+        if now_us is None:
+            now_us = time.time_ns() // 1000
+        cutoff = now_us - int(max_age_s * 1e6)
+        kept = []
+        for segment in self.segments:
+            if not segment.writable and segment.last_us < cutoff:
+                segment.close()
+                os.remove(segment.path)
+            else:
+                kept.append(segment)
+        removed = len(self.segments) - len(kept)
+        self.segments = kept
+        return removed
+
+    def compact(self):
+        """
+        Merges runs of consecutive sealed segments that fit one segment
+        Must not run while another writer has the device open
+        """
+        self._recover()
+        merged = 0
+        paths = self._paths()
+        run = []
+        for i, path in enumerate(paths + [None]):
+            segment = Segment(path) if path else None
+            # The newest segment may still be appended to, leave it alone
+            small = (
+                segment is not None
+                and i < len(paths) - 1
+                and segment.count < self.segment_records
+            )
+            fits = small and sum(s.count for s in run) + segment.count <= (
+                self.segment_records
+            )
+            if fits:
+                run.append(segment)
+                continue
+            if len(run) > 1:
+                self._merge(run)
+                merged += len(run)
+            else:
+                for s in run:
+                    s.close()
+            if small:
+                run = [segment]
+            else:
+                run = []
+                if segment is not None:
+                    segment.close()
+        return merged
+
+    def _merge(self, run):
+        """Rewrites `run` as one segment under the name of its first"""
+        count = sum(s.count for s in run)
+        tmp = os.path.join(self.dir, MERGE_TMP)
+        out = Segment.create(tmp, count)
+        for segment in run:
+            out.append(segment.records[: segment.count])
+            segment.close()
+        out.close()
+        with open(os.path.join(self.dir, MERGE_LOG), "w") as f:
+            f.write("\n".join(os.path.basename(s.path) for s in run[1:]))
+            f.flush()
+            os.fsync(f.fileno())
+        os.replace(tmp, run[0].path)
+        self._recover()
+
+    def close(self):
+        for segment in self.segments:
+            segment.close()
+
+
+"""
+Stores of all devices under one root directory
+"""
+
+
+class CSIStore:
+    def __init__(self, root, writable=False, retention_s=None):
+        self.root = root
+        self.writable = writable
+        self.retention_s = retention_s
+        self._devices = {}
+        if writable:
+            os.makedirs(root, exist_ok=True)
+
+    def device(self, device):
+        store = self._devices.get(device)
+        if store is None:
+            store = self._devices[device] = DeviceStore(
+                self.root,
+                device,
+                writable=self.writable,
+                retention_s=self.retention_s,
+            )
+        return store
+
+    def devices(self):
+        if not os.path.isdir(self.root):
+            return []
+        return sorted(
+            name
+            for name in os.listdir(self.root)
+            if os.path.isdir(os.path.join(self.root, name))
+        )
+
+    def close(self):
+        for store in self._devices.values():
+            store.close()
+
+
+def info(root):
+    store = CSIStore(root)
+    for device in store.devices():
+        ds = store.device(device)
+        count = sum(s.count for s in ds.segments)
+        if not count:
+            print(f"{device}: empty")
+            continue
+        first = min(s.first_us for s in ds.segments if s.count)
+        span = (ds.last_us - first) / 1e6
+        print(
+            f"{device}: {count} records in {len(ds.segments)} segments, "
+            f"{span:.0f} s from {time.ctime(first / 1e6)}"
+        )
+
+
+def bench(root, devices=16, seconds=600, batch=10, fs=100, scans=200):
+    """
+    Appends `seconds` of synthetic frames for every device, `batch` frames
+    per call in device round-robin as the ingest workers do, then times
+    15 s range reads and a full scan through breathing.get_br()'s input path
+    """
+    import breathing
+
+    rng = np.random.default_rng(0)
+    rows = rng.integers(-40, 40, (batch, 2 * csi_frame.BAND_SUBCARRIERS), np.int8)
+    step_us = 1_000_000 // fs
+    stores = [DeviceStore(root, f"bench{d}", writable=True) for d in range(devices)]
+    start_us = 1_700_000_000_000_000
+    latency = []
+    begin = time.perf_counter()
+    for tick in range(int(seconds * fs / batch)):
+        t = start_us + (tick * batch + np.arange(batch)) * step_us
+        for store in stores:
+            t0 = time.perf_counter()
+            store.append(t, rows, rssi=-45, confidence=0.5, layout=2)
+            latency.append(time.perf_counter() - t0)
+    elapsed = time.perf_counter() - begin
+    records = len(latency) * batch
+    lat = np.array(latency) * 1e6
+    print(
+        f"ingest: {devices} devices x {seconds:g} s, {records} records in "
+        f"{elapsed:.2f} s, {records / elapsed:.0f} records/s "
+        f"({records / elapsed / (devices * fs):.0f}x real time), "
+        f"{records * RECORD.itemsize / elapsed / 1e6:.0f} MB/s, "
+        f"append p50 {np.percentile(lat, 50):.1f} us, "
+        f"p99 {np.percentile(lat, 99):.1f} us"
+    )
+    for store in stores:
+        store.close()
+
+    readers = [DeviceStore(root, f"bench{d}") for d in range(devices)]
+    window_us = 15_000_000
+    span_us = int(seconds * 1e6) - window_us
+    read_lat, br_lat, copies = [], [], 0
+    for i in range(scans):
+        reader = readers[i % devices]
+        t0_us = start_us + int(rng.integers(0, max(span_us, 1)))
+        t0 = time.perf_counter()
+        window = reader.rows(t0_us, t0_us + window_us)
+        t1 = time.perf_counter()
+        breathing.subcarrier_band_mean(window)
+        read_lat.append(t1 - t0)
+        br_lat.append(time.perf_counter() - t0)
+        copies += len(reader.scan(t0_us, t0_us + window_us)) > 1
+    read_us = np.array(read_lat) * 1e6
+    br_us = np.array(br_lat) * 1e6
+    print(
+        f"15 s range read: p50 {np.percentile(read_us, 50):.0f} us, "
+        f"p99 {np.percentile(read_us, 99):.0f} us; with the band mean "
+        f"p50 {np.percentile(br_us, 50):.0f} us; "
+        f"{copies}/{scans} spanned segments and were copied"
+    )
+
+    t0 = time.perf_counter()
+    total = 0
+    for reader in readers:
+        for view in reader.scan(start_us, start_us + int(seconds * 1e6)):
+            total += len(view)
+            breathing.subcarrier_band_mean(view["iq"])
+    elapsed = time.perf_counter() - t0
+    print(
+        f"full scan: {total} records in {elapsed:.2f} s, "
+        f"{total / elapsed:.0f} records/s, "
+        f"{total * RECORD.itemsize / elapsed / 1e6:.0f} MB/s"
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser(description="CSI store tools")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    show = sub.add_parser("info", help="summarise every device")
+    show.add_argument("root")
+
+    retain = sub.add_parser("retain", help="delete sealed segments by age")
+    retain.add_argument("root")
+    retain.add_argument("--days", type=float, required=True)
+
+    compact = sub.add_parser("compact", help="merge small sealed segments")
+    compact.add_argument("root")
+
+    timing = sub.add_parser("bench", help="ingest and range scan throughput")
+    timing.add_argument("root", help="scratch directory, bench* devices")
+    timing.add_argument("--devices", type=int, default=16)
+    timing.add_argument("--seconds", type=float, default=600)
+
+    args = parser.parse_args()
+    if args.cmd == "bench":
+        bench(args.root, args.devices, args.seconds)
+    elif args.cmd == "info":
+        info(args.root)
+    else:
+        # Run these with the server stopped: they assume no other writer
+        store = CSIStore(args.root, writable=True)
+        for device in store.devices():
+            ds = store.device(device)
+            if args.cmd == "retain":
+                removed = ds.retain(args.days * 86400)
+                print(f"{device}: removed {removed} segments")
+            else:
+                print(f"{device}: {len(ds.segments)} segments after compaction")
+        store.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,562 @@
+import sys
+import struct
+import argparse
+import numpy as np
+import csi_frame
+
+"""
+CSI trace files (see esp32c5/csi_recv/main/csi_trace.h)
+
+A 16-byte file header, then one record per received frame: a 20-byte record
+header with the rx_ctrl fields and gains, followed by the raw int8 I/Q.
+Traces are replayed through the firmware pipeline by host/csi_replay and can
+be fed to get_br() here. The binary serial mode streams the same records,
+host/csi_serial_decode turns a capture into a trace.
+"""
+
+MAGIC = b"CSIT"
+VERSION = 1
+FILE_HEADER = struct.Struct("<4sHH8x")
+RECORD = struct.Struct("<qbBbBbBBBH2x")
+FIELDS = (
+    "timestamp_us",
+    "rssi",
+    "rate",
+    "noise_floor",
+    "agc_gain",
+    "fft_gain",
+    "channel",
+    "first_word_invalid",
+    "second",
+)
+MAX_LEN = 384
+
+
+def write(path, records):
+    """Write (fields dict, int8 I/Q) records, returns the record count"""
+    count = 0
+    with open(path, "wb") as f:
+        f.write(FILE_HEADER.pack(MAGIC, VERSION, RECORD.size))
+        for fields, iq in records:
+            iq = np.asarray(iq, dtype=np.int8)
+            if len(iq) > MAX_LEN:
+                raise ValueError(f"Record of {len(iq)} bytes exceeds {MAX_LEN}")
+            f.write(RECORD.pack(*(int(fields.get(k, 0)) for k in FIELDS), len(iq)))
+            f.write(iq.tobytes())
+            count += 1
+    return count
+
+
+def read(path):
+    """Yields (fields dict, int8 I/Q array) for every record"""
+    with open(path, "rb") as f:
+        magic, version, record_size = FILE_HEADER.unpack(f.read(FILE_HEADER.size))
+        if magic != MAGIC or version != VERSION or record_size != RECORD.size:
+            raise ValueError(f"{path}: not a version {VERSION} CSI trace")
+        while True:
+            head = f.read(RECORD.size)
+            if not head:
+                return
+            if len(head) < RECORD.size:
+                raise ValueError(f"{path}: truncated record header")
+            *values, length = RECORD.unpack(head)
+            data = f.read(length)
+            if len(data) < length:
+                raise ValueError(f"{path}: truncated record")
+            yield dict(zip(FIELDS, values)), np.frombuffer(data, dtype=np.int8)
+
+
+"""
+Parses one line of the serial CSI_DATA output of the CSI_Q_ENABLE == 0 path:
+CSI_DATA,count,mac,rssi,rate,noise_floor,fft_gain,agc_gain,channel,
+timestamp,sig_len,rx_state,len,first_word_invalid,"[i0,q0,...]"
+Returns (fields dict, int8 I/Q) or None for any other line, including the
+short per-frame summary line printed before it
+"""
+
+
+def parse_serial_line(line):
+    start = line.find("CSI_DATA,")
+    bracket = line.find('"[', start)
+    if start < 0 or bracket < 0:
+        return None
+
+    head = line[start:bracket].rstrip(",").split(",")
+    if len(head) != 14:
+        return None
+    body = line[bracket + 2 :].strip().rstrip('"').rstrip("]")
+    try:
+        iq = np.array([int(v) for v in body.split(",")], dtype=np.int8)
+        _, _, _, rssi, rate, noise, fft, agc, channel, ts, _, _, length, fwi = head
+        fields = {
+            "timestamp_us": int(ts),
+            "rssi": int(rssi),
+            "rate": int(rate),
+            "noise_floor": int(noise),
+            "agc_gain": int(agc),
+            "fft_gain": int(fft),
+            "channel": int(channel),
+            "first_word_invalid": int(fwi),
+        }
+    except ValueError:
+        return None
+    if len(iq) != int(length):
+        return None
+    return fields, iq
+
+
+def from_serial(lines):
+    """Records from a serial log, with the 32-bit rx timestamp unwrapped"""
+    offset = 0
+    last = None
+    for line in lines:
+        record = parse_serial_line(line)
+        if record is None:
+            continue
+        fields, iq = record
+        if last is not None and fields["timestamp_us"] < last:
+            offset += 1 << 32
+        last = fields["timestamp_us"]
+        fields["timestamp_us"] += offset
+        yield fields, iq
+
+
+def synth(
+    seconds,
+    fs=100,
+    bpm=15,
+    motion=None,
+    snr_db=20,
+    seed=0,
+    layouts=("ht20",),
+    fades=0,
+    hr=None,
+    heart_depth=0.02,
+):
+    """
+    Synthetic trace breathing at `bpm`, with optional (start_s, end_s) of
+    movement that perturbs amplitude and RSSI
+    With `hr`, a heartbeat at that rate adds `heart_depth` of amplitude
+    modulation on every subcarrier
+    Every frame takes a random layout out of `layouts` (csi_frame.LAYOUT_NAMES);
+    all are cut from one channel, so their band views agree
+    With `fades`, the breathing reflection is frequency selective: its depth
+    goes through that many nulls across the 53 band view subcarriers, at a
+    random offset, instead of being the same on every subcarrier
+    """
+    rng = np.random.default_rng(seed)
+    # One channel over every subcarrier a layout can cover, -90..90 relative
+    # to the primary channel
+    span = 181
+    base = rng.uniform(20, 40, span) * np.exp(1j * rng.uniform(0, 2 * np.pi, span))
+    noise = np.sqrt(np.mean(np.abs(base) ** 2) / 10 ** (snr_db / 10) / 2)
+    layouts = [csi_frame.LAYOUT_NAMES[name] for name in layouts]
+    index = [csi_frame.subcarrier_index(layout) + span // 2 for layout in layouts]
+    depth = np.full(span, 0.05)
+    if fades:
+        offset = rng.uniform(0, np.pi)
+        k = np.arange(span) - span // 2
+        depth = 0.1 * np.abs(np.cos(np.pi * fades * k / 53 + offset))
+    for n in range(int(seconds * fs)):
+        t = n / fs
+        k = int(rng.integers(len(layouts))) if len(layouts) > 1 else 0
+        sc = index[k]
+        z = base[sc] * (1 + depth[sc] * np.sin(2 * np.pi * bpm / 60 * t))
+        if hr:
+            z = z + base[sc] * heart_depth * np.sin(2 * np.pi * hr / 60 * t + 1.0)
+        rssi = -45 + int(rng.integers(0, 2))
+        if motion and motion[0] <= t < motion[1]:
+            z = z * (1 + 0.3 * np.sin(2 * np.pi * 0.7 * t + sc * 0.5))
+            rssi += int(rng.integers(-3, 4))
+        z = z + rng.normal(0, noise, len(sc)) + 1j * rng.normal(0, noise, len(sc))
+        iq = np.empty(2 * len(sc))
+        iq[0::2] = z.imag
+        iq[1::2] = z.real
+        fields = {
+            "timestamp_us": n * 1_000_000 // fs,
+            "rssi": rssi,
+            "channel": 64,
+            "second": layouts[k].second,
+        }
+        yield fields, np.clip(np.round(iq), -128, 127).astype(np.int8)
+
+
+def info(path):
+    records = list(read(path))
+    if not records:
+        print(f"{path}: empty")
+        return
+    ts = np.array([fields["timestamp_us"] for fields, _ in records])
+    layouts = [
+        csi_frame.lookup_layout(len(iq) // 2, fields["second"])
+        for fields, iq in records
+    ]
+    names = np.unique(
+        [
+            layout.name if layout else f"unknown {len(iq)}"
+            for layout, (_, iq) in zip(layouts, records)
+        ],
+        return_counts=True,
+    )
+    duration = (ts[-1] - ts[0]) / 1e6
+    print(f"{path}: {len(records)} frames over {duration:.1f} s")
+    if len(ts) > 1:
+        gaps = np.diff(ts) / 1000
+        print(
+            f"  rate {(len(ts) - 1) / max(duration, 1e-9):.1f} Hz, "
+            f"gap p50 {np.median(gaps):.2f} ms, max {gaps.max():.2f} ms"
+        )
+    print("  layouts " + ", ".join(f"{l}: {c}" for l, c in zip(*names)))
+
+    # get_br() on the band view of the last 15 s of frames of known layouts
+    rows = [
+        csi_frame.band(iq[None, :], layout, fields["first_word_invalid"])[0]
+        for layout, (fields, iq) in zip(layouts, records)
+        if layout
+    ][-1500:]
+    if len(rows) == 1500:
+        import breathing
+
+        print(
+            f"  get_br over the last 15 s: {breathing.get_br(np.array(rows)):.2f} BPM"
+        )
+        for name, v in breathing.get_vitals(np.array(rows)).items():
+            if v["bpm"] is not None:
+                print(
+                    f"  {name} over the last 15 s: {v['bpm']:.2f} BPM, "
+                    f"confidence {v['confidence']:.2f}"
+                )
+
+
+def _acf_peak(acf, bpm, fs=100):
+    # Local maximum of the ACF a rate was read from, None if there is none
+    lag = int(round(fs * 60 / bpm))
+    for k in (lag, lag - 1, lag + 1):
+        if 0 < k < len(acf) - 1 and acf[k - 1] <= acf[k] >= acf[k + 1]:
+            return k
+    return None
+
+
+def br_check(path, tool, tolerance=0.15, hop=100, margin=0.002):
+    """
+    The firmware's breathing engine (host/breathing_replay) against get_br()
+    on the same windows of a trace: prints every window whose rates differ
+    by more than `tolerance` BPM and returns how many did
+    The device's fixed-point autocorrelation can peak one lag off, which is
+    rate**2 / 6000 BPM at 100 Hz; the default allows that up to 30 BPM.
+    Its ACF is also within `margin` of get_br()'s, so windows whose peak
+    passes a height or prominence threshold, or the plausible range, by less
+    than that, or that has two peaks as high within that, could go either
+    way; they are counted apart and do not fail
+    """
+    import itertools
+    import subprocess
+    import breathing
+
+    rows = np.array(
+        [
+            csi_frame.band(iq[None, :], layout, fields["first_word_invalid"])[0]
+            for fields, iq in read(path)
+            for layout in [csi_frame.lookup_layout(len(iq) // 2, fields["second"])]
+            if layout
+        ]
+    )
+    out = subprocess.run(
+        [tool, "--hop", str(hop), path], check=True, capture_output=True, text=True
+    ).stdout
+    estimates = [tuple(map(float, line.split(","))) for line in out.split()]
+    if not estimates:
+        print(f"{path}: no estimates, the trace is shorter than a window")
+        return 0
+
+    failures, edges, worst = 0, 0, 0.0
+    for frames, device in estimates:
+        frames = int(frames)
+        acf = breathing.br_acf(rows[frames - 1500 : frames])
+        backend = breathing.acf_br(acf)
+        diff = abs(device - backend)
+        worst = max(worst, diff)
+        if diff <= tolerance:
+            continue
+        # One lag moves the plausible range by at most `tolerance`
+        outcomes = [
+            breathing.acf_br(
+                acf,
+                height=0.01 + h,
+                prominence=0.05 + p,
+                plausible=(8 + r, 25 + r),
+            )
+            for h, p, r in itertools.product(
+                (-margin, margin), (-margin, margin), (-tolerance, 0, tolerance)
+            )
+        ]
+        # Or two local maxima within `margin` of each other, where the
+        # prominence of the first depends on which is higher
+        lags = [_acf_peak(acf, br) for br in (device, backend)]
+        edge = any(abs(device - br) <= tolerance for br in outcomes) or (
+            None not in lags and abs(acf[lags[0]] - acf[lags[1]]) <= margin
+        )
+        edges += edge
+        failures += not edge
+        print(
+            f"  window ending at frame {frames}: device {device:.2f} BPM, "
+            f"get_br {backend:.2f} BPM" + (", on a threshold" if edge else "")
+        )
+    print(
+        f"{path}: {len(estimates)} windows, largest difference {worst:.4f} BPM, "
+        f"{failures} outside {tolerance} BPM, {edges} more on a threshold"
+    )
+    return failures
+
+
+def bench(path, bpm=None, batch=10):
+    """
+    StreamingBreathing over a trace with the fixed and the ranked subcarrier
+    band, fed `batch` frames at a time as ingest.py does: time per frame,
+    and the mean absolute error of the estimates if the true `bpm` is known
+    """
+    import time
+    import breathing
+
+    rows = [
+        csi_frame.band(iq[None, :], layout, fields["first_word_invalid"])[0]
+        for fields, iq in read(path)
+        for layout in [csi_frame.lookup_layout(len(iq) // 2, fields["second"])]
+        if layout
+    ]
+    rows = np.array(rows)
+    for adaptive in (False, True):
+        estimator = breathing.StreamingBreathing(adaptive=adaptive)
+        estimates = []
+        start = time.perf_counter()
+        for i in range(0, len(rows), batch):
+            estimate = estimator.update(rows[i : i + batch])
+            if estimate is not None:
+                estimates.append(estimate)
+        elapsed = time.perf_counter() - start
+        line = (
+            f"{'ranked' if adaptive else 'fixed':6} "
+            f"{elapsed / max(len(rows), 1) * 1e6:6.1f} us/frame, "
+            f"{len(estimates)} estimates"
+        )
+        if bpm is not None and estimates:
+            line += f", error {np.mean(np.abs(np.array(estimates) - bpm)):.2f} BPM"
+        if adaptive:
+            line += ", subcarriers " + " ".join(map(str, estimator.selected))
+        print(line)
+
+
+def _chain_bpm(s, fs, band):
+    # One filter chain per vital sign, as get_br() does for breathing:
+    # zero-phase band-pass, then the first ACF peak
+    from scipy.signal import butter, correlate, find_peaks, sosfiltfilt
+
+    sos = butter(3, band, "band", fs=fs, output="sos")
+    x = sosfiltfilt(sos, s - s.mean())
+    acf = correlate(x, x, mode="full")[len(x) - 1 :]
+    peaks, _ = find_peaks(acf[int(fs / band[1]) :])
+    if not len(peaks):
+        return None
+    return 60 * fs / (peaks[0] + int(fs / band[1]))
+
+
+def vitals_bench(seconds=60, traces=4, snrs=(0, 10, 20, 30), heart_depth=0.02):
+    """
+    breathing.VitalSigns on synthetic traces at known breathing and heart
+    rates, `traces` per SNR: mean absolute error and median confidence of both
+    bands, the share of windows confident enough to report a rate (the error
+    is over those), how often the ACF cross-check agrees, and the time per
+    frame. A heart depth of 0 checks that no heartbeat is reported. The
+    same windows also go through a band-pass and ACF chain per vital sign,
+    which is timed and scored against the single FFT of estimate_vitals()
+    """
+    import time
+    import breathing
+
+    print(
+        f"{seconds:g} s traces, heart depth {heart_depth:g}; error BPM, "
+        "confidence and ACF agreement for breathing/heart"
+    )
+    for snr in snrs:
+        errors, confidence, agree, chain_errors = [], [], [], []
+        frame_s = fft_s = chain_s = 0.0
+        frames = hops = 0
+        for seed in range(traces):
+            rng = np.random.default_rng(1000 + seed)
+            bpm = rng.uniform(10, 20)
+            hr = rng.uniform(55, 100)
+            rows = np.array(
+                [
+                    csi_frame.band(
+                        iq[None, :],
+                        csi_frame.lookup_layout(len(iq) // 2, fields["second"]),
+                        0,
+                    )[0]
+                    for fields, iq in synth(
+                        seconds,
+                        bpm=bpm,
+                        snr_db=snr,
+                        seed=seed,
+                        hr=hr,
+                        heart_depth=heart_depth,
+                    )
+                ]
+            )
+            estimator = breathing.VitalSigns()
+            start = time.perf_counter()
+            for i in range(0, len(rows), 10):
+                vitals = estimator.update(rows[i : i + 10])
+                if vitals is None:
+                    continue
+                errors.append(
+                    [
+                        abs(v["bpm"] - true) if v["bpm"] is not None else np.nan
+                        for v, true in zip(vitals.values(), (bpm, hr))
+                    ]
+                )
+                confidence.append(
+                    [vitals["breathing"]["confidence"], vitals["heart"]["confidence"]]
+                )
+                agree.append([vitals["breathing"]["agree"], vitals["heart"]["agree"]])
+            frame_s += time.perf_counter() - start
+            frames += len(rows)
+
+            s = np.abs(breathing.subcarrier_band_mean(rows))
+            for end in range(estimator.window, len(s) + 1, estimator.hop):
+                window = s[end - estimator.window : end]
+                start = time.perf_counter()
+                breathing.estimate_vitals(window)
+                fft_s += time.perf_counter() - start
+                start = time.perf_counter()
+                rates = [
+                    _chain_bpm(window, 100, band)
+                    for band in breathing.VITAL_BANDS.values()
+                ]
+                chain_s += time.perf_counter() - start
+                chain_errors.append(
+                    [
+                        abs(r - true) if r else np.nan
+                        for r, true in zip(rates, (bpm, hr))
+                    ]
+                )
+                hops += 1
+
+        errors = np.array(errors)
+        given = ~np.isnan(errors)
+        reported = given.mean(axis=0)
+        errors = [
+            errors[given[:, i], i].mean() if given[:, i].any() else np.nan
+            for i in (0, 1)
+        ]
+        confidence = np.median(confidence, axis=0)
+        agree = np.mean(agree, axis=0)
+        chain_errors = np.nanmean(chain_errors, axis=0)
+        print(
+            f"{snr:3g} dB: error {errors[0]:5.2f}/{errors[1]:5.2f}, "
+            f"confidence {confidence[0]:.2f}/{confidence[1]:.2f}, "
+            f"reported {reported[0]:.0%}/{reported[1]:.0%}, "
+            f"agree {agree[0]:.2f}/{agree[1]:.2f}, "
+            f"{frame_s / frames * 1e6:5.1f} us/frame; per hop FFT "
+            f"{fft_s / hops * 1e3:.2f} ms, chains {chain_s / hops * 1e3:.2f} ms "
+            f"(error {chain_errors[0]:5.2f}/{chain_errors[1]:5.2f})"
+        )
+
+
+def main():
+    parser = argparse.ArgumentParser(description="CSI trace tools")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    convert = sub.add_parser("convert", help="serial CSI_DATA log to trace")
+    convert.add_argument("log", help="serial log, - for stdin")
+    convert.add_argument("trace")
+
+    gen = sub.add_parser("synth", help="write a synthetic trace")
+    gen.add_argument("trace")
+    gen.add_argument("--seconds", type=float, default=60)
+    gen.add_argument("--bpm", type=float, default=15)
+    gen.add_argument(
+        "--motion", type=float, nargs=2, metavar=("START", "END"), default=None
+    )
+    gen.add_argument("--snr", type=float, default=20, help="dB")
+    gen.add_argument("--seed", type=int, default=0)
+    gen.add_argument(
+        "--layouts",
+        default="ht20",
+        help="comma-separated frame layouts to mix, of "
+        + ", ".join(csi_frame.LAYOUT_NAMES),
+    )
+    gen.add_argument("--hr", type=float, default=None, help="heart rate, BPM")
+    gen.add_argument(
+        "--fades",
+        type=float,
+        default=0,
+        help="nulls of the breathing depth across the band, 0 for flat",
+    )
+
+    show = sub.add_parser("info", help="summarise a trace")
+    show.add_argument("trace")
+
+    check = sub.add_parser(
+        "br-check", help="firmware breathing engine against get_br()"
+    )
+    check.add_argument("trace", nargs="+")
+    check.add_argument(
+        "--tool",
+        default="../esp32c5/csi_recv/host/breathing_replay",
+        help="built host/breathing_replay",
+    )
+    check.add_argument("--tolerance", type=float, default=0.15, help="BPM")
+    check.add_argument("--hop", type=int, default=100, help="frames")
+
+    timing = sub.add_parser(
+        "bench", help="streaming breathing, fixed against ranked subcarriers"
+    )
+    timing.add_argument("trace")
+    timing.add_argument("--bpm", type=float, default=None, help="true rate")
+
+    vitals = sub.add_parser(
+        "vitals", help="breathing and heart rate accuracy and time, synthetic"
+    )
+    vitals.add_argument("--seconds", type=float, default=60)
+    vitals.add_argument("--traces", type=int, default=4, help="per SNR")
+    vitals.add_argument("--heart-depth", type=float, default=0.02)
+    vitals.add_argument(
+        "--snr", type=float, nargs="+", default=[0, 10, 20, 30], help="dB"
+    )
+
+    args = parser.parse_args()
+    if args.cmd == "convert":
+        log = sys.stdin if args.log == "-" else open(args.log, errors="replace")
+        with log:
+            count = write(args.trace, from_serial(log))
+        print(f"Wrote {count} frames to {args.trace}")
+    elif args.cmd == "synth":
+        count = write(
+            args.trace,
+            synth(
+                args.seconds,
+                bpm=args.bpm,
+                motion=args.motion,
+                snr_db=args.snr,
+                seed=args.seed,
+                layouts=args.layouts.split(","),
+                fades=args.fades,
+                hr=args.hr,
+            ),
+        )
+        print(f"Wrote {count} frames to {args.trace}")
+    elif args.cmd == "br-check":
+        failures = sum(
+            br_check(path, args.tool, args.tolerance, args.hop) for path in args.trace
+        )
+        sys.exit(1 if failures else 0)
+    elif args.cmd == "bench":
+        bench(args.trace, args.bpm)
+    elif args.cmd == "vitals":
+        vitals_bench(args.seconds, args.traces, args.snr, args.heart_depth)
+    else:
+        info(args.trace)
+
+
+if __name__ == "__main__":
+    main()
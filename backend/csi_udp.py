@@ -0,0 +1,139 @@
+import struct
+
+"""
+csi/data messages over UDP (see esp32c5/csi_recv/main/csi_udp.h)
+
+Receivers built with CSI_TRANSPORT_UDP send their csi/data messages straight
+to the backend instead of through the broker. Every datagram carries the
+device MAC, the sequence number of its last message and, oldest first, up to
+CSI_UDP_MAX_REDUNDANCY messages before it, so one lost datagram is made up by
+the next.
+
+Header (little-endian, 16 bytes):
+    magic u8, version u8, flags u8, count u8, mac 6 bytes, boot u16, seq u32
+followed by count messages, each a u16 length and the message; the last one
+has sequence number seq, the ones before it count down by one. boot is drawn
+anew at every start of the receiver, whose sequence numbers start over at 0;
+receivers without one send 0.
+"""
+
+MAGIC = 0xC7
+VERSION = 1
+HEADER = struct.Struct("<BBBB6sHI")
+ENTRY = struct.Struct("<H")
+# Without a boot id, a sequence number this far behind the expected one means
+# the device started over rather than a late datagram. A restart takes
+# seconds, reordering on a LAN a few datagrams at most
+RESTART_GAP = 32
+
+
+def is_datagram(data):
+    return len(data) > 0 and data[0] == MAGIC
+
+
+"""
+Splits one datagram
+Returns (device, boot, seq, messages): device is the MAC as in the
+csi/data/<mac> topic, boot its boot id or 0, seq the sequence number of the
+last of the messages
+"""
+
+
+def parse(data):
+    if len(data) < HEADER.size:
+        raise ValueError("CSI datagram shorter than header")
+    magic, version, _, count, mac, boot, seq = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        raise ValueError(f"Bad CSI datagram magic {magic:#x}")
+    if version != VERSION:
+        raise ValueError(f"Unsupported CSI datagram version {version}")
+    messages = []
+    pos = HEADER.size
+    for _ in range(count):
+        if pos + ENTRY.size > len(data):
+            raise ValueError("CSI datagram shorter than its messages")
+        (n,) = ENTRY.unpack_from(data, pos)
+        pos += ENTRY.size
+        if pos + n > len(data):
+            raise ValueError("CSI datagram shorter than its messages")
+        messages.append(data[pos : pos + n])
+        pos += n
+    if not messages:
+        raise ValueError("CSI datagram without messages")
+    return mac.hex(), boot, seq, messages
+
+
+"""
+Turns the datagrams of any number of devices back into each device's message
+sequence
+push() returns the device and its messages not seen before, in sequence
+order, straight away: a gap no later datagram has filled yet counts as lost
+instead of holding the messages after it back. Messages that only arrived as
+a repeat count as recovered. A new boot id starts the device's sequence over;
+from receivers without one, so does a datagram far behind the expected
+sequence number or one that carries message 0 again.
+"""
+
+
+class Receiver:
+    def __init__(self):
+        # device -> sequence number of the next message
+        self.next_seq = {}
+        # device -> boot id of the last datagram
+        self.boot = {}
+        # device -> counters, see stats()
+        self.counts = {}
+        self.malformed = 0
+
+    def stats(self, device):
+        return dict(self.counts[device])
+
+    def devices(self):
+        return list(self.counts)
+
+    def push(self, data):
+        try:
+            device, boot, seq, messages = parse(data)
+        except ValueError:
+            self.malformed += 1
+            raise
+        counts = self.counts.get(device)
+        if counts is None:
+            counts = self.counts[device] = {
+                "received": 0,
+                "recovered": 0,
+                "lost": 0,
+                "duplicates": 0,
+                "restarts": 0,
+            }
+        first = (seq - len(messages) + 1) & 0xFFFFFFFF
+        expected = self.next_seq.get(device)
+        if expected is None:
+            expected = first
+        # Signed distance from the expected sequence number to the last one
+        ahead = ((seq - expected + 0x80000000) & 0xFFFFFFFF) - 0x80000000
+        last_boot = self.boot.get(device)
+        self.boot[device] = boot
+        if last_boot is None:
+            restarted = False
+        elif boot or last_boot:
+            restarted = boot != last_boot
+        else:
+            # A restart before the sequence number got RESTART_GAP far still
+            # sends message 0 again, where a late datagram would repeat it
+            restarted = ahead < -RESTART_GAP or (ahead < 0 and first == 0)
+        if restarted:
+            counts["restarts"] += 1
+            expected = first
+            ahead = len(messages) - 1
+        if ahead < 0:
+            # A datagram that came twice or late, not a repeat
+            counts["duplicates"] += 1
+            return device, []
+
+        new = messages[-(ahead + 1) :]
+        counts["lost"] += ahead + 1 - len(new)
+        counts["received"] += len(new)
+        counts["recovered"] += len(new) - 1
+        self.next_seq[device] = (seq + 1) & 0xFFFFFFFF
+        return device, new
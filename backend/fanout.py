@@ -0,0 +1,307 @@
+import sys
+import json
+import time
+import struct
+import asyncio
+import argparse
+from collections import deque
+import numpy as np
+from websockets.exceptions import ConnectionClosed
+
+"""
+WebSocket fan-out
+Every client gets its own bounded outbound queue and writer task, so one slow
+browser only ever delays (and drops) its own messages. Data entries are
+coalesced and sent as one "batch" message per UI refresh tick, encoded once
+for all clients.
+"""
+
+# Binary batch: magic, u32 JSON length, JSON (entries without CSIs, each with
+# "csi_len"), then every entry's CSIs as int8 in order. CSIs are int8 I/Q
+# pairs; the float subcarrier amplitudes of decimated-mode entries stay in the
+# JSON as "amplitudes"
+BINARY_MAGIC = b"CSIB"
+BINARY_HEADER = struct.Struct("<4sI")
+
+
+def encode_batch_json(entries):
+    return json.dumps({"type": "batch", "data": entries})
+
+
+def encode_batch_binary(entries):
+    meta = []
+    arrays = []
+    for entry in entries:
+        csis = entry.get("CSIs") or []
+        arrays.append(np.clip(np.asarray(csis), -128, 127).astype(np.int8))
+        meta.append(
+            {
+                **{k: v for k, v in entry.items() if k != "CSIs"},
+                "csi_len": len(csis),
+            }
+        )
+
+    body = json.dumps({"type": "batch", "data": meta}).encode()
+    return (
+        BINARY_HEADER.pack(BINARY_MAGIC, len(body))
+        + body
+        + b"".join(a.tobytes() for a in arrays)
+    )
+
+
+class ClientChannel:
+    def __init__(self, websocket, depth):
+        self.websocket = websocket
+        self.queue = deque(maxlen=depth)
+        self.wakeup = asyncio.Event()
+        self.binary = False
+        self.dropped = 0
+
+    def push(self, message):
+        # Full queue: deque(maxlen) evicts the oldest message
+        if len(self.queue) == self.queue.maxlen:
+            self.dropped += 1
+        self.queue.append(message)
+        self.wakeup.set()
+
+    async def run(self):
+        try:
+            while True:
+                await self.wakeup.wait()
+                self.wakeup.clear()
+                while self.queue:
+                    await self.websocket.send(self.queue.popleft())
+        except ConnectionClosed:
+            pass
+
+
+class Broadcaster:
+    def __init__(self, refresh_hz=10, queue_depth=32):
+        self.period = 1 / refresh_hz
+        self.queue_depth = queue_depth
+        self.channels = {}
+        self.pending = []
+
+    def add_client(self, websocket):
+        channel = ClientChannel(websocket, self.queue_depth)
+        self.channels[websocket] = channel
+        return channel
+
+    def remove_client(self, websocket):
+        self.channels.pop(websocket, None)
+
+    def set_binary(self, websocket, binary):
+        if websocket in self.channels:
+            self.channels[websocket].binary = binary
+
+    """
+    Sent immediately (still through the per-client queue), not coalesced
+    """
+
+    def send_now(self, message):
+        for channel in self.channels.values():
+            channel.push(message)
+
+    """
+    Queued for the next batch; must be called on the event loop thread
+    """
+
+    def add(self, entry):
+        self.pending.append(entry)
+
+    def flush(self):
+        if not self.pending or not self.channels:
+            self.pending = []
+            return
+
+        entries, self.pending = self.pending, []
+        encoded = {}
+        for channel in self.channels.values():
+            if channel.binary not in encoded:
+                encoded[channel.binary] = (
+                    encode_batch_binary(entries)
+                    if channel.binary
+                    else encode_batch_json(entries)
+                )
+            channel.push(encoded[channel.binary])
+
+    async def run(self):
+        while True:
+            await asyncio.sleep(self.period)
+            self.flush()
+
+
+class _FakeClient:
+    """
+    Stand-in WebSocket for bench(): each send takes `delay` seconds, or
+    never returns with None, and the entries of every batch received are
+    recorded with the time they arrived
+    """
+
+    def __init__(self, delay):
+        self.delay = delay
+        self.received = []  # (time received, seqs of the batch, times added)
+        self.stuck = asyncio.Event()
+        self.sending = False
+
+    async def send(self, message):
+        self.sending = True
+        if self.delay is None:
+            await self.stuck.wait()
+        await asyncio.sleep(self.delay)
+        self.sending = False
+        entries = json.loads(message)["data"]
+        self.received.append(
+            (
+                time.monotonic(),
+                [e["seq"] for e in entries],
+                [e["t"] for e in entries],
+            )
+        )
+
+
+async def _bench(fast, slow, stalled, seconds, rate, refresh_hz, depth, slow_s):
+    broadcaster = Broadcaster(refresh_hz, depth)
+    kinds = ["fast"] * fast + ["slow"] * slow + ["stalled"] * stalled
+    delays = {"fast": 0, "slow": slow_s, "stalled": None}
+    clients = [_FakeClient(delays[kind]) for kind in kinds]
+    channels = [broadcaster.add_client(client) for client in clients]
+
+    # Batches pushed to every client, counted as Broadcaster.flush() sends
+    pushed = 0
+    flush = broadcaster.flush
+
+    def counted_flush():
+        nonlocal pushed
+        pushed += bool(broadcaster.pending and broadcaster.channels)
+        flush()
+
+    broadcaster.flush = counted_flush
+    tasks = [asyncio.create_task(c.run()) for c in channels]
+    tasks.append(asyncio.create_task(broadcaster.run()))
+
+    # Entries arrive in small bursts, as MQTT messages of one device would
+    produced = 0
+    tick = 0.01
+    end = time.monotonic() + seconds
+    while time.monotonic() < end:
+        for _ in range(max(int(rate * tick), 1)):
+            broadcaster.add({"seq": produced, "t": time.monotonic()})
+            produced += 1
+        await asyncio.sleep(tick)
+    broadcaster.flush()
+
+    # Let the slow clients work through what is still queued
+    drain = time.monotonic() + (depth + 2) * slow_s + 1
+    while time.monotonic() < drain and any(
+        channel.queue or client.sending
+        for channel, client, kind in zip(channels, clients, kinds)
+        if kind != "stalled"
+    ):
+        await asyncio.sleep(0.01)
+    for task in tasks:
+        task.cancel()
+    await asyncio.gather(*tasks, return_exceptions=True)
+    return kinds, clients, channels, produced, pushed
+
+
+def bench(
+    fast=4,
+    slow=2,
+    stalled=1,
+    seconds=3,
+    rate=1000,
+    refresh_hz=10,
+    queue_depth=8,
+    slow_s=0.25,
+):
+    """
+    Fans a stream of `rate` entries/s out to in-process fast clients, slow
+    ones taking `slow_s` per send, and stalled ones whose sends never
+    return, through a Broadcaster with `queue_depth` messages per client
+    Checks that:
+    - fast clients get every entry once, in order, within two refresh periods
+      of its arrival, whatever the others do
+    - slow clients get whole batches in order, ending with the latest, and
+      every batch is either sent or counted as dropped
+    - stalled clients hold no more than the queue depth
+    Returns the number of failed checks
+    """
+    kinds, clients, channels, produced, pushed = asyncio.run(
+        _bench(fast, slow, stalled, seconds, rate, refresh_hz, queue_depth, slow_s)
+    )
+    period = 1 / refresh_hz
+    failures = 0
+
+    def check(ok, what):
+        nonlocal failures
+        if not ok:
+            failures += 1
+            print(f"  FAILED: {what}")
+
+    print(
+        f"{produced} entries in {pushed} batches of {1 / period:g} Hz, "
+        f"queue depth {queue_depth}"
+    )
+    for n, (kind, client, channel) in enumerate(zip(kinds, clients, channels)):
+        seqs = [seq for _, batch, _ in client.received for seq in batch]
+        lag = max(
+            (t - min(added) for t, _, added in client.received if added), default=0
+        )
+        print(
+            f"client {n} ({kind}): {len(client.received)} batches, "
+            f"{len(seqs)} entries, {channel.dropped} dropped, "
+            f"{len(channel.queue)} queued, lag up to {lag * 1e3:.0f} ms"
+        )
+        check(seqs == sorted(set(seqs)), f"client {n} entries out of order")
+        if kind == "fast":
+            check(seqs == list(range(produced)), f"client {n} missed entries")
+            check(lag < 2 * period, f"client {n} lagged {lag * 1e3:.0f} ms")
+            check(channel.dropped == 0, f"client {n} dropped batches")
+        elif kind == "slow":
+            check(channel.dropped > 0, f"client {n} was never coalesced")
+            check(
+                len(client.received) + channel.dropped == pushed,
+                f"client {n} batches neither sent nor dropped",
+            )
+            check(
+                bool(seqs) and seqs[-1] == produced - 1,
+                f"client {n} did not end with the latest entry",
+            )
+        else:
+            check(len(channel.queue) <= queue_depth, f"client {n} queue overran")
+            check(
+                channel.dropped + len(channel.queue) + 1 == pushed,
+                f"client {n} batches neither queued nor dropped",
+            )
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description="WebSocket fan-out tools")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    timing = sub.add_parser("bench", help="fast clients next to slow and stalled")
+    timing.add_argument("--fast", type=int, default=4)
+    timing.add_argument("--slow", type=int, default=2)
+    timing.add_argument("--stalled", type=int, default=1)
+    timing.add_argument("--seconds", type=float, default=3)
+    timing.add_argument("--rate", type=float, default=1000, help="entries/s")
+    timing.add_argument("--depth", type=int, default=8, help="queue per client")
+    timing.add_argument("--slow-send", type=float, default=0.25, help="seconds")
+
+    args = parser.parse_args()
+    failures = bench(
+        args.fast,
+        args.slow,
+        args.stalled,
+        args.seconds,
+        args.rate,
+        queue_depth=args.depth,
+        slow_s=args.slow_send,
+    )
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
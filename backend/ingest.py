@@ -0,0 +1,433 @@
+import os
+import time
+import zlib
+import queue
+import threading
+import multiprocessing as mp
+import numpy as np
+from ast import literal_eval
+import breathing as breathing
+import csi_codec
+import csi_frame
+import csi_store
+
+"""
+Multi-device CSI ingest
+Every device gets its own session (breathing window, last sequence number),
+one per link when the receiver hears several transmitters (csi_link.h).
+Sessions live in worker processes; a device is always routed to the same
+worker, so its messages are processed in arrival order while different
+devices run in parallel on separate cores. With a store directory the worker
+is also the single writer of its devices' csi_store.DeviceStore.
+"""
+
+
+"""
+Device key for a topic: csi/data/<mac> -> <mac>
+Topics without a device segment (old firmware) map to the topic itself
+"""
+
+
+def device_id(topic):
+    parts = topic.split("/")
+    return parts[2] if len(parts) > 2 else topic
+
+
+"""
+Decodes a csi/data payload in either wire format
+Returns (band rows, rssi, motion_detect, binary header or None)
+The rows are the primary-channel band view of whatever layout the frames came
+in (csi_frame.band()), so messages of different layouts line up; they are
+None for a layout the decoder does not know
+Text payloads carry HT20 frames only, as the firmware leaves every other
+layout out of them, and no motion confidence
+Coded binary payloads need the device's csi_codec.Decoder as `codec`
+"""
+
+
+def parse_payload(payload, codec=None):
+    if csi_frame.is_binary(payload):
+        header, csi = csi_frame.decode(payload, codec)
+        layout = header["layout"]
+        if layout is None:
+            return None, header["rssi"], header["motion_detect"], header
+        rows = csi_frame.band(csi, layout, header["first_word_invalid"])
+        return rows, header["rssi"], header["motion_detect"], header
+
+    # Legacy comma-separated text payload
+    csi = list(literal_eval(payload.decode()))
+    rssi = csi.pop(-1)
+    motion_detect = csi.pop(-1)
+    rows = np.array(csi).reshape(-1, 114)
+    ht20 = csi_frame.LAYOUTS[csi_frame.LAYOUT_HT20]
+    return csi_frame.band(rows, ht20), rssi, motion_detect, None
+
+
+"""
+Puts CSI rows back on the sender's uniform grid using the probe sequence
+numbers (csi_probe.h): csi_send transmits one probe every 10 ms by its own
+clock, so sequence n belongs at grid position n
+Duplicates and frames older than the last one are dropped, and gaps of up to
+max_gap lost frames are filled by linear interpolation between the frames on
+either side; the filled rows stay int8 so the native kernels still apply
+A longer gap, or a sender reboot, restarts the grid
+push() returns (rows, restarted); after a restart the caller should drop state
+built on the old grid
+"""
+
+
+class SequenceResampler:
+    def __init__(self, max_gap=100):
+        self.max_gap = max_gap
+        self.last_seq = None
+        self.last_row = None
+        self.filled = 0
+        self.dropped = 0
+        self.restarts = 0
+
+    def push(self, probe_seq, rows):
+        seq = np.asarray(probe_seq, dtype=np.int64)
+        if len(seq) == 0:
+            return rows, False
+
+        # Fast path: the batch continues the grid without a gap
+        first = seq[0] - 1 if self.last_seq is None else self.last_seq
+        if seq[0] - first == 1 and np.all(np.diff(seq) == 1):
+            self.last_seq = int(seq[-1])
+            self.last_row = rows[-1]
+            return rows, False
+
+        out = []
+        restarted = False
+        for s, row in zip(seq.tolist(), rows):
+            if self.last_seq is None:
+                step = 1
+            else:
+                # Signed 32-bit distance, survives the counter wrapping
+                step = ((s - self.last_seq + 2**31) % 2**32) - 2**31
+            if step <= 0 and step > -self.max_gap:
+                self.dropped += 1
+                continue
+            if step > self.max_gap + 1 or step <= 0:
+                self.restarts += 1
+                restarted = True
+                out.clear()
+                step = 1
+            elif step > 1:
+                weight = np.arange(1, step)[:, None] / step
+                last = self.last_row.astype(np.float32)
+                fill = last + (row.astype(np.float32) - last) * weight
+                out.extend(np.round(fill).astype(np.int8))
+                self.filled += step - 1
+            out.append(row)
+            self.last_seq = s
+            self.last_row = row
+
+        if not out:
+            return rows[:0], restarted
+        return np.stack(out), restarted
+
+
+class DeviceSession:
+    def __init__(self, device, store=None, link=0):
+        self.device = device
+        self.link = link
+        self.store = store
+        # Raw frames go through the vital signs engine, the decimated stream
+        # (already the |diff| breathing signal) through StreamingBreathing
+        self.vitals = breathing.VitalSigns()
+        self.breathing = None
+        self.grid = SequenceResampler()
+        self.codec = csi_codec.Decoder()
+        self.messages = 0
+        self.unknown_layout = 0
+        # Receive time minus device time, see _end_time()
+        self.clock_offset = None
+        self.device_us = None
+
+    def _new_breathing(self, fs):
+        # Emits a new BPM every second once 15 s of samples have arrived
+        return breathing.StreamingBreathing(
+            fs=fs, window_s=15, hop=int(round(fs)), adaptive=False
+        )
+
+    def _process_stream(self, payload):
+        # Decimated publish mode: the device sends the breathing signal at
+        # header["fs"] and the amplitudes of its breathing subcarriers
+        header, channels, samples = csi_frame.decode_stream(payload)
+        self.messages += 1
+        if self.breathing is None or self.breathing.fs != header["fs"]:
+            self.breathing = self._new_breathing(header["fs"])
+        amplitudes = []
+        for i, channel in enumerate(channels):
+            if channel == csi_frame.STREAM_CHANNEL_BREATHING:
+                self.breathing.update_signal(samples[:, i])
+            elif len(samples):
+                amplitudes.append(float(samples[-1, i]))
+
+        return {
+            "device_id": self.device,
+            # Amplitudes, not I/Q: they go to clients as such
+            "CSIs": [],
+            "amplitudes": amplitudes[0:20],
+            "rssi": header["rssi"],
+            "motion_detect": header["motion_detect"],
+            "motion_confidence": header["motion_confidence"],
+            "breathing_rate": self.breathing.bpm,
+            "breathing_quality": self.breathing.quality,
+            "device_timestamp_us": header["timestamp_us"],
+            "link": self.link,
+        }
+
+    # Local time at which a message was sent. The device stamps messages with
+    # its uptime; the smallest receive delay seen so far maps that onto the
+    # local clock, so messages the device held back while the broker was
+    # unreachable keep their capture times instead of all landing at the
+    # moment the backlog is flushed. The offset may creep up by 100 ppm of the
+    # elapsed device time to follow a device clock that runs slow, and starts
+    # over when the device restarts. A backlog flushed right after boot comes
+    # before any undelayed message, so it is still placed at receive time.
+    def _end_time(self, received_us, header):
+        if not header:
+            return received_us
+        device_us = header["timestamp_us"]
+        offset = received_us - device_us
+        if self.clock_offset is None or device_us < self.device_us:
+            self.clock_offset = offset
+        else:
+            drift = (device_us - self.device_us) // 10_000
+            self.clock_offset = min(self.clock_offset + drift, offset)
+        self.device_us = device_us
+        return device_us + self.clock_offset
+
+    # Rows end at the send time, one probe interval apart
+    def _store(self, rows, received_us, rssi, motion_detect, header):
+        n = len(rows)
+        end_us = self._end_time(received_us, header)
+        timestamps = end_us - (n - 1 - np.arange(n)) * 10_000
+        probe_seq = None
+        if (
+            self.grid.last_seq is not None
+            and header
+            and header["probe_seq"] is not None
+        ):
+            probe_seq = (self.grid.last_seq - (n - 1) + np.arange(n)) & 0xFFFFFFFF
+        self.store.append(
+            timestamps,
+            rows,
+            rssi=rssi,
+            motion=int(bool(motion_detect)),
+            confidence=header["motion_confidence"] if header else 0.0,
+            layout=header["layout"].id if header else csi_frame.LAYOUT_HT20,
+            probe_seq=probe_seq,
+        )
+
+    def process(self, payload, received_us=None):
+        if csi_frame.is_stream(payload):
+            return self._process_stream(payload)
+        csi, rssi, motion_detect, header = parse_payload(payload, self.codec)
+        motion_confidence = header["motion_confidence"] if header else None
+        self.messages += 1
+        if csi is None:
+            # Unknown layout: the frames count as lost for the grid
+            self.unknown_layout += 1
+            csi = []
+        else:
+            if header and header["probe_seq"] is not None:
+                csi, restarted = self.grid.push(header["probe_seq"], csi)
+                if restarted:
+                    self.vitals = breathing.VitalSigns()
+            if len(csi):
+                self.vitals.update(csi)
+                if self.store is not None:
+                    if received_us is None:
+                        received_us = time.time_ns() // 1000
+                    self._store(csi, received_us, rssi, motion_detect, header)
+
+        heart = self.vitals.vitals["heart"] if self.vitals.vitals else None
+        return {
+            "device_id": self.device,
+            "CSIs": np.asanyarray(csi).flatten().tolist()[0:20],
+            "rssi": rssi,
+            "motion_detect": motion_detect,
+            "motion_confidence": motion_confidence,
+            "breathing_rate": self.vitals.bpm,
+            "breathing_quality": self.vitals.quality,
+            "heart_rate": heart["bpm"] if heart else None,
+            "heart_confidence": heart["confidence"] if heart else None,
+            "device_timestamp_us": header["timestamp_us"] if header else None,
+            "link": self.link,
+        }
+
+
+"""
+Fuses the links of one device: a receiver that hears several transmitters
+tags every message with its link, and each link is analysed by a session of
+its own
+fuse() takes the result of the link that just sent and returns it with the
+motion and breathing of all links heard within the last stale_s: motion if
+any link sees it, the highest confidence, and the breathing and heart rates
+of the links whose spectra have the clearest peaks (the confidence of
+breathing.estimate_vitals(), or StreamingBreathing.quality on the same 0 to 1
+scale for the decimated stream). "links" lists what every one of those links
+sees. A single link comes out as it went in, plus "links".
+"""
+
+
+class LinkFusion:
+    def __init__(self, stale_s=5):
+        self.stale_s = stale_s
+        # link -> (monotonic time, last result)
+        self.latest = {}
+
+    def fuse(self, result, now):
+        self.latest[result["link"]] = (now, result)
+        live = [
+            r for _, (t, r) in sorted(self.latest.items()) if now - t <= self.stale_s
+        ]
+        fused = dict(result)
+        fused["links"] = [
+            {
+                "link": r["link"],
+                "rssi": r["rssi"],
+                "motion_detect": r["motion_detect"],
+                "motion_confidence": r["motion_confidence"],
+                "breathing_rate": r["breathing_rate"],
+                "breathing_quality": r["breathing_quality"],
+                "heart_rate": r.get("heart_rate"),
+                "heart_confidence": r.get("heart_confidence"),
+            }
+            for r in live
+        ]
+        if len(live) == 1:
+            return fused
+
+        fused["motion_detect"] = int(any(r["motion_detect"] for r in live))
+        confidences = [
+            r["motion_confidence"] for r in live if r["motion_confidence"] is not None
+        ]
+        fused["motion_confidence"] = max(confidences) if confidences else None
+        rated = [r for r in live if r["breathing_rate"] is not None]
+        if rated:
+            best = max(rated, key=lambda r: r["breathing_quality"] or 0)
+            fused["breathing_rate"] = best["breathing_rate"]
+            fused["breathing_quality"] = best["breathing_quality"]
+        rated = [r for r in live if r.get("heart_rate") is not None]
+        if rated:
+            best = max(rated, key=lambda r: r["heart_confidence"] or 0)
+            fused["heart_rate"] = best["heart_rate"]
+            fused["heart_confidence"] = best["heart_confidence"]
+        return fused
+
+
+def _worker(inbox, outbox, ready, store_dir=None, retention_s=None):
+    # (device, link) -> DeviceSession
+    sessions = {}
+    fusions = {}
+    store = None
+    if store_dir:
+        store = csi_store.CSIStore(store_dir, writable=True, retention_s=retention_s)
+    ready.put(os.getpid())
+    while True:
+        item = inbox.get()
+        if item is None:
+            break
+
+        topic, payload, received, received_us = item
+        device = device_id(topic)
+        link = csi_frame.link(payload)
+        session = sessions.get((device, link))
+        if session is None:
+            # Link 0 keeps the device's own store, so a single transmitter
+            # stores as before
+            store_id = device if link == 0 else f"{device}.{link}"
+            device_store = store.device(store_id) if store else None
+            session = DeviceSession(device, device_store, link)
+            sessions[(device, link)] = session
+        fusion = fusions.get(device)
+        if fusion is None:
+            fusion = fusions[device] = LinkFusion()
+
+        try:
+            result = session.process(payload, received_us)
+            result, error = fusion.fuse(result, time.monotonic()), None
+        except Exception as e:
+            result, error = None, f"{device}: {e}"
+        outbox.put((topic, result, error, received))
+    if store:
+        store.close()
+
+
+"""
+Pool of worker processes sharded by device
+on_result(topic, result, error, latency_s) is called from a collector thread
+for every submitted message, in per-device submission order
+With store_dir, raw frames are kept in a csi_store.CSIStore there, sealed
+segments deleted after retention_s
+"""
+
+
+class IngestPool:
+    def __init__(
+        self,
+        on_result,
+        workers=None,
+        queue_depth=1000,
+        store_dir=None,
+        retention_s=None,
+    ):
+        ctx = mp.get_context("spawn")
+        self.workers = workers or os.cpu_count() or 1
+        self.on_result = on_result
+        self.outbox = ctx.Queue()
+        # Bounded inboxes: a full shard blocks the submitter (the MQTT
+        # thread), which pushes back on the broker instead of growing memory
+        self.inboxes = [ctx.Queue(maxsize=queue_depth) for _ in range(self.workers)]
+        ready = ctx.Queue()
+        self.procs = [
+            ctx.Process(
+                target=_worker,
+                args=(inbox, self.outbox, ready, store_dir, retention_s),
+                daemon=True,
+            )
+            for inbox in self.inboxes
+        ]
+        for proc in self.procs:
+            proc.start()
+        # Workers import numpy/scipy on start, don't queue traffic behind that
+        for proc in self.procs:
+            ready.get()
+
+        self.dropped = 0
+        self.collector = threading.Thread(target=self._collect, daemon=True)
+        self.collector.start()
+
+    # block=False is for callers on the event loop (the UDP receiver): a full
+    # shard drops the message instead, counted in `dropped`
+    def submit(self, topic, payload, block=True):
+        shard = zlib.crc32(device_id(topic).encode()) % self.workers
+        received_us = time.time_ns() // 1000
+        try:
+            self.inboxes[shard].put(
+                (topic, bytes(payload), time.monotonic(), received_us), block
+            )
+        except queue.Full:
+            self.dropped += 1
+            return False
+        return True
+
+    def _collect(self):
+        while True:
+            item = self.outbox.get()
+            if item is None:
+                break
+            topic, result, error, received = item
+            self.on_result(topic, result, error, time.monotonic() - received)
+
+    def close(self):
+        for inbox in self.inboxes:
+            inbox.put(None)
+        for proc in self.procs:
+            proc.join()
+        self.outbox.put(None)
+        self.collector.join()
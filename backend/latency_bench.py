@@ -0,0 +1,109 @@
+import sys
+import json
+import time
+import asyncio
+import argparse
+import websockets
+import numpy as np
+from datetime import datetime
+
+"""
+Capture-to-dashboard latency of the csi/data paths
+
+Connects to server.py like a dashboard and, for every data entry it
+receives, takes the time since the entry's device_timestamp_us, both to its
+arrival here and to its "timestamp", when server.py had the ingest result and
+queued it for the dashboards. The device timestamp is wall-clock time only
+for host/csi_replay with --broker or --udp, which stamp each message with the
+capture time of its last frame; a board stamps its uptime, so run this
+against the replay:
+
+    python mqtt_standin.py --port 1883 &
+    python server.py &
+    python latency_bench.py --broker 127.0.0.1:1883 --seconds 60 &
+    csi_replay --broker 127.0.0.1:1883 trace.csit
+
+    python latency_bench.py --seconds 60 &
+    csi_replay --udp 127.0.0.1:8766 trace.csit
+
+The difference between the two is the UI_REFRESH_HZ coalescing, which adds
+up to 1 / UI_REFRESH_HZ whatever the path; the time to the ingest result is
+the one the transport changes. --broker points server.py at the broker first,
+as the dashboard's connect button does. p50, p99 and the maximum are printed
+per device, in ms. Both ends must share a clock, so run everything on one
+machine.
+"""
+
+
+def percentiles(latencies_ms):
+    a = np.asarray(latencies_ms)
+    return np.percentile(a, 50), np.percentile(a, 99), a.max()
+
+
+async def collect(url, broker, seconds, warmup):
+    latencies = {}
+    async with websockets.connect(url, max_size=None) as ws:
+        if broker:
+            host, _, port = broker.rpartition(":")
+            await ws.send(
+                json.dumps({"type": "connect", "broker": host, "port": int(port)})
+            )
+        start = time.monotonic()
+        deadline = None
+        while deadline is None or time.monotonic() < deadline:
+            timeout = None if deadline is None else deadline - time.monotonic()
+            try:
+                message = await asyncio.wait_for(ws.recv(), timeout)
+            except asyncio.TimeoutError:
+                break
+            now_us = time.time_ns() // 1000
+            if isinstance(message, bytes):
+                continue
+            msg = json.loads(message)
+            if msg.get("type") != "batch":
+                continue
+            for entry in msg["data"]:
+                device_us = entry.get("device_timestamp_us")
+                if device_us is None:
+                    continue
+                # The window starts with the first entry, so the bench can be
+                # started before the sender
+                if deadline is None:
+                    start = time.monotonic()
+                    deadline = start + warmup + seconds
+                if time.monotonic() - start < warmup:
+                    continue
+                ingest_us = datetime.fromisoformat(entry["timestamp"]).timestamp() * 1e6
+                latencies.setdefault(entry["device_id"], []).append(
+                    ((ingest_us - device_us) / 1000, (now_us - device_us) / 1000)
+                )
+    return latencies
+
+
+def main():
+    parser = argparse.ArgumentParser(description="csi/data latency bench")
+    parser.add_argument("--ws", default="ws://localhost:8765")
+    parser.add_argument("--broker", help="HOST:PORT for server.py to connect to")
+    parser.add_argument("--seconds", type=float, default=60)
+    parser.add_argument(
+        "--warmup", type=float, default=5, help="seconds left out at the start"
+    )
+    args = parser.parse_args()
+
+    latencies = asyncio.run(collect(args.ws, args.broker, args.seconds, args.warmup))
+    if not latencies:
+        print("no entries with a device timestamp", file=sys.stderr)
+        sys.exit(1)
+    for device, values in latencies.items():
+        values = np.asarray(values)
+        print(f"{device}: {len(values)} entries")
+        for name, column in (("ingest", 0), ("emit", 1)):
+            p50, p99, worst = percentiles(values[:, column])
+            print(
+                f"  to {name:6} p50 {p50:6.1f} ms, p99 {p99:6.1f} ms, "
+                f"max {worst:6.1f} ms"
+            )
+
+
+if __name__ == "__main__":
+    main()
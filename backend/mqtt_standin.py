@@ -0,0 +1,235 @@
+import sys
+import time
+import signal
+import socket
+import asyncio
+import argparse
+
+"""
+Stand-in MQTT broker for testing on one machine
+
+Speaks enough MQTT 3.1.1 for csi_recv, host/csi_replay and server.py:
+CONNECT, PUBLISH at QoS 0 and 1, SUBSCRIBE with + and # wildcards, PINGREQ
+and DISCONNECT. Messages are forwarded to subscribers at QoS 0, nothing is
+retained or persisted.
+
+Every connection's inbound packets can be held back by --latency before
+they are handled, so a PUBACK takes a round trip that long, and read at no
+more than --rate bytes per second, so a publisher that sends more fills the
+TCP window and then its own outbox, as with a slow uplink. --stall stops
+reading for a while, like a broker that hangs. The receive buffer is kept
+small so the publisher sees the backpressure soon.
+
+    python mqtt_standin.py --port 1883 --latency 200 --rate 20000
+"""
+
+CONNECT = 1
+CONNACK = 2
+PUBLISH = 3
+PUBACK = 4
+SUBSCRIBE = 8
+SUBACK = 9
+UNSUBSCRIBE = 10
+UNSUBACK = 11
+PINGREQ = 12
+PINGRESP = 13
+DISCONNECT = 14
+RECEIVE_BUFFER = 8 * 1024
+
+
+def topic_matches(pattern, topic):
+    pattern = pattern.split("/")
+    topic = topic.split("/")
+    for i, level in enumerate(pattern):
+        if level == "#":
+            return True
+        if i >= len(topic) or (level != "+" and level != topic[i]):
+            return False
+    return len(pattern) == len(topic)
+
+
+def encode_remaining(n):
+    out = bytearray()
+    while True:
+        byte = n % 128
+        n //= 128
+        out.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def packet(kind, flags, body=b""):
+    return bytes([kind << 4 | flags]) + encode_remaining(len(body)) + body
+
+
+def string(s):
+    data = s.encode()
+    return len(data).to_bytes(2, "big") + data
+
+
+async def read_packet(reader):
+    first = (await reader.readexactly(1))[0]
+    remaining = 0
+    for shift in range(0, 28, 7):
+        byte = (await reader.readexactly(1))[0]
+        remaining |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            break
+    body = await reader.readexactly(remaining) if remaining else b""
+    return first >> 4, first & 0x0F, body
+
+
+class Broker:
+    def __init__(self, latency_s=0.0, rate=0.0, stall=None, verbose=False):
+        self.latency_s = latency_s
+        self.rate = rate
+        self.stall = stall
+        self.verbose = verbose
+        self.started = time.monotonic()
+        # writer -> topic filters
+        self.subscriptions = {}
+        self.published = 0
+        self.published_bytes = 0
+        self.forwarded = 0
+
+    def log(self, *args):
+        if self.verbose:
+            print(f"{time.monotonic() - self.started:8.3f}", *args, file=sys.stderr)
+
+    async def throttle(self, size):
+        # Reading slower than the publisher sends is what makes its outbox
+        # grow, so the limits apply before the packet is handled
+        if self.stall:
+            start, end = self.stall
+            elapsed = time.monotonic() - self.started
+            if start <= elapsed < end:
+                await asyncio.sleep(end - elapsed)
+        if self.rate > 0:
+            await asyncio.sleep(size / self.rate)
+
+    def forward(self, topic, payload):
+        data = packet(PUBLISH, 0, string(topic) + payload)
+        for writer, filters in list(self.subscriptions.items()):
+            if any(topic_matches(f, topic) for f in filters):
+                if writer.transport.get_write_buffer_size() > 4 * 1024 * 1024:
+                    # A subscriber that does not read loses messages
+                    continue
+                writer.write(data)
+                self.forwarded += 1
+
+    async def handle(self, writer, kind, flags, body):
+        if kind == CONNECT:
+            writer.write(packet(CONNACK, 0, b"\x00\x00"))
+        elif kind == PUBLISH:
+            qos = (flags >> 1) & 3
+            topic_len = int.from_bytes(body[0:2], "big")
+            topic = body[2 : 2 + topic_len].decode(errors="replace")
+            pos = 2 + topic_len
+            if qos:
+                msg_id = body[pos : pos + 2]
+                pos += 2
+                writer.write(packet(PUBACK, 0, msg_id))
+            self.published += 1
+            self.published_bytes += len(body)
+            self.forward(topic, body[pos:])
+        elif kind == SUBSCRIBE:
+            msg_id, pos, granted = body[0:2], 2, bytearray()
+            filters = self.subscriptions.setdefault(writer, [])
+            while pos < len(body):
+                n = int.from_bytes(body[pos : pos + 2], "big")
+                filters.append(body[pos + 2 : pos + 2 + n].decode())
+                pos += 2 + n + 1
+                granted.append(0)
+            self.log("subscribe", filters)
+            writer.write(packet(SUBACK, 0, msg_id + bytes(granted)))
+        elif kind == UNSUBSCRIBE:
+            writer.write(packet(UNSUBACK, 0, body[0:2]))
+        elif kind == PINGREQ:
+            writer.write(packet(PINGRESP, 0))
+
+    async def client(self, reader, writer):
+        peer = writer.get_extra_info("peername")
+        self.log("connect", peer)
+        # Packets wait here for their latency, in order
+        pending = asyncio.Queue()
+
+        async def process():
+            while True:
+                due, item = await pending.get()
+                if item is None:
+                    break
+                delay = due - time.monotonic()
+                if delay > 0:
+                    await asyncio.sleep(delay)
+                await self.handle(writer, *item)
+
+        processor = asyncio.create_task(process())
+        try:
+            while True:
+                kind, flags, body = await read_packet(reader)
+                await self.throttle(len(body) + 2)
+                if kind == DISCONNECT:
+                    break
+                pending.put_nowait(
+                    (time.monotonic() + self.latency_s, (kind, flags, body))
+                )
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        finally:
+            pending.put_nowait((0, None))
+            await processor
+            self.subscriptions.pop(writer, None)
+            writer.close()
+            self.log("disconnect", peer)
+
+    async def serve(self, host, port):
+        # Accepted sockets inherit the receive buffer; the stream reader
+        # stops reading at twice its limit
+        server = await asyncio.start_server(
+            self.client, host, port, limit=RECEIVE_BUFFER
+        )
+        for sock in server.sockets:
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, RECEIVE_BUFFER)
+        print(f"MQTT stand-in listening on {host}:{port}", file=sys.stderr)
+        async with server:
+            await server.serve_forever()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stand-in MQTT broker")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument(
+        "--latency", type=float, default=0, help="ms before a packet is handled"
+    )
+    parser.add_argument(
+        "--rate", type=float, default=0, help="bytes/s read per connection"
+    )
+    parser.add_argument(
+        "--stall",
+        type=float,
+        nargs=2,
+        metavar=("START", "END"),
+        default=None,
+        help="seconds after start during which nothing is read",
+    )
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    broker = Broker(args.latency / 1000, args.rate, args.stall, args.verbose)
+    # Stopped from a script: report the counts as on Ctrl-C
+    signal.signal(signal.SIGTERM, lambda *_: sys.exit(0))
+    try:
+        asyncio.run(broker.serve(args.host, args.port))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        print(
+            f"{broker.published} messages, {broker.published_bytes} bytes "
+            f"published, {broker.forwarded} forwarded",
+            file=sys.stderr,
+        )
+
+
+if __name__ == "__main__":
+    main()
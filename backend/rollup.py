@@ -0,0 +1,349 @@
+import os
+import time
+import argparse
+import numpy as np
+
+"""
+Multi-resolution history of the per-device results
+Every device keeps a pyramid of LEVELS: for each level's bucket width, the
+min, max, sum and count of every metric in a ring of CAPACITY buckets, so
+the finest level covers the last 2.3 hours and the coarsest 8 weeks. A result
+updates the current bucket of every level, O(levels) per message, and a query
+reads at most ~10 buckets per output point from the coarsest level that still
+resolves it, so a week costs about the same as a minute.
+Missing values (NaN, e.g. no breathing rate yet) are left out of a bucket.
+"""
+
+METRICS = ("rssi", "motion_detect", "motion_confidence", "breathing_rate")
+# Bucket widths in seconds, each a multiple of the one before
+LEVELS = (1, 10, 60, 600)
+CAPACITY = 8192
+
+
+class Level:
+    def __init__(self, width, capacity=CAPACITY, metrics=len(METRICS)):
+        self.width = width
+        self.capacity = capacity
+        # Bucket number (time // width) of the newest bucket, -1 while empty
+        self.head = -1
+        self.min = np.full((capacity, metrics), np.inf)
+        self.max = np.full((capacity, metrics), -np.inf)
+        self.sum = np.zeros((capacity, metrics))
+        self.count = np.zeros((capacity, metrics), dtype=np.int32)
+
+    def _clear(self, slots):
+        self.min[slots] = np.inf
+        self.max[slots] = -np.inf
+        self.sum[slots] = 0
+        self.count[slots] = 0
+
+    def _advance(self, newest):
+        if newest > self.head:
+            # Buckets between the old and the new head had no results yet
+            skipped = min(newest - self.head, self.capacity)
+            self._clear(np.arange(newest - skipped + 1, newest + 1) % self.capacity)
+            self.head = newest
+
+    def add_one(self, t, values, present, lows, highs):
+        bucket = int(t // self.width)
+        self._advance(bucket)
+        if bucket <= self.head - self.capacity:
+            return
+        slot = bucket % self.capacity
+        np.minimum(self.min[slot], lows, out=self.min[slot])
+        np.maximum(self.max[slot], highs, out=self.max[slot])
+        self.sum[slot] += values
+        self.count[slot] += present
+
+    def add(self, t, values, present):
+        """Adds rows of values at times t; values where not present are ignored"""
+        bucket = (np.asarray(t) // self.width).astype(np.int64)
+        self._advance(int(bucket.max()))
+        keep = bucket > self.head - self.capacity
+        slot = bucket[keep] % self.capacity
+        values, present = values[keep], present[keep]
+        np.minimum.at(self.min, slot, np.where(present, values, np.inf))
+        np.maximum.at(self.max, slot, np.where(present, values, -np.inf))
+        np.add.at(self.sum, slot, np.where(present, values, 0))
+        np.add.at(self.count, slot, present)
+
+    @property
+    def first(self):
+        """Oldest bucket number still held"""
+        return max(self.head - self.capacity + 1, 0)
+
+    def buckets(self, first, last):
+        """Slots of buckets first..last, which must lie in the ring"""
+        return np.arange(first, last + 1) % self.capacity
+
+
+"""
+History of one device
+"""
+
+
+class Pyramid:
+    def __init__(self, levels=LEVELS, capacity=CAPACITY):
+        self.levels = [Level(width, capacity) for width in levels]
+
+    def add(self, t, result):
+        """Adds the METRICS of `result` (a dict, None for missing) at time t"""
+        values = np.array(
+            [np.nan if result.get(m) is None else float(result[m]) for m in METRICS]
+        )
+        present = ~np.isnan(values)
+        lows = np.where(present, values, np.inf)
+        highs = np.where(present, values, -np.inf)
+        values = np.where(present, values, 0)
+        for level in self.levels:
+            level.add_one(t, values, present, lows, highs)
+
+    def add_many(self, t, values):
+        """Adds rows of METRICS values, NaN for missing, at times t"""
+        values = np.asarray(values, dtype=np.float64)
+        if len(values) == 0:
+            return
+        present = ~np.isnan(values)
+        for level in self.levels:
+            level.add(t, values, present)
+
+    def _level_for(self, start, step):
+        # Coarsest level no wider than one output point that holds `start`;
+        # failing that the coarsest one that does, or the coarsest of all
+        usable = [
+            lv for lv in self.levels if lv.head >= 0 and lv.first * lv.width <= start
+        ]
+        fine = [lv for lv in usable if lv.width <= step]
+        if fine:
+            return fine[-1]
+        if usable:
+            return usable[0]
+        return self.levels[-1]
+
+    def query(self, start, end, points):
+        """
+        Aggregates of [start, end) in at most `points` steps
+        Steps are whole buckets of the level read, so the aggregates are exact
+        and the range is widened to bucket edges
+        Returns (t, step, series): t the start time of every step, step its
+        length in seconds, series {metric: (min, max, mean)} with NaN where a
+        step has no values
+        """
+        points = max(int(points), 1)
+        level = self._level_for(start, (end - start) / points)
+        width = level.width
+        first = int(start // width)
+        last = max(int(np.ceil(end / width)) - 1, first)
+        # Buckets per step
+        per = -(-(last - first + 1) // points)
+        steps = -(-(last - first + 1) // per)
+        t = (first + np.arange(steps) * per) * width
+
+        nan = np.full((steps, len(METRICS)), np.nan)
+        out_min, out_max, out_mean = nan, nan.copy(), nan.copy()
+        lo, hi = max(first, level.first), min(last, level.head)
+        if level.head >= 0 and hi >= lo:
+            slots = level.buckets(lo, hi)
+            step = (np.arange(lo, hi + 1) - first) // per
+            # Buckets are in time order, so each step is one run of them
+            runs, starts = np.unique(step, return_index=True)
+            total = np.add.reduceat(level.count[slots], starts)
+            sums = np.add.reduceat(level.sum[slots], starts)
+            mins = np.minimum.reduceat(level.min[slots], starts)
+            maxs = np.maximum.reduceat(level.max[slots], starts)
+            has = total > 0
+            with np.errstate(invalid="ignore", divide="ignore"):
+                out_mean[runs] = np.where(has, sums / total, np.nan)
+            out_min[runs] = np.where(has, mins, np.nan)
+            out_max[runs] = np.where(has, maxs, np.nan)
+
+        series = {
+            m: (out_min[:, i], out_max[:, i], out_mean[:, i])
+            for i, m in enumerate(METRICS)
+        }
+        return t, per * width, series
+
+    def state(self):
+        return {
+            f"{name}{lv.width}": getattr(lv, name)
+            for lv in self.levels
+            for name in ("min", "max", "sum", "count")
+        } | {f"head{lv.width}": np.int64(lv.head) for lv in self.levels}
+
+    def load_state(self, state):
+        for lv in self.levels:
+            if f"head{lv.width}" not in state:
+                continue
+            if state[f"count{lv.width}"].shape != lv.count.shape:
+                continue
+            lv.head = int(state[f"head{lv.width}"])
+            for name in ("min", "max", "sum", "count"):
+                getattr(lv, name)[:] = state[f"{name}{lv.width}"]
+
+
+"""
+Pyramids of all devices, saved to and loaded from one .npz file
+"""
+
+
+class History:
+    def __init__(self, path=None):
+        self.path = path
+        self.devices = {}
+        if path and os.path.exists(path):
+            self.load()
+
+    def add(self, device, t, result):
+        pyramid = self.devices.get(device)
+        if pyramid is None:
+            pyramid = self.devices[device] = Pyramid()
+        pyramid.add(t, result)
+
+    """
+    JSON-ready answer to a dashboard "query" command, or None for an unknown
+    device; missing values are null
+    """
+
+    def query(self, device, start, end, points):
+        pyramid = self.devices.get(device)
+        if pyramid is None:
+            return None
+        t, step, series = pyramid.query(start, end, points)
+
+        def column(a):
+            return [None if np.isnan(v) else round(float(v), 3) for v in a]
+
+        return {
+            "device_id": device,
+            "start": start,
+            "end": end,
+            "resolution_s": step,
+            "t": t.round(3).tolist(),
+            "series": {
+                m: {"min": column(lo), "max": column(hi), "mean": column(mean)}
+                for m, (lo, hi, mean) in series.items()
+            },
+        }
+
+    def snapshot(self):
+        """Copy of every pyramid, for save() on another thread"""
+        state = {}
+        for i, (device, pyramid) in enumerate(self.devices.items()):
+            state[f"device{i}"] = np.array(device)
+            for key, value in pyramid.state().items():
+                state[f"{i}.{key}"] = value.copy()
+        return state
+
+    def save(self, state=None):
+        if not self.path:
+            return
+        if state is None:
+            state = self.snapshot()
+        os.makedirs(os.path.dirname(self.path) or ".", exist_ok=True)
+        # np.savez appends .npz to names without it
+        tmp = self.path + ".tmp.npz"
+        np.savez(tmp, **state)
+        os.replace(tmp, self.path)
+
+    def load(self):
+        with np.load(self.path) as data:
+            i = 0
+            while f"device{i}" in data:
+                prefix = f"{i}."
+                state = {
+                    key[len(prefix) :]: data[key]
+                    for key in data.files
+                    if key.startswith(prefix)
+                }
+                pyramid = self.devices[str(data[f"device{i}"])] = Pyramid()
+                pyramid.load_state(state)
+                i += 1
+
+
+def bench(days=7, rate=10, points=800, repeat=50):
+    """
+    Fills a pyramid with `days` of results at `rate` per second, then times
+    queries of growing range against the same aggregation over the raw results
+    """
+    rng = np.random.default_rng(0)
+    n = int(days * 86400 * rate)
+    t0 = 1_700_000_000.0
+    t = t0 + np.arange(n) / rate
+    raw = np.column_stack(
+        [
+            rng.normal(-50, 3, n),
+            rng.random(n) < 0.1,
+            rng.random(n),
+            15 + 2 * np.sin(np.arange(n) / (600 * rate)),
+        ]
+    )
+
+    pyramid = Pyramid()
+    # add() is timed on the last hour only, the rest is filled in bulk
+    timed = min(int(3600 * rate), n)
+    pyramid.add_many(t[: n - timed], raw[: n - timed])
+    begin = time.perf_counter()
+    for i in range(n - timed, n):
+        pyramid.add(t[i], dict(zip(METRICS, raw[i])))
+    add_us = (time.perf_counter() - begin) / timed * 1e6
+    print(f"add: {add_us:.1f} us per result, {days:g} days at {rate:g} Hz")
+
+    end = t[-1] + 1 / rate
+    for span in (10, 60, 600, 3600, 6 * 3600, 86400, days * 86400):
+        start = end - span
+        begin = time.perf_counter()
+        for _ in range(repeat):
+            steps, step, series = pyramid.query(start, end, points)
+        pyramid_us = (time.perf_counter() - begin) / repeat * 1e6
+
+        # Same means straight from the raw results
+        begin = time.perf_counter()
+        for _ in range(max(repeat // 10, 1)):
+            lo, hi = np.searchsorted(t, [steps[0], steps[-1] + step])
+            point = ((t[lo:hi] - steps[0]) // step).astype(np.int64)
+            runs, starts = np.unique(point, return_index=True)
+            raw_mean = (
+                np.add.reduceat(raw[lo:hi], starts)
+                / np.diff(np.append(starts, hi - lo))[:, None]
+            )
+        raw_us = (time.perf_counter() - begin) / max(repeat // 10, 1) * 1e6
+        err = np.nanmax(np.abs(series["breathing_rate"][2][runs] - raw_mean[:, 3]))
+        print(
+            f"{span:>8g} s: {len(steps):4d} points of {step:g} s in "
+            f"{pyramid_us:4.0f} us, {raw_us:7.0f} us from raw results, "
+            f"breathing rate within {err:.1e}"
+        )
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Result history tools")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    timing = sub.add_parser("bench", help="query latency against range length")
+    timing.add_argument("--days", type=float, default=7)
+    timing.add_argument("--rate", type=float, default=10, help="results/s")
+    timing.add_argument("--points", type=int, default=800)
+
+    show = sub.add_parser("info", help="summarise a saved history")
+    show.add_argument("path")
+
+    args = parser.parse_args()
+    if args.cmd == "bench":
+        bench(args.days, args.rate, args.points)
+    else:
+        history = History(args.path)
+        for device, pyramid in history.devices.items():
+            level = pyramid.levels[0]
+            if level.head < 0:
+                continue
+            print(
+                f"{device}: last result {time.ctime(level.head * level.width)}, "
+                + ", ".join(
+                    f"{lv.width} s from {time.ctime(lv.first * lv.width)}"
+                    for lv in pyramid.levels
+                )
+            )
+
+
+if __name__ == "__main__":
+    main()
@@ -1,12 +1,15 @@
+import os
 import json
+import time
 import asyncio
 import websockets
+from collections import deque
 import paho.mqtt.client as mqtt
 from datetime import datetime
-import breathing as breathing
-import pandas as pd
-import numpy as np
-from ast import literal_eval
+import ingest
+import fanout
+import csi_udp
+import rollup
 
 # Add this near the top with other globals
 main_event_loop = None
@@ -23,15 +26,42 @@ def schedule_task(coro):
 
 DEFAULT_MQTT_BROKER = "192.168.46.44"  # "192.168.31.215"
 DEFAULT_MQTT_PORT = 1883
-DEFAULT_MQTT_TOPIC = "csi/data"
+# Devices publish on csi/data/<mac>
+DEFAULT_MQTT_TOPIC = "csi/data/#"
+# Breathing rate estimated on the device (CSI_ONBOARD_BR in csi_recv)
+DEVICE_BR_TOPIC = "csi/br/#"
+# Probe loss and jitter reported by csi_recv every 10 s
+DEVICE_TELEMETRY_TOPIC = "csi/telemetry/#"
 WS_HOST = "localhost"
 WS_PORT = 8765
-
-csi_data = []
-connected_clients = set()
+# csi/data datagrams from receivers built with CSI_TRANSPORT_UDP (csi_udp.py),
+# UDP_PORT None to disable
+UDP_HOST = "0.0.0.0"
+UDP_PORT = 8766
+# Datagram loss and redundancy are logged this often
+UDP_STATS_S = 10
+# Data updates are coalesced and pushed to the dashboards at this rate
+UI_REFRESH_HZ = 10
+# Per-client outbound queue; the oldest message is dropped when it is full
+WS_CLIENT_QUEUE_DEPTH = 32
+# Raw CSI of every device is kept here (csi_store.py), None to disable
+CSI_STORE_DIR = "csi_db"
+CSI_STORE_RETENTION_S = 7 * 86400
+# Entries sent to a dashboard when it connects
+INITIAL_DATA_ENTRIES = 100
+# Result history for "query" commands (rollup.py), saved every HISTORY_SAVE_S
+HISTORY_PATH = os.path.join(CSI_STORE_DIR, "history.npz") if CSI_STORE_DIR else None
+HISTORY_SAVE_S = 300
+# Largest number of points a query may ask for
+QUERY_MAX_POINTS = 4000
+
+csi_data = deque(maxlen=INITIAL_DATA_ENTRIES)
+broadcaster = fanout.Broadcaster(UI_REFRESH_HZ, WS_CLIENT_QUEUE_DEPTH)
+history = rollup.History(HISTORY_PATH)
 mqtt_client = None
 mqtt_connected = False
-topic_filter = "csi/data"
+topic_filter = DEFAULT_MQTT_TOPIC
+ingest_pool = None
 
 
 def on_connect(client, userdata, flags, rc):
@@ -39,6 +69,8 @@ def on_connect(client, userdata, flags, rc):
     print(f"Connected to MQTT broker with result code {rc}")
     mqtt_connected = True
     client.subscribe(topic_filter)
+    client.subscribe(DEVICE_BR_TOPIC)
+    client.subscribe(DEVICE_TELEMETRY_TOPIC)
     schedule_task(broadcast_connection_status())
 
 
@@ -49,74 +81,128 @@ def on_disconnect(client, userdata, rc):
     schedule_task(broadcast_connection_status())
 
 
+def publish_entry(topic, payload):
+    data_entry = {
+        "topic": topic,
+        "timestamp": datetime.now().isoformat(),
+        **payload,
+    }
+
+    csi_data.append(data_entry)
+
+    if main_event_loop:
+        main_event_loop.call_soon_threadsafe(broadcaster.add, data_entry)
+        # History is only touched from the event loop, like the broadcaster
+        main_event_loop.call_soon_threadsafe(
+            history.add, payload["device_id"], time.time(), payload
+        )
+
+
+def on_device_br(topic, result):
+    publish_entry(
+        topic,
+        {
+            "device_id": ingest.device_id(topic),
+            "CSIs": [],
+            "rssi": result.get("rssi"),
+            "motion_detect": result.get("motion_detect"),
+            "motion_confidence": result.get("motion_confidence"),
+            "breathing_rate": result["breathing_rate"],
+        },
+    )
+
+
+def on_device_telemetry(topic, stats):
+    print(
+        f"{ingest.device_id(topic)}: {stats['received']} probes, "
+        f"{stats['loss_rate'] * 100:.1f}% lost, jitter {stats['jitter_us']:.0f} us, "
+        f"max interval {stats['max_interval_us'] / 1000:.0f} ms"
+    )
+    schedule_task(broadcast_telemetry(ingest.device_id(topic), stats))
+
+
 def on_message(client, userdata, msg):
     try:
         topic = msg.topic
-        csi = list(literal_eval(msg.payload.decode()))
-        rssi = csi.pop(-1)
-        motion_detect = csi.pop(-1)
-        csi = np.array(csi)
-        csi = csi.reshape(-1, 114)
-
-        if not hasattr(on_message, "csi_buffer"):
-            on_message.csi_buffer = np.empty((0, 114))
-
-        on_message.csi_buffer = np.concatenate((on_message.csi_buffer, csi))
-
-        if len(on_message.csi_buffer) >= 15 * 100:
-            breathing_rate = breathing.get_br(np.vstack(on_message.csi_buffer))
-            on_message.csi_buffer = on_message.csi_buffer[1:]
-        else:
-            breathing_rate = None
-
-        payload = {
-            "CSIs": np.asanyarray(csi).flatten().tolist()[0:20],
-            "rssi": rssi,
-            "motion_detect": motion_detect,
-            "breathing_rate": breathing_rate,
-        }
-
-        data_entry = {
-            "topic": topic,
-            "timestamp": datetime.now().isoformat(),
-            **payload,
-        }
-
-        csi_data.append(data_entry)
-        if len(csi_data) > 100:
-            csi_data.pop(0)
-
-        schedule_task(broadcast_data(data_entry))
+        if mqtt.topic_matches_sub(DEVICE_BR_TOPIC, topic):
+            on_device_br(topic, json.loads(msg.payload))
+            return
+        if mqtt.topic_matches_sub(DEVICE_TELEMETRY_TOPIC, topic):
+            on_device_telemetry(topic, json.loads(msg.payload))
+            return
+
+        # Decoding and per-device analysis run in the worker pool
+        ingest_pool.submit(topic, msg.payload)
 
     except Exception as e:
         print(f"Error processing message: {e}")
 
 
-async def broadcast_data(data):
-    if connected_clients:
-        message = json.dumps({"type": "data", "payload": data})
-        await asyncio.gather(*[client.send(message) for client in connected_clients])
+class UDPReceiver(asyncio.DatagramProtocol):
+    # Runs on the event loop, so messages are dropped rather than waited on
+    # when a worker falls behind; UDP has no backpressure to apply anyway
+    def __init__(self):
+        self.receiver = csi_udp.Receiver()
+
+    def datagram_received(self, data, addr):
+        try:
+            device, messages = self.receiver.push(data)
+        except ValueError as e:
+            print(f"Error processing datagram from {addr[0]}: {e}")
+            return
+        topic = f"csi/data/{device}"
+        if not mqtt.topic_matches_sub(topic_filter, topic):
+            return
+        for payload in messages:
+            ingest_pool.submit(topic, payload, block=False)
+
+    async def log_stats(self):
+        while True:
+            await asyncio.sleep(UDP_STATS_S)
+            for device in self.receiver.devices():
+                stats = self.receiver.stats(device)
+                print(
+                    f"{device}: {stats['received']} datagram messages, "
+                    f"{stats['recovered']} recovered, {stats['lost']} lost, "
+                    f"{stats['restarts']} restarts"
+                )
+            if ingest_pool.dropped:
+                print(
+                    f"{ingest_pool.dropped} datagram messages dropped by a full worker"
+                )
+
+
+def on_ingest_result(topic, payload, error, latency):
+    if error:
+        print(f"Error processing message: {error}")
+        return
+    publish_entry(topic, payload)
 
 
 async def broadcast_connection_status():
-    if connected_clients:
-        status = {
-            "type": "connection_status",
-            "connected": mqtt_connected,
-            "broker": mqtt_client._host if mqtt_client else None,
-            "topic_filter": topic_filter,
-        }
-        message = json.dumps(status)
-        await asyncio.gather(*[client.send(message) for client in connected_clients])
+    status = {
+        "type": "connection_status",
+        "connected": mqtt_connected,
+        "broker": mqtt_client._host if mqtt_client else None,
+        "topic_filter": topic_filter,
+    }
+    broadcaster.send_now(json.dumps(status))
+
+
+async def broadcast_telemetry(device, stats):
+    broadcaster.send_now(
+        json.dumps({"type": "telemetry", "device_id": device, **stats})
+    )
 
 
 async def websocket_handler(websocket):
     global mqtt_client, topic_filter
 
-    connected_clients.add(websocket)
+    channel = broadcaster.add_client(websocket)
+    writer = asyncio.create_task(channel.run())
     try:
         if csi_data:
-            await websocket.send(json.dumps({"type": "initial_data", "data": csi_data}))
+            channel.push(json.dumps({"type": "initial_data", "data": list(csi_data)}))
 
         await broadcast_connection_status()
 
@@ -148,12 +234,31 @@ async def websocket_handler(websocket):
                         print(f"Updated topic filter to: {topic_filter}")
 
                     await broadcast_connection_status()
+                elif cmd["type"] == "set_format":
+                    broadcaster.set_binary(websocket, bool(cmd.get("binary")))
+                elif cmd["type"] == "query":
+                    # Time range of one device at the dashboard's resolution
+                    points = min(int(cmd.get("points", 500)), QUERY_MAX_POINTS)
+                    result = history.query(
+                        cmd["device_id"], float(cmd["start"]), float(cmd["end"]), points
+                    )
+                    channel.push(
+                        json.dumps(
+                            {
+                                "type": "query_result",
+                                "id": cmd.get("id"),
+                                "device_id": cmd["device_id"],
+                                **(result or {"error": "unknown device"}),
+                            }
+                        )
+                    )
             except Exception as e:
                 print(f"Error processing WebSocket command: {e}")
     except websockets.exceptions.ConnectionClosed:
         pass
     finally:
-        connected_clients.remove(websocket)
+        broadcaster.remove_client(websocket)
+        writer.cancel()
 
 
 def setup_mqtt(broker=DEFAULT_MQTT_BROKER, port=DEFAULT_MQTT_PORT):
@@ -164,9 +269,30 @@ def setup_mqtt(broker=DEFAULT_MQTT_BROKER, port=DEFAULT_MQTT_PORT):
     return client
 
 
+async def save_history():
+    while True:
+        await asyncio.sleep(HISTORY_SAVE_S)
+        # Copied on the loop, written to disk off it
+        state = history.snapshot()
+        await asyncio.to_thread(history.save, state)
+
+
 async def main():
-    global mqtt_client, main_event_loop
+    global mqtt_client, main_event_loop, ingest_pool
     main_event_loop = asyncio.get_running_loop()
+    ingest_pool = ingest.IngestPool(
+        on_ingest_result,
+        store_dir=CSI_STORE_DIR,
+        retention_s=CSI_STORE_RETENTION_S,
+    )
+    flush_task = asyncio.create_task(broadcaster.run())
+    save_task = asyncio.create_task(save_history())
+    if UDP_PORT:
+        _, udp = await main_event_loop.create_datagram_endpoint(
+            UDPReceiver, local_addr=(UDP_HOST, UDP_PORT)
+        )
+        udp_stats_task = asyncio.create_task(udp.log_stats())
+        print(f"UDP receiver listening on {UDP_HOST}:{UDP_PORT}")
 
     async with websockets.serve(websocket_handler, WS_HOST, WS_PORT):
         print(f"WebSocket server started on ws://{WS_HOST}:{WS_PORT}")
@@ -179,5 +305,6 @@ if __name__ == "__main__":
         asyncio.run(main())
     except KeyboardInterrupt:
         print("Server stopped")
+        history.save()
         if mqtt_client and mqtt_client.is_connected():
             mqtt_client.disconnect()
@@ -1,7 +1,12 @@
 import json
 import time
 import random
+import argparse
+import threading
+import numpy as np
 import paho.mqtt.client as mqtt
+import csi_frame
+import ingest
 
 MQTT_BROKER = "broker.emqx.io"
 MQTT_PORT = 1883
@@ -26,20 +31,214 @@ def generate_csi_data():
     return data
 
 
+def encode_binary(data, seq):
+    """Re-encode simulated data in the firmware's binary frame format"""
+    *CSIs, motion_detect, rssi = data
+    csi = np.clip(np.round(np.array(CSIs) * 127), -128, 127)
+    return csi_frame.encode(
+        csi,
+        seq=seq,
+        timestamp_us=time.monotonic_ns() // 1000,
+        rssi=rssi,
+        motion_detect=motion_detect,
+    )
+
+
+class SimDevice:
+    """
+    One simulated csi_recv board breathing at its own rate
+    Every message takes a random frame layout out of `layouts`
+    (csi_frame.LAYOUT_NAMES), all cut from one channel
+    With `link`, it is that transmitter's link of board `index` instead: the
+    links of a board share its topic and breathing rate, and the breathing
+    shows less clearly on every further link
+    """
+
+    def __init__(self, index, fs=100, loss=0.0, layouts=("ht20",), link=0):
+        self.mac = f"1a{index:010x}"
+        self.topic = f"csi/data/{self.mac}"
+        self.link = link
+        self.fs = fs
+        self.seq = 0
+        self.sample = 0
+        # Fraction of probes lost on the air, dropped before publishing
+        self.loss = loss
+        self.bpm = np.random.default_rng(index).uniform(10, 22)
+        self.depth = 0.1 / (1 + link)
+        self.rng = np.random.default_rng((index, link))
+        # Subcarriers -90..90 relative to the primary channel
+        self.base = self.rng.uniform(20, 40, 181) * np.exp(
+            1j * self.rng.uniform(0, 2 * np.pi, 181)
+        )
+        self.layouts = [csi_frame.LAYOUT_NAMES[name] for name in layouts]
+
+    def frames(self, count, layout):
+        t = (self.sample + np.arange(count)) / self.fs
+        self.sample += count
+        breath = 1 + self.depth * np.sin(2 * np.pi * self.bpm / 60 * t)
+        z = self.base[None, csi_frame.subcarrier_index(layout) + 90] * breath[:, None]
+        z = z + self.rng.normal(0, 1, z.shape) + 1j * self.rng.normal(0, 1, z.shape)
+        iq = np.empty((count, 2 * layout.subcarriers))
+        iq[:, 0::2] = z.imag
+        iq[:, 1::2] = z.real
+        return np.clip(np.round(iq), -128, 127).astype(np.int8)
+
+    def payload(self, count, binary=True):
+        probe_seq = self.sample + np.arange(count)
+        layout = self.layouts[self.rng.integers(len(self.layouts))]
+        if not binary:
+            # The text format has no layout, old firmware only sent HT20
+            layout = csi_frame.LAYOUTS[csi_frame.LAYOUT_HT20]
+        csi = self.frames(count, layout)
+        if self.loss:
+            kept = self.rng.random(count) >= self.loss
+            kept[0] = True
+            csi, probe_seq = csi[kept], probe_seq[kept]
+        rssi = -40 + int(self.rng.integers(-3, 4))
+        motion = int(self.rng.random() < 0.1)
+        self.seq += 1
+        if binary:
+            return csi_frame.encode(
+                csi,
+                seq=self.seq,
+                timestamp_us=time.monotonic_ns() // 1000,
+                rssi=rssi,
+                motion_detect=motion,
+                motion_confidence=self.rng.uniform(0.5, 1),
+                probe_seq=probe_seq,
+                layout=layout,
+                link=self.link,
+            )
+        return ",".join(map(str, csi.flatten().tolist() + [motion, rssi])).encode()
+
+
+def sim_devices(args):
+    return [
+        SimDevice(i, loss=args.loss, layouts=args.layouts.split(","), link=link)
+        for i in range(args.devices)
+        for link in range(args.links)
+    ]
+
+
+def run_devices(publish, devices, rate, batch, binary, duration=None):
+    """Publish `batch`-frame messages for every device, paced to `rate` Hz"""
+    period = batch / rate
+    deadline = start = time.monotonic()
+    sent = 0
+    while duration is None or time.monotonic() - start < duration:
+        for device in devices:
+            publish(device.topic, device.payload(batch, binary))
+            sent += 1
+        deadline += period
+        delay = deadline - time.monotonic()
+        if delay > 0:
+            time.sleep(delay)
+    return sent, time.monotonic() - start
+
+
+def local_bench(args):
+    """Drive ingest.IngestPool directly, without a broker"""
+    latencies = []
+    done = threading.Event()
+    expected = [None]
+
+    def on_result(topic, payload, error, latency):
+        if error:
+            print(f"Error: {error}")
+        latencies.append(latency)
+        if expected[0] is not None and len(latencies) >= expected[0]:
+            done.set()
+
+    pool = ingest.IngestPool(on_result, workers=args.workers, store_dir=args.store)
+    devices = sim_devices(args)
+    sent, elapsed = run_devices(
+        pool.submit, devices, args.rate, args.batch, args.binary, args.bench
+    )
+    expected[0] = sent
+    if len(latencies) < sent:
+        done.wait()
+    pool.close()
+
+    lat = np.array(latencies) * 1000
+    print(
+        f"{args.devices} devices, {pool.workers} workers: "
+        f"{sent} msgs in {elapsed:.1f}s ({sent / elapsed:.0f} msg/s offered, "
+        f"{args.devices * args.links * args.rate / args.batch:.0f} msg/s target), "
+        f"latency p50 {np.percentile(lat, 50):.2f} ms, "
+        f"p99 {np.percentile(lat, 99):.2f} ms"
+    )
+
+
 def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument(
+        "--binary", action="store_true", help="publish binary frames, not JSON"
+    )
+    parser.add_argument(
+        "--devices",
+        type=int,
+        default=0,
+        help="simulate N devices on csi/data/<mac> (0: legacy random publisher)",
+    )
+    parser.add_argument(
+        "--links", type=int, default=1, help="transmitters heard by every device"
+    )
+    parser.add_argument("--rate", type=float, default=100, help="frames/s per device")
+    parser.add_argument("--batch", type=int, default=10, help="frames per message")
+    parser.add_argument(
+        "--bench",
+        type=float,
+        metavar="SECONDS",
+        help="feed the ingest pool in-process for SECONDS and report latency",
+    )
+    parser.add_argument("--workers", type=int, default=None)
+    parser.add_argument(
+        "--store", metavar="DIR", help="with --bench, keep the frames in a CSI store"
+    )
+    parser.add_argument(
+        "--loss", type=float, default=0.0, help="fraction of frames to drop"
+    )
+    parser.add_argument(
+        "--layouts",
+        default="ht20",
+        help="comma-separated frame layouts to mix, of "
+        + ", ".join(csi_frame.LAYOUT_NAMES),
+    )
+    args = parser.parse_args()
+
+    if args.bench:
+        local_bench(args)
+        return
+
     client = mqtt.Client()
     client.connect(MQTT_BROKER, MQTT_PORT, 60)
 
+    if args.devices:
+        client.loop_start()
+        devices = sim_devices(args)
+        print(f"Publishing {args.devices} devices at {args.rate:g} Hz...")
+        try:
+            run_devices(client.publish, devices, args.rate, args.batch, args.binary)
+        except KeyboardInterrupt:
+            print("Simulation stopped")
+            client.disconnect()
+        return
+
     print(f"Publishing simulated data to various topics every second...")
 
     try:
+        seq = 0
         while True:
             # Select a random topic
             time.sleep(2)
             topic = random.choice(TOPICS)
 
             data = generate_csi_data()
-            client.publish(topic, json.dumps(data))
+            if args.binary:
+                client.publish(topic, encode_binary(data, seq))
+                seq += 1
+            else:
+                client.publish(topic, json.dumps(data))
             print(f"Published to {topic}: {data}")
 
             time.sleep(1)
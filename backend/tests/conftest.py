@@ -0,0 +1,41 @@
+import os
+import shutil
+import subprocess
+import sys
+import pytest
+
+# The backend modules import each other by name, as server.py runs them
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+FIRMWARE = os.path.join(
+    os.path.dirname(os.path.abspath(__file__)), "..", "..", "esp32c5", "csi_recv"
+)
+
+
+@pytest.fixture(scope="session")
+def host_tool(tmp_path_factory):
+    """
+    Builds esp32c5/csi_recv/host/<name>.c with the main/ modules and the
+    host/ helpers it links, as in the README, and returns the path of the
+    binary
+    Tests using it are skipped without a C compiler
+    """
+    cc = shutil.which(os.environ.get("CC", "cc"))
+    out = tmp_path_factory.mktemp("host")
+
+    def build(name, modules, helpers=()):
+        if cc is None:
+            pytest.skip(f"no C compiler to build {name}")
+        tool = str(out / name)
+        main = os.path.join(FIRMWARE, "main")
+        subprocess.run(
+            [cc, "-std=c11", "-D_DEFAULT_SOURCE", "-O2", "-I" + main, "-o", tool]
+            + [os.path.join(FIRMWARE, "host", name + ".c")]
+            + [os.path.join(main, m + ".c") for m in modules]
+            + [os.path.join(FIRMWARE, "host", h + ".c") for h in helpers]
+            + ["-lm"],
+            check=True,
+        )
+        return tool
+
+    return build
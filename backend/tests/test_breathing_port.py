@@ -0,0 +1,45 @@
+import pytest
+import csi_trace
+
+"""
+The firmware's breathing engine (esp32c5/csi_recv/main/breathing.c) against
+get_br() on the same windows of synthetic traces, within
+csi_trace.br_check()'s default tolerance
+"""
+
+
+@pytest.fixture(scope="module")
+def breathing_replay(host_tool):
+    return host_tool(
+        "breathing_replay", ["breathing", "csi_dsp", "csi_layout", "csi_trace"]
+    )
+
+
+# The last trace flipped a peak by 3.5 BPM while breathing.c rounded its
+# window to the Q15 mean and took peaks straight from the Q15 ACF
+@pytest.mark.parametrize(
+    "bpm, snr_db, seed, layouts",
+    [
+        (10, 20, 10, ("ht20",)),
+        (15, 10, 15, ("ht20",)),
+        (22, 30, 22, ("ht20",)),
+        (18, 20, 18, ("ht20",)),
+        (15, 30, 0, ("ht20",)),
+        (18, 20, 18, ("ht20", "ht40-", "lltf")),
+    ],
+)
+def test_device_matches_get_br(breathing_replay, tmp_path, bpm, snr_db, seed, layouts):
+    path = str(tmp_path / "trace.csit")
+    trace = csi_trace.synth(40, bpm=bpm, snr_db=snr_db, seed=seed, layouts=layouts)
+    csi_trace.write(path, trace)
+    assert csi_trace.br_check(path, breathing_replay, hop=50) == 0
+
+
+def test_mismatch_fails(tmp_path):
+    path = str(tmp_path / "trace.csit")
+    csi_trace.write(path, csi_trace.synth(20, bpm=15))
+    # A device stuck at 30 BPM, twice the rate, on every window
+    tool = tmp_path / "stuck"
+    tool.write_text("#!/bin/sh\nfor f in 1500 1600 1700; do echo $f,30.0; done\n")
+    tool.chmod(0o755)
+    assert csi_trace.br_check(path, str(tool)) == 3
@@ -0,0 +1,19 @@
+import subprocess
+
+"""
+The firmware's MQTT backlog (main/csi_backlog.c) against a FIFO model:
+esp32c5/csi_recv/host/csi_backlog_test.c checks its skip markers and `used`
+accounting after every push and pop
+"""
+
+
+def test_backlog_matches_fifo_model(host_tool):
+    tool = host_tool("csi_backlog_test", ["csi_backlog"])
+    for seed in (1, 2, 3):
+        run = subprocess.run(
+            [tool, "--ops", "100000", "--seed", str(seed)],
+            capture_output=True,
+            text=True,
+        )
+        assert run.returncode == 0, run.stderr[-2000:]
+        assert "0 check(s) failed" in run.stdout
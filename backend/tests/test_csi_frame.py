@@ -0,0 +1,101 @@
+import json
+import subprocess
+import numpy as np
+import pytest
+import csi_frame
+
+"""
+csi_frame.py against the firmware's encoder: messages written by
+esp32c5/csi_recv/host/csi_frame_dump.c with main/csi_frame.c must decode to
+the fields they were built from, and csi_frame.encode() must give the same
+bytes. The firmware's codec itself goes through the random round trips of
+esp32c5/csi_recv/host/csi_codec_bench.c
+"""
+
+
+@pytest.fixture(scope="module")
+def messages(host_tool, tmp_path_factory):
+    tool = host_tool("csi_frame_dump", ["csi_frame", "csi_codec", "csi_layout"])
+    path = str(tmp_path_factory.mktemp("csi_frame") / "messages.jsonl")
+    subprocess.run(
+        [tool, "--messages", "2000", "--repeat", "1", path],
+        check=True,
+        stdout=subprocess.DEVNULL,
+    )
+    with open(path) as f:
+        return [json.loads(line) for line in f]
+
+
+def expected_csi(m):
+    return np.frombuffer(bytes.fromhex(m["iq"]), dtype=np.int8).reshape(
+        m["frame_count"], 2 * m["subcarriers"]
+    )
+
+
+def test_decodes_every_field(messages):
+    seen_flags = set()
+    for m in messages:
+        header, csi = csi_frame.decode(bytes.fromhex(m["payload"]))
+        assert header["version"] == csi_frame.VERSION
+        for field in ("seq", "timestamp_us", "rssi", "motion_detect", "link"):
+            assert header[field] == m[field], field
+        for field in ("frame_count", "subcarriers", "first_word_invalid"):
+            assert header[field] == m[field], field
+        assert header["motion_confidence"] == m["motion_confidence"] / 255
+        if m["layout"] == csi_frame.LAYOUT_UNKNOWN:
+            assert header["layout"] == csi_frame.lookup_layout(m["subcarriers"])
+        else:
+            assert header["layout"].id == m["layout"]
+        if m["seq_flag"]:
+            assert list(header["probe_seq"]) == m["probe_seq"]
+        else:
+            assert header["probe_seq"] is None
+        np.testing.assert_array_equal(csi, expected_csi(m))
+        seen_flags.add((m["motion_detect"], m["seq_flag"], m["first_word_invalid"]))
+    # Every combination of flags came up
+    assert len(seen_flags) == 8
+
+
+def test_python_encoder_matches(messages):
+    for m in messages:
+        layout = csi_frame.LAYOUTS.get(m["layout"])
+        payload = csi_frame.encode(
+            expected_csi(m),
+            seq=m["seq"],
+            timestamp_us=m["timestamp_us"],
+            rssi=m["rssi"],
+            motion_detect=m["motion_detect"],
+            motion_confidence=m["motion_confidence"] / 255,
+            probe_seq=m["probe_seq"] if m["seq_flag"] else None,
+            layout=layout,
+            first_word_invalid=m["first_word_invalid"],
+            link=m["link"],
+        )
+        assert payload.hex() == m["payload"]
+
+
+def test_truncated_messages_are_rejected(messages):
+    payload = bytes.fromhex(messages[0]["payload"])
+    for size in (0, csi_frame.HEADER_V1.size - 1, csi_frame.HEADER.size - 1):
+        with pytest.raises(ValueError):
+            csi_frame.decode(payload[:size])
+
+
+def test_version_1_still_decodes(messages):
+    m = messages[0]
+    payload = bytes.fromhex(m["payload"])
+    v1 = bytes([payload[0], 1]) + payload[2 : csi_frame.HEADER_V1.size]
+    header, csi = csi_frame.decode(v1 + payload[csi_frame.HEADER.size :])
+    assert header["version"] == 1
+    assert header["motion_confidence"] is None
+    assert header["seq"] == m["seq"]
+    np.testing.assert_array_equal(csi, expected_csi(m))
+
+
+def test_codec_round_trips(host_tool):
+    tool = host_tool(
+        "csi_codec_bench", ["csi_codec", "csi_frame", "csi_trace", "csi_layout"]
+    )
+    run = subprocess.run([tool, "--fuzz", "2000"], capture_output=True, text=True)
+    assert run.returncode == 0, run.stderr[-2000:]
+    assert "2000 round trips, 0 failure(s)" in run.stdout
@@ -0,0 +1,118 @@
+import os
+import shutil
+import subprocess
+import numpy as np
+import pytest
+import breathing
+import csi_frame
+from conftest import FIRMWARE
+
+"""
+make_csi_complex(), subcarrier_band_mean() and subcarrier_select_mean(), with
+numpy and with the native kernels of csi_kernel.c, against the list
+comprehensions they replaced
+"""
+
+BACKEND = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def reference_complex(csi_data):
+    """
+    make_csi_complex() as it was, one Python complex per subcarrier
+    """
+    return np.array(
+        [
+            [complex(row[i + 1], row[i]) for i in range(0, len(row), 2)]
+            for row in csi_data
+        ]
+    )
+
+
+def reference_band_mean(csi_data, first, last):
+    """
+    The band mean as it was, over the rows of reference_complex()
+    """
+    return np.array([np.mean(row[first:last]) for row in reference_complex(csi_data)])
+
+
+@pytest.fixture(scope="module")
+def native(tmp_path_factory):
+    """
+    libcsi_kernel.so built as in the README, skipped without a C compiler
+    """
+    cc = shutil.which(os.environ.get("CC", "cc"))
+    if cc is None:
+        pytest.skip("no C compiler to build libcsi_kernel.so")
+    lib = str(tmp_path_factory.mktemp("kernel") / "libcsi_kernel.so")
+    main = os.path.join(FIRMWARE, "main")
+    subprocess.run(
+        [cc, "-O3", "-shared", "-fPIC", "-I" + main, "-o", lib]
+        + [os.path.join(BACKEND, "csi_kernel.c")]
+        + [os.path.join(main, m + ".c") for m in ("csi_codec", "csi_frame")],
+        check=True,
+    )
+    kernel = breathing._load_kernel(lib)
+    assert kernel is not None
+    return kernel
+
+
+@pytest.fixture(params=["numpy", "native"])
+def kernel(request, monkeypatch):
+    lib = request.getfixturevalue("native") if request.param == "native" else None
+    monkeypatch.setattr(breathing, "_kernel", lib)
+    return request.param
+
+
+def rows(shape, seed=0):
+    return np.random.default_rng(seed).integers(-128, 128, shape, dtype=np.int8)
+
+
+def inputs():
+    """
+    CSI rows in the forms the backend passes them: int8 matrices of every
+    layout, with the extremes of int8, views cut out of wider rows as
+    csi_frame.band() and probe sequence numbers leave them, floats and lists
+    """
+    full = rows((64, 2 * 117 + 8), seed=1)
+    yield pytest.param(rows((200, 114)), id="ht20")
+    for layout in csi_frame.LAYOUTS.values():
+        yield pytest.param(
+            rows((50, 2 * layout.subcarriers), seed=layout.id), id=layout.name
+        )
+    yield pytest.param(
+        np.array([[-128, 127] * 57, [127, -128] * 57], dtype=np.int8), id="extremes"
+    )
+    yield pytest.param(full[:, 4 : 4 + 114], id="row view")
+    yield pytest.param(full[::2, :114], id="every other row")
+    yield pytest.param(rows((20, 114), seed=2).astype(np.float64), id="float")
+    yield pytest.param(rows((20, 114), seed=3).tolist(), id="list")
+    yield pytest.param(rows((1, 114), seed=4), id="one row")
+
+
+@pytest.mark.parametrize("csi", list(inputs()))
+def test_make_csi_complex(kernel, csi):
+    np.testing.assert_array_equal(
+        breathing.make_csi_complex(csi), reference_complex(csi)
+    )
+
+
+@pytest.mark.parametrize("csi", list(inputs()))
+@pytest.mark.parametrize(
+    "first, last", [(breathing.BAND_FIRST, breathing.BAND_LAST), (0, 1), (20, 30)]
+)
+def test_subcarrier_band_mean(kernel, csi, first, last):
+    np.testing.assert_allclose(
+        breathing.subcarrier_band_mean(csi, first, last),
+        reference_band_mean(csi, first, last),
+        rtol=0,
+        atol=1e-12,
+    )
+
+
+@pytest.mark.parametrize("index", [[18, 19, 20, 21], [3, 9, 27, 40, 55], [7]])
+def test_subcarrier_select_mean(kernel, index):
+    csi = rows((100, 114), seed=5)
+    want = np.array([np.mean(row[index]) for row in reference_complex(csi)])
+    np.testing.assert_allclose(
+        breathing.subcarrier_select_mean(csi, index), want, rtol=0, atol=1e-12
+    )
@@ -0,0 +1,132 @@
+import subprocess
+import numpy as np
+import pytest
+import csi_codec
+import csi_frame
+import csi_trace
+import ingest
+
+"""
+The firmware's publish path (esp32c5/csi_recv/main/csi_publish.c), the same
+code app_main.c runs, through host/csi_replay: every link's raw messages are
+numbered without gaps, carry the link's id and, with probes, its probe
+sequence numbers, and decode to the trace's frames in order; legacy text
+messages carry the HT20 frames of a mixed trace in order
+"""
+
+MODULES = [
+    "breathing",
+    "csi_backlog",
+    "csi_codec",
+    "csi_dsp",
+    "csi_frame",
+    "csi_layout",
+    "csi_publish",
+    "csi_ring",
+    "csi_stream",
+    "csi_trace",
+    "csi_udp",
+    "motion",
+    "publish_sched",
+    "sc_rank",
+]
+LINK = 7
+
+
+@pytest.fixture(scope="module")
+def tool(host_tool):
+    return host_tool("csi_replay", MODULES, helpers=["mqtt_host"])
+
+
+@pytest.fixture(scope="module")
+def trace(tmp_path_factory):
+    path = str(tmp_path_factory.mktemp("replay") / "mixed.csit")
+    csi_trace.write(
+        path, csi_trace.synth(20, layouts=("ht20", "ht40+", "lltf"), seed=3)
+    )
+    return path
+
+
+def replay(tool, trace, tmp_path, *args):
+    """The messages csi_replay publishes for `trace` with `args`"""
+    out = tmp_path / "messages.bin"
+    subprocess.run(
+        [tool, "--quiet", "--link", str(LINK), "--messages", str(out), *args, trace],
+        check=True,
+        capture_output=True,
+    )
+    data = out.read_bytes()
+    messages, pos = [], 0
+    while pos < len(data):
+        size = int.from_bytes(data[pos : pos + 4], "little")
+        messages.append(data[pos + 4 : pos + 4 + size])
+        pos += 4 + size
+    return messages
+
+
+@pytest.mark.parametrize(
+    "links, probe, coded",
+    [(1, False, False), (1, True, True), (3, True, True), (4, False, True)],
+)
+def test_links(tool, trace, tmp_path, links, probe, coded):
+    args = ["--links", str(links)] + ["--probe"] * probe + ["--coded"] * coded
+    decoders = [csi_codec.Decoder() for _ in range(links)]
+    seqs = [[] for _ in range(links)]
+    rows = [[] for _ in range(links)]
+    probe_seqs = [[] for _ in range(links)]
+    for payload in replay(tool, trace, tmp_path, *args):
+        assert csi_frame.is_binary(payload)
+        i = csi_frame.link(payload) - LINK
+        assert 0 <= i < links
+        header, csi = csi_frame.decode(payload, decoders[i])
+        assert header["skipped"] == 0
+        seqs[i].append(header["seq"])
+        rows[i].extend(bytes(row) for row in csi)
+        if probe:
+            probe_seqs[i].extend(int(s) for s in header["probe_seq"])
+        else:
+            assert header["probe_seq"] is None
+
+    # Frame k of the trace went to link k % links
+    frames = [bytes(iq) for _, iq in csi_trace.read(trace)]
+    for i in range(links):
+        assert seqs[i] == list(range(len(seqs[i]))), f"link {i} sequence"
+        assert decoders[i].resets == 0
+        want = frames[i::links]
+        # Frames after the last publish tick are never sent
+        assert len(want) - 20 <= len(rows[i]) <= len(want)
+        assert rows[i] == want[: len(rows[i])], f"link {i} frames"
+        if probe:
+            assert probe_seqs[i] == list(range(len(rows[i])))
+
+
+def test_decimated_stream(tool, trace, tmp_path):
+    """The stream is the first link's, numbered on its own"""
+    messages = replay(tool, trace, tmp_path, "--links", "2", "--decimate", "10")
+    assert messages
+    seqs = []
+    for payload in messages:
+        assert csi_frame.is_stream(payload)
+        header, ids, _ = csi_frame.decode_stream(payload)
+        assert header["link"] == LINK
+        assert ids[0] == csi_frame.STREAM_CHANNEL_BREATHING
+        seqs.append(header["seq"])
+    assert seqs == list(range(len(seqs)))
+
+
+def test_text_carries_ht20_frames(tool, trace, tmp_path):
+    """ingest.parse_payload() reads every text message as whole HT20 rows"""
+    ht20 = csi_frame.LAYOUTS[csi_frame.LAYOUT_HT20]
+    want = [
+        csi_frame.band(iq[None, :], ht20)[0]
+        for _, iq in csi_trace.read(trace)
+        if len(iq) == 2 * ht20.subcarriers
+    ]
+    rows = []
+    for payload in replay(tool, trace, tmp_path, "--text"):
+        assert not csi_frame.is_binary(payload)
+        csi, _, _, header = ingest.parse_payload(payload)
+        assert header is None
+        rows.extend(csi)
+    assert len(want) - 20 <= len(rows) <= len(want)
+    np.testing.assert_array_equal(rows, want[: len(rows)])
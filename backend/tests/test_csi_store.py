@@ -0,0 +1,177 @@
+import os
+import shutil
+import numpy as np
+import csi_frame
+import csi_store
+
+"""
+csi_store.DeviceStore against the records appended to it, across segments,
+processes and restarts
+"""
+
+SEGMENT = 100
+
+
+def batch(start, n, seed=0):
+    """n records at 10 ms spacing from record `start` on"""
+    rng = np.random.default_rng(seed + start)
+    t = (start + np.arange(n)) * 10_000 + 1_700_000_000_000_000
+    rows = rng.integers(-128, 128, (n, 2 * csi_frame.BAND_SUBCARRIERS))
+    return t, rows.astype(np.int8)
+
+
+def fill(store, start, n, chunk=37):
+    """Appends records start..start+n in odd-sized chunks, returns them"""
+    ts, rows = [], []
+    for i in range(start, start + n, chunk):
+        t, r = batch(i, min(chunk, start + n - i))
+        store.append(t, r, rssi=-40, probe_seq=np.arange(i, i + len(t)))
+        ts.append(t)
+        rows.append(r)
+    return np.concatenate(ts), np.concatenate(rows)
+
+
+def check(store, t, rows):
+    records = store.read(t[0], t[-1] + 1)
+    assert np.array_equal(records["timestamp_us"], t)
+    assert np.array_equal(records["iq"], rows)
+    # A range starting and ending inside segments
+    lo, hi = len(t) // 3, 2 * len(t) // 3
+    assert np.array_equal(store.rows(t[lo], t[hi]), rows[lo:hi])
+
+
+def test_reads_span_segments_and_survive_reopen(tmp_path):
+    store = csi_store.DeviceStore(tmp_path, "dev", True, segment_records=SEGMENT)
+    t, rows = fill(store, 0, 450)
+    assert len(store.segments) == 5
+    check(store, t, rows)
+    assert len(store.scan(t[90], t[110])) == 2
+    assert len(store.read(t[10], t[20])) == 10
+    assert len(store.read(t[-1] + 1, t[-1] + 10**6)) == 0
+    store.close()
+
+    store = csi_store.DeviceStore(tmp_path, "dev", True, segment_records=SEGMENT)
+    t2, rows2 = fill(store, 450, 120)
+    check(store, np.concatenate([t, t2]), np.concatenate([rows, rows2]))
+    store.close()
+
+
+def test_timestamps_never_decrease(tmp_path):
+    store = csi_store.DeviceStore(tmp_path, "dev", True, segment_records=SEGMENT)
+    t, rows = batch(0, 20)
+    store.append(t, rows)
+    store.append(t[:5], rows[:5])
+    stamps = store.read(0, t[-1] + 1)["timestamp_us"]
+    assert len(stamps) == 25
+    assert np.all(np.diff(stamps) >= 0)
+    store.close()
+
+
+def test_reader_refresh_sees_new_records_and_segments(tmp_path):
+    writer = csi_store.DeviceStore(tmp_path, "dev", True, segment_records=SEGMENT)
+    t, rows = fill(writer, 0, 60)
+    reader = csi_store.DeviceStore(tmp_path, "dev")
+    check(reader, t, rows)
+
+    t2, rows2 = fill(writer, 60, 190)
+    t, rows = np.concatenate([t, t2]), np.concatenate([rows, rows2])
+    assert len(reader.read(t[0], t[-1] + 1)) == 60
+    reader.refresh()
+    check(reader, t, rows)
+
+    writer.retain(0, now_us=t[-1])
+    reader.refresh()
+    assert len(reader.segments) == 1
+    assert np.array_equal(reader.rows(0, t[-1] + 1), rows[200:])
+    writer.close()
+    reader.close()
+
+
+def test_retention_keeps_recent_and_open_segments(tmp_path):
+    store = csi_store.DeviceStore(tmp_path, "dev", True, segment_records=SEGMENT)
+    t, rows = fill(store, 0, 450)
+    # Segments end at records 99, 199, 299 and 399, 1 s apart
+    assert store.retain(1.5, now_us=t[399] + 1) == 2
+    check(store, t[200:], rows[200:])
+    # The open segment stays whatever its age
+    assert store.retain(0, now_us=t[-1] + 10**9) == 2
+    check(store, t[400:], rows[400:])
+    store.close()
+    assert len(os.listdir(store.dir)) == 1
+
+
+def test_retention_on_seal(tmp_path):
+    store = csi_store.DeviceStore(
+        tmp_path, "dev", True, segment_records=SEGMENT, retention_s=0
+    )
+    fill(store, 0, 450)
+    # The records are from 2023, so every segment goes once sealed
+    assert len(store.segments) == 1
+    store.close()
+
+
+def restarts(tmp_path, runs=5, n=30):
+    """A writer restarted `runs` times, each leaving a small sealed segment"""
+    t, rows = [], []
+    for i in range(runs):
+        store = csi_store.DeviceStore(tmp_path, "dev", True, segment_records=SEGMENT)
+        ti, ri = fill(store, i * n, n)
+        store.close()
+        t.append(ti)
+        rows.append(ri)
+    return np.concatenate(t), np.concatenate(rows)
+
+
+def test_compaction_merges_small_segments(tmp_path):
+    t, rows = restarts(tmp_path)
+    # Each open merged the small segments before the newest that fit
+    store = csi_store.DeviceStore(tmp_path, "dev", segment_records=SEGMENT)
+    assert [s.count for s in store.segments] == [90, 30, 30]
+    check(store, t, rows)
+    store.close()
+
+    store = csi_store.DeviceStore(tmp_path, "dev", True, segment_records=SEGMENT)
+    assert [s.count for s in store.segments] == [90, 30, 30]
+    check(store, t, rows)
+    store.close()
+
+
+def test_compaction_survives_a_crash_mid_merge(tmp_path):
+    t, rows = restarts(tmp_path, runs=3)
+    device = os.path.join(tmp_path, "dev")
+    before = sorted(os.listdir(device))
+    saved = tmp_path / "saved"
+    shutil.copytree(device, saved)
+
+    # Merge, then put back the sources a crash before their removal leaves
+    store = csi_store.DeviceStore(tmp_path, "dev", True, segment_records=SEGMENT)
+    store.close()
+    merged = sorted(os.listdir(device))
+    assert len(merged) == len(before) - 1
+    leftovers = [name for name in before if name not in merged or name == before[0]]
+    for name in leftovers[1:]:
+        shutil.copy(saved / name, device)
+    with open(os.path.join(device, csi_store.MERGE_LOG), "w") as f:
+        f.write("\n".join(leftovers[1:]))
+
+    reader = csi_store.DeviceStore(tmp_path, "dev", segment_records=SEGMENT)
+    check(reader, t, rows)
+    reader.close()
+    store = csi_store.DeviceStore(tmp_path, "dev", True, segment_records=SEGMENT)
+    check(store, t, rows)
+    store.close()
+    assert csi_store.MERGE_LOG not in os.listdir(device)
+
+    # A crash before the rename leaves the sources and merge.tmp
+    shutil.rmtree(device)
+    shutil.copytree(saved, device)
+    shutil.copy(os.path.join(device, before[0]), os.path.join(device, "merge.tmp"))
+    with open(os.path.join(device, csi_store.MERGE_LOG), "w") as f:
+        f.write("\n".join(leftovers[1:]))
+    reader = csi_store.DeviceStore(tmp_path, "dev", segment_records=SEGMENT)
+    check(reader, t, rows)
+    reader.close()
+    store = csi_store.DeviceStore(tmp_path, "dev", True, segment_records=SEGMENT)
+    check(store, t, rows)
+    store.close()
+    assert not {csi_store.MERGE_LOG, "merge.tmp"} & set(os.listdir(device))
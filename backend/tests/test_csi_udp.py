@@ -0,0 +1,119 @@
+import pytest
+import csi_udp
+
+"""
+csi_udp.Receiver on datagrams as main/csi_udp.c packs them: every message
+comes out once and in order whatever is lost, repeated or reordered, and a
+restarted receiver is followed from its first message on
+"""
+
+MAC = bytes.fromhex("aabbccddeeff")
+
+
+class Sender:
+    """Packs datagrams like csi_udp_pack(), `redundancy` repeats each"""
+
+    def __init__(self, boot=1, redundancy=2):
+        self.boot = boot
+        self.redundancy = redundancy
+        self.seq = 0
+        self.history = []
+
+    def pack(self, message):
+        messages = self.history[-self.redundancy :] if self.redundancy else []
+        messages = messages + [message]
+        out = csi_udp.HEADER.pack(
+            csi_udp.MAGIC, csi_udp.VERSION, 0, len(messages), MAC, self.boot, self.seq
+        )
+        for m in messages:
+            out += csi_udp.ENTRY.pack(len(m)) + m
+        self.seq += 1
+        self.history.append(message)
+        return out
+
+
+def message(i, boot=1):
+    return f"{boot}:{i}".encode()
+
+
+def run(receiver, datagrams):
+    out = []
+    for d in datagrams:
+        device, messages = receiver.push(d)
+        assert device == MAC.hex()
+        out += messages
+    return out
+
+
+def test_in_order():
+    sender, receiver = Sender(), csi_udp.Receiver()
+    got = run(receiver, [sender.pack(message(i)) for i in range(50)])
+    assert got == [message(i) for i in range(50)]
+    stats = receiver.stats(MAC.hex())
+    assert stats["received"] == 50 and stats["lost"] == 0
+    # The first datagram carried nothing before it
+    assert stats["recovered"] == 0 and stats["duplicates"] == 0
+
+
+def test_repeats_make_up_for_loss():
+    sender, receiver = Sender(redundancy=2), csi_udp.Receiver()
+    datagrams = [sender.pack(message(i)) for i in range(20)]
+    # Two in a row lost: the next datagram still carries both
+    got = run(receiver, datagrams[:5] + datagrams[7:])
+    assert got == [message(i) for i in range(20)]
+    stats = receiver.stats(MAC.hex())
+    assert stats["recovered"] == 2 and stats["lost"] == 0
+
+    # Three in a row are more than the repeats cover
+    sender, receiver = Sender(redundancy=2), csi_udp.Receiver()
+    datagrams = [sender.pack(message(i)) for i in range(20)]
+    got = run(receiver, datagrams[:5] + datagrams[8:])
+    assert got == [message(i) for i in range(20) if i != 5]
+    assert receiver.stats(MAC.hex())["lost"] == 1
+
+
+def test_late_and_repeated_datagrams_are_dropped():
+    sender, receiver = Sender(redundancy=1), csi_udp.Receiver()
+    d = [sender.pack(message(i)) for i in range(10)]
+    order = [d[0], d[1], d[3], d[2], d[4], d[4], d[6], d[5], d[7], d[8], d[9]]
+    got = run(receiver, order)
+    # d[2] came after d[3] had delivered message 2 as a repeat, d[5] after
+    # d[6]; neither delivers twice
+    assert got == [message(i) for i in range(10)]
+    stats = receiver.stats(MAC.hex())
+    assert stats["duplicates"] == 3
+    assert stats["lost"] == 0 and stats["restarts"] == 0
+
+
+@pytest.mark.parametrize("sent_before", [1, 3, 10, 31, 100])
+def test_restart_with_boot_id(sent_before):
+    first, receiver = Sender(boot=0x1234), csi_udp.Receiver()
+    got = run(receiver, [first.pack(message(i)) for i in range(sent_before)])
+    second = Sender(boot=0x4321)
+    got += run(receiver, [second.pack(message(i, boot=2)) for i in range(5)])
+    assert got == [message(i) for i in range(sent_before)] + [
+        message(i, boot=2) for i in range(5)
+    ]
+    stats = receiver.stats(MAC.hex())
+    assert stats["restarts"] == 1 and stats["lost"] == 0
+
+
+@pytest.mark.parametrize("sent_before", [2, 5, 31, 40, 100])
+def test_restart_without_boot_id(sent_before):
+    first, receiver = Sender(boot=0), csi_udp.Receiver()
+    got = run(receiver, [first.pack(message(i)) for i in range(sent_before)])
+    second = Sender(boot=0)
+    got += run(receiver, [second.pack(message(i, boot=2)) for i in range(5)])
+    assert got == [message(i) for i in range(sent_before)] + [
+        message(i, boot=2) for i in range(5)
+    ]
+    assert receiver.stats(MAC.hex())["restarts"] == 1
+
+
+def test_malformed():
+    receiver = csi_udp.Receiver()
+    good = Sender().pack(b"x")
+    for bad in (good[:10], good[:-1], b"\x00" + good[1:]):
+        with pytest.raises(ValueError):
+            receiver.push(bad)
+    assert receiver.malformed == 3
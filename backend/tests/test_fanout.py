@@ -0,0 +1,40 @@
+import asyncio
+import fanout
+
+"""
+Broadcaster and ClientChannel with slow and stalled clients next to fast ones
+(fanout.py bench): the fast ones keep getting every batch on time, the slow
+ones are coalesced to the latest, and a fanout that shares one writer or
+queues without bound fails the checks
+"""
+
+BENCH = dict(fast=3, slow=2, stalled=1, seconds=2, slow_s=0.3)
+
+
+def test_slow_clients_do_not_block_fast_ones():
+    assert fanout.bench(**BENCH) == 0
+
+
+def test_shared_writer_is_caught(monkeypatch):
+    lock = asyncio.Lock()
+
+    async def run(self):
+        while True:
+            await self.wakeup.wait()
+            self.wakeup.clear()
+            while self.queue:
+                async with lock:
+                    await self.websocket.send(self.queue.popleft())
+
+    monkeypatch.setattr(fanout.ClientChannel, "run", run)
+    assert fanout.bench(**BENCH) > 0
+
+
+def test_unbounded_queue_is_caught(monkeypatch):
+    init = fanout.ClientChannel.__init__
+
+    def unbounded(self, websocket, depth):
+        init(self, websocket, None)
+
+    monkeypatch.setattr(fanout.ClientChannel, "__init__", unbounded)
+    assert fanout.bench(**BENCH) > 0
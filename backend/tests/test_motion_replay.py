@@ -0,0 +1,59 @@
+import subprocess
+import pytest
+import csi_trace
+
+"""
+The firmware's motion detector (esp32c5/csi_recv/main/motion.c) over synthetic
+traces whose motion is known, through host/motion_replay: motion reported
+through each span of movement and nowhere else
+Receiver noise alone scores 2 / SNR against MOTION_POWER_REF (see motion.h),
+so the traces are at 20 dB and above
+"""
+
+GOLDEN = {
+    "still": (dict(snr_db=20), []),
+    "still, 30 dB": (dict(snr_db=30, seed=1), []),
+    "motion": (dict(snr_db=20, motion=(15, 25)), [(15, 25)]),
+    "short motion": (dict(snr_db=30, motion=(5, 7), seed=2), [(5, 7)]),
+    "motion, mixed layouts": (
+        dict(snr_db=20, motion=(10, 14), layouts=("ht20", "ht40+", "lltf"), seed=3),
+        [(10, 14)],
+    ),
+}
+
+
+@pytest.fixture(scope="module")
+def tool(host_tool):
+    return host_tool("motion_replay", ["motion", "csi_layout", "csi_trace"])
+
+
+@pytest.fixture(scope="module")
+def traces(tmp_path_factory):
+    out = tmp_path_factory.mktemp("motion")
+    paths = {}
+    for n, (name, (kwargs, _)) in enumerate(GOLDEN.items()):
+        paths[name] = str(out / f"{n}.csit")
+        csi_trace.write(paths[name], csi_trace.synth(40, **kwargs))
+    return paths
+
+
+def replay(tool, path, spans):
+    args = [tool]
+    for start, end in spans:
+        args += ["--motion", str(start), str(end)]
+    return subprocess.run(args + [path], capture_output=True, text=True)
+
+
+@pytest.mark.parametrize("name", GOLDEN)
+def test_golden(tool, traces, name):
+    result = replay(tool, traces[name], GOLDEN[name][1])
+    assert result.returncode == 0, result.stdout + result.stderr
+
+
+def test_missed_motion_fails(tool, traces):
+    assert replay(tool, traces["still"], [(15, 25)]).returncode == 1
+
+
+def test_false_motion_fails(tool, traces):
+    assert replay(tool, traces["motion"], []).returncode == 1
+    assert replay(tool, traces["motion"], [(15, 20)]).returncode == 1
@@ -0,0 +1,151 @@
+import numpy as np
+import pytest
+import rollup
+
+"""
+rollup.Pyramid and History queries against the same aggregates taken
+straight from the results, with rings small enough to wrap around
+"""
+
+CAPACITY = 40
+
+
+def results(n=3000, seed=0):
+    """Irregular times over ~50 minutes with gaps, METRICS values with NaNs"""
+    rng = np.random.default_rng(seed)
+    gaps = rng.exponential(1.0, n)
+    gaps[rng.random(n) < 0.01] += 120
+    t = 1_700_000_000.0 + np.cumsum(gaps)
+    values = np.column_stack(
+        [
+            rng.normal(-50, 3, n),
+            rng.random(n) < 0.2,
+            rng.random(n),
+            rng.normal(15, 2, n),
+        ]
+    )
+    values[rng.random(values.shape) < 0.1] = np.nan
+    # A stretch without any breathing rate
+    values[n // 3 : n // 3 + 200, 3] = np.nan
+    return t, values
+
+
+def brute(t, values, width, start, end, points, capacity=CAPACITY):
+    """
+    (t, step, series) as Pyramid.query() should give them for one level of
+    `width`: whole buckets per step, and only the results the ring still
+    holds
+    """
+    first = int(start // width)
+    last = max(int(np.ceil(end / width)) - 1, first)
+    per = -(-(last - first + 1) // points)
+    steps = np.arange(first, last + 1, per) * width
+    step = per * width
+    held = t // width > t.max() // width - capacity
+    series = {}
+    for i, metric in enumerate(rollup.METRICS):
+        out = np.full((3, len(steps)), np.nan)
+        for j, s in enumerate(steps):
+            v = values[held & (t >= s) & (t < s + step), i]
+            v = v[~np.isnan(v)]
+            if len(v):
+                out[:, j] = v.min(), v.max(), v.mean()
+        series[metric] = tuple(out)
+    return steps, step, series
+
+
+def check(got, expected):
+    t, step, series = got
+    assert np.array_equal(t, expected[0])
+    assert step == expected[1]
+    for metric in rollup.METRICS:
+        for a, b in zip(series[metric], expected[2][metric]):
+            np.testing.assert_allclose(a, b, rtol=1e-9, equal_nan=True)
+
+
+def ranges(t):
+    end = t[-1] + 1
+    return [
+        # The last minute, the last few buckets of every level
+        (end - 60, end, 30),
+        (end - 600, end, 100),
+        # Everything, wrapped around the rings many times over
+        (t[0], end, 50),
+        # Partly before what the finer rings hold
+        (end - 3000, end - 1000, 17),
+        # Entirely before it, and after the newest result
+        (t[0], t[0] + 300, 10),
+        (end + 100, end + 400, 5),
+        # One point
+        (end - 3000, end, 1),
+    ]
+
+
+@pytest.mark.parametrize("width", [1, 10, 60])
+def test_query_matches_the_results(width):
+    t, values = results()
+    pyramid = rollup.Pyramid(levels=(width,), capacity=CAPACITY)
+    pyramid.add_many(t, values)
+    for start, end, points in ranges(t):
+        check(
+            pyramid.query(start, end, points),
+            brute(t, values, width, start, end, points),
+        )
+
+
+def test_add_matches_add_many():
+    t, values = results(1500, seed=1)
+    one = rollup.Pyramid(capacity=CAPACITY)
+    for ti, row in zip(t, values):
+        one.add(
+            ti, {m: None if np.isnan(v) else v for m, v in zip(rollup.METRICS, row)}
+        )
+    many = rollup.Pyramid(capacity=CAPACITY)
+    # In batches that straddle bucket edges and ring wraps
+    for i in range(0, len(t), 97):
+        many.add_many(t[i : i + 97], values[i : i + 97])
+    for start, end, points in ranges(t):
+        check(one.query(start, end, points), many.query(start, end, points))
+
+
+def test_query_reads_the_finest_level_that_holds_the_range():
+    t, values = results()
+    pyramid = rollup.Pyramid(levels=(1, 10, 60), capacity=CAPACITY)
+    pyramid.add_many(t, values)
+    end = t[-1] + 1
+    # 30 s at 30 points: 1 s buckets
+    check(pyramid.query(end - 30, end, 30), brute(t, values, 1, end - 30, end, 30))
+    # 30 s at 3 points: a 10 s bucket per point
+    check(pyramid.query(end - 30, end, 3), brute(t, values, 10, end - 30, end, 3))
+    # Older than the 1 s and 10 s rings hold: 60 s buckets, though more
+    # points were asked for
+    start = end - 1200
+    check(
+        pyramid.query(start, end, 1200),
+        brute(t, values, 60, start, end, 1200),
+    )
+
+
+def test_history_survives_save_and_load(tmp_path):
+    path = str(tmp_path / "history.npz")
+    history = rollup.History(path)
+    t, values = results(600, seed=2)
+    for ti, row in zip(t, values):
+        for device in ("a", "b"):
+            result = {
+                m: None if np.isnan(v) else v for m, v in zip(rollup.METRICS, row)
+            }
+            history.add(device, ti, result)
+    history.save()
+
+    loaded = rollup.History(path)
+    assert sorted(loaded.devices) == ["a", "b"]
+    end = t[-1] + 1
+    for start, points in [(t[0], 40), (end - 60, 60)]:
+        answer = loaded.query("a", start, end, points)
+        assert answer == history.query("a", start, end, points)
+        assert answer["series"] == loaded.query("b", start, end, points)["series"]
+    # Steps without a breathing rate come out as null
+    rates = loaded.query("a", t[0], end, 40)["series"]["breathing_rate"]["mean"]
+    assert None in rates and any(r is not None for r in rates)
+    assert loaded.query("c", t[0], end, 10) is None
@@ -0,0 +1,90 @@
+import numpy as np
+import pytest
+import breathing
+
+"""
+StreamingBreathing against get_br() on the same windows: every estimate it
+emits is within TOLERANCE of get_br() on the 15 s window it closes, which
+is what server.py ran on every message before
+"""
+
+TOLERANCE = 1.5
+
+
+def breathing_rows(seconds, bpm, snr_db=10, seed=0, fs=100):
+    """
+    Band view rows whose breathing signal, |diff| of the band mean, rises and
+    falls at `bpm`: every subcarrier alternates sign from frame to frame
+    with an amplitude that breathes, over a random static channel
+    """
+    rng = np.random.default_rng(seed)
+    n = int(seconds * fs)
+    t = np.arange(n) / fs
+    swing = 6 * (1 + 0.5 * np.sin(2 * np.pi * bpm / 60 * t)) * (-1) ** np.arange(n)
+    noise = rng.normal(0, 6 / 10 ** (snr_db / 20), (n, 106))
+    rows = rng.uniform(-40, 40, 106) + swing[:, None] + noise
+    return np.clip(np.round(rows), -128, 127).astype(np.int8)
+
+
+def estimate_pairs(rows, batch=10):
+    """
+    (StreamingBreathing, get_br()) for every estimate the streaming
+    estimator emits when fed `batch` rows per message
+    """
+    estimator = breathing.StreamingBreathing()
+    window = estimator.window
+    pairs = []
+    for end in range(batch, len(rows) + 1, batch):
+        estimate = estimator.update(rows[end - batch : end])
+        if estimate is not None:
+            pairs.append((estimate, breathing.get_br(rows[end - window : end])))
+    return np.array(pairs).reshape(-1, 2)
+
+
+@pytest.mark.parametrize("bpm", [10, 16, 22])
+def test_streaming_agrees_with_get_br(bpm):
+    pairs = estimate_pairs(breathing_rows(25, bpm, seed=bpm))
+    # One estimate per second once the 15 s window of differences is full
+    assert len(pairs) == 10
+    assert np.abs(pairs[:, 0] - pairs[:, 1]).max() <= TOLERANCE
+
+
+def test_streaming_rate_is_caught(monkeypatch):
+    estimate = breathing.StreamingBreathing._estimate
+    monkeypatch.setattr(
+        breathing.StreamingBreathing, "_estimate", lambda self: estimate(self) + 3
+    )
+    pairs = estimate_pairs(breathing_rows(16, 15, seed=15))
+    assert np.abs(pairs[:, 0] - pairs[:, 1]).max() > TOLERANCE
+
+
+def stream_signal(x, fs):
+    """(BPM or None, quality) of every window, fed a second at a time"""
+    estimator = breathing.StreamingBreathing(fs=fs, hop=fs, adaptive=False)
+    out = []
+    for i in range(0, len(x), fs):
+        estimate = estimator.update_signal(x[i : i + fs])
+        if estimator.n >= estimator.window:
+            out.append((estimate, estimator.quality))
+    return out
+
+
+def test_noise_reports_no_rate():
+    # As estimate_vitals(): at most one window in 20 may pass the floor
+    reported = []
+    for seed in range(10):
+        x = np.random.default_rng(seed).normal(size=600)
+        for walk in (False, True):
+            windows = stream_signal(np.cumsum(x) if walk else x, 10)
+            assert all(0 <= q <= 1 for _, q in windows)
+            reported += [bpm is not None for bpm, _ in windows]
+    assert np.mean(reported) <= 0.05
+
+
+def test_quality_is_a_confidence():
+    t = np.arange(600) / 10
+    noise = 0.5 * np.random.default_rng(1).normal(size=600)
+    windows = stream_signal(np.sin(2 * np.pi * 0.25 * t) + noise, 10)
+    assert all(abs(bpm - 15) < 0.5 for bpm, _ in windows)
+    # On the 0 to 1 scale of the raw path, which LinkFusion compares it with
+    assert all(0.8 <= q <= 1 for _, q in windows)
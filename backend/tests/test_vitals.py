@@ -0,0 +1,76 @@
+import numpy as np
+import breathing
+import csi_frame
+import csi_trace
+
+"""
+breathing.estimate_vitals() and VitalSigns on synthetic traces
+"""
+
+
+def band_rows(seconds, **synth):
+    return np.array(
+        [
+            csi_frame.band(
+                iq[None, :],
+                csi_frame.lookup_layout(len(iq) // 2, fields["second"]),
+                0,
+            )[0]
+            for fields, iq in csi_trace.synth(seconds, **synth)
+        ]
+    )
+
+
+def stream(rows):
+    estimator = breathing.VitalSigns()
+    return [
+        vitals
+        for i in range(0, len(rows), 10)
+        for vitals in [estimator.update(rows[i : i + 10])]
+        if vitals is not None
+    ]
+
+
+def test_no_heartbeat_reports_no_heart_rate():
+    for seed in range(3):
+        windows = stream(band_rows(45, bpm=14, snr_db=30, seed=seed))
+        assert len(windows) == 31
+        heart = [v["heart"] for v in windows]
+        # At most one window in 20 may pass the floor by chance, and never
+        # on the band edge
+        assert sum(h["bpm"] is not None for h in heart) <= len(heart) // 20
+        for h in heart:
+            assert h["bpm"] is None or 49 < h["bpm"] < 119
+            assert h["bpm"] is not None or h["confidence"] < 0.4
+        breath = [v["breathing"]["bpm"] for v in windows]
+        assert all(b is not None and abs(b - 14) < 1 for b in breath)
+
+
+def test_heartbeat_is_found():
+    windows = stream(band_rows(30, bpm=14, snr_db=30, seed=1, hr=72))
+    heart = [v["heart"]["bpm"] for v in windows]
+    assert all(h is not None and abs(h - 72) < 1.5 for h in heart)
+
+
+def test_edge_slope_is_not_a_peak():
+    # A strong line under the heart band leaks a slope and its sidelobes
+    # into the lower edge; the band has no peak of its own
+    t = np.arange(1500) / 100
+    for f in (0.6, 0.7, 0.75):
+        vitals = breathing.estimate_vitals(np.sin(2 * np.pi * f * t), floors={})
+        assert vitals["heart"]["bpm"] is None, f
+        assert vitals["heart"]["confidence"] == 0.0
+
+
+def test_noise_stays_under_the_floors():
+    rng = np.random.default_rng(0)
+    windows = [breathing.estimate_vitals(rng.standard_normal(1500)) for _ in range(200)]
+    for band in breathing.VITAL_BANDS:
+        reported = sum(v[band]["bpm"] is not None for v in windows)
+        assert reported <= 20, band
+
+
+def test_silence_has_no_rates():
+    vitals = breathing.estimate_vitals(np.full(1500, 30.0))
+    for v in vitals.values():
+        assert v["bpm"] is None and v["confidence"] == 0.0
@@ -0,0 +1,67 @@
+/* ESP-NOW probe payload shared by csi_send and csi_recv
+
+   csi_send broadcasts one probe per CSI sample. The receiver uses the
+   sequence number to count lost frames and the sender timestamp to measure
+   inter-arrival jitter independently of its own clock. All multi-byte
+   fields are little-endian.
+
+   offset  size  field
+        0     2  magic (CSI_PROBE_MAGIC)
+        2     1  version (CSI_PROBE_VERSION)
+        3     1  send frequency, Hz
+        4     4  sequence number, +1 per probe
+        8     8  sender timestamp (us since boot)
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CSI_PROBE_MAGIC 0x5043
+#define CSI_PROBE_VERSION 1
+#define CSI_PROBE_SIZE 16
+// ESP-NOW data starts this far into wifi_csi_info_t.payload: category, OUI,
+// random value, then the vendor element's id, length, OUI, type and version
+#define CSI_PROBE_ESPNOW_OFFSET 15
+
+typedef struct {
+  uint8_t frequency;
+  uint32_t seq;
+  int64_t timestamp_us;
+} csi_probe_t;
+
+static inline void csi_probe_pack(const csi_probe_t *probe, uint8_t *out) {
+  out[0] = (uint8_t)CSI_PROBE_MAGIC;
+  out[1] = (uint8_t)(CSI_PROBE_MAGIC >> 8);
+  out[2] = CSI_PROBE_VERSION;
+  out[3] = probe->frequency;
+  for (int i = 0; i < 4; i++) {
+    out[4 + i] = (uint8_t)(probe->seq >> (8 * i));
+  }
+  for (int i = 0; i < 8; i++) {
+    out[8 + i] = (uint8_t)((uint64_t)probe->timestamp_us >> (8 * i));
+  }
+}
+
+/**
+ * @brief Parse a probe, false if `buf` is not a probe of this version
+ */
+static inline bool csi_probe_parse(const uint8_t *buf, size_t len,
+                                   csi_probe_t *probe) {
+  if (len < CSI_PROBE_SIZE ||
+      (buf[0] | buf[1] << 8) != CSI_PROBE_MAGIC || buf[2] != CSI_PROBE_VERSION)
+    return false;
+
+  probe->frequency = buf[3];
+  probe->seq = 0;
+  for (int i = 0; i < 4; i++) {
+    probe->seq |= (uint32_t)buf[4 + i] << (8 * i);
+  }
+  uint64_t ts = 0;
+  for (int i = 0; i < 8; i++) {
+    ts |= (uint64_t)buf[8 + i] << (8 * i);
+  }
+  probe->timestamp_us = (int64_t)ts;
+  return true;
+}
@@ -0,0 +1,74 @@
+/* Run the on-device breathing engine over a CSI trace
+
+   Usage: breathing_replay [--hop N] trace.csit
+
+   Pushes the band view of every frame of a known layout through
+   breathing.h with the fixed subcarrier band, and once the window is full
+   prints an estimate every N frames (default 100, one second at 100 Hz):
+
+   stdout: one CSV line per estimate, frames,bpm
+           frames counts the frames pushed, so the window is frames
+           [frames - BR_WINDOW, frames) of the known layouts
+
+   `csi_trace.py br-check` runs get_br() over the same windows and compares.
+*/
+#include "breathing.h"
+#include "csi_layout.h"
+#include "csi_trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+  int hop = 100;
+  const char *path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--hop") && i + 1 < argc) {
+      hop = atoi(argv[++i]);
+    } else if (argv[i][0] == '-' || path) {
+      fprintf(stderr, "usage: breathing_replay [--hop N] trace.csit\n");
+      return 2;
+    } else {
+      path = argv[i];
+    }
+  }
+  if (!path || hop < 1) {
+    fprintf(stderr, "usage: breathing_replay [--hop N] trace.csit\n");
+    return 2;
+  }
+
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    perror(path);
+    return 1;
+  }
+  if (!csi_trace_read_header(fp)) {
+    fprintf(stderr, "%s: not a CSI trace\n", path);
+    fclose(fp);
+    return 1;
+  }
+
+  breathing_init();
+  static csi_trace_record_t rec;
+  unsigned long frames = 0;
+  int r;
+  while ((r = csi_trace_read(fp, &rec)) == 1) {
+    const csi_layout_t *layout =
+        csi_layout_lookup(rec.meta.len, rec.meta.second);
+    if (!layout->band)
+      continue;
+    int8_t band[CSI_LAYOUT_BAND_LEN];
+    layout->band(rec.data, rec.meta.first_word_invalid, band);
+    breathing_push(band, sizeof(band));
+    frames++;
+    if (breathing_ready() && frames % (unsigned long)hop == 0)
+      printf("%lu,%.4f\n", frames, breathing_estimate());
+  }
+  fclose(fp);
+  if (r < 0) {
+    fprintf(stderr, "%s: truncated record\n", path);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,278 @@
+/* Check the MQTT backlog on the host against a FIFO model
+
+   Usage: csi_backlog_test [--ops N] [--seed S]
+
+   First runs the backlog (main/csi_backlog.h) through its fixed cases:
+   empty, too long, the wrap with and without room for a skip marker, and
+   a message that takes the whole buffer. Then it pushes and pops N random
+   messages into buffers of a few sizes, the odd ones included, and keeps a
+   FIFO of what they should hold: a push may only drop the oldest messages,
+   and the dropped count must say how many. After every operation the
+   buffer is walked from the tail the way csi_backlog_front() and
+   csi_backlog_pop() read it, over skip markers and short ends, and every
+   message must match the model, the walk must end at the head and the
+   bytes it covers must equal `used`. Exits with 1 on any mismatch.
+*/
+#include "csi_backlog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LEN_SIZE 2
+#define SKIP 0xFFFF
+#define MAX_CAP 1024
+
+static int failures;
+static unsigned skips, short_ends, full_buffers;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+// Message `seq`: a pattern of its number, `len` bytes long
+static void message_fill(uint32_t seq, size_t len, uint8_t *data) {
+  for (size_t i = 0; i < len; i++)
+    data[i] = (uint8_t)(seq * 31 + i * 7 + (seq >> 8));
+}
+
+static bool message_check(uint32_t seq, size_t len, const uint8_t *data) {
+  uint8_t expect[MAX_CAP + 2];
+  message_fill(seq, len, expect);
+  return memcmp(data, expect, len) == 0;
+}
+
+// What the backlog should hold, oldest first
+typedef struct {
+  uint32_t seq[MAX_CAP];
+  size_t len[MAX_CAP];
+  size_t count;
+} model_t;
+
+static void model_drop_oldest(model_t *m, size_t n) {
+  memmove(m->seq, m->seq + n, (m->count - n) * sizeof(m->seq[0]));
+  memmove(m->len, m->len + n, (m->count - n) * sizeof(m->len[0]));
+  m->count -= n;
+}
+
+// Walks the buffer from the tail over every held message, checking each
+// against the model, and checks where the walk ends and what it covers
+static void check_layout(const csi_backlog_t *b, const model_t *m) {
+  CHECK(b->count == m->count);
+  if (b->count != m->count)
+    return;
+  if (b->count == 0) {
+    CHECK(b->head == 0 && b->tail == 0 && b->used == 0);
+    return;
+  }
+  size_t pos = b->tail, covered = 0;
+  for (size_t i = 0; i < m->count; i++) {
+    size_t rest = b->cap - pos;
+    if (rest < LEN_SIZE || (b->buf[pos] | b->buf[pos + 1] << 8) == SKIP) {
+      // Only past the head, where the messages start over at 0
+      CHECK(pos > b->head);
+      covered += rest;
+      pos = 0;
+    }
+    size_t len = b->buf[pos] | (size_t)b->buf[pos + 1] << 8;
+    CHECK(len == m->len[i]);
+    if (len != m->len[i] || pos + LEN_SIZE + len > b->cap)
+      return;
+    CHECK(message_check(m->seq[i], len, b->buf + pos + LEN_SIZE));
+    pos += LEN_SIZE + len;
+    covered += LEN_SIZE + len;
+  }
+  CHECK(pos == b->head);
+  CHECK(covered == b->used);
+  CHECK(b->used <= b->cap);
+}
+
+static bool push(csi_backlog_t *b, model_t *m, uint32_t seq, size_t len) {
+  uint8_t data[MAX_CAP + 2];
+  size_t head = b->head, count = b->count;
+  uint32_t dropped = b->dropped;
+  message_fill(seq, len, data);
+  bool ok = csi_backlog_push(b, data, len);
+  if (!ok) {
+    CHECK(LEN_SIZE + len > b->cap);
+    CHECK(b->dropped == dropped + 1 && b->count == count);
+    return false;
+  }
+  CHECK(LEN_SIZE + len <= b->cap);
+  // Only the oldest messages make room, and each one counts
+  CHECK(b->count >= 1 && b->count <= count + 1);
+  size_t gone = count + 1 - b->count;
+  CHECK(b->dropped == dropped + gone);
+  if (gone <= m->count)
+    model_drop_oldest(m, gone);
+  m->seq[m->count] = seq;
+  m->len[m->count++] = len;
+  if (b->head == LEN_SIZE + len && head != 0 && count > gone) {
+    // Wrapped over the end of the buffer
+    if (b->cap - head >= LEN_SIZE)
+      skips++;
+    else
+      short_ends++;
+  }
+  if (b->used == b->cap)
+    full_buffers++;
+  check_layout(b, m);
+  return true;
+}
+
+static void pop(csi_backlog_t *b, model_t *m) {
+  size_t len;
+  const uint8_t *front = csi_backlog_front(b, &len);
+  CHECK((front == NULL) == (m->count == 0));
+  if (front == NULL) {
+    csi_backlog_pop(b);
+    check_layout(b, m);
+    return;
+  }
+  CHECK(len == m->len[0] && message_check(m->seq[0], len, front));
+  csi_backlog_pop(b);
+  model_drop_oldest(m, 1);
+  check_layout(b, m);
+}
+
+static void test_fixed(void) {
+  static uint8_t buf[MAX_CAP];
+  static model_t m;
+  csi_backlog_t b;
+  size_t len;
+  memset(&m, 0, sizeof(m));
+
+  csi_backlog_init(&b, buf, 10);
+  CHECK(csi_backlog_front(&b, &len) == NULL);
+  csi_backlog_pop(&b);
+  check_layout(&b, &m);
+
+  // Too long for the buffer, and too long for the length prefix
+  CHECK(!push(&b, &m, 0, 9));
+  CHECK(!csi_backlog_push(&b, buf, CSI_BACKLOG_MAX_MESSAGE + 1));
+  CHECK(b.dropped == 2 && b.count == 0);
+
+  // The whole buffer in one message
+  CHECK(push(&b, &m, 1, 8));
+  CHECK(b.used == 10 && b.head == 10);
+  pop(&b, &m);
+
+  // 6 + 4 bytes end flush with the buffer; after popping the first, the
+  // next 6 wrap to 0 without a marker, as none fits
+  CHECK(push(&b, &m, 2, 4));
+  CHECK(push(&b, &m, 3, 2));
+  pop(&b, &m);
+  CHECK(push(&b, &m, 4, 4));
+  CHECK(b.head == 6 && b.tail == 6 && b.used == 10 && b.dropped == 2);
+  pop(&b, &m);
+  CHECK(b.tail == 0 && b.used == 6);
+  pop(&b, &m);
+
+  // One byte left at the end: skipped without a marker
+  CHECK(push(&b, &m, 5, 4));
+  CHECK(push(&b, &m, 6, 1));
+  pop(&b, &m);
+  CHECK(push(&b, &m, 7, 3));
+  CHECK(b.head == 5 && b.used == 3 + 1 + 5);
+  pop(&b, &m);
+  CHECK(b.tail == 0 && b.used == 5);
+  pop(&b, &m);
+
+  // Three bytes at the end: a skip marker, read over by the pop
+  csi_backlog_init(&b, buf, 12);
+  memset(&m, 0, sizeof(m));
+  CHECK(push(&b, &m, 8, 4));
+  CHECK(push(&b, &m, 9, 1));
+  pop(&b, &m);
+  CHECK(push(&b, &m, 10, 2));
+  CHECK((buf[9] | buf[10] << 8) == SKIP);
+  pop(&b, &m);
+  CHECK(b.tail == 0 && b.used == 4);
+
+  // No room after the tail either: the oldest message goes
+  CHECK(push(&b, &m, 11, 7));
+  CHECK(b.count == 1 && b.dropped == 1);
+  pop(&b, &m);
+  CHECK(b.head == 0 && b.tail == 0 && b.used == 0);
+}
+
+static uint32_t rng_state;
+
+static uint32_t rng(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+static void test_random(size_t cap, unsigned ops, uint32_t *seq) {
+  static uint8_t buf[MAX_CAP];
+  static model_t m;
+  csi_backlog_t b;
+  memset(&m, 0, sizeof(m));
+  csi_backlog_init(&b, buf, cap);
+  size_t high = 0;
+
+  for (unsigned op = 0; op < ops; op++) {
+    uint32_t r = rng();
+    // Pushes outnumber pops, so the buffer is mostly full and drops
+    if (r % 8 < 3) {
+      pop(&b, &m);
+      continue;
+    }
+    size_t len;
+    switch ((r >> 3) % 8) {
+    case 0:
+      // Anything up to a bit more than fits
+      len = rng() % (cap + 2);
+      break;
+    case 1:
+      len = 0;
+      break;
+    default:
+      len = rng() % (cap / 4 + 1);
+      break;
+    }
+    push(&b, &m, (*seq)++, len);
+    if (b.count > high)
+      high = b.count;
+    CHECK(b.high_water == high);
+  }
+  while (m.count)
+    pop(&b, &m);
+  pop(&b, &m);
+}
+
+int main(int argc, char **argv) {
+  unsigned ops = 200000;
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--ops") && i + 1 < argc) {
+      ops = (unsigned)strtoul(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else {
+      fprintf(stderr, "usage: csi_backlog_test [--ops N] [--seed S]\n");
+      return 2;
+    }
+  }
+  rng_state = seed ? seed : 1;
+
+  test_fixed();
+  static const size_t caps[] = {2, 3, 16, 61, 256, MAX_CAP};
+  size_t n_caps = sizeof(caps) / sizeof(caps[0]);
+  uint32_t seq = 0;
+  for (size_t i = 0; i < n_caps; i++)
+    test_random(caps[i], ops / n_caps + 1, &seq);
+  // The random runs must have reached every way of wrapping
+  CHECK(ops < 1000 || (skips > 0 && short_ends > 0 && full_buffers > 0));
+
+  printf("%u messages, %u skip markers, %u short ends, %u full buffers\n",
+         seq, skips, short_ends, full_buffers);
+  printf("%d check(s) failed\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,355 @@
+/* Check, measure and time the CSI frame codec on the host
+
+   Usage: csi_codec_bench [--fuzz N] [--repeat N] [trace.csit ...]
+
+   First runs N random round trips (default 1000) through csi_codec.h and
+   the coded messages of csi_frame.h: frame sequences of mixed layouts and
+   of every kind of change between frames, encoder calls that do not fit
+   their buffer, lost frames, and truncated or corrupted messages. Decoded
+   frames must match the input exactly, and frames may only be skipped
+   after a loss until the next keyframe of their layout.
+
+   Then, for every trace, encodes the frames in the order the receiver sees
+   them and prints the compression ratio, the share of keyframes and the
+   time per frame to encode and decode, averaged over --repeat passes
+   (default 10). Exits with 1 on any mismatch.
+*/
+#include "csi_codec.h"
+#include "csi_frame.h"
+#include "csi_layout.h"
+#include "csi_trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng_next(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+static int rng_range(int n) { return (int)(rng_next() % (uint32_t)n); }
+
+static int failures;
+
+static void fail(int iteration, const char *what) {
+  if (failures++ < 10)
+    fprintf(stderr, "fuzz %d: %s\n", iteration, what);
+}
+
+// Next frame of a layout: the last one plus a change whose size varies
+// from none to completely random, as a static link, movement and a new
+// channel would give
+static void next_frame(int8_t *frame, size_t len) {
+  int kind = rng_range(6);
+  for (size_t i = 0; i < len; i++) {
+    switch (kind) {
+    case 0:
+      break;
+    case 1:
+      frame[i] = (int8_t)(frame[i] + rng_range(3) - 1);
+      break;
+    case 2:
+      frame[i] = (int8_t)(frame[i] + rng_range(17) - 8);
+      break;
+    case 3:
+      frame[i] = (int8_t)rng_next();
+      break;
+    case 4:
+      frame[i] = rng_range(2) ? 127 : -128;
+      break;
+    default:
+      // Smooth across subcarriers, for the intra prediction
+      frame[i] = (int8_t)(i >= 2 ? frame[i - 2] + rng_range(5) - 2
+                                 : rng_range(256));
+      break;
+    }
+  }
+}
+
+static const size_t fuzz_len[CSI_CODEC_REFS] = {CSI_CODEC_MAX_LEN, 106, 114,
+                                                234, 234};
+
+// Encoder and decoder side by side over one random frame sequence
+static void fuzz_codec(int iteration) {
+  static csi_codec_t enc, dec, shadow;
+  static int8_t frames[CSI_CODEC_REFS][CSI_CODEC_MAX_LEN];
+  static bool keyed[CSI_CODEC_REFS];
+  csi_codec_init(&enc);
+  csi_codec_init(&dec);
+  for (int s = 0; s < CSI_CODEC_REFS; s++) {
+    for (size_t i = 0; i < CSI_CODEC_MAX_LEN; i++) {
+      frames[s][i] = (int8_t)rng_next();
+    }
+    keyed[s] = false;
+  }
+
+  int count = 1 + rng_range(300);
+  for (int n = 0; n < count; n++) {
+    uint8_t layout = (uint8_t)rng_range(CSI_CODEC_REFS + 1);
+    int s = layout < CSI_CODEC_REFS ? layout : 0;
+    size_t len = fuzz_len[s] - (size_t)(s == 0 ? 2 * rng_range(4) : 0);
+    next_frame(frames[s], len);
+
+    uint8_t coded[CSI_CODEC_BOUND(CSI_CODEC_MAX_LEN)];
+    if (rng_range(20) == 0) {
+      // One byte short of the frame: fails and leaves the codec unchanged
+      shadow = enc;
+      size_t need = csi_codec_encode(&shadow, layout, frames[s], len, coded,
+                                     sizeof(coded));
+      shadow = enc;
+      if (csi_codec_encode(&enc, layout, frames[s], len, coded, need - 1) !=
+              0 ||
+          memcmp(&shadow, &enc, sizeof(enc)) != 0)
+        fail(iteration, "frame encoded into too small a buffer");
+    }
+    size_t size =
+        csi_codec_encode(&enc, layout, frames[s], len, coded, sizeof(coded));
+    if (size == 0 || size > CSI_CODEC_BOUND(len)) {
+      fail(iteration, "frame size out of bound");
+      return;
+    }
+    bool key = (coded[0] >> 6) != CSI_CODEC_INTER;
+
+    if (rng_range(50) == 0) {
+      // Lost message: the receiver resets and waits for keyframes
+      csi_codec_init(&dec);
+      memset(keyed, 0, sizeof(keyed));
+      continue;
+    }
+
+    int8_t out[CSI_CODEC_MAX_LEN];
+    bool valid;
+    size_t used = csi_codec_decode(&dec, layout, coded, size, out, len, &valid);
+    if (used != size) {
+      fail(iteration, "decoder consumed a different length");
+      return;
+    }
+    keyed[s] |= key;
+    if (valid != keyed[s])
+      fail(iteration, valid ? "frame decoded without a reference"
+                            : "frame skipped after a keyframe");
+    else if (valid && memcmp(out, frames[s], len) != 0)
+      fail(iteration, "decoded frame differs");
+
+    // Any shorter input is truncated
+    if (size > 1) {
+      csi_codec_t copy = dec;
+      if (csi_codec_decode(&copy, layout, coded, size - 1 - rng_range(
+                               (int)size - 1), out, len, &valid) != 0)
+        fail(iteration, "truncated frame accepted");
+    }
+  }
+}
+
+// Messages of csi_frame.h with per-frame sequence numbers, then corrupted
+static void fuzz_message(int iteration) {
+  static csi_codec_t enc, dec;
+  static uint8_t buf[CSI_FRAME_HEADER_SIZE +
+                     10 * (CSI_FRAME_CODED_SEQ_SIZE + CSI_CODEC_BOUND(234))];
+  static int8_t frames[10][234], out[10 * 234];
+  csi_codec_init(&enc);
+  csi_codec_init(&dec);
+
+  size_t len = 2 * (1 + (size_t)rng_range(117));
+  csi_frame_header_t hdr = {
+      .flags = CSI_FRAME_FLAG_CODED | (rng_range(2) ? CSI_FRAME_FLAG_SEQ : 0),
+      .layout = (uint8_t)rng_range(CSI_CODEC_REFS),
+  };
+  csi_frame_writer_t w;
+  csi_frame_begin(&w, buf, sizeof(buf), &hdr);
+  uint32_t seq[10], seq_out[10];
+  seq[0] = rng_next();
+  int count = 1 + rng_range(10);
+  for (int f = 0; f < count; f++) {
+    if (f > 0) {
+      memcpy(frames[f], frames[f - 1], len);
+      seq[f] = seq[f - 1] + (rng_range(4) ? 1 : rng_next());
+    }
+    next_frame(frames[f], len);
+    if (!csi_frame_add_coded(&w, &enc, frames[f], len, seq[f])) {
+      fail(iteration, "frame did not fit the message");
+      return;
+    }
+  }
+  size_t size = csi_frame_finish(&w);
+
+  csi_frame_header_t parsed;
+  const int8_t *payload;
+  uint8_t valid[10];
+  if (!csi_frame_parse(buf, size, &parsed, &payload) ||
+      parsed.frame_count != count ||
+      !csi_frame_decode_coded(&parsed, (const uint8_t *)payload,
+                              size - CSI_FRAME_HEADER_SIZE, &dec, out,
+                              seq_out, valid)) {
+    fail(iteration, "message did not decode");
+    return;
+  }
+  for (int f = 0; f < count; f++) {
+    if (!valid[f] || memcmp(out + f * len, frames[f], len) != 0)
+      fail(iteration, "message frame differs");
+    if ((hdr.flags & CSI_FRAME_FLAG_SEQ) && seq_out[f] != seq[f])
+      fail(iteration, "sequence number differs");
+  }
+
+  // Corrupt bytes and cut the payload: decoding may fail but must stay
+  // inside the buffers (build with -fsanitize=address to check)
+  for (int i = 0; i < 4; i++) {
+    buf[CSI_FRAME_HEADER_SIZE + rng_range((int)(size - CSI_FRAME_HEADER_SIZE))]
+        ^= (uint8_t)(1 + rng_range(255));
+  }
+  csi_codec_init(&dec);
+  csi_frame_decode_coded(&parsed, (const uint8_t *)payload,
+                         (size_t)rng_range((int)(size - CSI_FRAME_HEADER_SIZE)),
+                         &dec, out, seq_out, valid);
+}
+
+typedef struct {
+  int8_t iq[CSI_TRACE_MAX_LEN];
+  uint16_t len;
+  uint8_t layout;
+} frame_t;
+
+static int bench_trace(const char *path, int repeat) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    perror(path);
+    return -1;
+  }
+  if (!csi_trace_read_header(fp)) {
+    fprintf(stderr, "%s: not a CSI trace\n", path);
+    fclose(fp);
+    return -1;
+  }
+  size_t count = 0, cap = 0;
+  frame_t *frames = NULL;
+  static csi_trace_record_t rec;
+  int r;
+  while ((r = csi_trace_read(fp, &rec)) == 1) {
+    if (rec.meta.len > CSI_CODEC_MAX_LEN)
+      continue;
+    if (count == cap) {
+      cap = cap ? 2 * cap : 4096;
+      frame_t *grown = realloc(frames, cap * sizeof(*frames));
+      if (!grown) {
+        free(frames);
+        fclose(fp);
+        return -1;
+      }
+      frames = grown;
+    }
+    memcpy(frames[count].iq, rec.data, rec.meta.len);
+    frames[count].len = rec.meta.len;
+    frames[count].layout =
+        csi_layout_lookup(rec.meta.len, rec.meta.second)->id;
+    count++;
+  }
+  fclose(fp);
+  if (r < 0 || count == 0) {
+    fprintf(stderr, "%s: %s\n", path, r < 0 ? "truncated record" : "empty");
+    free(frames);
+    return -1;
+  }
+
+  size_t stream_cap = 0;
+  for (size_t i = 0; i < count; i++) {
+    stream_cap += CSI_CODEC_BOUND(frames[i].len);
+  }
+  uint8_t *stream = malloc(stream_cap);
+  if (!stream) {
+    free(frames);
+    return -1;
+  }
+  static csi_codec_t codec;
+  size_t raw = 0, coded = 0, keys = 0;
+  uint64_t start = now_ns();
+  for (int p = 0; p < repeat; p++) {
+    csi_codec_init(&codec);
+    coded = 0;
+    for (size_t i = 0; i < count; i++) {
+      size_t n = csi_codec_encode(&codec, frames[i].layout, frames[i].iq,
+                                  frames[i].len, stream + coded,
+                                  stream_cap - coded);
+      if (p == 0) {
+        raw += frames[i].len;
+        keys += (stream[coded] >> 6) != CSI_CODEC_INTER;
+      }
+      coded += n;
+    }
+  }
+  double encode_ns = (double)(now_ns() - start) / repeat / count;
+
+  int mismatches = 0;
+  start = now_ns();
+  for (int p = 0; p < repeat; p++) {
+    csi_codec_init(&codec);
+    size_t pos = 0;
+    for (size_t i = 0; i < count; i++) {
+      int8_t out[CSI_CODEC_MAX_LEN];
+      bool valid;
+      size_t n = csi_codec_decode(&codec, frames[i].layout, stream + pos,
+                                  coded - pos, out, frames[i].len, &valid);
+      if (p == 0 &&
+          (n == 0 || !valid || memcmp(out, frames[i].iq, frames[i].len)))
+        mismatches++;
+      if (n == 0)
+        break;
+      pos += n;
+    }
+  }
+  double decode_ns = (double)(now_ns() - start) / repeat / count;
+
+  printf("%s: %zu frames, %zu -> %zu bytes, ratio %.2f, %.1f%% keyframes, "
+         "encode %.0f ns/frame, decode %.0f ns/frame, %s\n",
+         path, count, raw, coded, (double)raw / coded, 100.0 * keys / count,
+         encode_ns, decode_ns, mismatches ? "MISMATCH" : "lossless");
+  free(stream);
+  free(frames);
+  return mismatches;
+}
+
+int main(int argc, char **argv) {
+  int fuzz = 1000, repeat = 10;
+  int first_trace = argc;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--fuzz") && i + 1 < argc) {
+      fuzz = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr,
+              "usage: csi_codec_bench [--fuzz N] [--repeat N] "
+              "[trace.csit ...]\n");
+      return 2;
+    } else {
+      first_trace = i;
+      break;
+    }
+  }
+  if (repeat < 1)
+    repeat = 1;
+
+  for (int i = 0; i < fuzz; i++) {
+    fuzz_codec(i);
+    fuzz_message(i);
+  }
+  printf("fuzz: %d round trips, %d failure(s)\n", fuzz, failures);
+
+  for (int i = first_trace; i < argc; i++) {
+    int r = bench_trace(argv[i], repeat);
+    if (r != 0)
+      failures++;
+  }
+  return failures ? 1 : 0;
+}
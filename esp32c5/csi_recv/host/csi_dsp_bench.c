@@ -0,0 +1,35 @@
+/* Check and time the fixed-point DSP kernels on the host
+
+   Usage: csi_dsp_bench [--repeat N]
+
+   Runs csi_dsp_bench_run() (csi_dsp_bench.h): every kernel in csi_dsp.h
+   against its float reference, with ns per call for both. Exits with 1 if
+   any kernel is outside its error bound.
+*/
+#include "csi_dsp_bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+  int repeat = 1000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: csi_dsp_bench [--repeat N]\n");
+      return 2;
+    }
+  }
+  if (repeat < 1)
+    repeat = 1;
+
+  int failures = csi_dsp_bench_run(repeat);
+  if (failures < 0) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  printf("%d kernel(s) outside their error bound\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,197 @@
+/* Write CSI messages with the firmware's encoder, and time it
+
+   Usage: csi_frame_dump [--messages N] [--repeat N] [out.jsonl]
+
+   Encodes N random messages (default 1000) with csi_frame.h and writes one
+   JSON object per line: the message as hex, and the fields and frames it
+   was built from. Headers vary in every field and flag, layouts include
+   unknown ones, and frames carry probe sequence numbers or not. The backend
+   tests (backend/tests/test_csi_frame.py) decode the messages with
+   csi_frame.py and compare every field, so the two sides cannot drift
+   apart. Without an output file only the timing runs.
+
+   Then times a receiver's batch, 10 HT20 frames, encoded --repeat times
+   (default 100000), and prints the message size and bytes per second at
+   100 frames/s, with and without sequence numbers, next to the legacy text
+   format of the same frames.
+*/
+#include "csi_frame.h"
+#include "csi_layout.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_FRAMES 12
+#define MAX_LEN 234
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng_next(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+static int rng_range(int n) { return (int)(rng_next() % (uint32_t)n); }
+
+static void put_hex(FILE *fp, const void *data, size_t len) {
+  const uint8_t *p = data;
+  for (size_t i = 0; i < len; i++)
+    fprintf(fp, "%02x", p[i]);
+}
+
+// One random message and the line describing it
+static int dump_message(FILE *fp) {
+  static uint8_t buf[CSI_FRAME_HEADER_SIZE + MAX_FRAMES * (4 + MAX_LEN)];
+  static int8_t iq[MAX_FRAMES * MAX_LEN];
+  uint32_t probe_seq[MAX_FRAMES];
+
+  uint8_t layout = (uint8_t)rng_range(CSI_LAYOUT_COUNT);
+  size_t len = layout != CSI_LAYOUT_UNKNOWN
+                   ? csi_layout_get(layout)->len
+                   : 2 * (1 + (size_t)rng_range(MAX_LEN / 2));
+  csi_frame_header_t hdr = {
+      .flags = (uint8_t)(rng_next() & (CSI_FRAME_FLAG_MOTION |
+                                       CSI_FRAME_FLAG_SEQ |
+                                       CSI_FRAME_FLAG_FIRST_WORD_INVALID)),
+      .rssi = (int8_t)rng_next(),
+      .seq = rng_next(),
+      .timestamp_us = (int64_t)(((uint64_t)rng_next() << 31) ^ rng_next()),
+      .motion_confidence = (uint8_t)rng_next(),
+      .layout = layout,
+      .link = (uint8_t)rng_range(4),
+  };
+  int count = 1 + rng_range(MAX_FRAMES);
+
+  csi_frame_writer_t w;
+  csi_frame_begin(&w, buf, sizeof(buf), &hdr);
+  for (int f = 0; f < count; f++) {
+    for (size_t i = 0; i < len; i++)
+      iq[f * len + i] = (int8_t)rng_next();
+    probe_seq[f] = rng_range(4) ? (f ? probe_seq[f - 1] + 1 : rng_next())
+                                : rng_next();
+    if (!csi_frame_add(&w, iq + f * len, len, probe_seq[f])) {
+      fprintf(stderr, "frame %d did not fit the message\n", f);
+      return -1;
+    }
+  }
+  size_t size = csi_frame_finish(&w);
+
+  fprintf(fp, "{\"payload\": \"");
+  put_hex(fp, buf, size);
+  fprintf(fp,
+          "\", \"motion_detect\": %d, \"seq_flag\": %d, "
+          "\"first_word_invalid\": %d, \"rssi\": %d, \"seq\": %u, "
+          "\"timestamp_us\": %lld, \"motion_confidence\": %u, "
+          "\"layout\": %u, \"link\": %u, \"frame_count\": %d, "
+          "\"subcarriers\": %zu, \"probe_seq\": [",
+          !!(hdr.flags & CSI_FRAME_FLAG_MOTION),
+          !!(hdr.flags & CSI_FRAME_FLAG_SEQ),
+          !!(hdr.flags & CSI_FRAME_FLAG_FIRST_WORD_INVALID), hdr.rssi,
+          hdr.seq, (long long)hdr.timestamp_us, hdr.motion_confidence,
+          hdr.layout, hdr.link, count, len / 2);
+  for (int f = 0; f < count; f++)
+    fprintf(fp, f ? ", %u" : "%u", probe_seq[f]);
+  fprintf(fp, "], \"iq\": \"");
+  put_hex(fp, iq, count * len);
+  fprintf(fp, "\"}\n");
+  return 0;
+}
+
+// Legacy text payload of app_main.c: "i0,q0,...,motion,rssi"
+static size_t text_size(const int8_t *iq, size_t samples) {
+  static char text[MAX_FRAMES * MAX_LEN * 5 + 16];
+  size_t n = 0;
+  for (size_t i = 0; i < samples; i++)
+    n += (size_t)snprintf(text + n, sizeof(text) - n, "%d,", iq[i]);
+  n += (size_t)snprintf(text + n, sizeof(text) - n, "%d,%d", 1, -60);
+  return n;
+}
+
+static void bench(int repeat) {
+  enum { FRAMES = 10, RATE = 100 };
+  static uint8_t buf[CSI_FRAME_HEADER_SIZE + FRAMES * (4 + MAX_LEN)];
+  static int8_t iq[FRAMES * MAX_LEN];
+  const size_t len = csi_layout_get(CSI_LAYOUT_HT20)->len;
+  // Quiet-room CSI: small values, as text is shorter for them
+  for (size_t i = 0; i < FRAMES * len; i++)
+    iq[i] = (int8_t)(rng_range(41) - 20);
+
+  for (int with_seq = 0; with_seq < 2; with_seq++) {
+    csi_frame_header_t hdr = {
+        .flags = with_seq ? CSI_FRAME_FLAG_SEQ : 0,
+        .layout = CSI_LAYOUT_HT20,
+    };
+    size_t size = 0;
+    uint64_t start = now_ns();
+    for (int r = 0; r < repeat; r++) {
+      csi_frame_writer_t w;
+      hdr.seq = (uint32_t)r;
+      csi_frame_begin(&w, buf, sizeof(buf), &hdr);
+      for (int f = 0; f < FRAMES; f++)
+        csi_frame_add(&w, iq + f * len, len, (uint32_t)(r * FRAMES + f));
+      size = csi_frame_finish(&w);
+    }
+    double ns = (double)(now_ns() - start) / repeat;
+    // Keep the encoder's stores alive
+    volatile uint8_t sink = buf[size - 1];
+    (void)sink;
+    printf("binary%s: %d x %zu B frames, %zu B/message, %zu B/s at %d "
+           "frames/s, encode %.0f ns/message (%.1f ns/frame)\n",
+           with_seq ? " + seq" : "", FRAMES, len, size, size * RATE / FRAMES,
+           RATE, ns, ns / FRAMES);
+  }
+  size_t text = text_size(iq, FRAMES * len);
+  printf("text: %zu B/message, %zu B/s at %d frames/s\n", text,
+         text * RATE / FRAMES, RATE);
+}
+
+int main(int argc, char **argv) {
+  int messages = 1000, repeat = 100000;
+  const char *out = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--messages") && i + 1 < argc) {
+      messages = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+    } else if (argv[i][0] == '-' || out) {
+      fprintf(stderr, "usage: csi_frame_dump [--messages N] [--repeat N] "
+                      "[out.jsonl]\n");
+      return 2;
+    } else {
+      out = argv[i];
+    }
+  }
+  if (repeat < 1)
+    repeat = 1;
+
+  if (out) {
+    FILE *fp = fopen(out, "w");
+    if (!fp) {
+      perror(out);
+      return 1;
+    }
+    for (int m = 0; m < messages; m++) {
+      if (dump_message(fp) != 0) {
+        fclose(fp);
+        return 1;
+      }
+    }
+    if (fclose(fp) != 0) {
+      perror(out);
+      return 1;
+    }
+    printf("%s: %d messages\n", out, messages);
+  }
+  bench(repeat);
+  return 0;
+}
@@ -0,0 +1,32 @@
+/* Time the per-frame link lookup and dispatch on the host
+
+   Usage: csi_link_bench [--repeat N]
+
+   Runs csi_link_bench_run() (csi_link_bench.h): the CSI callback's link
+   lookup and ring dispatch with 1, 4 and 16 transmitters, in ns per frame.
+*/
+#include "csi_link_bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+  int repeat = 100000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: csi_link_bench [--repeat N]\n");
+      return 2;
+    }
+  }
+  if (repeat < 1)
+    repeat = 1;
+
+  if (csi_link_bench_run(repeat) != 0) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  return 0;
+}
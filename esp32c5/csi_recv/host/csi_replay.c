@@ -0,0 +1,644 @@
+/* Replay a CSI trace through the csi_recv analysis pipeline on Linux
+
+   Runs the same stages, in the same order, as wifi_csi_rx_cb() and
+   csi_analysis_task() in main/app_main.c: ring capture, motion detection,
+   breathing window update, breathing estimate every BR_PUBLISH_PERIOD_US
+   and a csi_publish.h tick every PUBLISH_PERIOD_US of trace time, the
+   same code that publishes on the board. Frames are looked up in the
+   layout table and analysed through their band view, so traces that mix
+   HT20, HT40 and L-LTF frames replay as on the board, and frames of an
+   unknown layout are counted and only published. Wi-Fi and MQTT are left
+   out; the encoded messages are discarded unless --broker or --udp is
+   given.
+
+   Usage: csi_replay [--realtime] [--repeat N] [--quiet] [--fixed-band]
+                     [--bpm TRUE_BPM] [--decimate FACTOR] [--coded | --text]
+                     [--messages FILE] [--offline SECONDS [--late-capture]]
+                     [--broker HOST:PORT [--heap BYTES] [--device NAME]]
+                     [--udp HOST:PORT [--redundancy N] [--loss P]]
+                     [--link ID] [--links N] [--probe] trace.csit
+
+   The breathing estimate averages the subcarriers picked by sc_rank.h, as
+   with CSI_ADAPTIVE_BAND, or the fixed band with --fixed-band. --bpm adds
+   the mean absolute error of the estimates against a known rate, for
+   synthetic traces.
+
+   --decimate publishes csi_stream.h messages, as CSI_PUBLISH_DECIMATED
+   with CSI_DECIM_FACTOR = FACTOR, instead of raw frames. --coded
+   compresses the raw frames as CSI_MQTT_CODED does, and --text sends
+   them as the legacy comma-separated text of CSI_MQTT_BINARY 0, which
+   only carries HT20 frames. The bytes published per second and the frames
+   no message could carry are reported either way, and --messages writes
+   every message to FILE, each prefixed by its u32 little-endian length,
+   for feeding to the backend.
+
+   --offline keeps the broker unreachable for the first SECONDS of the
+   trace, as at boot: messages wait in a csi_backlog.h backlog of the
+   firmware's size and are flushed as app_main.c does once it is up. The
+   time the first frame is published and how old it is, the first
+   breathing estimate and the messages the backlog dropped are reported.
+   --late-capture instead ignores every frame until the broker is up, the
+   way the firmware started before capture was decoupled from MQTT.
+
+   --broker publishes every message to csi/data/<device> on a real MQTT
+   broker, in real time, through mqtt_host.h's outbox. The publish_sched.h
+   scheduler then plans every tick from the outbox size and from BYTES of
+   free heap (default 160 KB) minus the outbox, as app_main.c does, falling
+   back to a decimated stream at factor 10 when raw frames do not get
+   through. Run it against backend/mqtt_standin.py with --latency and
+   --rate to see the levels change; the ticks spent at each level, the
+   outbox peak and the messages the backlog dropped are reported.
+
+   --udp sends every message instead as a csi_udp.h datagram to the
+   backend's UDP receiver, in real time, as CSI_TRANSPORT_UDP does,
+   repeating the N previous messages in each (default 1). --loss drops
+   each datagram with probability P before it is sent, from a fixed seed,
+   to see what the repeats recover.
+
+   --link tags every message with link ID (csi_link.h), as a receiver
+   does for the transmitter whose MAC ends in ID. --device publishes on
+   csi/data/NAME instead of a topic of the process's own, so replays with
+   different --link act as the links of one receiver. --links deals the
+   trace's frames round-robin to N links of one receiver instead, with ids
+   ID to ID + N - 1, each with its own ring, motion state, message
+   sequence and coder; breathing, the ranking and the stream follow the
+   first, as in app_main.c. --probe gives every link's frames consecutive
+   probe sequence numbers from 0, as csi_probe.h probes carry them, so
+   the raw messages carry them too (CSI_FRAME_FLAG_SEQ).
+
+   With --broker or --udp the message timestamps are wall-clock time, us
+   since the epoch, of the last frame captured before the message, so the
+   backend can measure latency from capture (backend/latency_bench.py).
+
+   stdout: one CSV line per breathing tick, the motion of the first link,
+           time_s,motion,motion_confidence,motion_score,breathing_rate
+   stderr: frame count, throughput, bytes published and ns/frame for every
+           stage
+
+   The CSV output is deterministic for a given trace, so diffing it before
+   and after an algorithm change is a regression test.
+*/
+#include "breathing.h"
+#include "csi_layout.h"
+#include "csi_publish.h"
+#include "csi_trace.h"
+#include "csi_udp.h"
+#include "mqtt_host.h"
+#include "sc_rank.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <netdb.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Match MQTT_FREQ, CSI_DECIM_FACTOR, CSI_DECIM_SEND_SAMPLES,
+// BR_PUBLISH_TICKS, CSI_BACKLOG_SIZE, CSI_BACKLOG_FLUSH, CSI_LINKS and
+// MQTT_OUT_SIZE less MQTT_PUBLISH_OVERHEAD in app_main.c
+#define PUBLISH_PERIOD_US (100 * 1000)
+#define DECIM_FACTOR 10
+#define SEND_SAMPLES 10
+#define BR_PUBLISH_PERIOD_US (10 * PUBLISH_PERIOD_US)
+#define BACKLOG_SIZE (64 * 1024)
+#define BACKLOG_FLUSH 10
+#define MAX_LINKS 4
+#define MAX_MESSAGE (8192 - (5 + 2 + 32 + 2))
+
+enum {
+  STAGE_CAPTURE,
+  STAGE_MOTION,
+  STAGE_RANK,
+  STAGE_BREATHING,
+  STAGE_DECIMATE,
+  STAGE_ESTIMATE,
+  STAGE_PUBLISH,
+  STAGE_COUNT
+};
+
+static const char *stage_names[STAGE_COUNT] = {
+    "capture",  "motion",
+    "subcarrier_rank", "breathing_push",
+    "decimate", "breathing_estimate",
+    "publish"};
+
+static csi_publish_link_t links[MAX_LINKS];
+static int link_count = 1;
+static bool probe;
+static uint32_t probe_seq[MAX_LINKS];
+static csi_publish_t publisher;
+static sc_rank_t sc_rank;
+static bool coded;
+static bool text;
+static csi_stream_t stream;
+static int decimate;
+// The decimated stream is kept up, for the scheduler to fall back on
+static bool stream_fallback;
+static FILE *messages;
+static uint64_t published_bytes;
+static unsigned published;
+static double trace_seconds;
+static uint64_t stage_ns[STAGE_COUNT];
+static uint64_t stage_calls[STAGE_COUNT];
+static unsigned unknown_layout;
+static bool fixed_band;
+static float true_bpm;
+static double bpm_error;
+static unsigned bpm_estimates;
+static int64_t offline_us;
+static bool late_capture;
+static bool broker_up;
+static uint8_t backlog_buf[BACKLOG_SIZE];
+static mqtt_host_t *broker;
+static char data_topic[64] = "csi/data/replay";
+static uint32_t heap_bytes = 160 * 1024;
+static unsigned broker_lost;
+static int udp_fd = -1;
+static csi_udp_t udp;
+static uint8_t datagram[CSI_UDP_HEADER_SIZE + 2 + CSI_PUBLISH_FRAME_BUFFER];
+static double udp_loss;
+static uint64_t loss_state = 1;
+static unsigned udp_lost;
+// Added to trace timestamps to stamp messages with wall-clock time
+static int64_t wall_offset_us;
+// Trace time of the publish tick, for emit()
+static double tick_s;
+// Startup timeline of the last pass, trace seconds, negative until reached
+static double first_publish_s;
+static double first_publish_age_s;
+static double first_estimate_s;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t stage_done(int stage, uint64_t start) {
+  uint64_t end = now_ns();
+  stage_ns[stage] += end - start;
+  stage_calls[stage]++;
+  return end;
+}
+
+// With a broker, the client's socket is served while waiting
+static void sleep_until(uint64_t deadline_ns) {
+  uint64_t now;
+  while ((now = now_ns()) < deadline_ns) {
+    uint64_t wait = deadline_ns - now;
+    if (broker) {
+      if (!mqtt_host_poll(broker, (int)((wait + 999999) / 1000000))) {
+        fprintf(stderr, "broker connection lost\n");
+        mqtt_host_close(broker);
+        broker = NULL;
+        broker_lost++;
+      }
+      continue;
+    }
+    struct timespec ts = {(time_t)(wait / 1000000000u),
+                          (long)(wait % 1000000000u)};
+    nanosleep(&ts, NULL);
+  }
+}
+
+static uint32_t outbox_bytes(void *ctx) {
+  (void)ctx;
+  return broker ? (uint32_t)mqtt_host_outbox_size(broker) : 0;
+}
+
+// Same as the capture half of wifi_csi_rx_cb()
+static void capture(const csi_trace_record_t *rec, int index) {
+  csi_ring_t *ring = &links[index].q;
+  csi_ring_slot_t *slot =
+      rec->meta.len <= CSI_RING_SLOT_SIZE ? csi_ring_claim(ring) : NULL;
+  if (!slot)
+    return;
+  memcpy(slot->data, rec->data, rec->meta.len);
+  slot->len = rec->meta.len;
+  slot->rssi = rec->meta.rssi;
+  slot->agc_gain = rec->meta.agc_gain;
+  slot->fft_gain = (uint8_t)rec->meta.fft_gain;
+  slot->layout = csi_layout_lookup(rec->meta.len, rec->meta.second)->id;
+  slot->first_word_invalid = rec->meta.first_word_invalid;
+  slot->timestamp = (uint32_t)rec->meta.timestamp_us;
+  slot->probe = probe;
+  if (probe)
+    slot->probe_seq = probe_seq[index]++;
+  csi_ring_commit(ring);
+}
+
+// xorshift64, so --loss drops the same datagrams on every run
+static double loss_draw(void) {
+  loss_state ^= loss_state << 13;
+  loss_state ^= loss_state >> 7;
+  loss_state ^= loss_state << 17;
+  return (loss_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void udp_send(const uint8_t *buf, size_t len) {
+  size_t size = csi_udp_pack(&udp, buf, len, datagram, sizeof(datagram));
+  if (size == 0)
+    return;
+  if (udp_loss > 0 && loss_draw() < udp_loss) {
+    udp_lost++;
+    return;
+  }
+  if (send(udp_fd, datagram, size, 0) < 0)
+    perror("udp");
+}
+
+// The transport of csi_publish.h: the file, the broker or the socket
+static int emit(void *ctx, const uint8_t *buf, size_t len, int qos) {
+  (void)ctx;
+  if (first_publish_s < 0) {
+    // Both message formats carry the publish timestamp at offset 8
+    int64_t ts = 0;
+    for (int i = 0; i < 8; i++) {
+      ts |= (int64_t)buf[8 + i] << (8 * i);
+    }
+    first_publish_s = tick_s;
+    first_publish_age_s = tick_s - (ts - wall_offset_us) / 1e6;
+  }
+  published_bytes += len;
+  published++;
+  if (broker)
+    mqtt_host_enqueue(broker, data_topic, buf, len, qos);
+  if (udp_fd >= 0)
+    udp_send(buf, len);
+  if (messages) {
+    uint8_t prefix[4] = {(uint8_t)len, (uint8_t)(len >> 8),
+                         (uint8_t)(len >> 16), (uint8_t)(len >> 24)};
+    fwrite(prefix, 1, sizeof(prefix), messages);
+    fwrite(buf, 1, len, messages);
+  }
+  return 0;
+}
+
+static int replay(FILE *fp, bool realtime, bool quiet, unsigned *frames) {
+  csi_trace_record_t rec;
+  bool first = true;
+  int64_t first_us = 0;
+  int64_t next_publish = 0;
+  int64_t next_br = 0;
+  uint64_t start_ns = now_ns();
+  unsigned captured = 0;
+  csi_publish_link_t *tick_links[MAX_LINKS];
+  for (int i = 0; i < link_count; i++) {
+    tick_links[i] = &links[i];
+  }
+  int ret;
+
+  while ((ret = csi_trace_read(fp, &rec)) == 1) {
+    int64_t ts = rec.meta.timestamp_us;
+    if (first) {
+      first = false;
+      first_us = ts;
+      next_publish = first_us + PUBLISH_PERIOD_US;
+      next_br = first_us + BR_PUBLISH_PERIOD_US;
+      if (broker || udp_fd >= 0) {
+        struct timespec wall;
+        clock_gettime(CLOCK_REALTIME, &wall);
+        wall_offset_us = (int64_t)wall.tv_sec * 1000000 +
+                         wall.tv_nsec / 1000 - first_us;
+      }
+    }
+    if (realtime)
+      sleep_until(start_ns + (uint64_t)(ts - first_us) * 1000u);
+    (*frames)++;
+    double now_s = (ts - first_us) / 1e6;
+    broker_up = ts - first_us >= offline_us && (broker || !broker_lost);
+    if (late_capture && !broker_up) {
+      // Nothing runs yet; the timers start with the pipeline
+      next_publish = ts + PUBLISH_PERIOD_US;
+      next_br = ts + BR_PUBLISH_PERIOD_US;
+      continue;
+    }
+
+    uint64_t t = now_ns();
+    capture(&rec, captured++ % link_count);
+    t = stage_done(STAGE_CAPTURE, t);
+
+    for (int i = 0; i < link_count; i++) {
+      csi_publish_link_t *link = &links[i];
+      const csi_ring_slot_t *slot;
+      while ((slot = csi_ring_peek(&link->q, link->analysed)) != NULL) {
+        const csi_layout_t *layout = csi_layout_get(slot->layout);
+        int8_t band[CSI_LAYOUT_BAND_LEN];
+        if (layout->band)
+          layout->band(slot->data, slot->first_word_invalid, band);
+        else
+          unknown_layout++;
+        link->last_rssi = slot->rssi;
+        motion_push(&link->motion, slot->rssi, layout->band ? band : NULL,
+                    layout->band ? sizeof(band) : 0);
+        t = stage_done(STAGE_MOTION, t);
+        link->analysed++;
+        if (i != 0 || !layout->band)
+          continue;
+        if (!fixed_band && sc_rank_push(&sc_rank, band))
+          breathing_select(sc_rank.selected, SC_RANK_K);
+        t = stage_done(STAGE_RANK, t);
+        int32_t diff = breathing_push(band, sizeof(band));
+        t = stage_done(STAGE_BREATHING, t);
+        if (decimate || stream_fallback)
+          csi_stream_push(&stream, diff, band);
+        t = stage_done(STAGE_DECIMATE, t);
+      }
+    }
+
+    if (ts >= next_publish) {
+      next_publish += PUBLISH_PERIOD_US;
+      if (next_publish <= ts)
+        next_publish = ts + PUBLISH_PERIOD_US;
+      // Same as mqtt_send()
+      const publish_sched_t *sched = &publisher.sched;
+      publish_level_t level = sched->level;
+      uint32_t outbox = outbox_bytes(NULL);
+      uint32_t free_heap = outbox < heap_bytes ? heap_bytes - outbox : 0;
+      tick_s = now_s;
+      csi_publish_tick(&publisher, tick_links, link_count, broker_up,
+                       free_heap, ts + wall_offset_us);
+      if (sched->level != level)
+        fprintf(stderr, "%.1f s: publish level %s -> %s, outbox %" PRIu32
+                        " B\n",
+                now_s, publish_sched_level_name(level),
+                publish_sched_level_name(sched->level), outbox);
+      t = stage_done(STAGE_PUBLISH, t);
+    }
+
+    trace_seconds = (ts - first_us) / 1e6;
+    if (ts >= next_br) {
+      next_br += BR_PUBLISH_PERIOD_US;
+      float bpm = 0;
+      if (breathing_ready()) {
+        if (first_estimate_s < 0)
+          first_estimate_s = now_s;
+        bpm = breathing_estimate();
+        stage_done(STAGE_ESTIMATE, t);
+        bpm_error += fabsf(bpm - true_bpm);
+        bpm_estimates++;
+      }
+      if (!quiet)
+        printf("%.1f,%d,%.3f,%.3f,%.2f\n", (ts - first_us) / 1e6,
+               links[0].motion.motion, links[0].motion.confidence,
+               links[0].motion.score, bpm);
+    }
+  }
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  bool realtime = false;
+  bool quiet = false;
+  int repeat = 1;
+  const char *path = NULL;
+  const char *broker_addr = NULL;
+  const char *udp_addr = NULL;
+  const char *device = NULL;
+  int redundancy = 1;
+  int link = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--realtime"))
+      realtime = true;
+    else if (!strcmp(argv[i], "--quiet"))
+      quiet = true;
+    else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+      repeat = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--fixed-band"))
+      fixed_band = true;
+    else if (!strcmp(argv[i], "--bpm") && i + 1 < argc)
+      true_bpm = strtof(argv[++i], NULL);
+    else if (!strcmp(argv[i], "--decimate") && i + 1 < argc)
+      decimate = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--coded"))
+      coded = true;
+    else if (!strcmp(argv[i], "--text"))
+      text = true;
+    else if (!strcmp(argv[i], "--offline") && i + 1 < argc)
+      offline_us = (int64_t)(strtod(argv[++i], NULL) * 1e6);
+    else if (!strcmp(argv[i], "--late-capture"))
+      late_capture = true;
+    else if (!strcmp(argv[i], "--broker") && i + 1 < argc)
+      broker_addr = argv[++i];
+    else if (!strcmp(argv[i], "--heap") && i + 1 < argc)
+      heap_bytes = (uint32_t)strtoul(argv[++i], NULL, 0);
+    else if (!strcmp(argv[i], "--udp") && i + 1 < argc)
+      udp_addr = argv[++i];
+    else if (!strcmp(argv[i], "--redundancy") && i + 1 < argc)
+      redundancy = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--loss") && i + 1 < argc)
+      udp_loss = strtod(argv[++i], NULL);
+    else if (!strcmp(argv[i], "--link") && i + 1 < argc)
+      link = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--links") && i + 1 < argc)
+      link_count = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--probe"))
+      probe = true;
+    else if (!strcmp(argv[i], "--device") && i + 1 < argc)
+      device = argv[++i];
+    else if (!strcmp(argv[i], "--messages") && i + 1 < argc) {
+      messages = fopen(argv[++i], "wb");
+      if (!messages) {
+        perror(argv[i]);
+        return 1;
+      }
+    }
+    else
+      path = argv[i];
+  }
+  if (!path || repeat < 1 || decimate < 0 || (coded && text) ||
+      decimate > CSI_STREAM_MAX_FACTOR || (broker_addr && udp_addr) ||
+      redundancy < 0 || redundancy > CSI_UDP_MAX_REDUNDANCY || link < 0 ||
+      link_count < 1 || link_count > MAX_LINKS || link + link_count > 256) {
+    fprintf(stderr,
+            "usage: %s [--realtime] [--repeat N] [--quiet] [--fixed-band] "
+            "[--bpm TRUE_BPM] [--decimate FACTOR] [--coded | --text] "
+            "[--messages FILE] [--offline SECONDS [--late-capture]] "
+            "[--broker HOST:PORT [--heap BYTES] [--device NAME]] "
+            "[--udp HOST:PORT [--redundancy N] [--loss P]] "
+            "[--link ID] [--links N] [--probe] trace.csit\n",
+            argv[0]);
+    return 2;
+  }
+
+  if (broker_addr) {
+    char host[256];
+    snprintf(host, sizeof(host), "%s", broker_addr);
+    char *colon = strrchr(host, ':');
+    int port = 1883;
+    if (colon) {
+      *colon = '\0';
+      port = atoi(colon + 1);
+    }
+    char client_id[32];
+    snprintf(client_id, sizeof(client_id), "csi_replay_%d", (int)getpid());
+    snprintf(data_topic, sizeof(data_topic), "csi/data/%s",
+             device ? device : client_id);
+    broker = mqtt_host_connect(host, port, client_id);
+    if (!broker)
+      return 1;
+    realtime = true;
+    stream_fallback = !decimate;
+  }
+  if (udp_addr) {
+    char host[256];
+    snprintf(host, sizeof(host), "%s", udp_addr);
+    char *colon = strrchr(host, ':');
+    const char *port = "8766";
+    if (colon) {
+      *colon = '\0';
+      port = colon + 1;
+    }
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_DGRAM};
+    struct addrinfo *res;
+    int err = getaddrinfo(host, port, &hints, &res);
+    if (err) {
+      fprintf(stderr, "%s: %s\n", host, gai_strerror(err));
+      return 1;
+    }
+    udp_fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (udp_fd < 0 || connect(udp_fd, res->ai_addr, res->ai_addrlen) < 0) {
+      perror(udp_addr);
+      return 1;
+    }
+    freeaddrinfo(res);
+    // A locally administered MAC per process, as the topic is for --broker
+    int pid = (int)getpid();
+    uint8_t mac[6] = {0x02, 0x00, (uint8_t)(pid >> 24), (uint8_t)(pid >> 16),
+                      (uint8_t)(pid >> 8), (uint8_t)pid};
+    csi_udp_init(&udp, mac, redundancy, (uint16_t)time(NULL));
+    realtime = true;
+    stream_fallback = !decimate;
+  }
+
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    perror(path);
+    return 1;
+  }
+
+  unsigned frames = 0;
+  unsigned dropped = 0;
+  uint64_t start = now_ns();
+  for (int r = 0; r < repeat; r++) {
+    // Every pass starts from boot state, so repeats time the same work
+    for (int i = 0; i < link_count; i++) {
+      csi_publish_link_init(&links[i], (uint8_t)(link + i));
+      probe_seq[i] = 0;
+    }
+    breathing_init();
+    sc_rank_init(&sc_rank);
+    if (decimate || stream_fallback)
+      csi_stream_init(&stream, decimate ? decimate : DECIM_FACTOR, BR_FS);
+    csi_publish_config_t config = {
+        .mode = decimate ? CSI_PUBLISH_MODE_DECIMATED : CSI_PUBLISH_MODE_RAW,
+        .format = coded  ? CSI_PUBLISH_FORMAT_CODED
+                  : text ? CSI_PUBLISH_FORMAT_TEXT
+                         : CSI_PUBLISH_FORMAT_BINARY,
+        .stream = decimate || stream_fallback ? &stream : NULL,
+        .stream_samples = SEND_SAMPLES,
+        .subcarriers = sc_rank.selected,
+        .subcarrier_count = SC_RANK_K,
+        .max_message = MAX_MESSAGE,
+        .backlog_buf = backlog_buf,
+        .backlog_size = sizeof(backlog_buf),
+        .backlog_flush = BACKLOG_FLUSH,
+        .transport = {.enqueue = emit, .outbox_size = outbox_bytes},
+    };
+    csi_publish_init(&publisher, &config);
+    first_publish_s = first_publish_age_s = first_estimate_s = -1;
+    rewind(fp);
+    if (!csi_trace_read_header(fp)) {
+      fprintf(stderr, "%s: not a CSI trace\n", path);
+      return 1;
+    }
+    if (r == 1 && messages) {
+      // One pass of messages is enough
+      fclose(messages);
+      messages = NULL;
+    }
+    if (replay(fp, realtime, quiet || r > 0, &frames) < 0) {
+      fprintf(stderr, "%s: truncated record after %u frames\n", path, frames);
+      return 1;
+    }
+    for (int i = 0; i < link_count; i++) {
+      dropped += atomic_load(&links[i].q.dropped);
+    }
+  }
+  double elapsed = (now_ns() - start) / 1e9;
+  fclose(fp);
+  if (broker) {
+    // Give the outbox a moment to drain, then report what is left
+    uint64_t deadline = now_ns() + 2000000000u;
+    while (broker && mqtt_host_outbox_size(broker) > 0 && now_ns() < deadline)
+      sleep_until(now_ns() + 10000000u);
+  }
+  if (messages)
+    fclose(messages);
+
+  fprintf(stderr,
+          "%u frames in %.3f s, %.0f frames/s, %u dropped, %u unknown "
+          "layout\n",
+          frames, elapsed, frames / elapsed, dropped, unknown_layout);
+  fprintf(stderr,
+          "published %u %s messages, %.0f bytes/s, %" PRIu32
+          " frame(s) left out\n",
+          published / repeat,
+          decimate ? "decimated" : coded ? "coded" : text ? "text" : "raw",
+          trace_seconds > 0 ? published_bytes / repeat / trace_seconds : 0,
+          publisher.unsendable);
+  fprintf(stderr, "breathing subcarriers %s, %u re-ranks:",
+          fixed_band ? "fixed" : "ranked", sc_rank.reranks);
+  for (int i = 0; i < SC_RANK_K; i++) {
+    fprintf(stderr, " %u", fixed_band ? BR_SC_FIRST + i : sc_rank.selected[i]);
+  }
+  fprintf(stderr, "\n");
+  if (offline_us > 0)
+    fprintf(stderr,
+            "broker up at %.1f s%s: first frame published at %.1f s, %.1f s "
+            "old, first breathing estimate at %.1f s, backlog high-water "
+            "%" PRIu32 " messages, %" PRIu32 " dropped\n",
+            offline_us / 1e6, late_capture ? ", late capture" : "",
+            first_publish_s, first_publish_age_s, first_estimate_s,
+            publisher.backlog.high_water, publisher.backlog.dropped);
+  if (broker_addr) {
+    const publish_sched_t *sched = &publisher.sched;
+    fprintf(stderr,
+            "publish levels normal/batch/qos0/decimated/hold %" PRIu32
+            "/%" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32
+            " ticks, %" PRIu32 " transitions, outbox peak %" PRIu32
+            " B, free heap min %" PRIu32 " B, backlog %" PRIu32
+            " dropped\n",
+            sched->level_ticks[0], sched->level_ticks[1],
+            sched->level_ticks[2], sched->level_ticks[3],
+            sched->level_ticks[4], sched->transitions, sched->outbox_peak,
+            sched->heap_min, publisher.backlog.dropped);
+    if (broker) {
+      fprintf(stderr, "broker acknowledged %" PRIu32 " messages, %zu B left "
+                      "in the outbox\n",
+              mqtt_host_acked(broker), mqtt_host_outbox_size(broker));
+      mqtt_host_close(broker);
+    } else {
+      fprintf(stderr, "broker connection lost\n");
+    }
+  }
+  if (udp_addr) {
+    fprintf(stderr,
+            "udp: %" PRIu32 " messages, %" PRIu32 " repeats, %u datagrams "
+            "dropped by --loss\n",
+            udp.sent, udp.repeated, udp_lost);
+    close(udp_fd);
+  }
+  if (true_bpm > 0 && bpm_estimates)
+    fprintf(stderr, "breathing error %.2f BPM mean over %u estimates\n",
+            bpm_error / bpm_estimates, bpm_estimates);
+  for (int s = 0; s < STAGE_COUNT; s++) {
+    fprintf(stderr, "  %-20s %10.0f ns/frame %10.0f ns/call\n", stage_names[s],
+            frames ? (double)stage_ns[s] / frames : 0,
+            stage_calls[s] ? (double)stage_ns[s] / stage_calls[s] : 0);
+  }
+  return 0;
+}
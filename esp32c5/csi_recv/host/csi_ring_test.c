@@ -0,0 +1,227 @@
+/* Check the CSI ring on the host, alone and between two threads
+
+   Usage: csi_ring_test [--frames N]
+
+   First runs the ring (main/csi_ring.h) through its single-threaded cases:
+   empty and full, drops, claim/commit, peek, partial pops and the counter
+   wrap. Then a producer thread pushes N numbered frames while a consumer
+   thread reads them back in batches, twice: once with the producer
+   retrying a full ring, where every frame must arrive, and once dropping
+   like the CSI callback does, where every frame must either arrive or be
+   counted as dropped. Each frame's bytes derive from its number, so a slot
+   read while the producer rewrites it shows up too. Exits with 1 on a lost,
+   duplicated, reordered or torn frame.
+*/
+#include "csi_ring.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+// Frame `seq`: its number in the first four bytes, then a pattern of it, at
+// a length that varies with it
+static size_t frame_fill(uint32_t seq, int8_t *data) {
+  size_t len = 8 + seq % (CSI_RING_SLOT_SIZE - 8);
+  memcpy(data, &seq, sizeof(seq));
+  for (size_t i = sizeof(seq); i < len; i++)
+    data[i] = (int8_t)(seq * 31 + i);
+  return len;
+}
+
+// Number of a frame read back, or -1 if it is not a frame_fill() frame
+static int64_t frame_check(const csi_ring_slot_t *slot) {
+  uint32_t seq;
+  int8_t expect[CSI_RING_SLOT_SIZE];
+  memcpy(&seq, slot->data, sizeof(seq));
+  size_t len = frame_fill(seq, expect);
+  if (slot->len != len || memcmp(slot->data, expect, len) != 0)
+    return -1;
+  return seq;
+}
+
+static void test_single_thread(void) {
+  static csi_ring_t ring;
+  int8_t data[CSI_RING_SLOT_SIZE];
+  csi_ring_init(&ring);
+
+  CHECK(csi_ring_count(&ring) == 0);
+  CHECK(csi_ring_front(&ring) == NULL);
+
+  // Fill up, then one more is dropped
+  for (uint32_t i = 0; i < CSI_RING_FRAMES; i++)
+    CHECK(csi_ring_push(&ring, data, frame_fill(i, data)));
+  CHECK(csi_ring_count(&ring) == CSI_RING_FRAMES);
+  CHECK(!csi_ring_push(&ring, data, frame_fill(99, data)));
+  CHECK(csi_ring_claim(&ring) == NULL);
+  CHECK(atomic_load(&ring.dropped) == 2);
+  CHECK(ring.high_water == CSI_RING_FRAMES);
+
+  // Peek in order, past the end is NULL
+  for (uint32_t i = 0; i < CSI_RING_FRAMES; i++)
+    CHECK(frame_check(csi_ring_peek(&ring, i)) == i);
+  CHECK(csi_ring_peek(&ring, CSI_RING_FRAMES) == NULL);
+
+  // Partial pop frees exactly that many slots
+  csi_ring_pop(&ring, 5);
+  CHECK(csi_ring_count(&ring) == CSI_RING_FRAMES - 5);
+  CHECK(frame_check(csi_ring_front(&ring)) == 5);
+  for (uint32_t i = 0; i < 5; i++)
+    CHECK(csi_ring_push(&ring, data, frame_fill(CSI_RING_FRAMES + i, data)));
+  CHECK(!csi_ring_push(&ring, data, frame_fill(0, data)));
+
+  // Popping more than queued empties the ring
+  csi_ring_pop(&ring, 1000);
+  CHECK(csi_ring_count(&ring) == 0);
+
+  // A frame that does not fit a slot is dropped
+  CHECK(!csi_ring_push(&ring, data, CSI_RING_SLOT_SIZE + 1));
+  CHECK(atomic_load(&ring.dropped) == 4);
+
+  // Claim and commit in place; nothing is visible before the commit
+  csi_ring_slot_t *slot = csi_ring_claim(&ring);
+  CHECK(slot != NULL);
+  if (slot) {
+    slot->len = (uint16_t)frame_fill(7, slot->data);
+    CHECK(csi_ring_count(&ring) == 0);
+    csi_ring_commit(&ring);
+    CHECK(frame_check(csi_ring_front(&ring)) == 7);
+    csi_ring_pop(&ring, 1);
+  }
+
+  // Free-running counters across the unsigned wrap
+  csi_ring_init(&ring);
+  atomic_store(&ring.head, 0u - 3);
+  atomic_store(&ring.tail, 0u - 3);
+  for (uint32_t i = 0; i < 10; i++)
+    CHECK(csi_ring_push(&ring, data, frame_fill(i, data)));
+  CHECK(csi_ring_count(&ring) == 10);
+  for (uint32_t i = 0; i < 10; i++)
+    CHECK(frame_check(csi_ring_peek(&ring, i)) == i);
+  csi_ring_pop(&ring, 10);
+  CHECK(csi_ring_count(&ring) == 0);
+}
+
+typedef struct {
+  csi_ring_t ring;
+  uint32_t frames;
+  int retry;
+  atomic_bool done;
+  uint32_t received;
+  uint32_t lost, duplicated, reordered, torn;
+} stress_t;
+
+static void *producer(void *arg) {
+  stress_t *s = arg;
+  int8_t data[CSI_RING_SLOT_SIZE];
+  for (uint32_t seq = 0; seq < s->frames; seq++) {
+    size_t len = frame_fill(seq, data);
+    if (s->retry) {
+      while (!csi_ring_push(&s->ring, data, len))
+        sched_yield();
+    } else {
+      // Bursts of frames, so some fit and some overflow the ring
+      csi_ring_push(&s->ring, data, len);
+      if (seq % 48 == 0)
+        sched_yield();
+    }
+  }
+  atomic_store(&s->done, true);
+  return NULL;
+}
+
+static void *consumer(void *arg) {
+  stress_t *s = arg;
+  int64_t last = -1;
+  unsigned batch = 1;
+  for (;;) {
+    // Done is read first, so frames pushed before it are counted below
+    bool done = atomic_load(&s->done);
+    size_t count = csi_ring_count(&s->ring);
+    if (count == 0) {
+      if (done)
+        break;
+      sched_yield();
+      continue;
+    }
+    // Read a varying number of frames in place before releasing them
+    if (count > batch)
+      count = batch;
+    batch = batch % CSI_RING_FRAMES + 1;
+    for (size_t i = 0; i < count; i++) {
+      int64_t seq = frame_check(csi_ring_peek(&s->ring, i));
+      if (seq < 0) {
+        s->torn++;
+        continue;
+      }
+      if (seq == last)
+        s->duplicated++;
+      else if (seq < last)
+        s->reordered++;
+      else if (s->retry && seq != last + 1)
+        s->lost += (uint32_t)(seq - last - 1);
+      if (seq > last)
+        last = seq;
+      s->received++;
+    }
+    csi_ring_pop(&s->ring, count);
+  }
+  return NULL;
+}
+
+static void test_two_threads(uint32_t frames, int retry) {
+  static stress_t s;
+  memset(&s, 0, sizeof(s));
+  csi_ring_init(&s.ring);
+  s.frames = frames;
+  s.retry = retry;
+
+  pthread_t prod, cons;
+  pthread_create(&cons, NULL, consumer, &s);
+  pthread_create(&prod, NULL, producer, &s);
+  pthread_join(prod, NULL);
+  pthread_join(cons, NULL);
+
+  // A retried push counts as a drop too, but the frame comes again
+  unsigned dropped = retry ? 0 : atomic_load(&s.ring.dropped);
+  printf("%s: %u frames, %u received, %u dropped, %u lost, %u duplicated, "
+         "%u reordered, %u torn, high water %u\n",
+         retry ? "retrying producer" : "dropping producer", frames,
+         s.received, dropped, s.lost, s.duplicated, s.reordered,
+         s.torn, s.ring.high_water);
+  CHECK(s.lost == 0 && s.duplicated == 0 && s.reordered == 0 && s.torn == 0);
+  // Frames neither received nor dropped went missing
+  CHECK(s.received + dropped == frames);
+}
+
+int main(int argc, char **argv) {
+  uint32_t frames = 1000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+      frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else {
+      fprintf(stderr, "usage: csi_ring_test [--frames N]\n");
+      return 2;
+    }
+  }
+  if (frames < 1)
+    frames = 1;
+
+  test_single_thread();
+  test_two_threads(frames, 1);
+  test_two_threads(frames, 0);
+  printf("%d check(s) failed\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+/* Decode the binary serial CSI stream into a CSI trace
+
+   Usage: csi_serial_decode [-o trace.csit] [input]
+
+   Reads the raw byte stream of the CSI_SERIAL_BINARY mode (csi_serial.h)
+   from `input` (a file, or a serial device already set to raw mode, e.g.
+   `stty -F /dev/ttyUSB0 921600 raw`), default stdin. Valid frames are
+   written as a trace to `-o`, default stdout, so the output can be piped
+   into other tools. Frames that fail to decode or have a bad CRC are
+   counted and dropped; text such as boot logs costs only the frame it is
+   glued to.
+
+   A summary goes to stderr at the end of the input or on SIGINT.
+*/
+#include "csi_serial.h"
+#include "csi_trace.h"
+
+#include <signal.h>
+#include <string.h>
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig) {
+  (void)sig;
+  stop = 1;
+}
+
+int main(int argc, char **argv) {
+  const char *in_path = NULL;
+  const char *out_path = NULL;
+  bool usage = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      out_path = argv[++i];
+    else if (argv[i][0] == '-' && argv[i][1] != '\0')
+      usage = true;
+    else
+      in_path = argv[i];
+  }
+  if (usage) {
+    fprintf(stderr, "usage: csi_serial_decode [-o trace.csit] [input]\n");
+    return 2;
+  }
+
+  FILE *in = in_path ? fopen(in_path, "rb") : stdin;
+  FILE *out = out_path ? fopen(out_path, "wb") : stdout;
+  if (!in || !out) {
+    perror(in ? out_path : in_path);
+    return 1;
+  }
+  signal(SIGINT, on_signal);
+  if (!csi_trace_write_header(out)) {
+    perror("write");
+    return 1;
+  }
+
+  static uint8_t frame[CSI_SERIAL_MAX_FRAME];
+  static csi_trace_record_t rec;
+  size_t len = 0;
+  bool overflow = false;
+  unsigned long frames = 0, bad = 0, bytes = 0;
+  int c;
+
+  while (!stop && (c = fgetc(in)) != EOF) {
+    bytes++;
+    if (c != 0) {
+      if (len < sizeof(frame))
+        frame[len++] = (uint8_t)c;
+      else
+        overflow = true;
+      continue;
+    }
+
+    // A delimiter right after start-up or another delimiter is not a frame
+    if (len > 0) {
+      if (!overflow && csi_serial_decode(frame, len, &rec)) {
+        csi_trace_write(out, &rec);
+        frames++;
+      } else {
+        bad++;
+      }
+    }
+    len = 0;
+    overflow = false;
+  }
+  fflush(out);
+
+  fprintf(stderr, "%lu bytes, %lu frames, %lu bad frames\n", bytes, frames,
+          bad);
+  if (in != stdin)
+    fclose(in);
+  if (out != stdout)
+    fclose(out);
+  return 0;
+}
@@ -0,0 +1,132 @@
+/* Check the motion detector against a trace with known motion
+
+   Usage: motion_replay [--motion START END]... [--enter S] [--leave S]
+                        trace.csit
+
+   Feeds every frame's RSSI and band view to motion.h as the analysis task
+   does, and checks the decision against the labelled motion: each
+   --motion START END is a span of movement in seconds from the first
+   frame, as `csi_trace.py synth --motion` writes it, and any time outside
+   them is still. Motion must be reported from START + enter (default
+   0.5 s) to END and must not be reported from END + leave (default 3 s) to
+   the next span; either is accepted while the detector settles in
+   between. Without --motion the whole trace must be still.
+
+   stdout: the transitions, time_s,motion,confidence, then a summary
+   Exits with 1 if a frame's decision is wrong.
+*/
+#include "csi_layout.h"
+#include "csi_trace.h"
+#include "motion.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SPANS 16
+#define MAX_REPORTS 10
+
+typedef struct {
+  double start_s, end_s;
+} span_t;
+
+static void usage(void) {
+  fprintf(stderr, "usage: motion_replay [--motion START END]... [--enter S] "
+                  "[--leave S] trace.csit\n");
+}
+
+// 1 if motion must be reported at `t`, 0 if it must not, -1 if either is
+static int expected(const span_t *spans, int count, double t, double enter,
+                    double leave) {
+  int want = 0;
+  for (int i = 0; i < count; i++) {
+    if (t >= spans[i].start_s + enter && t < spans[i].end_s)
+      return 1;
+    if (t >= spans[i].start_s && t < spans[i].end_s + leave)
+      want = -1;
+  }
+  return want;
+}
+
+int main(int argc, char **argv) {
+  span_t spans[MAX_SPANS];
+  int span_count = 0;
+  double enter = 0.5, leave = 3.0;
+  const char *path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--motion") && i + 2 < argc &&
+        span_count < MAX_SPANS) {
+      spans[span_count].start_s = atof(argv[++i]);
+      spans[span_count].end_s = atof(argv[++i]);
+      span_count++;
+    } else if (!strcmp(argv[i], "--enter") && i + 1 < argc) {
+      enter = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--leave") && i + 1 < argc) {
+      leave = atof(argv[++i]);
+    } else if (argv[i][0] == '-' || path) {
+      usage();
+      return 2;
+    } else {
+      path = argv[i];
+    }
+  }
+  if (!path) {
+    usage();
+    return 2;
+  }
+
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    perror(path);
+    return 1;
+  }
+  if (!csi_trace_read_header(fp)) {
+    fprintf(stderr, "%s: not a CSI trace\n", path);
+    fclose(fp);
+    return 1;
+  }
+
+  static motion_t motion;
+  static csi_trace_record_t rec;
+  motion_init(&motion);
+  int64_t first_us = 0;
+  unsigned long frames = 0, motion_frames = 0, wrong = 0;
+  int reports = 0;
+  bool reported = false, was_bad = false;
+  int r;
+  while ((r = csi_trace_read(fp, &rec)) == 1) {
+    if (frames == 0)
+      first_us = rec.meta.timestamp_us;
+    double t = (rec.meta.timestamp_us - first_us) / 1e6;
+    const csi_layout_t *layout =
+        csi_layout_lookup(rec.meta.len, rec.meta.second);
+    int8_t band[CSI_LAYOUT_BAND_LEN];
+    if (layout->band)
+      layout->band(rec.data, rec.meta.first_word_invalid, band);
+    bool now = motion_push(&motion, rec.meta.rssi, layout->band ? band : NULL,
+                           layout->band ? sizeof(band) : 0);
+    frames++;
+    motion_frames += now;
+    if (now != reported) {
+      printf("%.2f,%d,%.3f\n", t, now, motion.confidence);
+      reported = now;
+    }
+
+    int want = expected(spans, span_count, t, enter, leave);
+    bool bad = want >= 0 && now != (bool)want;
+    // Report where a wrong stretch starts, not every frame of it
+    if (bad && !was_bad && reports++ < MAX_REPORTS)
+      fprintf(stderr, "%.2f s: motion %d, expected %d (score %.2f)\n", t, now,
+              want, motion.score);
+    was_bad = bad;
+    wrong += bad;
+  }
+  fclose(fp);
+  if (r < 0) {
+    fprintf(stderr, "%s: truncated record\n", path);
+    return 1;
+  }
+  printf("%lu frames, motion in %lu, %d span(s) labelled, %lu wrong\n",
+         frames, motion_frames, span_count, wrong);
+  return wrong ? 1 : 0;
+}
@@ -0,0 +1,331 @@
+#include "mqtt_host.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define KEEPALIVE_S 60
+// About lwIP's TCP_SND_BUF on the board
+#define SEND_BUFFER 5760
+
+typedef struct message {
+  struct message *next;
+  uint16_t id;
+  uint8_t qos;
+  size_t len;
+  uint8_t data[];
+} message_t;
+
+struct mqtt_host {
+  int fd;
+  // Outbox in enqueue order; `unsent` is the first message not fully
+  // written, `offset` how much of it is
+  message_t *head;
+  message_t *tail;
+  message_t *unsent;
+  size_t offset;
+  size_t outbox_bytes;
+  uint16_t next_id;
+  uint32_t acked;
+  uint8_t in[256];
+  size_t in_len;
+  time_t last_send;
+};
+
+static size_t put_remaining(uint8_t *p, size_t len) {
+  size_t n = 0;
+  do {
+    uint8_t byte = len % 128;
+    len /= 128;
+    p[n++] = byte | (len ? 0x80 : 0);
+  } while (len);
+  return n;
+}
+
+static size_t put_string(uint8_t *p, const char *s) {
+  size_t len = strlen(s);
+  p[0] = (uint8_t)(len >> 8);
+  p[1] = (uint8_t)len;
+  memcpy(p + 2, s, len);
+  return 2 + len;
+}
+
+static bool write_all(int fd, const uint8_t *p, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+mqtt_host_t *mqtt_host_connect(const char *host, int port,
+                               const char *client_id) {
+  char service[8];
+  snprintf(service, sizeof(service), "%d", port);
+  struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+  struct addrinfo *res;
+  int err = getaddrinfo(host, service, &hints, &res);
+  if (err) {
+    fprintf(stderr, "%s: %s\n", host, gai_strerror(err));
+    return NULL;
+  }
+  int fd = -1;
+  for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0)
+      continue;
+    int sndbuf = SEND_BUFFER;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+      break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  if (fd < 0) {
+    fprintf(stderr, "%s:%d: %s\n", host, port, strerror(errno));
+    return NULL;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  // CONNECT, clean session, no credentials
+  uint8_t body[300];
+  size_t n = put_string(body, "MQTT");
+  body[n++] = 4;
+  body[n++] = 0x02;
+  body[n++] = KEEPALIVE_S >> 8;
+  body[n++] = KEEPALIVE_S & 0xFF;
+  n += put_string(body + n, client_id);
+  uint8_t packet[8 + sizeof(body)];
+  packet[0] = 0x10;
+  size_t h = 1 + put_remaining(packet + 1, n);
+  memcpy(packet + h, body, n);
+  uint8_t connack[4];
+  size_t got = 0;
+  if (!write_all(fd, packet, h + n))
+    goto fail;
+  while (got < sizeof(connack)) {
+    ssize_t r = recv(fd, connack + got, sizeof(connack) - got, 0);
+    if (r <= 0)
+      goto fail;
+    got += (size_t)r;
+  }
+  if (connack[0] != 0x20 || connack[3] != 0) {
+    fprintf(stderr, "%s:%d: connection refused, code %u\n", host, port,
+            connack[3]);
+    close(fd);
+    return NULL;
+  }
+
+  mqtt_host_t *c = calloc(1, sizeof(*c));
+  if (!c) {
+    close(fd);
+    return NULL;
+  }
+  c->fd = fd;
+  c->next_id = 1;
+  c->last_send = time(NULL);
+  return c;
+
+fail:
+  fprintf(stderr, "%s:%d: no CONNACK\n", host, port);
+  close(fd);
+  return NULL;
+}
+
+int mqtt_host_enqueue(mqtt_host_t *c, const char *topic, const void *data,
+                      size_t len, int qos) {
+  if (c->fd < 0)
+    return -1;
+  size_t topic_len = strlen(topic);
+  size_t remaining = 2 + topic_len + (qos ? 2 : 0) + len;
+  uint8_t header[5];
+  header[0] = 0x30 | (qos ? 0x02 : 0);
+  size_t h = 1 + put_remaining(header + 1, remaining);
+  message_t *m = malloc(sizeof(*m) + h + remaining);
+  if (!m)
+    return -1;
+  m->next = NULL;
+  m->qos = qos ? 1 : 0;
+  m->id = 0;
+  m->len = h + remaining;
+  uint8_t *p = m->data;
+  memcpy(p, header, h);
+  p += h + put_string(p + h, topic);
+  if (qos) {
+    m->id = c->next_id;
+    c->next_id = c->next_id == UINT16_MAX ? 1 : c->next_id + 1;
+    *p++ = (uint8_t)(m->id >> 8);
+    *p++ = (uint8_t)m->id;
+  }
+  memcpy(p, data, len);
+
+  if (c->tail)
+    c->tail->next = m;
+  else
+    c->head = m;
+  c->tail = m;
+  if (!c->unsent)
+    c->unsent = m;
+  c->outbox_bytes += m->len;
+  return m->id;
+}
+
+static void unlink_message(mqtt_host_t *c, message_t *prev, message_t *m) {
+  if (prev)
+    prev->next = m->next;
+  else
+    c->head = m->next;
+  if (c->tail == m)
+    c->tail = prev;
+  c->outbox_bytes -= m->len;
+  free(m);
+}
+
+static void drop_connection(mqtt_host_t *c) {
+  if (c->fd >= 0) {
+    close(c->fd);
+    c->fd = -1;
+  }
+}
+
+// Write as much of the outbox as the socket takes
+static void flush(mqtt_host_t *c) {
+  while (c->unsent) {
+    message_t *m = c->unsent;
+    ssize_t n = send(c->fd, m->data + c->offset, m->len - c->offset,
+                     MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        drop_connection(c);
+      return;
+    }
+    c->last_send = time(NULL);
+    c->offset += (size_t)n;
+    if (c->offset < m->len)
+      return;
+    c->offset = 0;
+    c->unsent = m->next;
+    // A written QoS 0 message is done, QoS 1 ones wait for their PUBACK
+    if (m->qos == 0) {
+      message_t *prev = NULL;
+      for (message_t *it = c->head; it != m; it = it->next) {
+        prev = it;
+      }
+      unlink_message(c, prev, m);
+    }
+  }
+}
+
+static void puback(mqtt_host_t *c, uint16_t id) {
+  message_t *prev = NULL;
+  for (message_t *m = c->head; m && m != c->unsent; prev = m, m = m->next) {
+    if (m->qos == 1 && m->id == id) {
+      unlink_message(c, prev, m);
+      c->acked++;
+      return;
+    }
+  }
+}
+
+// Handle the complete packets in the input buffer. A publisher only gets
+// PUBACK and PINGRESP, anything else is skipped
+static void parse(mqtt_host_t *c) {
+  size_t pos = 0;
+  while (c->in_len - pos >= 2) {
+    size_t remaining = 0;
+    size_t h = 1;
+    int shift = 0;
+    uint8_t byte;
+    do {
+      if (pos + h >= c->in_len)
+        goto done;
+      byte = c->in[pos + h++];
+      remaining |= (size_t)(byte & 0x7F) << shift;
+      shift += 7;
+    } while ((byte & 0x80) && shift < 28);
+    if (h + remaining > sizeof(c->in)) {
+      drop_connection(c);
+      return;
+    }
+    if (pos + h + remaining > c->in_len)
+      break;
+    const uint8_t *body = c->in + pos + h;
+    if ((c->in[pos] & 0xF0) == 0x40 && remaining >= 2)
+      puback(c, (uint16_t)(body[0] << 8 | body[1]));
+    pos += h + remaining;
+  }
+done:
+  memmove(c->in, c->in + pos, c->in_len - pos);
+  c->in_len -= pos;
+}
+
+bool mqtt_host_poll(mqtt_host_t *c, int timeout_ms) {
+  if (c->fd < 0)
+    return false;
+  if (time(NULL) - c->last_send >= KEEPALIVE_S / 2 && !c->unsent) {
+    static const uint8_t ping[] = {0xC0, 0x00};
+    if (!write_all(c->fd, ping, sizeof(ping))) {
+      drop_connection(c);
+      return false;
+    }
+    c->last_send = time(NULL);
+  }
+  flush(c);
+  if (c->fd < 0)
+    return false;
+
+  struct pollfd pfd = {.fd = c->fd,
+                       .events = POLLIN | (c->unsent ? POLLOUT : 0)};
+  if (poll(&pfd, 1, timeout_ms) < 0)
+    return errno == EINTR;
+  if (pfd.revents & (POLLERR | POLLHUP)) {
+    drop_connection(c);
+    return false;
+  }
+  if (pfd.revents & POLLIN) {
+    ssize_t n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len,
+                     MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+      drop_connection(c);
+      return false;
+    }
+    if (n > 0) {
+      c->in_len += (size_t)n;
+      parse(c);
+    }
+  }
+  if (pfd.revents & POLLOUT)
+    flush(c);
+  return c->fd >= 0;
+}
+
+size_t mqtt_host_outbox_size(const mqtt_host_t *c) { return c->outbox_bytes; }
+
+uint32_t mqtt_host_acked(const mqtt_host_t *c) { return c->acked; }
+
+void mqtt_host_close(mqtt_host_t *c) {
+  if (c->fd >= 0) {
+    static const uint8_t disconnect[] = {0xE0, 0x00};
+    write_all(c->fd, disconnect, sizeof(disconnect));
+    close(c->fd);
+  }
+  while (c->head) {
+    unlink_message(c, NULL, c->head);
+  }
+  free(c);
+}
@@ -0,0 +1,66 @@
+/* Minimal MQTT 3.1.1 publisher for the host tools
+
+   Behaves like the esp-mqtt outbox as app_main.c uses it through
+   esp_mqtt_client_enqueue(): messages are queued without blocking and
+   written out by mqtt_host_poll(), a QoS 0 message leaves the outbox once
+   it is written to the socket, a QoS 1 message once its PUBACK arrives.
+   mqtt_host_outbox_size() then measures the same backpressure as
+   esp_mqtt_client_get_outbox_size() on the board. The socket's send
+   buffer is kept small, about lwIP's TCP_SND_BUF, so a slow broker fills
+   the outbox instead of the kernel.
+
+   Only what the host tools need: publish at QoS 0 or 1, keepalive pings,
+   no subscriptions, no retransmission and no reconnection.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mqtt_host mqtt_host_t;
+
+/**
+ * @brief Connect and wait for the CONNACK
+ * @return NULL on failure, with the reason on stderr
+ */
+mqtt_host_t *mqtt_host_connect(const char *host, int port,
+                               const char *client_id);
+
+/**
+ * @brief Queue one PUBLISH
+ * @return its message id, 0 for QoS 0, -1 if the connection is lost
+ */
+int mqtt_host_enqueue(mqtt_host_t *c, const char *topic, const void *data,
+                      size_t len, int qos);
+
+/**
+ * @brief Write queued messages and read acknowledgements, waiting up to
+ *        timeout_ms for the socket
+ * @return false once the connection is lost
+ */
+bool mqtt_host_poll(mqtt_host_t *c, int timeout_ms);
+
+/**
+ * @brief Bytes of the messages not yet written, or written at QoS 1 and not
+ *        yet acknowledged
+ */
+size_t mqtt_host_outbox_size(const mqtt_host_t *c);
+
+/**
+ * @brief Messages acknowledged so far
+ */
+uint32_t mqtt_host_acked(const mqtt_host_t *c);
+
+/**
+ * @brief Send DISCONNECT and free the client, dropping the outbox
+ */
+void mqtt_host_close(mqtt_host_t *c);
+
+#ifdef __cplusplus
+}
+#endif
@@ -34,131 +34,336 @@
  * Have fun building!
  */
 
+#include "breathing.h"
+#include "csi_dsp_bench.h"
+#include "csi_layout.h"
+#include "csi_link.h"
+#include "csi_link_bench.h"
+#include "csi_probe.h"
+#include "csi_publish.h"
+#include "csi_ring.h"
+#include "csi_serial.h"
+#include "csi_stream.h"
+#include "csi_udp.h"
+#include "esp_cpu.h"
 #include "esp_dsp.h"
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "esp_netif.h"
 #include "esp_now.h"
+#include "esp_random.h"
+#include "esp_system.h"
 #include "esp_timer.h"
 #include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "motion.h"
 #include "mqtt_client.h"
 #include "nvs_flash.h"
+#include "probe_stats.h"
+#include "publish_sched.h"
 #include "rom/ets_sys.h"
+#include "sc_rank.h"
+#include <inttypes.h>
 #include <math.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 // [1] YOUR CODE HERE
-#define CSI_BUFFER_LENGTH 1140
-#define CSI_FIFO_LENGTH 114
-static int16_t CSI_Q[CSI_BUFFER_LENGTH];
-static int CSI_Q_INDEX = 0; // CSI Buffer Index
+// Transmitters received at once, one link each (see csi_link.h): csi_send
+// boards whose MAC shares the first five bytes of CONFIG_CSI_SEND_MAC, told
+// apart by the last one. A link holds a ring, its analysis state and a
+// coder, about 15 KB; boards beyond CSI_LINKS are rejected
+#define CSI_LINKS 4
 // Enable/Disable CSI Buffering. 1: Enable, using buffer, 0: Disable, using
 // serial output
 static bool CSI_Q_ENABLE = 1;
-static void csi_process(const int8_t *csi_data, int length);
+// Serial output format when CSI_Q_ENABLE is 0. 1: COBS-framed binary records
+// written by a background task (see csi_serial.h), 0: CSI_DATA text lines
+#define CSI_SERIAL_BINARY 1
+// MQTT payload format. 1: binary frames (see csi_frame.h), 0: legacy
+// comma-separated text, which only carries HT20 frames
+#define CSI_MQTT_BINARY 1
+// Binary frames only. 1: compress them losslessly (see csi_codec.h), 0: raw
+#define CSI_MQTT_CODED 1
+// What goes on csi/data: CSI_PUBLISH_RAW batches of raw CSI frames,
+// CSI_PUBLISH_DECIMATED the breathing signal and the selected subcarriers'
+// amplitudes at 100 / CSI_DECIM_FACTOR Hz (see csi_stream.h), or
+// CSI_PUBLISH_NONE nothing, leaving the on-board results on csi/br
+#define CSI_PUBLISH_NONE 0
+#define CSI_PUBLISH_RAW 1
+#define CSI_PUBLISH_DECIMATED 2
+#define CSI_PUBLISH CSI_PUBLISH_RAW
+// The decimated stream is also what the other modes fall back to under
+// backpressure, see publish_sched.h
+#define CSI_STREAM_ENABLED (CSI_PUBLISH != CSI_PUBLISH_NONE)
+// Decimated mode: frames per output sample, and output samples per message
+#define CSI_DECIM_FACTOR 10
+#define CSI_DECIM_SEND_SAMPLES 10
+// csi/data messages held while the broker is unreachable (csi_backlog.h),
+// and how many of them are sent per publish tick on top of the new ones
+#define CSI_BACKLOG_SIZE (64 * 1024)
+#define CSI_BACKLOG_FLUSH 10
+// How csi/data messages reach the backend: CSI_TRANSPORT_MQTT through the
+// broker, or CSI_TRANSPORT_UDP as datagrams straight to backend/server.py
+// at CSI_UDP_HOST (see csi_udp.h), each repeating the CSI_UDP_REDUNDANCY
+// messages before it. csi/br and csi/telemetry use the broker either way
+#define CSI_TRANSPORT_MQTT 0
+#define CSI_TRANSPORT_UDP 1
+#define CSI_TRANSPORT CSI_TRANSPORT_MQTT
+#define CSI_UDP_REDUNDANCY 1
+// Estimate breathing rate on-board and publish it on csi/br every
+// BR_PUBLISH_TICKS publish ticks
+#define CSI_ONBOARD_BR 1
+#define BR_PUBLISH_TICKS 10
+// 1: average the subcarriers ranked best for breathing (see sc_rank.h),
+// 0: always average the fixed band [BR_SC_FIRST, BR_SC_LAST)
+#define CSI_ADAPTIVE_BAND 1
+// Analysis task, see csi_analysis_task()
+#define CSI_TASK_STACK_SIZE 8192
+#define CSI_TASK_PRIORITY 5
+#define CSI_STATS_PERIOD_US (10 * 1000 * 1000)
+static TaskHandle_t csi_task = NULL;
 // [1] END OF YOUR CODE
 static esp_mqtt_client_handle_t mqtt_client = NULL;
+// Per-device topics, csi/data/<mac>, csi/br/<mac> and csi/telemetry/<mac>,
+// set in mqtt_init()
+static char mqtt_data_topic[32] = "csi/data";
+static char mqtt_br_topic[32] = "csi/br";
+static char mqtt_telemetry_topic[32] = "csi/telemetry";
+// Link state, set and cleared by wifi_event_handler() and
+// mqtt_event_handler(); capture runs whatever the state
+static EventGroupHandle_t net_events;
+#define NET_WIFI_UP_BIT BIT0
+#define NET_MQTT_UP_BIT BIT1
+// Startup milestones, us since boot, 0 until reached. Logged once the first
+// frame is published and sent with the telemetry
+static struct {
+  int64_t radio; /**< Wi-Fi started, CSI capture on */
+  int64_t first_frame;
+  int64_t got_ip;
+  int64_t mqtt;
+  int64_t first_publish;
+} startup;
+static uint32_t mqtt_reconnects = 0;
+// MQTT client output buffer. A message must fit in it with its MQTT header
+// and topic, larger ones are dropped, see csi_publish_config_t
+#define MQTT_OUT_SIZE 8192
+#define MQTT_PUBLISH_OVERHEAD (5 + 2 + sizeof(mqtt_data_topic) + 2)
+_Static_assert(CSI_PUBLISH_FRAME_BUFFER + MQTT_PUBLISH_OVERHEAD <=
+                   MQTT_OUT_SIZE,
+               "a full batch fits in the MQTT client's buffer");
+// csi/data publishing: the pressure level of the publish path, updated
+// every publish tick, and the backlog, see csi_publish.h
+static csi_publish_t publisher;
+static uint8_t backlog_buf[CSI_BACKLOG_SIZE];
+#if CSI_TRANSPORT == CSI_TRANSPORT_UDP
+// Opened by udp_init(); a csi/data message is bounded by the MQTT buffer
+// either way
+static int udp_socket = -1;
+static struct sockaddr_in udp_backend;
+static csi_udp_t csi_udp;
+static uint8_t udp_datagram[CSI_UDP_HEADER_SIZE + 2 + MQTT_OUT_SIZE];
+static uint32_t udp_send_errors = 0;
+#endif
 
 // [2] YOUR CODE HERE
 
-#define RSSI_BUFFER_SIZE 20
-#define MOTION_THRESHOLD 0.5
-static int8_t rssi_buffer[RSSI_BUFFER_SIZE];
-static int rssi_index = 0;
-static bool rssi_buffer_filled = false;
-static bool motion_detected = false;
-static float variance = 0;
-
-bool motion_detection() {
-  if (!rssi_buffer_filled && rssi_index < 5) {
-    motion_detected = false;
-    return false;
-  }
+// Gains of a link's first 100 frames, see gain_calibration()
+typedef struct {
+  int count;
+  uint16_t agc_sum;
+  uint16_t fft_sum;
+} gain_cal_t;
+
+// Everything kept per transmitter. Capture, motion detection, probe
+// statistics and raw publishing run on every link; the breathing estimate,
+// the subcarrier ranking and the decimated stream, which have a single
+// instance, follow link 0, the first transmitter heard.
+typedef struct {
+  // Ring, analysis cursor, motion state and message sequence, see
+  // csi_publish.h. The ring is written by the CSI callback and drained by
+  // the analysis task
+  csi_publish_link_t pub;
+  // Loss and jitter of the link's probes, published every
+  // CSI_STATS_PERIOD_US
+  probe_stats_t probe_stats;
+  gain_cal_t gain;
+} csi_link_t;
+// Looked up by the CSI callback only, which assigns the links. The analysis
+// task goes through all CSI_LINKS, links not assigned yet have empty rings
+static csi_link_table_t link_table;
+static csi_link_t links[CSI_LINKS];
+// Subcarriers averaged by the breathing estimate
+static sc_rank_t sc_rank;
+#if CSI_STREAM_ENABLED
+static csi_stream_t csi_stream;
+#endif
 
-  float sum = 0.0;
-  int count = rssi_buffer_filled ? RSSI_BUFFER_SIZE : rssi_index;
+// `band` is the frame's band view (csi_layout.h), NULL for an unknown layout
+bool motion_detection(csi_link_t *link, const csi_ring_slot_t *frame,
+                      const int8_t *band) {
+  link->pub.last_rssi = frame->rssi;
+  return motion_push(&link->pub.motion, frame->rssi, band,
+                     band ? CSI_LAYOUT_BAND_LEN : 0);
+}
 
-  for (int i = 0; i < count; i++) {
-    sum += rssi_buffer[i];
+// The device's motion: seen on any link, at the highest confidence
+static bool motion_any(float *confidence) {
+  bool motion = false;
+  *confidence = 0;
+  for (int i = 0; i < CSI_LINKS; i++) {
+    motion |= links[i].pub.motion.motion;
+    if (links[i].pub.motion.confidence > *confidence)
+      *confidence = links[i].pub.motion.confidence;
   }
-  float mean = sum / count;
-
-  variance = 0.0;
-  for (int i = 0; i < count; i++) {
-    float diff = rssi_buffer[i] - mean;
-    variance += diff * diff;
-  }
-  variance /= count;
-  motion_detected = true;
-  return true;
+  return motion;
 }
 
-int breathing_rate_estimation() {
-  // TODO: Implement breathing rate estimation using CSI data in CSI_Q
-  return 0; // Placeholder
+float breathing_rate_estimation() {
+  if (!breathing_ready())
+    return 0;
+  return breathing_estimate();
 }
 
-void mqtt_send() {
-  if (CSI_Q_INDEX == 0)
-    return;
+// Pipeline counters of the analysis task, logged every CSI_STATS_PERIOD_US
+static struct {
+  uint32_t frames;
+  uint32_t unknown_layout;
+  uint32_t publishes;
+  uint32_t motion_cycles;
+  uint32_t breathing_cycles;
+  uint32_t publish_cycles;
+} csi_stats;
+// Added to by the CSI callback on the Wi-Fi task, taken and cleared by
+// csi_log_stats(), so it is atomic like the rings' counters
+static atomic_uint csi_capture_cycles;
+
+static bool mqtt_up(void) {
+  return xEventGroupGetBits(net_events) & NET_MQTT_UP_BIT;
+}
 
-  // 4 bytes per sample + 1 for '\0'
-  // +4 bytes for rssi and 1 byte for boolean motion_detected
-  int buffer_size = CSI_Q_INDEX * 4 + 4 + 1 + 1;
-  char *mqtt_buffer = malloc(buffer_size);
-  if (!mqtt_buffer) {
-    ESP_LOGE("MQTT", "Failed to allocate buffer");
+static void startup_published(void) {
+  if (startup.first_publish)
     return;
-  }
-
-  char *p = mqtt_buffer;
-  int remaining = buffer_size;
-
-  for (int i = 0; i < CSI_Q_INDEX; i++) {
-    int written =
-        snprintf(p, remaining, (i < CSI_Q_INDEX - 1) ? "%d," : "%d", CSI_Q[i]);
-
-    if (written < 0 || written >= remaining) {
-      ESP_LOGE("MQTT", "Buffer overflow at sample %d", i);
-      break;
-    }
-
-    p += written;
-    remaining -= written;
-  }
-
-  bool motion_detected = variance > MOTION_THRESHOLD;
+  startup.first_publish = esp_timer_get_time();
+  ESP_LOGI("Startup",
+           "first frame published %" PRId64 " ms after boot: radio up %" PRId64
+           " ms, first frame %" PRId64 " ms, IP %" PRId64 " ms, MQTT %" PRId64
+           " ms, %" PRIu32 " messages held",
+           startup.first_publish / 1000, startup.radio / 1000,
+           startup.first_frame / 1000, startup.got_ip / 1000,
+           startup.mqtt / 1000, publisher.backlog.count);
+}
 
-  *p++ = ',';
-  int written = snprintf(p, remaining, "%d", motion_detected);
-  p += written;
+// The csi/data transport's link and queue, for the publish scheduler. Over
+// UDP nothing queues beyond lwIP's buffers, so only the link counts
+static bool data_link_up(void) {
+#if CSI_TRANSPORT == CSI_TRANSPORT_UDP
+  return xEventGroupGetBits(net_events) & NET_WIFI_UP_BIT;
+#else
+  return mqtt_up();
+#endif
+}
 
-  *p++ = ',';
-  written = snprintf(p, remaining, "%d", rssi_buffer[0]);
-  p += written;
+static uint32_t data_outbox_size(void *ctx) {
+#if CSI_TRANSPORT == CSI_TRANSPORT_UDP
+  return 0;
+#else
+  int size = esp_mqtt_client_get_outbox_size(mqtt_client);
+  return size > 0 ? (uint32_t)size : 0;
+#endif
+}
 
-  *p = '\0';
+// Hand one csi/data message to the transport; the message id, or -1 if it
+// was not taken. csi/data messages are enqueued for the client's task, so a
+// slow broker never blocks the analysis task
+static int data_enqueue(void *ctx, const uint8_t *data, size_t len, int qos) {
+#if CSI_TRANSPORT == CSI_TRANSPORT_UDP
+  size_t size = csi_udp_pack(&csi_udp, data, len, udp_datagram,
+                             sizeof(udp_datagram));
+  if (size == 0)
+    return -1;
+  // A datagram lwIP has no buffer for is not retried: the next one repeats
+  // the message, as after a loss on the air
+  if (sendto(udp_socket, udp_datagram, size, 0,
+             (const struct sockaddr *)&udp_backend, sizeof(udp_backend)) < 0)
+    udp_send_errors++;
+  startup_published();
+  return 0;
+#else
+  int msg_id = esp_mqtt_client_enqueue(mqtt_client, mqtt_data_topic,
+                                       (const char *)data, len, qos, 0, true);
+  if (msg_id >= 0)
+    startup_published();
+  return msg_id;
+#endif
+}
 
-  int payload_len = strlen(mqtt_buffer);
-  int msg_id = esp_mqtt_client_publish(mqtt_client, "csi/data", mqtt_buffer,
-                                       payload_len, 1, 0);
-  free(mqtt_buffer);
-  ESP_LOGI("Motion Detection", "Variance: %.2f, Motion Detected: %d", variance,
-           motion_detected);
+#if CSI_ONBOARD_BR
+static void mqtt_send_br(bool motion_detected, float motion_confidence) {
+  static int ticks = 0;
+  if (!breathing_ready() || ++ticks < BR_PUBLISH_TICKS)
+    return;
+  ticks = 0;
+  // Only the newest estimate matters, nothing is held back
+  if (!mqtt_up() || publisher.sched.level == PUBLISH_LEVEL_HOLD)
+    return;
 
-  if (msg_id != -1) {
-    // ESP_LOGI("MQTT", "Message sent, msg_id=%d", msg_id);
-  } else {
-    ESP_LOGW("MQTT", "Send failed");
-  }
+  char payload[128];
+  int len = snprintf(payload, sizeof(payload),
+                     "{\"breathing_rate\":%.2f,\"motion_detect\":%d,"
+                     "\"motion_confidence\":%.2f,\"rssi\":%d}",
+                     breathing_rate_estimation(), motion_detected,
+                     motion_confidence, links[0].pub.last_rssi);
+  int qos = publisher.sched.level >= PUBLISH_LEVEL_QOS0 ? 0 : 1;
+  if (esp_mqtt_client_enqueue(mqtt_client, mqtt_br_topic, payload, len, qos,
+                              0, true) < 0)
+    ESP_LOGW("MQTT", "Breathing rate send failed");
 }
+#endif
 
-static void timer_callback(void *arg) {
-  if (CSI_Q_INDEX > 0) {
-    mqtt_send();
+// One publish tick of every link, see csi_publish_tick()
+void mqtt_send() {
+  publish_level_t level = publisher.sched.level;
+  uint32_t failed = publisher.failed;
+  uint32_t unsendable = publisher.unsendable;
+  csi_publish_link_t *publish_links[CSI_LINKS];
+  for (int i = 0; i < CSI_LINKS; i++) {
+    publish_links[i] = &links[i].pub;
   }
+  csi_publish_tick(&publisher, publish_links, CSI_LINKS, data_link_up(),
+                   esp_get_free_heap_size(), esp_timer_get_time());
+  const publish_sched_t *sched = &publisher.sched;
+  if (sched->level != level)
+    ESP_LOGW("MQTT", "publish level %s -> %s, outbox %" PRIu32
+                     " B, free heap %" PRIu32 " B",
+             publish_sched_level_name(level),
+             publish_sched_level_name(sched->level), sched->outbox_bytes,
+             sched->free_heap);
+
+  float motion_confidence;
+  bool motion_detected = motion_any(&motion_confidence);
+#if CSI_ONBOARD_BR
+  mqtt_send_br(motion_detected, motion_confidence);
+#endif
+  const motion_t *motion = &links[0].pub.motion;
+  ESP_LOGI("Motion Detection",
+           "RSSI var: %.2f, power var: %.4f, score: %.2f, Motion Detected: %d "
+           "(%.0f%%), on any link: %d (%.0f%%)",
+           motion->rssi_variance, motion->power_variation, motion->score,
+           motion->motion, motion->confidence * 100, motion_detected,
+           motion_confidence * 100);
+
+  if (publisher.unsendable != unsendable)
+    ESP_LOGW("MQTT", "Dropped %" PRIu32 " CSI frame(s) no message can hold",
+             publisher.unsendable - unsendable);
+  if (publisher.failed != failed)
+    ESP_LOGW("MQTT", "Send failed");
 }
 
 // [2] END OF YOUR CODE
@@ -174,6 +379,9 @@ static void timer_callback(void *arg) {
 #define CONFIG_GAIN_CONTROL CONFIG_FORCE_GAIN
 
 #define MQTT_BROKER_URL "mqtt://192.168.46.44"
+// Backend UDP receiver, CSI_TRANSPORT_UDP only (UDP_PORT in server.py)
+#define CSI_UDP_HOST "192.168.46.44"
+#define CSI_UDP_PORT 8766
 #define MQTT_FREQ 100 * 1000
 
 // UPDATE: Define parameters for scan method
@@ -224,15 +432,23 @@ extern void phy_force_rx_gain(int force_en, int force_value);
 
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data);
-static bool wifi_connected = false;
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
                                int32_t event_id, void *event_data);
-static bool mqtt_connected = false;
 
 //------------------------------------------------------MQTT
 // Initialize------------------------------------------------------
+// The client is started by wifi_event_handler() once there is an IP address
 static void mqtt_init() {
+  uint8_t mac[6];
+  esp_wifi_get_mac(WIFI_IF_STA, mac);
+  snprintf(mqtt_data_topic, sizeof(mqtt_data_topic),
+           "csi/data/%02x%02x%02x%02x%02x%02x", MAC2STR(mac));
+  snprintf(mqtt_br_topic, sizeof(mqtt_br_topic),
+           "csi/br/%02x%02x%02x%02x%02x%02x", MAC2STR(mac));
+  snprintf(mqtt_telemetry_topic, sizeof(mqtt_telemetry_topic),
+           "csi/telemetry/%02x%02x%02x%02x%02x%02x", MAC2STR(mac));
+
   esp_mqtt_client_config_t mqtt_cfg = {
       .broker.address.uri = MQTT_BROKER_URL,
       .broker.address.port = 1883,
@@ -245,7 +461,7 @@ static void mqtt_init() {
       .buffer =
           {
               .size = 4096,
-              .out_size = 4096,
+              .out_size = MQTT_OUT_SIZE,
           },
   };
   mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
@@ -253,10 +469,24 @@ static void mqtt_init() {
    * example mqtt_event_handler */
   esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID,
                                  mqtt_event_handler, NULL);
-  esp_mqtt_client_start(mqtt_client);
-  ESP_LOGI(TAG, "MQTT client started");
 }
 
+#if CSI_TRANSPORT == CSI_TRANSPORT_UDP
+// The socket is usable as soon as the netif exists; datagrams are only sent
+// once there is an IP address, see data_link_up()
+static void udp_init() {
+  uint8_t mac[6];
+  esp_wifi_get_mac(WIFI_IF_STA, mac);
+  csi_udp_init(&csi_udp, mac, CSI_UDP_REDUNDANCY, (uint16_t)esp_random());
+  udp_backend.sin_family = AF_INET;
+  udp_backend.sin_port = htons(CSI_UDP_PORT);
+  inet_pton(AF_INET, CSI_UDP_HOST, &udp_backend.sin_addr);
+  udp_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (udp_socket < 0)
+    ESP_LOGE(TAG, "UDP socket: errno %d", errno);
+}
+#endif
+
 // ------------------------------------------------------MQTT
 // Event Handler------------------------------------------------------
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
@@ -272,11 +502,15 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
     ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
     msg_id = esp_mqtt_client_publish(client, "$", "Hello", 0, 1, 0);
     ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
-    mqtt_connected = true;
+    if (startup.mqtt == 0)
+      startup.mqtt = esp_timer_get_time();
+    else
+      mqtt_reconnects++;
+    xEventGroupSetBits(net_events, NET_MQTT_UP_BIT);
     break;
   case MQTT_EVENT_DISCONNECTED:
     ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
-    mqtt_connected = false;
+    xEventGroupClearBits(net_events, NET_MQTT_UP_BIT);
     break;
   case MQTT_EVENT_PUBLISHED:
     // ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
@@ -365,7 +599,6 @@ static void wifi_init() {
   // [3] END OF YOUR CODE
 
   ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-  ESP_ERROR_CHECK(esp_wifi_start());
   ESP_LOGI(TAG, "wifi_init finished.");
 }
 
@@ -379,12 +612,24 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
   } else if (event_base == WIFI_EVENT &&
              event_id == WIFI_EVENT_STA_DISCONNECTED) {
     ESP_LOGI(TAG, "Connection failed! Retrying...");
-    wifi_connected = false;
+    xEventGroupClearBits(net_events, NET_WIFI_UP_BIT);
     esp_wifi_connect();
   } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
     ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
     ESP_LOGI(TAG, "Got IP:" IPSTR, IP2STR(&event->ip_info.ip));
-    wifi_connected = true;
+    if (startup.got_ip == 0)
+      startup.got_ip = esp_timer_get_time();
+    xEventGroupSetBits(net_events, NET_WIFI_UP_BIT);
+
+    // Connect to the broker now rather than on the client's retry timer
+    static bool mqtt_started = false;
+    if (!mqtt_started) {
+      esp_mqtt_client_start(mqtt_client);
+      mqtt_started = true;
+      ESP_LOGI(TAG, "MQTT client started");
+    } else {
+      esp_mqtt_client_reconnect(mqtt_client);
+    }
 
     wifi_ap_record_t ap_info;
     if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
@@ -412,6 +657,38 @@ static void wifi_esp_now_init(esp_now_peer_info_t peer) {
 
 //------------------------------------------------------CSI
 // Callback------------------------------------------------------
+#if CONFIG_GAIN_CONTROL
+// Average the gains of a link's first 100 frames. The radio has a single
+// gain setting: the first link to finish pins it, the others only log
+// theirs, which shows how far apart the transmitters are
+static void gain_calibration(csi_link_t *link, uint8_t agc_gain,
+                             uint8_t fft_gain) {
+  static bool forced = false;
+  gain_cal_t *g = &link->gain;
+  if (g->count < 100) {
+    g->agc_sum += agc_gain;
+    g->fft_sum += fft_gain;
+  } else if (g->count == 100) {
+    uint8_t agc_gain_force_value = g->agc_sum / 100;
+    uint8_t fft_gain_force_value = g->fft_sum / 100;
+#if CONFIG_FORCE_GAIN
+    if (!forced) {
+      phy_fft_scale_force(1, fft_gain_force_value);
+      phy_force_rx_gain(1, agc_gain_force_value);
+    }
+#endif
+    ESP_LOGI(TAG, "link %02x: fft %s %d, agc %s %d", link->pub.id,
+             forced ? "mean" : "force", fft_gain_force_value,
+             forced ? "mean" : "force", agc_gain_force_value);
+    forced = true;
+  }
+  if (g->count <= 100)
+    g->count++;
+}
+#endif
+
+// Runs in the Wi-Fi task: copy the frame into the ring and wake the analysis
+// task, everything else happens there
 static void wifi_csi_rx_cb(void *ctx, wifi_csi_info_t *info) {
   if (!info || !info->buf)
     return;
@@ -420,58 +697,63 @@ static void wifi_csi_rx_cb(void *ctx, wifi_csi_info_t *info) {
 
   // Applying the CSI_Q_ENABLE flag to determine the output method
   // 1: Enable, using buffer, 0: Disable, using serial output
-  if (!CSI_Q_ENABLE) {
+  if (!CSI_Q_ENABLE && !CSI_SERIAL_BINARY) {
     ets_printf("CSI_DATA,%d," MACSTR ",%d,%d,%d,%d\n", info->len,
                MAC2STR(info->mac), info->rx_ctrl.rssi, info->rx_ctrl.rate,
                info->rx_ctrl.noise_floor, info->rx_ctrl.channel);
   }
 
-  if (!info || !info->buf) {
-    ESP_LOGW(TAG, "<%s> wifi_csi_cb", esp_err_to_name(ESP_ERR_INVALID_ARG));
-    return;
-  }
-
   // ESP_LOGI(TAG, "Received MAC: " MACSTR ", Expected MAC: " MACSTR,
   //          MAC2STR(info->mac), MAC2STR(CONFIG_CSI_SEND_MAC));
 
-  if (memcmp(info->mac, CONFIG_CSI_SEND_MAC, 6)) {
-    ESP_LOGI(TAG, "MAC address doesn't match, skipping packet");
+  // Frames of other stations and of transmitters beyond CSI_LINKS are
+  // counted in link_table
+  uint8_t assigned = link_table.count;
+  int index = csi_link_lookup(&link_table, info->mac);
+  if (index < 0)
     return;
-  }
-
-  rssi_buffer[rssi_index] = info->rx_ctrl.rssi;
-  rssi_index = (rssi_index + 1) % RSSI_BUFFER_SIZE;
-  if (rssi_index == 0) {
-    rssi_buffer_filled = true;
-  }
-
-  motion_detection();
+  csi_link_t *link = &links[index];
+  if (link_table.count != assigned)
+    link->pub.id = info->mac[5];
 
   wifi_pkt_rx_ctrl_phy_t *phy_info = (wifi_pkt_rx_ctrl_phy_t *)info;
-  static int s_count = 0;
+  const wifi_pkt_rx_ctrl_t *rx_ctrl = &info->rx_ctrl;
 
+  if (CSI_Q_ENABLE == 0 && CSI_SERIAL_BINARY) {
 #if CONFIG_GAIN_CONTROL
-  static uint16_t agc_gain_sum = 0;
-  static uint16_t fft_gain_sum = 0;
-  static uint8_t agc_gain_force_value = 0;
-  static uint8_t fft_gain_force_value = 0;
-  if (s_count < 100) {
-    agc_gain_sum += phy_info->agc_gain;
-    fft_gain_sum += phy_info->fft_gain;
-  } else if (s_count == 100) {
-    agc_gain_force_value = agc_gain_sum / 100;
-    fft_gain_force_value = fft_gain_sum / 100;
-#if CONFIG_FORCE_GAIN
-    phy_fft_scale_force(1, fft_gain_force_value);
-    phy_force_rx_gain(1, agc_gain_force_value);
+    gain_calibration(link, phy_info->agc_gain, phy_info->fft_gain);
 #endif
-    ESP_LOGI(TAG, "fft_force %d, agc_force %d", fft_gain_force_value,
-             agc_gain_force_value);
+    // A trace records a single transmitter, link 0
+    if (index != 0)
+      return;
+    // rx_ctrl timestamps wrap every ~71 minutes, traces carry 64 bits
+    static uint32_t last_timestamp = 0;
+    static int64_t timestamp_high = 0;
+    if (rx_ctrl->timestamp < last_timestamp)
+      timestamp_high += 1LL << 32;
+    last_timestamp = rx_ctrl->timestamp;
+
+    csi_trace_meta_t meta = {
+        .timestamp_us = timestamp_high + rx_ctrl->timestamp,
+        .rssi = rx_ctrl->rssi,
+        .rate = rx_ctrl->rate,
+        .noise_floor = rx_ctrl->noise_floor,
+        .agc_gain = phy_info->agc_gain,
+        .fft_gain = phy_info->fft_gain,
+        .channel = rx_ctrl->channel,
+        .first_word_invalid = info->first_word_invalid,
+        .second = rx_ctrl->second,
+        .len = info->len,
+    };
+    csi_serial_send(&meta, info->buf);
+    return;
   }
-#endif
 
-  const wifi_pkt_rx_ctrl_t *rx_ctrl = &info->rx_ctrl;
   if (CSI_Q_ENABLE == 0) {
+    static int s_count = 0;
+#if CONFIG_GAIN_CONTROL
+    gain_calibration(link, phy_info->agc_gain, phy_info->fft_gain);
+#endif
     ESP_LOGI(TAG, "================ CSI RECV via Serial Port ================");
     ets_printf("CSI_DATA,%d," MACSTR ",%d,%d,%d,%d,%d,%d,%d,%d,%d", s_count++,
                MAC2STR(info->mac), rx_ctrl->rssi, rx_ctrl->rate,
@@ -485,27 +767,88 @@ static void wifi_csi_rx_cb(void *ctx, wifi_csi_info_t *info) {
       ets_printf(",%d", info->buf[i]);
     }
     ets_printf("]\"\n");
+    return;
   }
 
-  else {
-    // ESP_LOGI(TAG, "================ CSI RECV via Buffer ================");
-    csi_process(info->buf, info->len);
+  // ESP_LOGI(TAG, "================ CSI RECV via Buffer ================");
+  uint32_t start = esp_cpu_get_cycle_count();
+  csi_ring_slot_t *slot =
+      info->len <= CSI_RING_SLOT_SIZE ? csi_ring_claim(&link->pub.q) : NULL;
+  if (slot) {
+    memcpy(slot->data, info->buf, info->len);
+    slot->len = info->len;
+    slot->rssi = rx_ctrl->rssi;
+    slot->agc_gain = phy_info->agc_gain;
+    slot->fft_gain = phy_info->fft_gain;
+    slot->layout = csi_layout_lookup(info->len, rx_ctrl->second)->id;
+    slot->first_word_invalid = info->first_word_invalid;
+    slot->timestamp = rx_ctrl->timestamp;
+
+    csi_probe_t probe;
+    slot->probe =
+        info->payload_len > CSI_PROBE_ESPNOW_OFFSET &&
+        csi_probe_parse(info->payload + CSI_PROBE_ESPNOW_OFFSET,
+                        info->payload_len - CSI_PROBE_ESPNOW_OFFSET, &probe);
+    if (slot->probe) {
+      slot->probe_seq = probe.seq;
+      slot->probe_tx_us = (uint32_t)probe.timestamp_us;
+    }
+    csi_ring_commit(&link->pub.q);
+    xTaskNotifyGive(csi_task);
   }
+  atomic_fetch_add_explicit(&csi_capture_cycles,
+                            esp_cpu_get_cycle_count() - start,
+                            memory_order_relaxed);
 }
 
 //------------------------------------------------------CSI Processing &
 // Algorithms------------------------------------------------------
-static void csi_process(const int8_t *csi_data, int length) {
-  if (CSI_Q_INDEX + length > CSI_BUFFER_LENGTH) {
-    int shift_size = CSI_BUFFER_LENGTH - CSI_FIFO_LENGTH;
-    memmove(CSI_Q, CSI_Q + CSI_FIFO_LENGTH, shift_size * sizeof(int16_t));
-    CSI_Q_INDEX = shift_size;
+// Analysis stages for one frame of `link`, called from the analysis task
+static void csi_process(csi_link_t *link, const csi_ring_slot_t *frame) {
+  uint32_t start = esp_cpu_get_cycle_count();
+  if (startup.first_frame == 0)
+    startup.first_frame = esp_timer_get_time();
+  // The analysis stages see every layout as the same primary-channel band
+  const csi_layout_t *layout = csi_layout_get(frame->layout);
+  int8_t band_buf[CSI_LAYOUT_BAND_LEN];
+  const int8_t *band = NULL;
+  if (layout->band) {
+    layout->band(frame->data, frame->first_word_invalid, band_buf);
+    band = band_buf;
+  } else {
+    csi_stats.unknown_layout++;
   }
-  // ESP_LOGI(TAG, "CSI Buffer Status: %d samples stored", CSI_Q_INDEX);
-  // Append new CSI data to the buffer
-  for (int i = 0; i < length && CSI_Q_INDEX < CSI_BUFFER_LENGTH; i++) {
-    CSI_Q[CSI_Q_INDEX++] = (int16_t)csi_data[i];
+  motion_detection(link, frame, band);
+#if CONFIG_GAIN_CONTROL
+  gain_calibration(link, frame->agc_gain, frame->fft_gain);
+#endif
+  uint32_t motion_done = esp_cpu_get_cycle_count();
+  csi_stats.motion_cycles += motion_done - start;
+
+#if CSI_ONBOARD_BR || CSI_STREAM_ENABLED
+  if (band && link == &links[0]) {
+#if CSI_ADAPTIVE_BAND
+    if (sc_rank_push(&sc_rank, band)) {
+      breathing_select(sc_rank.selected, SC_RANK_K);
+      ESP_LOGI(TAG, "breathing subcarriers now %u..%u, re-rank %" PRIu32,
+               sc_rank.selected[0], sc_rank.selected[SC_RANK_K - 1],
+               sc_rank.reranks);
+    }
+#endif
+    int32_t diff = breathing_push(band, CSI_LAYOUT_BAND_LEN);
+#if CSI_STREAM_ENABLED
+    csi_stream_push(&csi_stream, diff, band);
+#else
+    (void)diff;
+#endif
   }
+#endif
+  csi_stats.breathing_cycles += esp_cpu_get_cycle_count() - motion_done;
+  csi_stats.frames++;
+
+  if (frame->probe)
+    probe_stats_push(&link->probe_stats, frame->probe_seq,
+                     frame->probe_tx_us, frame->timestamp);
 
   // [4] YOUR CODE HERE
 
@@ -528,6 +871,176 @@ static void csi_process(const int8_t *csi_data, int length) {
   // [4] END YOUR CODE HERE
 }
 
+// Frames the CSI callback found a link's ring full for, over all links
+static unsigned csi_q_dropped(void) {
+  unsigned dropped = 0;
+  for (int i = 0; i < CSI_LINKS; i++) {
+    dropped += atomic_load(&links[i].pub.q.dropped);
+  }
+  return dropped;
+}
+
+static void csi_log_stats(void) {
+  uint32_t frames = csi_stats.frames ? csi_stats.frames : 1;
+  uint32_t publishes = csi_stats.publishes ? csi_stats.publishes : 1;
+  uint32_t capture_cycles =
+      atomic_exchange_explicit(&csi_capture_cycles, 0, memory_order_relaxed);
+  unsigned high_water = 0;
+  for (int i = 0; i < CSI_LINKS; i++) {
+    if (links[i].pub.q.high_water > high_water)
+      high_water = links[i].pub.q.high_water;
+  }
+  EventBits_t bits = xEventGroupGetBits(net_events);
+  ESP_LOGI(TAG,
+           "frames %" PRIu32 ", dropped %u, foreign %" PRIu32
+           ", links %u/%d (rejected %" PRIu32 "), unknown layout %" PRIu32
+           ", queue high-water %u/%d, serial dropped %u, backlog %" PRIu32
+           " (high-water %" PRIu32 ", dropped %" PRIu32 "), Wi-Fi %s, MQTT %s",
+           csi_stats.frames, csi_q_dropped(), link_table.foreign,
+           link_table.count, CSI_LINKS, link_table.rejected,
+           csi_stats.unknown_layout, high_water, CSI_RING_FRAMES,
+           csi_serial_dropped(), publisher.backlog.count,
+           publisher.backlog.high_water, publisher.backlog.dropped,
+           bits & NET_WIFI_UP_BIT ? "up" : "down",
+           bits & NET_MQTT_UP_BIT ? "up" : "down");
+  const publish_sched_t *p = &publisher.sched;
+  ESP_LOGI(TAG,
+           "publish level %s, outbox %" PRIu32 " B (peak %" PRIu32
+           "), free heap min %" PRIu32 " B, ticks normal/batch/qos0/"
+           "decimated/hold %" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32
+           "/%" PRIu32 ", oversize %" PRIu32,
+           publish_sched_level_name(p->level), p->outbox_bytes, p->outbox_peak,
+           p->heap_min, p->level_ticks[0], p->level_ticks[1],
+           p->level_ticks[2], p->level_ticks[3], p->level_ticks[4],
+           p->oversize);
+#if CSI_TRANSPORT == CSI_TRANSPORT_UDP
+  ESP_LOGI(TAG,
+           "udp: %" PRIu32 " messages, %" PRIu32 " repeats, %" PRIu32
+           " send errors",
+           csi_udp.sent, csi_udp.repeated, udp_send_errors);
+#endif
+  ESP_LOGI(TAG,
+           "cycles/frame: capture %" PRIu32 ", motion %" PRIu32
+           ", breathing %" PRIu32 "; cycles/publish %" PRIu32,
+           capture_cycles / frames, csi_stats.motion_cycles / frames,
+           csi_stats.breathing_cycles / frames,
+           csi_stats.publish_cycles / publishes);
+  memset(&csi_stats, 0, sizeof(csi_stats));
+}
+
+static void csi_reset_period(void) {
+  for (int i = 0; i < CSI_LINKS; i++) {
+    probe_stats_reset_period(&links[i].probe_stats);
+  }
+  publish_sched_reset_period(&publisher.sched);
+}
+
+// Probe loss and jitter over the last stats period, logged and published on
+// csi/telemetry. The top-level probe figures are link 0's, "links" has them
+// for every link
+static void csi_send_telemetry(void) {
+  int count = link_table.count;
+  char link_json[CSI_LINKS * 112 + 1] = "";
+  size_t n = 0;
+  for (int i = 0; i < count; i++) {
+    const csi_link_t *link = &links[i];
+    const probe_stats_t *s = &link->probe_stats;
+    ESP_LOGI(TAG,
+             "link %02x probes: received %u, lost %u (%.2f%%), duplicates "
+             "%u, reordered %u, jitter %.0f us, max interval %" PRIu32 " us",
+             link->pub.id, s->received, s->lost, probe_stats_loss_rate(s) * 100,
+             s->duplicates, s->reordered, s->jitter_us, s->max_interval_us);
+    n += snprintf(link_json + n, sizeof(link_json) - n,
+                  "%s{\"id\":%u,\"received\":%u,\"lost\":%u,"
+                  "\"jitter_us\":%.1f,\"queue_dropped\":%u}",
+                  i ? "," : "", link->pub.id, s->received, s->lost,
+                  s->jitter_us, atomic_load(&link->pub.q.dropped));
+    if (n >= sizeof(link_json))
+      n = sizeof(link_json) - 1;
+  }
+
+  // Telemetry of a period without a broker is dropped
+  const probe_stats_t *s = &links[0].probe_stats;
+  const publish_sched_t *p = &publisher.sched;
+  if (!mqtt_up()) {
+    csi_reset_period();
+    return;
+  }
+  char payload[768 + sizeof(link_json)];
+  int len = snprintf(
+      payload, sizeof(payload),
+      "{\"received\":%u,\"lost\":%u,\"loss_rate\":%.4f,\"duplicates\":%u,"
+      "\"reordered\":%u,\"restarts\":%u,\"jitter_us\":%.1f,"
+      "\"max_interval_us\":%" PRIu32 ",\"gaps\":[%u,%u,%u,%u,%u,%u],"
+      "\"queue_dropped\":%u,\"backlog\":%" PRIu32
+      ",\"backlog_dropped\":%" PRIu32 ",\"reconnects\":%" PRIu32
+      ",\"startup_ms\":{\"radio\":%" PRId64 ",\"first_frame\":%" PRId64
+      ",\"ip\":%" PRId64 ",\"mqtt\":%" PRId64 ",\"first_publish\":%" PRId64
+      "},\"publish\":{\"level\":\"%s\",\"outbox\":%" PRIu32
+      ",\"outbox_peak\":%" PRIu32 ",\"heap_min\":%" PRIu32
+      ",\"transitions\":%" PRIu32 ",\"oversize\":%" PRIu32
+      ",\"ticks\":[%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32
+      "]},\"links\":[%s],\"link_rejected\":%" PRIu32 "}",
+      s->received, s->lost, probe_stats_loss_rate(s), s->duplicates,
+      s->reordered, s->restarts, s->jitter_us, s->max_interval_us, s->gaps[0],
+      s->gaps[1], s->gaps[2], s->gaps[3], s->gaps[4], s->gaps[5],
+      csi_q_dropped(), publisher.backlog.count, publisher.backlog.dropped,
+      mqtt_reconnects, startup.radio / 1000, startup.first_frame / 1000,
+      startup.got_ip / 1000, startup.mqtt / 1000, startup.first_publish / 1000,
+      publish_sched_level_name(p->level), p->outbox_bytes, p->outbox_peak,
+      p->heap_min, p->transitions, p->oversize, p->level_ticks[0],
+      p->level_ticks[1], p->level_ticks[2], p->level_ticks[3],
+      p->level_ticks[4], link_json, link_table.rejected);
+  // Sent at every level, it is how a pressure level is seen from outside
+  if (esp_mqtt_client_enqueue(mqtt_client, mqtt_telemetry_topic, payload, len,
+                              0, 0, true) < 0)
+    ESP_LOGW("MQTT", "Telemetry send failed");
+  csi_reset_period();
+}
+
+// Pipeline: analyse every new frame as soon as the callback signals it, then
+// publish the analysed frames every MQTT_FREQ us
+static void csi_analysis_task(void *arg) {
+  int64_t next_publish = esp_timer_get_time() + MQTT_FREQ;
+  int64_t next_stats = esp_timer_get_time() + CSI_STATS_PERIOD_US;
+
+  while (true) {
+    int64_t now = esp_timer_get_time();
+    TickType_t wait = 1;
+    if (next_publish - now > 1000 * portTICK_PERIOD_MS)
+      wait = pdMS_TO_TICKS((next_publish - now) / 1000);
+    ulTaskNotifyTake(pdTRUE, wait);
+
+    for (int i = 0; i < CSI_LINKS; i++) {
+      csi_link_t *link = &links[i];
+      const csi_ring_slot_t *frame;
+      while ((frame = csi_ring_peek(&link->pub.q, link->pub.analysed)) !=
+             NULL) {
+        csi_process(link, frame);
+        link->pub.analysed++;
+      }
+    }
+
+    now = esp_timer_get_time();
+    if (now >= next_publish) {
+      next_publish += MQTT_FREQ;
+      if (next_publish <= now)
+        next_publish = now + MQTT_FREQ;
+
+      uint32_t start = esp_cpu_get_cycle_count();
+      mqtt_send();
+      csi_stats.publish_cycles += esp_cpu_get_cycle_count() - start;
+      csi_stats.publishes++;
+    }
+
+    if (now >= next_stats) {
+      next_stats += CSI_STATS_PERIOD_US;
+      csi_log_stats();
+      csi_send_telemetry();
+    }
+  }
+}
+
 //------------------------------------------------------CSI Config
 // Initialize------------------------------------------------------
 static void wifi_csi_init() {
@@ -562,51 +1075,75 @@ void app_main() {
   }
   ESP_ERROR_CHECK(ret);
 
+  // Boot-time benches, built in with the switch in their header
+#if CSI_DSP_BENCH
+  if (csi_dsp_bench_run(100) != 0)
+    ESP_LOGW(TAG, "csi_dsp kernels outside their error bounds");
+#endif
+#if CSI_LINK_BENCH
+  if (csi_link_bench_run(1000) != 0)
+    ESP_LOGW(TAG, "csi_link bench skipped link counts, out of memory");
+#endif
+
+  // csi_send boards differ in the last MAC byte, see CONFIG_CSI_SEND_ID
+  csi_link_init(&link_table, CSI_LINKS, CONFIG_CSI_SEND_MAC,
+                CSI_LINK_MASK_ALL & ~0xFFull);
+  for (int i = 0; i < CSI_LINKS; i++) {
+    csi_publish_link_init(&links[i].pub, 0);
+    probe_stats_init(&links[i].probe_stats);
+  }
+  breathing_init();
+  sc_rank_init(&sc_rank);
+#if CSI_STREAM_ENABLED
+  csi_stream_init(&csi_stream, CSI_DECIM_FACTOR, BR_FS);
+#endif
+  csi_publish_config_t publish_config = {
+      .mode = CSI_PUBLISH == CSI_PUBLISH_RAW ? CSI_PUBLISH_MODE_RAW
+              : CSI_PUBLISH == CSI_PUBLISH_DECIMATED
+                  ? CSI_PUBLISH_MODE_DECIMATED
+                  : CSI_PUBLISH_MODE_NONE,
+      .format = !CSI_MQTT_BINARY ? CSI_PUBLISH_FORMAT_TEXT
+                : CSI_MQTT_CODED ? CSI_PUBLISH_FORMAT_CODED
+                                 : CSI_PUBLISH_FORMAT_BINARY,
+#if CSI_STREAM_ENABLED
+      .stream = &csi_stream,
+#endif
+      .stream_samples = CSI_DECIM_SEND_SAMPLES,
+      .subcarriers = sc_rank.selected,
+      .subcarrier_count = SC_RANK_K,
+      .max_message = MQTT_OUT_SIZE - MQTT_PUBLISH_OVERHEAD,
+      .backlog_buf = backlog_buf,
+      .backlog_size = sizeof(backlog_buf),
+      .backlog_flush = CSI_BACKLOG_FLUSH,
+      .transport = {.enqueue = data_enqueue,
+                    .outbox_size = data_outbox_size},
+  };
+  csi_publish_init(&publisher, &publish_config);
+  net_events = xEventGroupCreate();
   wifi_init();
 
   uint8_t mac[6];
   esp_wifi_get_mac(WIFI_IF_STA, mac);
   ESP_LOGI(TAG, "Device MAC Address: " MACSTR, MAC2STR(mac));
 
-  ESP_LOGI(TAG, "Connecting to WiFi...");
-
-  int retry_count = 0;
-  bool wifi_connected = false;
-  while (!wifi_connected && retry_count < 20) {
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    retry_count++;
-    ESP_LOGI(TAG, "Waiting for Wi-Fi connection... (%d/20)", retry_count);
-
-    wifi_ap_record_t ap_info;
-    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
-      ESP_LOGI(TAG, "Connected to SSID: %s, RSSI: %d, Channel: %d",
-               ap_info.ssid, ap_info.rssi, ap_info.primary);
-      wifi_connected = true;
-    }
-  }
+  // Created before the radio starts, wifi_event_handler() starts it
+  mqtt_init();
+#if CSI_TRANSPORT == CSI_TRANSPORT_UDP
+  udp_init();
+#endif
 
-  if (!wifi_connected) {
-    ESP_LOGW(TAG, "Wi-Fi connection failed after 20 attempts");
-    return;
-  } else {
-    ESP_LOGI(TAG, "Wi-Fi connected successfully!");
-  }
+  xTaskCreate(csi_analysis_task, "csi_analysis", CSI_TASK_STACK_SIZE, NULL,
+              CSI_TASK_PRIORITY, &csi_task);
 
-  mqtt_init(); // Initialize MQTT Client
+  if (!CSI_Q_ENABLE && CSI_SERIAL_BINARY)
+    csi_serial_start();
 
-  while (!mqtt_connected) {
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    ESP_LOGI(TAG, "Waiting for MQTT connection...");
-  }
-
-  if (!mqtt_connected) {
-    ESP_LOGW(TAG, "MQTT connection failed.");
-    return;
-  } else {
-    ESP_LOGI(TAG, "MQTT connected successfully!");
-  }
+  // Capture starts with the radio. Wi-Fi and MQTT connect in the background,
+  // csi/data messages wait in the backlog until the broker is reachable
+  ESP_ERROR_CHECK(esp_wifi_start());
+  startup.radio = esp_timer_get_time();
+  ESP_LOGI(TAG, "Connecting to WiFi...");
 
-  // send CSI data to mqtt
   esp_now_peer_info_t peer = {
       .channel = CONFIG_LESS_INTERFERENCE_CHANNEL,
       .ifidx = WIFI_IF_STA,
@@ -615,12 +1152,5 @@ void app_main() {
   };
 
   wifi_esp_now_init(peer); // Initialize ESP-NOW Communication
-
-  const esp_timer_create_args_t timer_args = {.callback = &timer_callback,
-                                              .name = "mqtt_timer"};
-  esp_timer_handle_t timer;
-  ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer));
-  ESP_ERROR_CHECK(esp_timer_start_periodic(timer, MQTT_FREQ));
-
-  wifi_csi_init(); // Initialize CSI Collection
+  wifi_csi_init();         // Initialize CSI Collection
 }
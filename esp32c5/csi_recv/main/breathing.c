@@ -0,0 +1,441 @@
+#include "breathing.h"
+#include "csi_dsp.h"
+#include "csi_layout.h"
+
+#include <math.h>
+#include <string.h>
+
+#define BR_N (BR_WINDOW - 1)       // samples left after the first difference
+#define BR_SG_LEN 200              // savgol_filter(s_t, 200, 4)
+#define BR_SG_ORDER 4
+#define BR_HAMPEL_HALF 5           // hampel(window_size=10)
+#define BR_HAMPEL_SIGMA 3.0f
+#define BR_SOS_SECTIONS 3          // butter(3, [0.15, 0.5], "band", fs=100)
+#define BR_PAD (3 * (2 * BR_SOS_SECTIONS + 1)) // sosfiltfilt default padlen
+#define BR_FFT_LOG2 12
+#define BR_FFT_SIZE (1 << BR_FFT_LOG2) // >= 2 * BR_N - 1, no circular wrap
+#define BR_PEAK_HEIGHT 0.01f
+#define BR_PEAK_PROMINENCE 0.05f
+#define BR_PEAK_REFINE 8 // lags searched around a peak of the Q15 ACF
+#define BR_MIN_BPM 8.0f
+#define BR_MAX_BPM 25.0f
+
+_Static_assert(BR_FFT_SIZE >= 2 * BR_N - 1, "FFT too short for the ACF");
+
+// b0, b1, b2, a1, a2 per section, from scipy.signal.butter(output="sos")
+static float br_sos[BR_SOS_SECTIONS][5] = {
+    {1.3006349890880354e-06f, 2.6012699781760708e-06f, 1.3006349890880354e-06f,
+     -1.9779542874002389f, 0.97824715973025067f},
+    {1.0f, 0.0f, -1.0f, -1.9827743278082059f, 0.98365308932212403f},
+    {1.0f, -2.0f, 1.0f, -1.9944082065182183f, 0.99450687607191013f},
+};
+
+// |difference of the complex mean of the selected subcarriers| per frame,
+// in raw CSI units, circular. Kept in float: rounding to 1/128 of a unit
+// moved the ACF peaks of quiet links by a few lags against get_br()
+static float br_diff[BR_N];
+static int br_head = 0;
+static int br_count = 0;
+
+// Selected band view positions, and the previous frame for the next
+// difference
+static uint8_t br_index[CSI_LAYOUT_BAND_SUBCARRIERS];
+static size_t br_index_len = 0;
+static int8_t br_prev[CSI_LAYOUT_BAND_LEN];
+static int32_t br_prev_re, br_prev_im;
+static bool br_have_prev = false;
+
+// Working buffers for one estimate
+static float br_sig[BR_N + 2 * BR_PAD];
+static float br_tmp[BR_N + 2 * BR_PAD];
+static q15_t br_acf_in[BR_N];
+static q15_t br_fft[2 * BR_FFT_SIZE];
+
+// Savitzky-Golay smoothing taps and the inverse normal matrix for edge fits
+static float br_sg_coef[BR_SG_LEN];
+static double br_sg_ginv[BR_SG_ORDER + 1][BR_SG_ORDER + 1];
+
+//------------------------------------------------------DSP
+// Primitives------------------------------------------------------
+#ifdef ESP_PLATFORM
+#include "esp_dsp.h"
+
+static void dsp_biquad(const float *in, float *out, int len, float *coef,
+                       float *w) {
+  dsps_biquad_f32(in, out, len, coef, w);
+}
+
+static float dsp_dot(const float *a, const float *b, int len) {
+  float r = 0;
+  dsps_dotprod_f32(a, b, &r, len);
+  return r;
+}
+#else
+// Reference versions with the same semantics as the esp-dsp calls above
+
+// Direct form II, as dsps_biquad_f32
+static void dsp_biquad(const float *in, float *out, int len, float *coef,
+                       float *w) {
+  for (int i = 0; i < len; i++) {
+    float d0 = in[i] - coef[3] * w[0] - coef[4] * w[1];
+    out[i] = coef[0] * d0 + coef[1] * w[0] + coef[2] * w[1];
+    w[1] = w[0];
+    w[0] = d0;
+  }
+}
+
+static float dsp_dot(const float *a, const float *b, int len) {
+  float r = 0;
+  for (int i = 0; i < len; i++) {
+    r += a[i] * b[i];
+  }
+  return r;
+}
+#endif
+
+//------------------------------------------------------Window
+// Buffer------------------------------------------------------
+void breathing_init(void) {
+  br_head = 0;
+  br_count = 0;
+  br_have_prev = false;
+  br_index_len = BR_SC_LAST - BR_SC_FIRST;
+  for (size_t i = 0; i < br_index_len; i++) {
+    br_index[i] = (uint8_t)(BR_SC_FIRST + i);
+  }
+  csi_dsp_fft_init();
+
+  // Least-squares polynomial fit over x = j - (L - 1) / 2, scaled to [-1, 1]
+  // to keep the normal matrix well conditioned
+  const int n = BR_SG_ORDER + 1;
+  const double half = (BR_SG_LEN - 1) / 2.0;
+  double g[BR_SG_ORDER + 1][2 * (BR_SG_ORDER + 1)] = {0};
+  for (int j = 0; j < BR_SG_LEN; j++) {
+    double x = (j - half) / half;
+    double p = 1;
+    double pw[2 * BR_SG_ORDER + 1];
+    for (int k = 0; k <= 2 * BR_SG_ORDER; k++, p *= x) {
+      pw[k] = p;
+    }
+    for (int r = 0; r < n; r++) {
+      for (int c = 0; c < n; c++) {
+        g[r][c] += pw[r + c];
+      }
+    }
+  }
+  for (int r = 0; r < n; r++) {
+    g[r][n + r] = 1;
+  }
+  // Gauss-Jordan with partial pivoting
+  for (int c = 0; c < n; c++) {
+    int piv = c;
+    for (int r = c + 1; r < n; r++) {
+      if (fabs(g[r][c]) > fabs(g[piv][c]))
+        piv = r;
+    }
+    for (int k = 0; k < 2 * n; k++) {
+      double t = g[c][k];
+      g[c][k] = g[piv][k];
+      g[piv][k] = t;
+    }
+    double d = g[c][c];
+    for (int k = 0; k < 2 * n; k++) {
+      g[c][k] /= d;
+    }
+    for (int r = 0; r < n; r++) {
+      if (r == c)
+        continue;
+      double f = g[r][c];
+      for (int k = 0; k < 2 * n; k++) {
+        g[r][k] -= f * g[c][k];
+      }
+    }
+  }
+  for (int r = 0; r < n; r++) {
+    for (int c = 0; c < n; c++) {
+      br_sg_ginv[r][c] = g[r][n + c];
+    }
+  }
+  for (int j = 0; j < BR_SG_LEN; j++) {
+    double x = (j - half) / half;
+    double p = 1, c = 0;
+    for (int k = 0; k < n; k++, p *= x) {
+      c += br_sg_ginv[0][k] * p;
+    }
+    br_sg_coef[j] = (float)c;
+  }
+}
+
+// Sums of the selected subcarriers, exact, so the mean is only rounded
+// once in the difference
+static void index_sum(const int8_t *iq, int32_t *re, int32_t *im) {
+  int32_t sum_re = 0, sum_im = 0;
+  for (size_t i = 0; i < br_index_len; i++) {
+    sum_im += iq[2 * br_index[i]];
+    sum_re += iq[2 * br_index[i] + 1];
+  }
+  *re = sum_re;
+  *im = sum_im;
+}
+
+void breathing_select(const uint8_t *index, size_t n) {
+  if (n == 0 || n > CSI_LAYOUT_BAND_SUBCARRIERS)
+    return;
+  memcpy(br_index, index, n);
+  br_index_len = n;
+  // The next difference is taken against the previous frame seen through
+  // the new selection, so the signal has no step at the switch
+  if (br_have_prev)
+    index_sum(br_prev, &br_prev_re, &br_prev_im);
+}
+
+int32_t breathing_push(const int8_t *iq, size_t len) {
+  if (len < CSI_LAYOUT_BAND_LEN)
+    return -1;
+
+  int32_t re, im;
+  int32_t diff = -1;
+  index_sum(iq, &re, &im);
+  if (br_have_prev) {
+    float d = hypotf((float)(re - br_prev_re), (float)(im - br_prev_im)) /
+              (float)br_index_len;
+    br_diff[br_head] = d;
+    diff = (int32_t)lrintf(d * 128);
+    br_head = (br_head + 1) % BR_N;
+    if (br_count < BR_N)
+      br_count++;
+  }
+  memcpy(br_prev, iq, CSI_LAYOUT_BAND_LEN);
+  br_prev_re = re;
+  br_prev_im = im;
+  br_have_prev = true;
+  return diff;
+}
+
+bool breathing_ready(void) { return br_count == BR_N; }
+
+//------------------------------------------------------Pipeline
+// Stages------------------------------------------------------
+static void detrend(float *s, int n) {
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (int i = 0; i < n; i++) {
+    sx += i;
+    sy += s[i];
+    sxx += (double)i * i;
+    sxy += (double)i * s[i];
+  }
+  double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+  double offset = (sy - slope * sx) / n;
+  for (int i = 0; i < n; i++) {
+    s[i] -= (float)(offset + slope * i);
+  }
+}
+
+// Evaluate the order-4 fit of s[0, BR_SG_LEN) at window positions [from, to)
+static void savgol_edge(const float *s, float *out, int from, int to) {
+  const double half = (BR_SG_LEN - 1) / 2.0;
+  double aty[BR_SG_ORDER + 1] = {0};
+  for (int j = 0; j < BR_SG_LEN; j++) {
+    double x = (j - half) / half, p = 1;
+    for (int k = 0; k <= BR_SG_ORDER; k++, p *= x) {
+      aty[k] += p * s[j];
+    }
+  }
+  double beta[BR_SG_ORDER + 1] = {0};
+  for (int r = 0; r <= BR_SG_ORDER; r++) {
+    for (int c = 0; c <= BR_SG_ORDER; c++) {
+      beta[r] += br_sg_ginv[r][c] * aty[c];
+    }
+  }
+  for (int j = from; j < to; j++) {
+    double x = (j - half) / half, p = 1, y = 0;
+    for (int k = 0; k <= BR_SG_ORDER; k++, p *= x) {
+      y += beta[k] * p;
+    }
+    out[j] = (float)y;
+  }
+}
+
+// savgol_filter(mode="interp"): sliding fit inside, one polynomial per edge.
+// scipy fits window_length / 2 samples at each edge, which for an even
+// window is one more on the left than the sliding fit leaves out
+static void savgol(const float *s, float *out, int n) {
+  const int left = (BR_SG_LEN - 1) / 2;
+  for (int i = left + 1; i + BR_SG_LEN - left <= n; i++) {
+    out[i] = dsp_dot(&s[i - left], br_sg_coef, BR_SG_LEN);
+  }
+  savgol_edge(s, out, 0, BR_SG_LEN / 2);
+  savgol_edge(&s[n - BR_SG_LEN], &out[n - BR_SG_LEN], BR_SG_LEN / 2,
+              BR_SG_LEN);
+}
+
+static float median(float *v, int n) {
+  for (int i = 1; i < n; i++) {
+    float t = v[i];
+    int j = i;
+    for (; j > 0 && v[j - 1] > t; j--) {
+      v[j] = v[j - 1];
+    }
+    v[j] = t;
+  }
+  return v[n / 2];
+}
+
+static void hampel(const float *s, float *out, int n) {
+  float win[2 * BR_HAMPEL_HALF + 1];
+  memcpy(out, s, n * sizeof(float));
+  for (int i = BR_HAMPEL_HALF; i < n - BR_HAMPEL_HALF; i++) {
+    memcpy(win, &s[i - BR_HAMPEL_HALF], sizeof(win));
+    float med = median(win, 2 * BR_HAMPEL_HALF + 1);
+    for (int k = 0; k < 2 * BR_HAMPEL_HALF + 1; k++) {
+      win[k] = fabsf(s[i - BR_HAMPEL_HALF + k] - med);
+    }
+    float mad = median(win, 2 * BR_HAMPEL_HALF + 1);
+    if (fabsf(s[i] - med) > BR_HAMPEL_SIGMA * 1.4826f * mad)
+      out[i] = med;
+  }
+}
+
+// One pass of the cascade, started in steady state for a constant input x0
+static void sos_pass(float *s, int n) {
+  float x0 = s[0];
+  for (int k = 0; k < BR_SOS_SECTIONS; k++) {
+    float *c = br_sos[k];
+    float d = x0 / (1 + c[3] + c[4]);
+    float w[2] = {d, d};
+    x0 *= (c[0] + c[1] + c[2]) / (1 + c[3] + c[4]);
+    dsp_biquad(s, s, n, c, w);
+  }
+}
+
+static void reverse(float *s, int n) {
+  for (int i = 0, j = n - 1; i < j; i++, j--) {
+    float t = s[i];
+    s[i] = s[j];
+    s[j] = t;
+  }
+}
+
+// sosfiltfilt: odd extension by BR_PAD, forward pass, backward pass
+static void filtfilt(const float *s, float *out, int n) {
+  float *ext = out;
+  for (int i = 0; i < BR_PAD; i++) {
+    ext[i] = 2 * s[0] - s[BR_PAD - i];
+    ext[BR_PAD + n + i] = 2 * s[n - 1] - s[n - 2 - i];
+  }
+  memcpy(&ext[BR_PAD], s, n * sizeof(float));
+
+  int len = n + 2 * BR_PAD;
+  sos_pass(ext, len);
+  reverse(ext, len);
+  sos_pass(ext, len);
+  reverse(ext, len);
+  memmove(out, &ext[BR_PAD], n * sizeof(float));
+}
+
+// Autocorrelation for lags [0, n) via |FFT|^2, normalised to acf[0] = 1. The
+// FFTs run in Q15 (csi_dsp.h), within 0.01 of the float result.
+static void autocorr(const float *s, float *acf, int n) {
+  float peak = 0;
+  for (int i = 0; i < n; i++) {
+    if (fabsf(s[i]) > peak)
+      peak = fabsf(s[i]);
+  }
+  float scale = peak > 0 ? 16384 / peak : 0;
+  for (int i = 0; i < n; i++) {
+    br_acf_in[i] = (q15_t)lrintf(s[i] * scale);
+  }
+  // br_acf_in is free again once the first FFT has run, reuse it for the lags
+  csi_dsp_autocorr_q15(br_acf_in, br_acf_in, n, br_fft, BR_FFT_LOG2);
+  for (int i = 0; i < n; i++) {
+    acf[i] = br_acf_in[i] / 32768.0f;
+  }
+}
+
+static float prominence(const float *x, int n, int peak) {
+  float left_min = x[peak], right_min = x[peak];
+  for (int i = peak - 1; i >= 0 && x[i] <= x[peak]; i--) {
+    if (x[i] < left_min)
+      left_min = x[i];
+  }
+  for (int i = peak + 1; i < n && x[i] <= x[peak]; i++) {
+    if (x[i] < right_min)
+      right_min = x[i];
+  }
+  return x[peak] - (left_min > right_min ? left_min : right_min);
+}
+
+// Lag of the largest float ACF of `s` within BR_PEAK_REFINE of `lag`. The
+// Q15 ACF is rounded to about 1e-4, so the tops of its peaks are plateaus
+// a few lags wide, which shift a peak or split it in two.
+static int refine_peak(const float *s, int n, int lag) {
+  int from = lag > BR_PEAK_REFINE ? lag - BR_PEAK_REFINE : 1;
+  int to = lag + BR_PEAK_REFINE < n - 1 ? lag + BR_PEAK_REFINE : n - 2;
+  int best = lag;
+  float best_acf = -INFINITY;
+  for (int k = from; k <= to; k++) {
+    float acf = dsp_dot(s, &s[k], n - k);
+    if (acf > best_acf) {
+      best_acf = acf;
+      best = k;
+    }
+  }
+  return best;
+}
+
+// find_peaks(height=0.01, prominence=0.05) on the ACF `x` of `s`, first
+// `max_peaks` lags only, each refined on `s`
+static int find_peaks(const float *x, const float *s, int n, int *peaks,
+                      int max_peaks) {
+  int found = 0;
+  int i = 1;
+  while (i < n - 1 && found < max_peaks) {
+    if (x[i - 1] < x[i]) {
+      // Plateaus count once, at their middle
+      int ahead = i + 1;
+      while (ahead < n - 1 && x[ahead] == x[i]) {
+        ahead++;
+      }
+      if (x[ahead] < x[i]) {
+        int peak = (i + ahead - 1) / 2;
+        if (x[peak] >= BR_PEAK_HEIGHT &&
+            prominence(x, n, peak) >= BR_PEAK_PROMINENCE) {
+          // Both halves of a split peak refine to the same lag
+          int lag = refine_peak(s, n, peak);
+          if (found == 0 || lag > peaks[found - 1])
+            peaks[found++] = lag;
+        }
+        i = ahead;
+      }
+    }
+    i++;
+  }
+  return found;
+}
+
+float breathing_estimate(void) {
+  if (!breathing_ready())
+    return BR_DEFAULT_BPM;
+
+  // np.abs(np.diff(mean subcarrier band)) in chronological order, in the
+  // int8 units of the raw CSI
+  for (int i = 0; i < BR_N; i++) {
+    br_sig[i] = br_diff[(br_head + i) % BR_N];
+  }
+
+  detrend(br_sig, BR_N);
+  savgol(br_sig, br_tmp, BR_N);
+  hampel(br_tmp, br_sig, BR_N);
+  filtfilt(br_sig, br_tmp, BR_N);
+  autocorr(br_tmp, br_sig, BR_N);
+
+  int peaks[2];
+  int found = find_peaks(br_sig, br_tmp, BR_N, peaks, 2);
+  if (found == 0)
+    return BR_DEFAULT_BPM;
+
+  float br = (float)BR_FS / peaks[0] * 60;
+  if (br < BR_MIN_BPM || br > BR_MAX_BPM)
+    br = found > 1 ? (float)BR_FS / peaks[1] * 60 : BR_DEFAULT_BPM;
+  return br;
+}
@@ -0,0 +1,68 @@
+/* On-device breathing rate estimation
+
+   Port of backend/breathing.py:get_br(). Frames arrive as band views
+   (csi_layout.h), so every layout measures the same subcarriers. Each one
+   is reduced on arrival to the complex mean of the selected subcarriers,
+   [BR_SC_FIRST, BR_SC_LAST) unless breathing_select() (sc_rank.h) picked
+   others, and the magnitude of its first difference is stored. The 15 s
+   analysis window costs 6 KB instead of the raw CSI. An estimate runs:
+   linear detrend, Savitzky-Golay smoothing, Hampel outlier rejection,
+   zero-phase 0.15-0.5 Hz Butterworth band-pass and an FFT autocorrelation
+   with the same peak picking as get_br().
+
+   The autocorrelation FFTs run in Q15 (csi_dsp.h). The window stays in
+   float, as rounding it shifts the autocorrelation peak of quiet links. On
+   the device the biquads and dot products go through esp-dsp; on any other
+   host a plain C reference of the same calls is used, so the pipeline can
+   be checked against the Python implementation: host/breathing_replay runs
+   it over a trace and `csi_trace.py br-check` compares it with get_br().
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BR_FS 100
+#define BR_WINDOW (15 * BR_FS)
+// Band view positions of subcarriers -8..1, HT20 subcarriers 20-29
+#define BR_SC_FIRST 18
+#define BR_SC_LAST 28
+// Returned when no plausible autocorrelation peak is found, as in get_br()
+#define BR_DEFAULT_BPM 15.0f
+
+/**
+ * @brief Reset the window and prepare the DSP tables
+ */
+void breathing_init(void);
+
+/**
+ * @brief Average band view positions `index[0, n)` from the next frame on
+ */
+void breathing_select(const uint8_t *index, size_t n);
+
+/**
+ * @brief Add one frame's band view (interleaved int8 imag/real pairs)
+ * @return the difference added to the window, in 1/128 of a raw CSI unit,
+ *         or -1 if the frame only starts the signal or is too short
+ */
+int32_t breathing_push(const int8_t *iq, size_t len);
+
+/**
+ * @brief True once a full BR_WINDOW of frames has been pushed
+ */
+bool breathing_ready(void);
+
+/**
+ * @brief Estimate the breathing rate over the last BR_WINDOW frames
+ * @return breathing rate in BPM, BR_DEFAULT_BPM if no peak is found
+ */
+float breathing_estimate(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,83 @@
+#include "csi_backlog.h"
+
+#include <string.h>
+
+#define LEN_SIZE 2
+// Length of a skip marker, the rest of the buffer holds no message
+#define SKIP 0xFFFF
+
+static void put_len(uint8_t *p, size_t len) {
+  p[0] = (uint8_t)len;
+  p[1] = (uint8_t)(len >> 8);
+}
+
+static size_t get_len(const uint8_t *p) { return p[0] | (size_t)p[1] << 8; }
+
+void csi_backlog_init(csi_backlog_t *b, uint8_t *buf, size_t cap) {
+  memset(b, 0, sizeof(*b));
+  b->buf = buf;
+  b->cap = cap;
+}
+
+const uint8_t *csi_backlog_front(csi_backlog_t *b, size_t *len) {
+  if (b->count == 0)
+    return NULL;
+  *len = get_len(b->buf + b->tail);
+  return b->buf + b->tail + LEN_SIZE;
+}
+
+void csi_backlog_pop(csi_backlog_t *b) {
+  if (b->count == 0)
+    return;
+  size_t size = LEN_SIZE + get_len(b->buf + b->tail);
+  b->tail += size;
+  b->used -= size;
+  if (--b->count == 0) {
+    b->head = b->tail = b->used = 0;
+    return;
+  }
+  // Keep the tail on a message: move it over skipped bytes at the end
+  size_t rest = b->cap - b->tail;
+  if (rest < LEN_SIZE || get_len(b->buf + b->tail) == SKIP) {
+    b->used -= rest;
+    b->tail = 0;
+  }
+}
+
+bool csi_backlog_push(csi_backlog_t *b, const void *data, size_t len) {
+  size_t size = LEN_SIZE + len;
+  if (len > CSI_BACKLOG_MAX_MESSAGE || size > b->cap) {
+    b->dropped++;
+    return false;
+  }
+
+  // An empty backlog starts at offset 0, so the message fits
+  while (b->count > 0) {
+    if (b->head > b->tail) {
+      // Free space is [head, cap) and then [0, tail)
+      size_t rest = b->cap - b->head;
+      if (size <= rest)
+        break;
+      if (size <= b->tail) {
+        if (rest >= LEN_SIZE)
+          put_len(b->buf + b->head, SKIP);
+        b->used += rest;
+        b->head = 0;
+        break;
+      }
+    } else if (size <= b->tail - b->head) {
+      // Wrapped: free space is [head, tail)
+      break;
+    }
+    csi_backlog_pop(b);
+    b->dropped++;
+  }
+
+  put_len(b->buf + b->head, len);
+  memcpy(b->buf + b->head + LEN_SIZE, data, len);
+  b->head += size;
+  b->used += size;
+  if (++b->count > b->high_water)
+    b->high_water = b->count;
+  return true;
+}
@@ -0,0 +1,66 @@
+/* Bounded backlog of encoded MQTT messages
+
+   While the broker is unreachable, at boot before Wi-Fi and MQTT are up or
+   after a drop, the analysis task keeps capturing and encoding; its
+   csi/data messages are appended here instead of being published, and sent
+   oldest first once the link is back. When the backlog is full the oldest
+   messages are dropped to make room, so it always holds the most recent
+   data. Dropped messages leave a gap in the message sequence numbers, which
+   the backend's decoders already treat as a lost message.
+
+   Messages are stored whole in one caller-provided byte buffer, each behind
+   a 2-byte length. A message that does not fit before the end of the buffer
+   starts over at offset 0, the bytes in between are skipped. The same task
+   pushes and pops, so there is no locking.
+
+   The module has no ESP-IDF dependencies and builds on any host.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest message, the 2-byte length prefix excluded
+#define CSI_BACKLOG_MAX_MESSAGE 0xFFFE
+
+typedef struct {
+  uint8_t *buf;
+  size_t cap;
+  size_t head; /**< where the next message is written */
+  size_t tail; /**< oldest message */
+  size_t used; /**< bytes in use, skipped ones included */
+  uint32_t count;
+  uint32_t dropped; /**< messages dropped, the oldest or too long ones */
+  uint32_t high_water; /**< most messages ever held */
+} csi_backlog_t;
+
+/**
+ * @brief Start an empty backlog in `buf`
+ */
+void csi_backlog_init(csi_backlog_t *b, uint8_t *buf, size_t cap);
+
+/**
+ * @brief Append one message, dropping the oldest ones until it fits
+ * @return false if the message can never fit; it is counted as dropped
+ */
+bool csi_backlog_push(csi_backlog_t *b, const void *data, size_t len);
+
+/**
+ * @brief Oldest message, NULL when empty
+ * @param[out] len its length
+ */
+const uint8_t *csi_backlog_front(csi_backlog_t *b, size_t *len);
+
+/**
+ * @brief Remove the oldest message
+ */
+void csi_backlog_pop(csi_backlog_t *b);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,237 @@
+#include "csi_codec.h"
+
+#include <string.h>
+
+#define MODE_SHIFT 6
+#define K_MASK 0x07
+#define K_MAX 7
+
+void csi_codec_init(csi_codec_t *c) { memset(c, 0, sizeof(*c)); }
+
+static int ref_slot(uint8_t layout) {
+  return layout < CSI_CODEC_REFS ? layout : 0;
+}
+
+// Differences wrap modulo 256, so every one fits an int8 and 0-255 after
+// the zigzag mapping 0, -1, 1, -2, ...
+static uint8_t zigzag(int8_t d) {
+  return (uint8_t)(d >= 0 ? 2 * d : -2 * d - 1);
+}
+
+static int8_t unzigzag(uint8_t z) {
+  return (int8_t)((z & 1) ? -(int)(z >> 1) - 1 : (int)(z >> 1));
+}
+
+static int8_t wrap_sub(int8_t a, int8_t b) {
+  return (int8_t)(uint8_t)((uint8_t)a - (uint8_t)b);
+}
+
+static int8_t wrap_add(int8_t a, int8_t b) {
+  return (int8_t)(uint8_t)((uint8_t)a + (uint8_t)b);
+}
+
+// Code length of value >> k, short of the terminating zero and low bits
+static unsigned rice_q(unsigned v, int k) {
+  unsigned q = v >> k;
+  return q < CSI_CODEC_ESCAPE ? q : (unsigned)(CSI_CODEC_ESCAPE + 7 - k);
+}
+
+// Smallest Rice code size of `z` over three k around log2(mean)
+static uint32_t rice_best(const uint8_t *z, size_t n, int *k_out) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum += z[i];
+  }
+  int k = 0;
+  while (k < K_MAX && ((uint32_t)n << (k + 1)) <= sum)
+    k++;
+  int k0 = k > 0 ? k - 1 : 0;
+  if (k0 > K_MAX - 2)
+    k0 = K_MAX - 2;
+
+  uint32_t bits[3] = {0};
+  for (size_t i = 0; i < n; i++) {
+    bits[0] += rice_q(z[i], k0);
+    bits[1] += rice_q(z[i], k0 + 1);
+    bits[2] += rice_q(z[i], k0 + 2);
+  }
+  uint32_t best = UINT32_MAX;
+  for (int j = 0; j < 3; j++) {
+    // Plus the terminating zero and the k low bits of every code
+    uint32_t b = bits[j] + (uint32_t)n * (1 + k0 + j);
+    if (b < best) {
+      best = b;
+      *k_out = k0 + j;
+    }
+  }
+  return best;
+}
+
+typedef struct {
+  uint8_t *p;
+  uint32_t acc;
+  int bits;
+} bit_writer_t;
+
+// n <= 24
+static void put_bits(bit_writer_t *w, uint32_t v, int n) {
+  w->acc = (w->acc << n) | v;
+  w->bits += n;
+  while (w->bits >= 8) {
+    w->bits -= 8;
+    *w->p++ = (uint8_t)(w->acc >> w->bits);
+  }
+}
+
+static void put_rice(bit_writer_t *w, const uint8_t *z, size_t n, int k) {
+  for (size_t i = 0; i < n; i++) {
+    unsigned q = z[i] >> k;
+    if (q < CSI_CODEC_ESCAPE) {
+      // q ones and the terminating zero, then the low bits
+      put_bits(w, (((1u << q) - 1) << (k + 1)) | (z[i] & ((1u << k) - 1)),
+               (int)q + 1 + k);
+    } else {
+      put_bits(w, (1u << CSI_CODEC_ESCAPE) - 1, CSI_CODEC_ESCAPE);
+      put_bits(w, z[i], 8);
+    }
+  }
+  if (w->bits > 0)
+    *w->p++ = (uint8_t)(w->acc << (8 - w->bits));
+}
+
+size_t csi_codec_encode(csi_codec_t *c, uint8_t layout, const int8_t *iq,
+                        size_t len, uint8_t *out, size_t cap) {
+  if (len == 0 || len > CSI_CODEC_MAX_LEN)
+    return 0;
+  int s = ref_slot(layout);
+
+  uint8_t intra[CSI_CODEC_MAX_LEN];
+  for (size_t i = 0; i < len; i++) {
+    intra[i] = zigzag(wrap_sub(iq[i], i >= 2 ? iq[i - 2] : 0));
+  }
+  csi_codec_mode_t mode = CSI_CODEC_STORED;
+  uint32_t bits = 8 * (uint32_t)len;
+  int k = 0, kk;
+  uint32_t b = rice_best(intra, len, &kk);
+  if (b < bits) {
+    mode = CSI_CODEC_INTRA;
+    bits = b;
+    k = kk;
+  }
+
+  uint8_t inter[CSI_CODEC_MAX_LEN];
+  if (c->ref_len[s] == len && c->since_key[s] < CSI_CODEC_KEY_INTERVAL) {
+    for (size_t i = 0; i < len; i++) {
+      inter[i] = zigzag(wrap_sub(iq[i], c->ref[s][i]));
+    }
+    b = rice_best(inter, len, &kk);
+    if (b < bits) {
+      mode = CSI_CODEC_INTER;
+      bits = b;
+      k = kk;
+    }
+  }
+
+  size_t size = 1 + (bits + 7) / 8;
+  if (size > cap)
+    return 0;
+  out[0] = (uint8_t)((mode << MODE_SHIFT) | k);
+  if (mode == CSI_CODEC_STORED) {
+    memcpy(out + 1, iq, len);
+  } else {
+    bit_writer_t w = {.p = out + 1};
+    put_rice(&w, mode == CSI_CODEC_INTER ? inter : intra, len, k);
+  }
+
+  memcpy(c->ref[s], iq, len);
+  c->ref_len[s] = (uint16_t)len;
+  c->since_key[s] = mode == CSI_CODEC_INTER ? c->since_key[s] + 1 : 0;
+  return size;
+}
+
+typedef struct {
+  const uint8_t *p, *end;
+  uint32_t acc;
+  int bits;
+} bit_reader_t;
+
+// Buffers at least 25 bits, enough for any code, unless the input ends
+static void refill(bit_reader_t *r) {
+  while (r->bits <= 24 && r->p < r->end) {
+    r->acc = (r->acc << 8) | *r->p++;
+    r->bits += 8;
+  }
+}
+
+static bool get_rice(bit_reader_t *r, uint8_t *z, size_t n, int k) {
+  for (size_t i = 0; i < n; i++) {
+    refill(r);
+    if (r->bits == 0)
+      return false;
+    // Leading ones of the buffered bits; the zeros shifted in stop the count
+    uint32_t ones = ~(r->acc << (32 - r->bits));
+    unsigned q = ones ? (unsigned)__builtin_clz(ones) : 32;
+    int low = k, len = (int)q + 1 + k;
+    if (q >= CSI_CODEC_ESCAPE) {
+      q = 0;
+      low = 8;
+      len = CSI_CODEC_ESCAPE + 8;
+    }
+    if (r->bits < len)
+      return false;
+    r->bits -= len;
+    uint32_t v = (r->acc >> r->bits) & ((1u << low) - 1);
+    v |= q << k;
+    if (v > 255)
+      return false;
+    z[i] = (uint8_t)v;
+  }
+  return true;
+}
+
+size_t csi_codec_decode(csi_codec_t *c, uint8_t layout, const uint8_t *in,
+                        size_t avail, int8_t *iq, size_t len, bool *valid) {
+  if (avail < 1 || len == 0 || len > CSI_CODEC_MAX_LEN)
+    return 0;
+  int s = ref_slot(layout);
+  int mode = in[0] >> MODE_SHIFT;
+  int k = in[0] & K_MASK;
+  size_t used;
+
+  if (mode == CSI_CODEC_STORED) {
+    if (avail < 1 + len)
+      return 0;
+    memcpy(iq, in + 1, len);
+    used = 1 + len;
+  } else if (mode == CSI_CODEC_INTRA || mode == CSI_CODEC_INTER) {
+    uint8_t z[CSI_CODEC_MAX_LEN];
+    bit_reader_t r = {.p = in + 1, .end = in + avail};
+    if (!get_rice(&r, z, len, k))
+      return 0;
+    // The reader may have buffered bytes of the next frame
+    used = (size_t)(r.p - in) - (size_t)r.bits / 8;
+
+    if (mode == CSI_CODEC_INTER) {
+      if (c->ref_len[s] != len) {
+        // Lost the reference: skip the frame until the next keyframe
+        c->ref_len[s] = 0;
+        *valid = false;
+        return used;
+      }
+      for (size_t i = 0; i < len; i++) {
+        iq[i] = wrap_add(c->ref[s][i], unzigzag(z[i]));
+      }
+    } else {
+      for (size_t i = 0; i < len; i++) {
+        iq[i] = wrap_add(i >= 2 ? iq[i - 2] : 0, unzigzag(z[i]));
+      }
+    }
+  } else {
+    return 0;
+  }
+
+  memcpy(c->ref[s], iq, len);
+  c->ref_len[s] = (uint16_t)len;
+  *valid = true;
+  return used;
+}
@@ -0,0 +1,88 @@
+/* Lossless compression of CSI frames
+
+   Raw I/Q takes one byte per value, although frames of a static link change
+   little from one to the next. The codec predicts every int8 value, zigzag
+   maps the difference (modulo 256) to 0-255 and writes it as a Rice code
+   with a per-frame parameter k: value >> k in unary, then the k low bits.
+   Each frame takes the cheapest of three modes:
+
+   - CSI_CODEC_INTER: predicted by the previous frame of the same layout;
+   - CSI_CODEC_INTRA: predicted by the same component of the previous
+     subcarrier, so no earlier frame is needed;
+   - CSI_CODEC_STORED: the raw bytes, so a frame never grows by more than
+     one byte.
+
+   Intra and stored frames are keyframes. A decoder that starts late, or was
+   reset after a lost message, outputs frames again from the next keyframe
+   of each layout. The encoder keeps one reference frame per layout id
+   (csi_layout.h), so a stream that mixes layouts still predicts from the
+   last frame of the same layout, and forces a keyframe after
+   CSI_CODEC_KEY_INTERVAL inter frames of a layout.
+
+   A coded frame is a mode byte, bits 7-6 the mode and bits 2-0 k, followed
+   by one code per value, most significant bit first, padded to a byte. A
+   code whose unary part would reach CSI_CODEC_ESCAPE is written as
+   CSI_CODEC_ESCAPE ones and the 8-bit value instead.
+
+   Encoder and decoder each hold one csi_codec_t of about 2 KB. The module
+   has no ESP-IDF dependencies and builds on any host.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest frame, CSI_RING_SLOT_SIZE
+#define CSI_CODEC_MAX_LEN 384
+// One reference per csi_layout_id_t, unknown layouts share slot 0
+#define CSI_CODEC_REFS 5
+#define CSI_CODEC_KEY_INTERVAL 100
+#define CSI_CODEC_ESCAPE 12
+// Largest coded size of a `len` byte frame
+#define CSI_CODEC_BOUND(len) (1 + (len))
+
+typedef enum {
+  CSI_CODEC_INTRA = 0,
+  CSI_CODEC_INTER = 1,
+  CSI_CODEC_STORED = 2,
+} csi_codec_mode_t;
+
+typedef struct {
+  int8_t ref[CSI_CODEC_REFS][CSI_CODEC_MAX_LEN];
+  uint16_t ref_len[CSI_CODEC_REFS]; /**< 0 if the slot has no reference */
+  uint8_t since_key[CSI_CODEC_REFS]; /**< inter frames since the keyframe */
+} csi_codec_t;
+
+/**
+ * @brief Forget all reference frames; the next frame of every layout is
+ *        encoded, or must arrive, as a keyframe
+ */
+void csi_codec_init(csi_codec_t *c);
+
+/**
+ * @brief Encode one frame of `len` I/Q bytes of layout `layout`
+ * @return coded length, at most CSI_CODEC_BOUND(len), or 0 if `len` is 0
+ *         or above CSI_CODEC_MAX_LEN or the frame does not fit in `cap`;
+ *         the codec is left unchanged then
+ */
+size_t csi_codec_encode(csi_codec_t *c, uint8_t layout, const int8_t *iq,
+                        size_t len, uint8_t *out, size_t cap);
+
+/**
+ * @brief Decode one frame of `len` I/Q bytes from at most `avail` bytes
+ * @param[out] valid false for an inter frame without a matching reference,
+ *             whose `iq` is then undefined; decoding can go on with the
+ *             next frame
+ * @return bytes consumed, 0 if the data is truncated or malformed
+ */
+size_t csi_codec_decode(csi_codec_t *c, uint8_t layout, const uint8_t *in,
+                        size_t avail, int8_t *iq, size_t len, bool *valid);
+
+#ifdef __cplusplus
+}
+#endif
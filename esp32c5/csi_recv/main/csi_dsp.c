@@ -0,0 +1,425 @@
+#include "csi_dsp.h"
+
+#include <math.h>
+#include <string.h>
+
+static q15_t sat_q15(int64_t v) {
+  if (v > INT16_MAX)
+    return INT16_MAX;
+  if (v < INT16_MIN)
+    return INT16_MIN;
+  return (q15_t)v;
+}
+
+static q31_t sat_q31(int64_t v) {
+  if (v > INT32_MAX)
+    return INT32_MAX;
+  if (v < INT32_MIN)
+    return INT32_MIN;
+  return (q31_t)v;
+}
+
+// Rounded division, halves away from zero
+static int64_t div_round(int64_t num, int64_t den) {
+  return (num >= 0 ? num + den / 2 : num - den / 2) / den;
+}
+
+//------------------------------------------------------Per-Frame
+// Kernels------------------------------------------------------
+// alpha * max + beta * min with the minimax pair for the largest error,
+// alpha = 0.96043387, beta = 0.39782473, in Q15
+#define MAG_ALPHA 31472
+#define MAG_BETA 13036
+
+void csi_dsp_magnitude(const int8_t *iq, uint16_t *mag, size_t n) {
+  for (size_t k = 0; k < n; k++) {
+    int32_t a = iq[2 * k] < 0 ? -iq[2 * k] : iq[2 * k];
+    int32_t b = iq[2 * k + 1] < 0 ? -iq[2 * k + 1] : iq[2 * k + 1];
+    int32_t hi = a > b ? a : b;
+    int32_t lo = a > b ? b : a;
+    // Q15 coefficient times a Q7 value, shifted to Q15: at most 45.6k
+    mag[k] = (uint16_t)((MAG_ALPHA * hi + MAG_BETA * lo + 64) >> 7);
+  }
+}
+
+void csi_dsp_band_mean(const int8_t *iq, size_t first, size_t last,
+                       q15_t *re, q15_t *im) {
+  // Pairs are (imag, real), see make_csi_complex()
+  int32_t sum_re = 0, sum_im = 0;
+  for (size_t k = first; k < last; k++) {
+    sum_im += iq[2 * k];
+    sum_re += iq[2 * k + 1];
+  }
+  int32_t count = (int32_t)(last - first);
+  *re = sat_q15(div_round((int64_t)sum_re << 8, count));
+  *im = sat_q15(div_round((int64_t)sum_im << 8, count));
+}
+
+void csi_dsp_index_mean(const int8_t *iq, const uint8_t *index, size_t n,
+                        q15_t *re, q15_t *im) {
+  int32_t sum_re = 0, sum_im = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum_im += iq[2 * index[i]];
+    sum_re += iq[2 * index[i] + 1];
+  }
+  *re = sat_q15(div_round((int64_t)sum_re << 8, (int32_t)n));
+  *im = sat_q15(div_round((int64_t)sum_im << 8, (int32_t)n));
+}
+
+//------------------------------------------------------Biquad
+// Cascades------------------------------------------------------
+// Largest sum of |coef| for which the 64-bit Q31 accumulator cannot overflow
+#define BIQUAD_COEF_SUM_MAX 8.0f
+
+static bool coef_sum_ok(const float coef[5]) {
+  float sum = 0;
+  for (int i = 0; i < 5; i++) {
+    sum += fabsf(coef[i]);
+  }
+  return sum < BIQUAD_COEF_SUM_MAX;
+}
+
+bool csi_dsp_biquad_q15_init(csi_dsp_biquad_q15_t *s, const float coef[5]) {
+  memset(s, 0, sizeof(*s));
+  for (int i = 0; i < 5; i++) {
+    long v = lrintf(coef[i] * (1 << CSI_DSP_BIQUAD_Q15_FRAC));
+    if (v > INT16_MAX || v < INT16_MIN)
+      return false;
+    s->coef[i] = (int16_t)v;
+  }
+  return true;
+}
+
+bool csi_dsp_biquad_q31_init(csi_dsp_biquad_q31_t *s, const float coef[5]) {
+  memset(s, 0, sizeof(*s));
+  if (!coef_sum_ok(coef))
+    return false;
+  for (int i = 0; i < 5; i++) {
+    s->coef[i] = (int32_t)llrint((double)coef[i] *
+                                 (1LL << CSI_DSP_BIQUAD_Q31_FRAC));
+  }
+  return true;
+}
+
+void csi_dsp_biquad_q15(csi_dsp_biquad_q15_t *s, int sections, q15_t *data,
+                        size_t len) {
+  const int64_t round = 1 << (CSI_DSP_BIQUAD_Q15_FRAC - 1);
+  for (int k = 0; k < sections; k++, s++) {
+    const int16_t *c = s->coef;
+    for (size_t i = 0; i < len; i++) {
+      int64_t acc = (int32_t)c[0] * data[i] + (int32_t)c[1] * s->x[0] +
+                    (int32_t)c[2] * s->x[1] - (int32_t)c[3] * s->y[0] -
+                    (int32_t)c[4] * s->y[1];
+      q15_t y = sat_q15((acc + round) >> CSI_DSP_BIQUAD_Q15_FRAC);
+      s->x[1] = s->x[0];
+      s->x[0] = data[i];
+      s->y[1] = s->y[0];
+      s->y[0] = y;
+      data[i] = y;
+    }
+  }
+}
+
+void csi_dsp_biquad_q31(csi_dsp_biquad_q31_t *s, int sections, q31_t *data,
+                        size_t len) {
+  const int64_t round = 1 << (CSI_DSP_BIQUAD_Q31_FRAC - 1);
+  for (int k = 0; k < sections; k++, s++) {
+    const int32_t *c = s->coef;
+    for (size_t i = 0; i < len; i++) {
+      int64_t acc = (int64_t)c[0] * data[i] + (int64_t)c[1] * s->x[0] +
+                    (int64_t)c[2] * s->x[1] - (int64_t)c[3] * s->y[0] -
+                    (int64_t)c[4] * s->y[1];
+      q31_t y = sat_q31((acc + round) >> CSI_DSP_BIQUAD_Q31_FRAC);
+      s->x[1] = s->x[0];
+      s->x[0] = data[i];
+      s->y[1] = s->y[0];
+      s->y[0] = y;
+      data[i] = y;
+    }
+  }
+}
+
+//------------------------------------------------------Moving
+// Statistics------------------------------------------------------
+void csi_dsp_movstat_init(csi_dsp_movstat_t *s, q15_t *buf, uint16_t size) {
+  memset(s, 0, sizeof(*s));
+  s->buf = buf;
+  s->size = size;
+}
+
+void csi_dsp_movstat_push(csi_dsp_movstat_t *s, q15_t x) {
+  if (s->count == s->size) {
+    q15_t old = s->buf[s->index];
+    s->sum -= old;
+    s->sumsq -= (int32_t)old * old;
+  } else {
+    s->count++;
+  }
+  s->buf[s->index] = x;
+  s->index = (uint16_t)((s->index + 1) % s->size);
+  s->sum += x;
+  s->sumsq += (int32_t)x * x;
+}
+
+q15_t csi_dsp_movstat_mean(const csi_dsp_movstat_t *s) {
+  return s->count ? sat_q15(div_round(s->sum, s->count)) : 0;
+}
+
+q31_t csi_dsp_movstat_var(const csi_dsp_movstat_t *s) {
+  if (s->count == 0)
+    return 0;
+  // n * sumsq - sum^2 is exact, as in motion.c
+  int64_t n = s->count;
+  return sat_q31(div_round(n * s->sumsq - (int64_t)s->sum * s->sum, n * n));
+}
+
+void csi_dsp_ewstat_init(csi_dsp_ewstat_t *s, uint8_t shift) {
+  memset(s, 0, sizeof(*s));
+  s->shift = shift;
+}
+
+void csi_dsp_ewstat_push(csi_dsp_ewstat_t *s, q15_t x) {
+  q31_t v = (q31_t)x << 15; // Q30
+  if (!s->started) {
+    s->mean = v;
+    s->var = 0;
+    s->started = true;
+    return;
+  }
+  // Same recurrence as motion.c's power statistics, alpha = 2^-shift
+  int64_t delta = (int64_t)v - s->mean;
+  int64_t round = s->shift ? 1LL << (s->shift - 1) : 0;
+  s->mean += (q31_t)((delta + round) >> s->shift);
+  int64_t t = s->var + ((delta * delta) >> (30 + s->shift));
+  s->var = (q31_t)(t - ((t + round) >> s->shift));
+}
+
+//------------------------------------------------------FFT &
+// Autocorrelation------------------------------------------------------
+// sin(2 pi k / CSI_DSP_FFT_MAX) for the first quarter wave, Q15
+static q15_t fft_sin[CSI_DSP_FFT_MAX / 4 + 1];
+
+void csi_dsp_fft_init(void) {
+  for (int k = 0; k <= CSI_DSP_FFT_MAX / 4; k++) {
+    double v = sin(2 * M_PI * k / CSI_DSP_FFT_MAX) * CSI_DSP_Q15_ONE;
+    fft_sin[k] = sat_q15(llrint(v));
+  }
+}
+
+// cos and sin of 2 pi idx / CSI_DSP_FFT_MAX for idx in [0, N / 2)
+static void twiddle(int idx, int32_t *c, int32_t *s) {
+  const int quarter = CSI_DSP_FFT_MAX / 4;
+  if (idx <= quarter) {
+    *s = fft_sin[idx];
+    *c = fft_sin[quarter - idx];
+  } else {
+    *s = fft_sin[2 * quarter - idx];
+    *c = -fft_sin[idx - quarter];
+  }
+}
+
+static int32_t max_abs(const q15_t *v, size_t n) {
+  int32_t m = 0;
+  for (size_t i = 0; i < n; i++) {
+    int32_t a = v[i] < 0 ? -v[i] : v[i];
+    if (a > m)
+      m = a;
+  }
+  return m;
+}
+
+int csi_dsp_fft_q15(q15_t *data, int log2n) {
+  const int n = 1 << log2n;
+  for (int i = 1, j = 0; i < n; i++) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      q15_t t = data[2 * i];
+      data[2 * i] = data[2 * j];
+      data[2 * j] = t;
+      t = data[2 * i + 1];
+      data[2 * i + 1] = data[2 * j + 1];
+      data[2 * j + 1] = t;
+    }
+  }
+
+  // Block floating point: a butterfly grows a component by at most
+  // 1 + sqrt(2), so each stage shifts just enough to stay in range
+  int exponent = 0;
+  int32_t peak = max_abs(data, 2 * (size_t)n);
+  for (int len = 2; len <= n; len <<= 1) {
+    int shift = peak < 13500 ? 0 : peak < 27000 ? 1 : 2;
+    int32_t round = shift ? 1 << (shift - 1) : 0;
+    int stride = CSI_DSP_FFT_MAX / len;
+    exponent += shift;
+    peak = 0;
+    for (int k = 0; k < len / 2; k++) {
+      int32_t wr, ws;
+      twiddle(k * stride, &wr, &ws);
+      for (int i = k; i < n; i += len) {
+        q15_t *a = &data[2 * i];
+        q15_t *b = &data[2 * (i + len / 2)];
+        // b * (wr - j ws)
+        int32_t tr = (b[0] * wr + b[1] * ws + (1 << 14)) >> 15;
+        int32_t ti = (b[1] * wr - b[0] * ws + (1 << 14)) >> 15;
+        int32_t v[4] = {(a[0] + tr + round) >> shift,
+                        (a[1] + ti + round) >> shift,
+                        (a[0] - tr + round) >> shift,
+                        (a[1] - ti + round) >> shift};
+        for (int m = 0; m < 4; m++) {
+          int32_t abs_v = v[m] < 0 ? -v[m] : v[m];
+          if (abs_v > peak)
+            peak = abs_v;
+        }
+        a[0] = (q15_t)v[0];
+        a[1] = (q15_t)v[1];
+        b[0] = (q15_t)v[2];
+        b[1] = (q15_t)v[3];
+      }
+    }
+  }
+  return exponent;
+}
+
+// Left shift that brings `peak` into [2^13, 2^14), the headroom the first
+// FFT stage needs
+static int normalise_shift(uint32_t peak) {
+  int shift = 0;
+  while (peak && peak < (1u << 13)) {
+    peak <<= 1;
+    shift++;
+  }
+  while (peak >= (1u << 14)) {
+    peak >>= 1;
+    shift--;
+  }
+  return shift;
+}
+
+void csi_dsp_autocorr_q15(const q15_t *x, q15_t *acf, size_t n, q15_t *work,
+                          int log2n) {
+  const size_t size = (size_t)1 << log2n;
+  memset(work, 0, 2 * size * sizeof(q15_t));
+  int shift = normalise_shift((uint32_t)max_abs(x, n));
+  for (size_t i = 0; i < n; i++) {
+    work[2 * i] = (q15_t)(shift >= 0 ? x[i] * (1 << shift) : x[i] >> -shift);
+  }
+  csi_dsp_fft_q15(work, log2n);
+
+  // Power spectrum, renormalised into the same headroom; the ACF is scaled
+  // to acf[0] = 1 at the end, so block exponents need not be tracked
+  uint32_t peak = 0;
+  for (size_t i = 0; i < size; i++) {
+    int32_t re = work[2 * i], im = work[2 * i + 1];
+    uint32_t p = (uint32_t)(re * re) + (uint32_t)(im * im);
+    if (p > peak)
+      peak = p;
+  }
+  shift = normalise_shift(peak);
+  // Rounded, not truncated: the many small noise bins would otherwise all
+  // lose their fraction and bias the ACF at short lags
+  uint64_t round = shift < 0 ? 1ull << (-shift - 1) : 0;
+  for (size_t i = 0; i < size; i++) {
+    int32_t re = work[2 * i], im = work[2 * i + 1];
+    uint64_t p = (uint32_t)(re * re) + (uint32_t)(im * im);
+    work[2 * i] = (q15_t)(shift >= 0 ? p << shift : (p + round) >> -shift);
+    work[2 * i + 1] = 0;
+  }
+  // The power spectrum is real and even, so a forward FFT inverts it
+  csi_dsp_fft_q15(work, log2n);
+
+  int32_t zero = work[0] > 0 ? work[0] : 1;
+  for (size_t i = 0; i < n; i++) {
+    acf[i] = sat_q15(div_round((int64_t)work[2 * i] * CSI_DSP_Q15_ONE, zero));
+  }
+}
+
+//------------------------------------------------------Polyphase
+// Decimation------------------------------------------------------
+bool csi_dsp_decim_design(q15_t *coef, int factor, int phases) {
+  int len = factor * phases;
+  if (len <= 0 || len > 255)
+    return false;
+
+  double h[255];
+  double sum = 0;
+  double fc = 0.5 / factor;
+  for (int i = 0; i < len; i++) {
+    double t = i - (len - 1) / 2.0;
+    double sinc = t == 0 ? 2 * fc : sin(2 * M_PI * fc * t) / (M_PI * t);
+    double w = len > 1 ? 0.42 - 0.5 * cos(2 * M_PI * i / (len - 1)) +
+                             0.08 * cos(4 * M_PI * i / (len - 1))
+                       : 1;
+    h[i] = sinc * w;
+    sum += h[i];
+  }
+  // Round, then put the rounding residue on the centre tap so that a
+  // constant input comes out unchanged
+  int32_t total = 0;
+  for (int i = 0; i < len; i++) {
+    coef[i] = sat_q15(llrint(h[i] / sum * CSI_DSP_Q15_ONE));
+    total += coef[i];
+  }
+  coef[len / 2] = sat_q15(coef[len / 2] + CSI_DSP_Q15_ONE - total);
+  return true;
+}
+
+void csi_dsp_decim_init(csi_dsp_decim_t *d, const q15_t *coef, int32_t *acc,
+                        int factor, int phases, int channels) {
+  d->coef = coef;
+  d->acc = acc;
+  d->factor = (uint8_t)factor;
+  d->phases = (uint8_t)phases;
+  d->channels = (uint8_t)channels;
+  d->phase = 0;
+  d->head = 0;
+  d->started = false;
+  memset(acc, 0, sizeof(int32_t) * phases * channels);
+}
+
+// Output head + j gets the history's share: taps [(j + 1) * factor, len)
+static void decim_prime(csi_dsp_decim_t *d, const int16_t *x) {
+  int len = d->factor * d->phases;
+  for (int j = 0; j < d->phases; j++) {
+    int32_t tail = 0;
+    for (int i = (j + 1) * d->factor; i < len; i++) {
+      tail += d->coef[i];
+    }
+    int32_t *row = &d->acc[((d->head + j) % d->phases) * d->channels];
+    for (int c = 0; c < d->channels; c++) {
+      row[c] = tail * x[c];
+    }
+  }
+}
+
+bool csi_dsp_decim_push(csi_dsp_decim_t *d, const int16_t *x, int16_t *y) {
+  if (!d->started) {
+    decim_prime(d, x);
+    d->started = true;
+  }
+
+  // This input is `factor - 1 - phase` samples before the end of output
+  // head's block, and j blocks further from output head + j
+  int tap = d->factor - 1 - d->phase;
+  for (int j = 0; j < d->phases; j++, tap += d->factor) {
+    int32_t c = d->coef[tap];
+    int32_t *row = &d->acc[((d->head + j) % d->phases) * d->channels];
+    for (int k = 0; k < d->channels; k++) {
+      row[k] += c * x[k];
+    }
+  }
+  if (++d->phase < d->factor)
+    return false;
+
+  int32_t *row = &d->acc[d->head * d->channels];
+  for (int k = 0; k < d->channels; k++) {
+    y[k] = sat_q15(((int64_t)row[k] + (1 << 14)) >> 15);
+    row[k] = 0;
+  }
+  d->phase = 0;
+  d->head = (uint8_t)((d->head + 1) % d->phases);
+  return true;
+}
@@ -0,0 +1,203 @@
+/* Fixed-point DSP kernels for the CSI signal path
+
+   The ESP32-C5 core has no FPU, so every float operation in the per-frame
+   path is a software routine. These kernels do the same work in integers:
+
+   - csi_dsp_magnitude(): |I + jQ| by the alpha-max-plus-beta-min rule, no
+     square root, within CSI_DSP_MAGNITUDE_ERROR of the exact value.
+   - csi_dsp_band_mean() / csi_dsp_index_mean(): complex mean of a range or
+     a list of subcarriers.
+   - csi_dsp_biquad_q15() / csi_dsp_biquad_q31(): direct form I biquad
+     cascades. Q15 is enough for wide bands; the breathing band-pass has
+     poles within 0.006 of the unit circle and needs the Q31 version.
+   - csi_dsp_movstat_*: sliding-window mean and variance, exact.
+   - csi_dsp_ewstat_*: exponentially weighted mean and variance with
+     alpha = 2^-shift, as MOTION_POWER_ALPHA.
+   - csi_dsp_fft_q15() / csi_dsp_autocorr_q15(): radix-2 FFT with block
+     floating point scaling and the |FFT|^2 autocorrelation of breathing.c.
+   - csi_dsp_decim_*: polyphase FIR decimator for several int16 channels,
+     with a windowed-sinc low-pass designed for the decimation factor.
+
+   Formats: q15_t holds x / 2^15 and q31_t x / 2^31. Raw CSI values are
+   int8 Q7 fractions (v / 128), so shifting them left by 8 gives Q15
+   without rounding. Biquad coefficients are Q2.13 (q15) and Q2.29 (q31) so
+   that |a1| up to 2 fits. Intermediate products are 64-bit where a 32-bit
+   sum could overflow.
+
+   csi_dsp_bench.h checks every kernel against a float reference and
+   times it. The module has no ESP-IDF dependencies and builds on any host.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+#define CSI_DSP_Q15_ONE 32768
+#define CSI_DSP_BIQUAD_Q15_FRAC 13
+#define CSI_DSP_BIQUAD_Q31_FRAC 29
+// Largest relative error of csi_dsp_magnitude()
+#define CSI_DSP_MAGNITUDE_ERROR 0.0396f
+// csi_dsp_fft_q15() sizes up to 2^CSI_DSP_FFT_MAX_LOG2
+#define CSI_DSP_FFT_MAX_LOG2 12
+#define CSI_DSP_FFT_MAX (1 << CSI_DSP_FFT_MAX_LOG2)
+
+//------------------------------------------------------Per-Frame
+// Kernels------------------------------------------------------
+/**
+ * @brief Magnitude of `n` interleaved int8 (imag, real) pairs
+ * @param[out] mag magnitudes as unsigned Q1.15, |z| / 128 * 2^15
+ */
+void csi_dsp_magnitude(const int8_t *iq, uint16_t *mag, size_t n);
+
+/**
+ * @brief Complex mean of subcarriers [first, last) of one CSI frame
+ * @param[out] re, im mean as Q15, rounded to nearest
+ */
+void csi_dsp_band_mean(const int8_t *iq, size_t first, size_t last,
+                       q15_t *re, q15_t *im);
+
+/**
+ * @brief Complex mean of the `n` subcarriers listed in `index`
+ * @param[out] re, im mean as Q15, rounded to nearest
+ */
+void csi_dsp_index_mean(const int8_t *iq, const uint8_t *index, size_t n,
+                        q15_t *re, q15_t *im);
+
+//------------------------------------------------------Biquad
+// Cascades------------------------------------------------------
+// Coefficients b0, b1, b2, a1, a2 per section, a0 = 1
+typedef struct {
+  int16_t coef[5];
+  q15_t x[2];
+  q15_t y[2];
+} csi_dsp_biquad_q15_t;
+
+typedef struct {
+  int32_t coef[5];
+  q31_t x[2];
+  q31_t y[2];
+} csi_dsp_biquad_q31_t;
+
+/**
+ * @brief Load one section from float coefficients and clear its state
+ * @return false if a coefficient does not fit the format
+ */
+bool csi_dsp_biquad_q15_init(csi_dsp_biquad_q15_t *s, const float coef[5]);
+bool csi_dsp_biquad_q31_init(csi_dsp_biquad_q31_t *s, const float coef[5]);
+
+/**
+ * @brief Run `len` samples through `sections` cascaded sections in place,
+ *        saturating on overflow
+ */
+void csi_dsp_biquad_q15(csi_dsp_biquad_q15_t *s, int sections, q15_t *data,
+                        size_t len);
+void csi_dsp_biquad_q31(csi_dsp_biquad_q31_t *s, int sections, q31_t *data,
+                        size_t len);
+
+//------------------------------------------------------Moving
+// Statistics------------------------------------------------------
+typedef struct {
+  q15_t *buf; /**< caller-owned window of `size` samples */
+  uint16_t size;
+  uint16_t index;
+  uint16_t count;
+  int32_t sum;
+  int64_t sumsq;
+} csi_dsp_movstat_t;
+
+/**
+ * @brief Start an empty window over `buf`, `size` at most 32768
+ */
+void csi_dsp_movstat_init(csi_dsp_movstat_t *s, q15_t *buf, uint16_t size);
+void csi_dsp_movstat_push(csi_dsp_movstat_t *s, q15_t x);
+/** @brief Mean of the window, Q15 */
+q15_t csi_dsp_movstat_mean(const csi_dsp_movstat_t *s);
+/** @brief Population variance of the window, Q30 */
+q31_t csi_dsp_movstat_var(const csi_dsp_movstat_t *s);
+
+typedef struct {
+  q31_t mean; /**< Q30 */
+  q31_t var;  /**< Q30 */
+  uint8_t shift;
+  bool started;
+} csi_dsp_ewstat_t;
+
+/**
+ * @brief Reset, with weight 2^-shift for the newest sample
+ */
+void csi_dsp_ewstat_init(csi_dsp_ewstat_t *s, uint8_t shift);
+
+/**
+ * @brief Add one Q15 sample; the first one sets the mean
+ */
+void csi_dsp_ewstat_push(csi_dsp_ewstat_t *s, q15_t x);
+
+//------------------------------------------------------FFT &
+// Autocorrelation------------------------------------------------------
+/**
+ * @brief Fill the twiddle table, once before the first FFT
+ */
+void csi_dsp_fft_init(void);
+
+/**
+ * @brief In-place forward FFT of 2^log2n interleaved (re, im) Q15 values
+ * @return block exponent e: the true, unscaled FFT is data * 2^e
+ */
+int csi_dsp_fft_q15(q15_t *data, int log2n);
+
+/**
+ * @brief Autocorrelation of `n` samples for lags [0, n), normalised so
+ *        acf[0] = 1 (saturated to 32767)
+ * @param[in] work 2 * 2^log2n values, 2^log2n >= 2 * n - 1 so the circular
+ *            correlation does not wrap
+ * @param[out] acf may be the same array as `x`
+ */
+void csi_dsp_autocorr_q15(const q15_t *x, q15_t *acf, size_t n, q15_t *work,
+                          int log2n);
+
+//------------------------------------------------------Polyphase
+// Decimation------------------------------------------------------
+// An output every `factor` inputs, from a low-pass of factor * phases taps.
+// Each input is added to the `phases` outputs it contributes to, so an
+// input costs `phases` multiply-adds per channel and no history is kept.
+typedef struct {
+  const q15_t *coef; /**< factor * phases taps, from csi_dsp_decim_design() */
+  int32_t *acc;      /**< caller-owned, phases * channels partial outputs */
+  uint8_t factor;
+  uint8_t phases;
+  uint8_t channels;
+  uint8_t phase; /**< inputs so far into the current output */
+  uint8_t head;  /**< row of acc that completes next */
+  bool started;
+} csi_dsp_decim_t;
+
+/**
+ * @brief Blackman-windowed sinc low-pass with its cutoff at the output
+ *        Nyquist frequency, fs / (2 * factor), and a DC gain of exactly 1
+ * @param[out] coef factor * phases taps
+ * @return false if factor * phases is 0 or over 255
+ */
+bool csi_dsp_decim_design(q15_t *coef, int factor, int phases);
+
+void csi_dsp_decim_init(csi_dsp_decim_t *d, const q15_t *coef, int32_t *acc,
+                        int factor, int phases, int channels);
+
+/**
+ * @brief Add one input sample of every channel; the first input is taken to
+ *        have been constant before, so the output starts in steady state
+ * @param[out] y one output sample per channel, written when returning true
+ * @return true every `factor` inputs
+ */
+bool csi_dsp_decim_push(csi_dsp_decim_t *d, const int16_t *x, int16_t *y);
+
+#ifdef __cplusplus
+}
+#endif
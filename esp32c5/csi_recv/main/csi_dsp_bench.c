@@ -0,0 +1,601 @@
+#include "csi_dsp_bench.h"
+
+// Only in firmware built with the bench, always on a host
+#if CSI_DSP_BENCH || !defined(ESP_PLATFORM)
+
+#include "csi_dsp.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#define BENCH_UNIT "cycles"
+
+typedef uint32_t bench_time_t;
+
+static bench_time_t bench_now(void) { return esp_cpu_get_cycle_count(); }
+#else
+#include <time.h>
+#define BENCH_UNIT "ns"
+
+typedef uint64_t bench_time_t;
+
+static bench_time_t bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+// Keeps the compiler from dropping a timed loop whose result is unused
+static volatile int32_t bench_sink;
+
+// Average time of `stmt` over `repeat` runs; `r_` is the run index
+#define BENCH_TIME(repeat, stmt, out)                                         \
+  do {                                                                        \
+    bench_time_t start_ = bench_now();                                        \
+    for (int r_ = 0; r_ < (repeat); r_++) {                                   \
+      stmt;                                                                   \
+    }                                                                         \
+    (out) = (double)(bench_time_t)(bench_now() - start_) / (repeat);          \
+  } while (0)
+
+// Deterministic input on every platform
+static uint32_t rng_state;
+
+static uint32_t rng_next(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+// Uniform in [-1, 1)
+static float rng_uniform(void) {
+  return (float)(int32_t)rng_next() / 2147483648.0f;
+}
+
+static int failures;
+
+static void report(const char *name, double err, double bound,
+                   const char *err_unit, double fixed_t, double float_t) {
+  bool ok = err <= bound;
+  if (!ok)
+    failures++;
+  printf("%-14s err %10.3g %-10s (bound %8.3g) %s  fixed %10.0f %s, "
+         "float %10.0f %s\n",
+         name, err, err_unit, bound, ok ? "ok  " : "FAIL", fixed_t,
+         BENCH_UNIT, float_t, BENCH_UNIT);
+}
+
+//------------------------------------------------------Float
+// References------------------------------------------------------
+static void ref_magnitude(const int8_t *iq, float *mag, size_t n) {
+  for (size_t k = 0; k < n; k++) {
+    mag[k] = hypotf(iq[2 * k], iq[2 * k + 1]) / 128;
+  }
+}
+
+static void ref_band_mean(const int8_t *iq, size_t first, size_t last,
+                          float *re, float *im) {
+  float sum_re = 0, sum_im = 0;
+  for (size_t k = first; k < last; k++) {
+    sum_im += iq[2 * k];
+    sum_re += iq[2 * k + 1];
+  }
+  *re = sum_re / (last - first) / 128;
+  *im = sum_im / (last - first) / 128;
+}
+
+// Direct form I, one section; w holds x1, x2, y1, y2
+static void ref_biquad(const float *c, float *w, float *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    float y = c[0] * data[i] + c[1] * w[0] + c[2] * w[1] - c[3] * w[2] -
+              c[4] * w[3];
+    w[1] = w[0];
+    w[0] = data[i];
+    w[3] = w[2];
+    w[2] = y;
+    data[i] = y;
+  }
+}
+
+static void ref_fft(float *data, int n) {
+  for (int i = 1, j = 0; i < n; i++) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      float t = data[2 * i];
+      data[2 * i] = data[2 * j];
+      data[2 * j] = t;
+      t = data[2 * i + 1];
+      data[2 * i + 1] = data[2 * j + 1];
+      data[2 * j + 1] = t;
+    }
+  }
+  for (int len = 2; len <= n; len <<= 1) {
+    double ang = -2.0 * M_PI / len;
+    for (int k = 0; k < len / 2; k++) {
+      float wr = (float)cos(ang * k);
+      float wi = (float)sin(ang * k);
+      for (int i = k; i < n; i += len) {
+        float *a = &data[2 * i];
+        float *b = &data[2 * (i + len / 2)];
+        float tr = b[0] * wr - b[1] * wi;
+        float ti = b[0] * wi + b[1] * wr;
+        b[0] = a[0] - tr;
+        b[1] = a[1] - ti;
+        a[0] += tr;
+        a[1] += ti;
+      }
+    }
+  }
+}
+
+// As breathing.c's autocorr()
+static void ref_autocorr(const float *x, float *acf, size_t n, float *work,
+                         int size) {
+  memset(work, 0, 2 * size * sizeof(float));
+  for (size_t i = 0; i < n; i++) {
+    work[2 * i] = x[i];
+  }
+  ref_fft(work, size);
+  for (int i = 0; i < size; i++) {
+    float re = work[2 * i], im = work[2 * i + 1];
+    work[2 * i] = re * re + im * im;
+    work[2 * i + 1] = 0;
+  }
+  ref_fft(work, size);
+  float norm = work[0] > 0 ? work[0] : 1;
+  for (size_t i = 0; i < n; i++) {
+    acf[i] = work[2 * i] / norm;
+  }
+}
+
+//------------------------------------------------------Kernel
+// Checks------------------------------------------------------
+#define FRAME_SUBCARRIERS 57
+#define SIGNAL_LEN 1500
+#define STAT_WINDOW 20
+#define STAT_LEN 10000
+#define FFT_LOG2 10
+#define ACF_LEN 1499
+#define ACF_LOG2 12
+#define DECIM_FACTOR 10
+#define DECIM_PHASES 8
+#define DECIM_CHANNELS 4
+#define DECIM_LEN 2000
+
+// breathing.c's band-pass, butter(3, [0.15, 0.5], "band", fs=100)
+static const float breathing_sos[3][5] = {
+    {1.3006349890880354e-06f, 2.6012699781760708e-06f, 1.3006349890880354e-06f,
+     -1.9779542874002389f, 0.97824715973025067f},
+    {1.0f, 0.0f, -1.0f, -1.9827743278082059f, 0.98365308932212403f},
+    {1.0f, -2.0f, 1.0f, -1.9944082065182183f, 0.99450687607191013f},
+};
+
+static void check_magnitude(int repeat) {
+  int8_t iq[2 * FRAME_SUBCARRIERS];
+  uint16_t mag[FRAME_SUBCARRIERS];
+  float ref[FRAME_SUBCARRIERS];
+  double err = 0;
+  // Every (imag, real) pair, one frame at a time
+  for (int base = 0; base < 256 * 256; base += FRAME_SUBCARRIERS) {
+    for (int k = 0; k < FRAME_SUBCARRIERS; k++) {
+      int v = (base + k) % (256 * 256);
+      iq[2 * k] = (int8_t)(v / 256 - 128);
+      iq[2 * k + 1] = (int8_t)(v % 256 - 128);
+    }
+    csi_dsp_magnitude(iq, mag, FRAME_SUBCARRIERS);
+    ref_magnitude(iq, ref, FRAME_SUBCARRIERS);
+    for (int k = 0; k < FRAME_SUBCARRIERS; k++) {
+      if (ref[k] > 0) {
+        double e = fabs(mag[k] / 32768.0 - ref[k]) / ref[k];
+        if (e > err)
+          err = e;
+      }
+    }
+  }
+
+  double fixed_t, float_t;
+  BENCH_TIME(repeat, csi_dsp_magnitude(iq, mag, FRAME_SUBCARRIERS), fixed_t);
+  bench_sink = mag[0];
+  BENCH_TIME(repeat, ref_magnitude(iq, ref, FRAME_SUBCARRIERS), float_t);
+  bench_sink = (int32_t)ref[0];
+  // One output LSB on top of the approximation for the smallest inputs
+  report("magnitude", err, CSI_DSP_MAGNITUDE_ERROR + 0.002, "relative",
+         fixed_t, float_t);
+}
+
+static void check_band_mean(int repeat) {
+  int8_t iq[2 * FRAME_SUBCARRIERS];
+  double err = 0;
+  q15_t re, im;
+  float ref_re, ref_im;
+  for (int frame = 0; frame < 1000; frame++) {
+    for (int i = 0; i < 2 * FRAME_SUBCARRIERS; i++) {
+      iq[i] = (int8_t)(rng_next() >> 24);
+    }
+    csi_dsp_band_mean(iq, 20, 30, &re, &im);
+    ref_band_mean(iq, 20, 30, &ref_re, &ref_im);
+    double e = fmax(fabs(re - ref_re * 32768.0), fabs(im - ref_im * 32768.0));
+    if (e > err)
+      err = e;
+  }
+
+  double fixed_t, float_t;
+  BENCH_TIME(repeat, csi_dsp_band_mean(iq, 20, 30, &re, &im), fixed_t);
+  bench_sink = re + im;
+  BENCH_TIME(repeat, ref_band_mean(iq, 20, 30, &ref_re, &ref_im), float_t);
+  bench_sink = (int32_t)(ref_re + ref_im);
+  // Exact sum, then one rounding of the division
+  report("band_mean", err, 0.5001, "Q15 LSB", fixed_t, float_t);
+}
+
+static void check_index_mean(int repeat) {
+  // A scattered selection as sc_rank.c produces, checked against the range
+  // reference one subcarrier at a time
+  static const uint8_t index[] = {1, 3, 5, 7, 26, 30, 31, 32, 38, 40};
+  const size_t n = sizeof(index);
+  int8_t iq[2 * FRAME_SUBCARRIERS];
+  double err = 0;
+  q15_t re, im;
+  float ref_re, ref_im;
+  for (int frame = 0; frame < 1000; frame++) {
+    for (int i = 0; i < 2 * FRAME_SUBCARRIERS; i++) {
+      iq[i] = (int8_t)(rng_next() >> 24);
+    }
+    csi_dsp_index_mean(iq, index, n, &re, &im);
+    ref_re = ref_im = 0;
+    for (size_t i = 0; i < n; i++) {
+      float r, m;
+      ref_band_mean(iq, index[i], index[i] + 1, &r, &m);
+      ref_re += r / n;
+      ref_im += m / n;
+    }
+    double e = fmax(fabs(re - ref_re * 32768.0), fabs(im - ref_im * 32768.0));
+    if (e > err)
+      err = e;
+  }
+
+  double fixed_t, float_t;
+  BENCH_TIME(repeat, csi_dsp_index_mean(iq, index, n, &re, &im), fixed_t);
+  bench_sink = re + im;
+  BENCH_TIME(repeat, ref_band_mean(iq, 20, 30, &ref_re, &ref_im), float_t);
+  bench_sink = (int32_t)(ref_re + ref_im);
+  // As band_mean, plus the float reference's own rounding over 10 terms
+  report("index_mean", err, 0.51, "Q15 LSB", fixed_t, float_t);
+}
+
+// Largest error over the RMS of the reference output
+static double rms_error(const float *ref, const double *fixed, size_t n) {
+  double sq = 0, worst = 0;
+  for (size_t i = 0; i < n; i++) {
+    sq += (double)ref[i] * ref[i];
+    double e = fabs(fixed[i] - ref[i]);
+    if (e > worst)
+      worst = e;
+  }
+  return sq > 0 ? worst / sqrt(sq / n) : worst;
+}
+
+static void check_biquad_q15(int repeat, float *x, float *ref, double *out,
+                             q15_t *q) {
+  // RBJ band-pass around 10 Hz at fs = 100, Q = 0.7
+  double w0 = 2 * M_PI * 10 / 100, alpha = sin(w0) / (2 * 0.7);
+  double a0 = 1 + alpha;
+  float c[5] = {(float)(alpha / a0), 0, (float)(-alpha / a0),
+                (float)(-2 * cos(w0) / a0), (float)((1 - alpha) / a0)};
+
+  for (int i = 0; i < SIGNAL_LEN; i++) {
+    x[i] = 0.4f * sinf(2 * (float)M_PI * 10 * i / 100) + 0.2f * rng_uniform();
+    q[i] = (q15_t)lrintf(x[i] * 32768);
+    ref[i] = q[i] / 32768.0f;
+  }
+  csi_dsp_biquad_q15_t s;
+  csi_dsp_biquad_q15_init(&s, c);
+  csi_dsp_biquad_q15(&s, 1, q, SIGNAL_LEN);
+  float w[4] = {0};
+  ref_biquad(c, w, ref, SIGNAL_LEN);
+  for (int i = 0; i < SIGNAL_LEN; i++) {
+    out[i] = q[i] / 32768.0;
+  }
+  double err = rms_error(ref, out, SIGNAL_LEN);
+
+  double fixed_t, float_t;
+  BENCH_TIME(repeat, csi_dsp_biquad_q15(&s, 1, q, SIGNAL_LEN), fixed_t);
+  BENCH_TIME(repeat, ref_biquad(c, w, ref, SIGNAL_LEN), float_t);
+  bench_sink = q[0] + (int32_t)ref[0];
+  report("biquad_q15", err, 0.01, "of RMS", fixed_t, float_t);
+}
+
+static void check_biquad_q31(int repeat, float *x, float *ref, double *out,
+                             q31_t *q) {
+  // Breathing-band input: 0.25 Hz plus broadband noise
+  for (int i = 0; i < SIGNAL_LEN; i++) {
+    x[i] = 0.3f * sinf(2 * (float)M_PI * 0.25f * i / 100) +
+           0.2f * rng_uniform();
+    q[i] = (q31_t)lrint(x[i] * 2147483648.0);
+    ref[i] = x[i];
+  }
+  csi_dsp_biquad_q31_t s[3];
+  float w[3][4] = {{0}};
+  for (int k = 0; k < 3; k++) {
+    csi_dsp_biquad_q31_init(&s[k], breathing_sos[k]);
+  }
+  csi_dsp_biquad_q31(s, 3, q, SIGNAL_LEN);
+  for (int k = 0; k < 3; k++) {
+    ref_biquad(breathing_sos[k], w[k], ref, SIGNAL_LEN);
+  }
+  for (int i = 0; i < SIGNAL_LEN; i++) {
+    out[i] = q[i] / 2147483648.0;
+  }
+  double err = rms_error(ref, out, SIGNAL_LEN);
+
+  double fixed_t, float_t;
+  BENCH_TIME(repeat, csi_dsp_biquad_q31(s, 3, q, SIGNAL_LEN), fixed_t);
+  BENCH_TIME(
+      repeat,
+      for (int k = 0; k < 3; k++) ref_biquad(breathing_sos[k], w[k], ref,
+                                             SIGNAL_LEN),
+      float_t);
+  bench_sink = q[0] + (int32_t)ref[0];
+  report("biquad_q31", err, 0.01, "of RMS", fixed_t, float_t);
+}
+
+static void check_movstat(int repeat) {
+  q15_t buf[STAT_WINDOW];
+  q15_t hist[STAT_WINDOW];
+  csi_dsp_movstat_t s;
+  csi_dsp_movstat_init(&s, buf, STAT_WINDOW);
+  double err = 0;
+  for (int i = 0; i < STAT_LEN; i++) {
+    q15_t x = (q15_t)(rng_next() >> 16);
+    hist[i % STAT_WINDOW] = x;
+    csi_dsp_movstat_push(&s, x);
+
+    int n = i + 1 < STAT_WINDOW ? i + 1 : STAT_WINDOW;
+    double mean = 0, var = 0;
+    for (int k = 0; k < n; k++) {
+      mean += hist[k];
+    }
+    mean /= n;
+    for (int k = 0; k < n; k++) {
+      var += (hist[k] - mean) * (hist[k] - mean);
+    }
+    var /= n;
+    // Mean in Q15 LSBs, variance (Q30 from Q15 inputs) in Q30 LSBs
+    err = fmax(err, fabs(csi_dsp_movstat_mean(&s) - mean));
+    err = fmax(err, fabs(csi_dsp_movstat_var(&s) - var));
+  }
+
+  double fixed_t, float_t;
+  float fbuf[STAT_WINDOW] = {0};
+  float fsum = 0, fsumsq = 0;
+  int fi = 0;
+  BENCH_TIME(repeat,
+             {
+               csi_dsp_movstat_push(&s, (q15_t)r_);
+               bench_sink = csi_dsp_movstat_var(&s);
+             },
+             fixed_t);
+  BENCH_TIME(repeat,
+             {
+               float x = r_ / 32768.0f;
+               fsum += x - fbuf[fi];
+               fsumsq += x * x - fbuf[fi] * fbuf[fi];
+               fbuf[fi] = x;
+               fi = (fi + 1) % STAT_WINDOW;
+               float mean = fsum / STAT_WINDOW;
+               bench_sink = (int32_t)(fsumsq / STAT_WINDOW - mean * mean);
+             },
+             float_t);
+  report("movstat", err, 0.5001, "LSB", fixed_t, float_t);
+}
+
+static void check_ewstat(int repeat) {
+  const int shift = 5;
+  const double alpha = 1.0 / (1 << shift);
+  csi_dsp_ewstat_t s;
+  csi_dsp_ewstat_init(&s, shift);
+  double mean = 0, var = 0, err = 0;
+  for (int i = 0; i < STAT_LEN; i++) {
+    // Slowly varying level plus noise, as subcarrier power
+    q15_t x = (q15_t)lrintf((0.3f + 0.2f * sinf(i / 500.0f) +
+                             0.05f * rng_uniform()) *
+                            32767);
+    csi_dsp_ewstat_push(&s, x);
+    double v = x / 32768.0;
+    if (i == 0) {
+      mean = v;
+    } else {
+      double delta = v - mean;
+      mean += alpha * delta;
+      var = (1 - alpha) * (var + alpha * delta * delta);
+    }
+    // Relative to full scale, 1.0, for the mean and the variance
+    err = fmax(err, fabs(s.mean / 1073741824.0 - mean));
+    err = fmax(err, fabs(s.var / 1073741824.0 - var));
+  }
+
+  double fixed_t, float_t;
+  float fmean = 0, fvar = 0;
+  const float falpha = (float)alpha;
+  BENCH_TIME(repeat, csi_dsp_ewstat_push(&s, (q15_t)r_), fixed_t);
+  bench_sink = s.var;
+  BENCH_TIME(repeat,
+             {
+               float delta = r_ / 32768.0f - fmean;
+               fmean += falpha * delta;
+               fvar = (1 - falpha) * (fvar + falpha * delta * delta);
+             },
+             float_t);
+  bench_sink = (int32_t)(fmean + fvar);
+  report("ewstat", err, 1e-5, "abs", fixed_t, float_t);
+}
+
+static void check_fft(int repeat, q15_t *q, float *f) {
+  const int n = 1 << FFT_LOG2;
+  // Inputs are kept after the working arrays and copied in for every run
+  q15_t *q_in = q + 2 * n;
+  float *f_in = f + 2 * n;
+  for (int i = 0; i < 2 * n; i++) {
+    float v = 0.5f * rng_uniform();
+    q[i] = q_in[i] = (q15_t)lrintf(v * 32768);
+    f[i] = f_in[i] = q[i] / 32768.0f;
+  }
+  int exponent = csi_dsp_fft_q15(q, FFT_LOG2);
+  ref_fft(f, n);
+  double scale = ldexp(1.0 / 32768, exponent), sq = 0, worst = 0;
+  for (int i = 0; i < 2 * n; i++) {
+    sq += (double)f[i] * f[i];
+    worst = fmax(worst, fabs(q[i] * scale - f[i]));
+  }
+  double err = worst / sqrt(sq / (2 * n));
+
+  double fixed_t, float_t;
+  BENCH_TIME(repeat,
+             {
+               memcpy(q, q_in, 2 * n * sizeof(q15_t));
+               bench_sink = csi_dsp_fft_q15(q, FFT_LOG2);
+             },
+             fixed_t);
+  BENCH_TIME(repeat,
+             {
+               memcpy(f, f_in, 2 * n * sizeof(float));
+               ref_fft(f, n);
+             },
+             float_t);
+  bench_sink = (int32_t)f[0];
+  report("fft_q15 1024", err, 0.02, "of RMS", fixed_t, float_t);
+}
+
+static void check_autocorr(int repeat, q15_t *x, q15_t *acf, q15_t *work,
+                           float *fx, float *facf, float *fwork) {
+  // Band-passed breathing signal: 15 BPM plus noise
+  for (int i = 0; i < ACF_LEN; i++) {
+    float v = 0.3f * sinf(2 * (float)M_PI * 0.25f * i / 100) +
+              0.05f * rng_uniform();
+    x[i] = (q15_t)lrintf(v * 32768);
+    fx[i] = x[i] / 32768.0f;
+  }
+  csi_dsp_autocorr_q15(x, acf, ACF_LEN, work, ACF_LOG2);
+  ref_autocorr(fx, facf, ACF_LEN, fwork, 1 << ACF_LOG2);
+  double err = 0;
+  for (int i = 0; i < ACF_LEN; i++) {
+    err = fmax(err, fabs(acf[i] / 32768.0 - facf[i]));
+  }
+
+  double fixed_t, float_t;
+  BENCH_TIME(repeat, csi_dsp_autocorr_q15(x, acf, ACF_LEN, work, ACF_LOG2),
+             fixed_t);
+  BENCH_TIME(repeat, ref_autocorr(fx, facf, ACF_LEN, fwork, 1 << ACF_LOG2),
+             float_t);
+  bench_sink = acf[1] + (int32_t)facf[1];
+  report("autocorr 1499", err, 0.01, "abs", fixed_t, float_t);
+}
+
+// Direct-form output m of the decimator, inputs before x[0] equal to x[0]
+static float ref_decim(const q15_t *coef, const int16_t *x, int channel,
+                       int m) {
+  const int len = DECIM_FACTOR * DECIM_PHASES;
+  int last = m * DECIM_FACTOR + DECIM_FACTOR - 1;
+  float y = 0;
+  for (int i = 0; i < len; i++) {
+    int n = last - i < 0 ? 0 : last - i;
+    y += coef[i] / 32768.0f * x[n * DECIM_CHANNELS + channel];
+  }
+  return y;
+}
+
+static void check_decim(int repeat, int16_t *x) {
+  static q15_t coef[DECIM_FACTOR * DECIM_PHASES];
+  int32_t acc[DECIM_PHASES * DECIM_CHANNELS];
+  int16_t y[DECIM_CHANNELS];
+  csi_dsp_decim_design(coef, DECIM_FACTOR, DECIM_PHASES);
+  // Breathing-band signals on an offset, plus broadband noise
+  for (int n = 0; n < DECIM_LEN; n++) {
+    for (int c = 0; c < DECIM_CHANNELS; c++) {
+      float v = 0.3f + 0.2f * sinf(2 * (float)M_PI * 0.25f * n / 100 + c) +
+                0.2f * rng_uniform();
+      x[n * DECIM_CHANNELS + c] = (int16_t)lrintf(v * 32767);
+    }
+  }
+
+  csi_dsp_decim_t d;
+  csi_dsp_decim_init(&d, coef, acc, DECIM_FACTOR, DECIM_PHASES,
+                     DECIM_CHANNELS);
+  double err = 0;
+  for (int n = 0, m = 0; n < DECIM_LEN; n++) {
+    if (!csi_dsp_decim_push(&d, &x[n * DECIM_CHANNELS], y))
+      continue;
+    for (int c = 0; c < DECIM_CHANNELS; c++) {
+      err = fmax(err, fabs(y[c] - ref_decim(coef, x, c, m)));
+    }
+    m++;
+  }
+
+  double fixed_t, float_t;
+  BENCH_TIME(repeat,
+             csi_dsp_decim_push(&d, &x[(r_ % DECIM_LEN) * DECIM_CHANNELS], y),
+             fixed_t);
+  bench_sink = y[0];
+  float fy = 0;
+  BENCH_TIME(repeat,
+             {
+               for (int c = 0; c < DECIM_CHANNELS; c++) {
+                 fy += ref_decim(coef, x, c, r_ % 100 + DECIM_PHASES);
+               }
+             },
+             float_t);
+  bench_sink = (int32_t)fy;
+  // Exact integer sums, one rounding; the float reference is per input
+  report("decim x10", err, 0.51, "LSB", fixed_t, float_t / DECIM_FACTOR);
+}
+
+int csi_dsp_bench_run(int repeat) {
+  const int fft_size = 1 << ACF_LOG2;
+  float *fbuf = malloc(2 * fft_size * sizeof(float) +
+                       2 * SIGNAL_LEN * sizeof(float));
+  double *dbuf = malloc(SIGNAL_LEN * sizeof(double));
+  q31_t *qbuf = malloc(2 * fft_size * sizeof(q15_t) +
+                       2 * ACF_LEN * sizeof(q15_t));
+  if (!fbuf || !dbuf || !qbuf) {
+    free(fbuf);
+    free(dbuf);
+    free(qbuf);
+    return -1;
+  }
+
+  rng_state = 2463534242u;
+  failures = 0;
+  csi_dsp_fft_init();
+  printf("csi_dsp: %d calls per timing, time per call\n", repeat);
+
+  float *f1 = fbuf, *f2 = fbuf + SIGNAL_LEN, *fwork = fbuf + 2 * SIGNAL_LEN;
+  q15_t *q15 = (q15_t *)qbuf;
+  check_magnitude(repeat);
+  check_band_mean(repeat);
+  check_index_mean(repeat);
+  check_biquad_q15(repeat, f1, f2, dbuf, q15);
+  check_biquad_q31(repeat, f1, f2, dbuf, qbuf);
+  check_movstat(repeat);
+  check_ewstat(repeat);
+  check_fft(repeat / 10 + 1, q15, fwork);
+  check_autocorr(repeat / 100 + 1, q15 + 2 * fft_size,
+                 q15 + 2 * fft_size + ACF_LEN, q15, f1, f2, fwork);
+  check_decim(repeat, q15);
+
+  free(fbuf);
+  free(dbuf);
+  free(qbuf);
+  return failures;
+}
+
+#endif
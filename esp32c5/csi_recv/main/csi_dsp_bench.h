@@ -0,0 +1,30 @@
+/* Accuracy checks and timings for the csi_dsp kernels
+
+   Runs every kernel in csi_dsp.h and a float reference of it on the same
+   deterministic input. It checks the largest error against a fixed bound
+   and prints time per call for both versions: CPU cycles on the device and
+   nanoseconds on a host. Set CSI_DSP_BENCH to 1 below to build it into
+   the firmware and run it at boot, or build host/csi_dsp_bench to run it
+   on Linux. Left at 0, the firmware image does not carry it.
+
+   Buffers are allocated for the duration of the run only.
+*/
+#pragma once
+
+#ifndef CSI_DSP_BENCH
+#define CSI_DSP_BENCH 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run all checks, timing each kernel over `repeat` calls
+ * @return number of kernels outside their error bound, -1 if out of memory
+ */
+int csi_dsp_bench_run(int repeat);
+
+#ifdef __cplusplus
+}
+#endif
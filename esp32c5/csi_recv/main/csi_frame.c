@@ -0,0 +1,184 @@
+#include "csi_frame.h"
+
+#include <string.h>
+
+static void put_le(uint8_t *p, uint64_t v, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    p[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+static uint64_t get_le(const uint8_t *p, int bytes) {
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; i++) {
+    v |= (uint64_t)p[i] << (8 * i);
+  }
+  return v;
+}
+
+void csi_frame_begin(csi_frame_writer_t *w, uint8_t *buf, size_t cap,
+                     const csi_frame_header_t *hdr) {
+  w->buf = buf;
+  w->cap = cap;
+  w->len = CSI_FRAME_HEADER_SIZE;
+  w->hdr = *hdr;
+  w->hdr.version = CSI_FRAME_VERSION;
+  w->hdr.frame_count = 0;
+  w->hdr.subcarriers = 0;
+  w->last_seq = 0;
+}
+
+bool csi_frame_add(csi_frame_writer_t *w, const int8_t *iq, size_t len,
+                   uint32_t seq) {
+  size_t prefix = (w->hdr.flags & CSI_FRAME_FLAG_SEQ) ? 4 : 0;
+  if (len == 0 || (len & 1) || w->len + prefix + len > w->cap)
+    return false;
+  if (w->hdr.frame_count > 0 && len != (size_t)w->hdr.subcarriers * 2)
+    return false;
+
+  if (prefix) {
+    put_le(w->buf + w->len, seq, 4);
+    w->len += prefix;
+  }
+  memcpy(w->buf + w->len, iq, len);
+  w->len += len;
+  w->hdr.subcarriers = (uint16_t)(len / 2);
+  w->hdr.frame_count++;
+  return true;
+}
+
+static size_t put_varint(uint8_t *p, uint32_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    p[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  p[n++] = (uint8_t)v;
+  return n;
+}
+
+// Bytes read, 0 if truncated or longer than CSI_FRAME_CODED_SEQ_SIZE
+static size_t get_varint(const uint8_t *p, size_t avail, uint32_t *v) {
+  *v = 0;
+  for (size_t n = 0; n < avail && n < CSI_FRAME_CODED_SEQ_SIZE; n++) {
+    *v |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+    if (!(p[n] & 0x80))
+      return n + 1;
+  }
+  return 0;
+}
+
+// Sequence number of a coded frame, relative to the previous one
+static uint32_t seq_code(uint32_t seq, uint32_t prev) {
+  uint32_t d = seq - prev - 1;
+  return (d << 1) ^ (uint32_t)-(int32_t)(d >> 31);
+}
+
+static uint32_t seq_decode(uint32_t code, uint32_t prev) {
+  return prev + 1 + ((code >> 1) ^ (uint32_t)-(int32_t)(code & 1));
+}
+
+bool csi_frame_add_coded(csi_frame_writer_t *w, csi_codec_t *codec,
+                         const int8_t *iq, size_t len, uint32_t seq) {
+  if (len == 0 || (len & 1))
+    return false;
+  if (w->hdr.frame_count > 0 && len != (size_t)w->hdr.subcarriers * 2)
+    return false;
+
+  uint8_t prefix[CSI_FRAME_CODED_SEQ_SIZE];
+  size_t n = 0;
+  if (w->hdr.flags & CSI_FRAME_FLAG_SEQ)
+    n = put_varint(prefix,
+                   w->hdr.frame_count ? seq_code(seq, w->last_seq) : seq);
+  if (w->len + n > w->cap)
+    return false;
+  size_t coded = csi_codec_encode(codec, w->hdr.layout, iq, len,
+                                  w->buf + w->len + n, w->cap - w->len - n);
+  if (coded == 0)
+    return false;
+
+  memcpy(w->buf + w->len, prefix, n);
+  w->len += n + coded;
+  w->last_seq = seq;
+  w->hdr.subcarriers = (uint16_t)(len / 2);
+  w->hdr.frame_count++;
+  return true;
+}
+
+size_t csi_frame_finish(csi_frame_writer_t *w) {
+  uint8_t *p = w->buf;
+  p[0] = CSI_FRAME_MAGIC;
+  p[1] = w->hdr.version;
+  p[2] = w->hdr.flags;
+  p[3] = (uint8_t)w->hdr.rssi;
+  put_le(p + 4, w->hdr.seq, 4);
+  put_le(p + 8, (uint64_t)w->hdr.timestamp_us, 8);
+  put_le(p + 16, w->hdr.frame_count, 2);
+  put_le(p + 18, w->hdr.subcarriers, 2);
+  p[20] = w->hdr.motion_confidence;
+  p[21] = w->hdr.layout;
+  p[22] = w->hdr.link;
+  p[23] = 0;
+  return w->len;
+}
+
+bool csi_frame_parse(const uint8_t *buf, size_t len, csi_frame_header_t *hdr,
+                     const int8_t **iq) {
+  if (len < CSI_FRAME_HEADER_SIZE_V1 || buf[0] != CSI_FRAME_MAGIC)
+    return false;
+  size_t header_size;
+  if (buf[1] == CSI_FRAME_VERSION)
+    header_size = CSI_FRAME_HEADER_SIZE;
+  else if (buf[1] == 1)
+    header_size = CSI_FRAME_HEADER_SIZE_V1;
+  else
+    return false;
+  if (len < header_size)
+    return false;
+
+  hdr->version = buf[1];
+  hdr->flags = buf[2];
+  hdr->rssi = (int8_t)buf[3];
+  hdr->seq = (uint32_t)get_le(buf + 4, 4);
+  hdr->timestamp_us = (int64_t)get_le(buf + 8, 8);
+  hdr->frame_count = (uint16_t)get_le(buf + 16, 2);
+  hdr->subcarriers = (uint16_t)get_le(buf + 18, 2);
+  hdr->motion_confidence = header_size > 20 ? buf[20] : 0;
+  hdr->layout = header_size > 21 ? buf[21] : 0;
+  hdr->link = header_size > 22 ? buf[22] : 0;
+
+  size_t frame = (size_t)hdr->subcarriers * 2 +
+                 ((hdr->flags & CSI_FRAME_FLAG_SEQ) ? 4 : 0);
+  size_t payload = (size_t)hdr->frame_count * frame;
+  if (!(hdr->flags & CSI_FRAME_FLAG_CODED) && len - header_size < payload)
+    return false;
+  if (iq)
+    *iq = (const int8_t *)(buf + header_size);
+  return true;
+}
+
+bool csi_frame_decode_coded(const csi_frame_header_t *hdr,
+                            const uint8_t *payload, size_t len,
+                            csi_codec_t *codec, int8_t *iq, uint32_t *seq,
+                            uint8_t *valid) {
+  size_t row = (size_t)hdr->subcarriers * 2;
+  size_t pos = 0;
+  for (size_t f = 0; f < hdr->frame_count; f++) {
+    if (hdr->flags & CSI_FRAME_FLAG_SEQ) {
+      uint32_t code;
+      size_t n = get_varint(payload + pos, len - pos, &code);
+      if (n == 0)
+        return false;
+      seq[f] = f ? seq_decode(code, seq[f - 1]) : code;
+      pos += n;
+    }
+    bool ok;
+    size_t n = csi_codec_decode(codec, hdr->layout, payload + pos, len - pos,
+                                iq + f * row, row, &ok);
+    if (n == 0)
+      return false;
+    valid[f] = ok;
+    pos += n;
+  }
+  return true;
+}
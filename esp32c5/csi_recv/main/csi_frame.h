@@ -0,0 +1,150 @@
+/* Binary CSI wire format for MQTT
+
+   One message carries a fixed header followed by `frame_count` frames of raw
+   int8 I/Q, each `subcarriers * 2` bytes long. All frames of a message have
+   the same layout (csi_layout.h), whose id is in the header. With
+   CSI_FRAME_FLAG_SEQ set,
+   every frame is prefixed by the u32 sequence number of the ESP-NOW probe it
+   was measured on (csi_probe.h). All multi-byte fields are little-endian.
+
+   With CSI_FRAME_FLAG_CODED, every frame is instead its csi_codec.h
+   encoding, of varying length. With CSI_FRAME_FLAG_SEQ it is preceded by
+   its sequence number as a LEB128 varint: the number itself for the first
+   frame, for the others the step from the previous one minus 1, zigzag
+   coded, which is a single zero byte for consecutive probes. Inter frames
+   depend on the frames of earlier messages, so a receiver resets its
+   decoder when the message sequence number skips and picks up again at
+   the next keyframe.
+
+   offset  size  field
+        0     1  magic (CSI_FRAME_MAGIC)
+        1     1  version (CSI_FRAME_VERSION)
+        2     1  flags, bit 0 = motion detected, bit 1 = per-frame sequence,
+                 bit 2 = first word invalid, bit 3 = coded frames
+        3     1  rssi (int8, dBm)
+        4     4  sequence number
+        8     8  timestamp (us since boot)
+       16     2  frame count
+       18     2  subcarriers per frame
+       20     1  motion confidence, 0-255 (version 2)
+       21     1  layout id, 0 = not stated (version 2)
+       22     1  link, the transmitter the frames came from, 0 = the
+                 only or first one (version 2, see csi_link.h)
+       23     1  reserved, zero (version 2)
+       24     -  I/Q payload
+
+   Version 1 messages end the header at offset 20 and carry no confidence.
+   Senders that predate the link byte leave it zero, as a single
+   transmitter.
+   Version 2 senders that predate the layout byte leave it zero; receivers
+   then infer the layout from the subcarrier count.
+
+   The magic byte is never a valid first character of the legacy
+   comma-separated text format, so receivers can accept both on one topic.
+*/
+#pragma once
+
+#include "csi_codec.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_FRAME_MAGIC 0xC5
+#define CSI_FRAME_VERSION 2
+#define CSI_FRAME_HEADER_SIZE 24
+#define CSI_FRAME_HEADER_SIZE_V1 20
+#define CSI_FRAME_FLAG_MOTION 0x01
+#define CSI_FRAME_FLAG_SEQ 0x02
+#define CSI_FRAME_FLAG_FIRST_WORD_INVALID 0x04
+#define CSI_FRAME_FLAG_CODED 0x08
+// Largest varint sequence number before a coded frame
+#define CSI_FRAME_CODED_SEQ_SIZE 5
+
+typedef struct {
+  uint8_t version;
+  uint8_t flags;
+  int8_t rssi;
+  uint32_t seq;
+  int64_t timestamp_us;
+  uint16_t frame_count;
+  uint16_t subcarriers;
+  uint8_t motion_confidence; /**< 0-255, 0 in version 1 messages */
+  uint8_t layout;            /**< csi_layout_id_t, 0 if not stated */
+  uint8_t link;              /**< transmitter, 0 in version 1 messages */
+} csi_frame_header_t;
+
+typedef struct {
+  uint8_t *buf;
+  size_t cap;
+  size_t len;
+  csi_frame_header_t hdr;
+  uint32_t last_seq; /**< sequence number of the last coded frame */
+} csi_frame_writer_t;
+
+/**
+ * @brief Start a message in a caller-owned buffer
+ * @param[in] hdr header fields; frame_count and subcarriers are filled in as
+ *            frames are added
+ */
+void csi_frame_begin(csi_frame_writer_t *w, uint8_t *buf, size_t cap,
+                     const csi_frame_header_t *hdr);
+
+/**
+ * @brief Append one frame of raw I/Q bytes
+ * @param[in] seq probe sequence number, written only if the header has
+ *            CSI_FRAME_FLAG_SEQ
+ * @return false if the buffer is full or `len` differs from the frames
+ *         already in the message; the message is left unchanged
+ */
+bool csi_frame_add(csi_frame_writer_t *w, const int8_t *iq, size_t len,
+                   uint32_t seq);
+
+/**
+ * @brief Append one frame to a message whose header has
+ *        CSI_FRAME_FLAG_CODED, encoded with `codec`
+ * @return false if the frame does not fit or `len` differs from the frames
+ *         already in the message; message and codec are left unchanged
+ */
+bool csi_frame_add_coded(csi_frame_writer_t *w, csi_codec_t *codec,
+                         const int8_t *iq, size_t len, uint32_t seq);
+
+/**
+ * @brief Write the header and return the total message length in bytes
+ */
+size_t csi_frame_finish(csi_frame_writer_t *w);
+
+/**
+ * @brief Parse and validate a message header
+ *
+ * `iq` points at the first frame; frames are `subcarriers * 2` bytes apart,
+ * plus 4 with CSI_FRAME_FLAG_SEQ. Coded payloads are only checked by
+ * csi_frame_decode_coded().
+ * @return false on bad magic, unknown version or a truncated payload;
+ *         version 1 messages are accepted
+ */
+bool csi_frame_parse(const uint8_t *buf, size_t len, csi_frame_header_t *hdr,
+                     const int8_t **iq);
+
+/**
+ * @brief Decode the frames of a CSI_FRAME_FLAG_CODED message
+ * @param[in] payload the bytes after the header, `iq` of csi_frame_parse()
+ * @param[out] iq frame_count frames of subcarriers * 2 bytes
+ * @param[out] seq per-frame sequence numbers, only with CSI_FRAME_FLAG_SEQ;
+ *             may be NULL otherwise
+ * @param[out] valid per frame, 0 if it could not be decoded for lack of a
+ *             reference frame (csi_codec_decode())
+ * @return false if the payload is truncated or malformed
+ */
+bool csi_frame_decode_coded(const csi_frame_header_t *hdr,
+                            const uint8_t *payload, size_t len,
+                            csi_codec_t *codec, int8_t *iq, uint32_t *seq,
+                            uint8_t *valid);
+
+#ifdef __cplusplus
+}
+#endif
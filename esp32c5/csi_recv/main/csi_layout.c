@@ -0,0 +1,46 @@
+#include "csi_layout.h"
+
+#include <string.h>
+
+// Pairs [0, valid) of the band view came from the invalid first word
+static void repair_first_word(int8_t *out, int valid) {
+  for (int k = 0; k < valid; k++) {
+    out[2 * k] = out[2 * valid];
+    out[2 * k + 1] = out[2 * valid + 1];
+  }
+}
+
+// One band copy per layout, `offset` being the layout's band_offset
+#define CSI_LAYOUT_BAND_FN(name, offset)                                       \
+  static void band_##name(const int8_t *iq, bool first_word_invalid,           \
+                          int8_t *out) {                                       \
+    memcpy(out, iq + 2 * (offset), CSI_LAYOUT_BAND_LEN);                       \
+    if ((offset) < 2 && first_word_invalid)                                    \
+      repair_first_word(out, 2 - (offset));                                    \
+  }
+
+CSI_LAYOUT_BAND_FN(lltf, 0)
+CSI_LAYOUT_BAND_FN(ht20, 2)
+CSI_LAYOUT_BAND_FN(ht40_above, 0)
+CSI_LAYOUT_BAND_FN(ht40_below, 64)
+
+static const csi_layout_t layouts[CSI_LAYOUT_COUNT] = {
+    {CSI_LAYOUT_UNKNOWN, "unknown", 0, 0, 0, 0, NULL},
+    {CSI_LAYOUT_LLTF, "lltf", 106, 20, 0, 0, band_lltf},
+    {CSI_LAYOUT_HT20, "ht20", CSI_LAYOUT_HT20_LEN, 20, 0, 2, band_ht20},
+    {CSI_LAYOUT_HT40_ABOVE, "ht40+", 234, 40, 1, 0, band_ht40_above},
+    {CSI_LAYOUT_HT40_BELOW, "ht40-", 234, 40, 2, 64, band_ht40_below},
+};
+
+const csi_layout_t *csi_layout_lookup(uint16_t len, uint8_t second) {
+  for (int i = 1; i < CSI_LAYOUT_COUNT; i++) {
+    const csi_layout_t *l = &layouts[i];
+    if (l->len == len && (l->bandwidth == 20 || l->second == second))
+      return l;
+  }
+  return &layouts[CSI_LAYOUT_UNKNOWN];
+}
+
+const csi_layout_t *csi_layout_get(uint8_t id) {
+  return &layouts[id < CSI_LAYOUT_COUNT ? id : CSI_LAYOUT_UNKNOWN];
+}
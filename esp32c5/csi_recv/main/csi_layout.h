@@ -0,0 +1,86 @@
+/* CSI frame layouts
+
+   wifi_csi_init() acquires both HT20 and HT40 channel estimates, so the
+   length and meaning of wifi_csi_info_t.buf change from packet to packet.
+   Every layout the receiver can produce is described once in a table,
+   keyed on the buffer length and, for 40 MHz, the secondary channel
+   position:
+
+   id  layout        bytes  subcarriers
+    1  L-LTF 20 MHz    106  -26..26
+    2  HT-LTF 20 MHz   114  -28..28
+    3  HT-LTF 40 MHz   234  -58..58, secondary channel above
+    4  HT-LTF 40 MHz   234  -58..58, secondary channel below
+
+   Subcarriers are stored in ascending order as interleaved int8 (imag, real)
+   pairs. With first_word_invalid set, the first two pairs are not valid.
+
+   The analysis stages don't read the raw buffer. They read the band view:
+   subcarriers -26..26 of the primary 20 MHz channel, which all layouts
+   contain. Each layout has its own copy routine into that view. The offset
+   and the first-word repair are fixed at compile time, so a frame of any
+   layout costs one constant-size copy. A frame that matches no entry has
+   layout CSI_LAYOUT_UNKNOWN and no band view.
+
+   The layout ids are part of the MQTT wire format (csi_frame.h), and
+   backend/csi_frame.py mirrors this table. The module has no ESP-IDF
+   dependencies and builds on any host.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  CSI_LAYOUT_UNKNOWN = 0,
+  CSI_LAYOUT_LLTF = 1,
+  CSI_LAYOUT_HT20 = 2,
+  CSI_LAYOUT_HT40_ABOVE = 3,
+  CSI_LAYOUT_HT40_BELOW = 4,
+  CSI_LAYOUT_COUNT
+} csi_layout_id_t;
+
+// info->len of an HT20 frame, the only layout of the legacy text payload
+#define CSI_LAYOUT_HT20_LEN 114
+
+// Band view: subcarriers -26..26 of the primary 20 MHz channel
+#define CSI_LAYOUT_BAND_FIRST (-26)
+#define CSI_LAYOUT_BAND_SUBCARRIERS 53
+#define CSI_LAYOUT_BAND_LEN (2 * CSI_LAYOUT_BAND_SUBCARRIERS)
+
+typedef struct {
+  uint8_t id;
+  const char *name;
+  uint16_t len;        /**< info->len, bytes */
+  uint8_t bandwidth;   /**< MHz */
+  uint8_t second;      /**< rx_ctrl.second: 0 none, 1 above, 2 below */
+  uint8_t band_offset; /**< pair index of primary subcarrier -26 */
+  /**
+   * @brief Copy the band view out of a raw buffer of this layout; invalid
+   *        first pairs are replaced by the nearest valid one
+   */
+  void (*band)(const int8_t *iq, bool first_word_invalid, int8_t *out);
+} csi_layout_t;
+
+/**
+ * @brief Layout of a received buffer
+ * @param[in] second secondary channel, only used to tell 40 MHz layouts
+ *            apart; a 40 MHz buffer with second == 0 is unknown
+ * @return never NULL, the CSI_LAYOUT_UNKNOWN entry (band == NULL) if no
+ *         layout matches
+ */
+const csi_layout_t *csi_layout_lookup(uint16_t len, uint8_t second);
+
+/**
+ * @brief Table entry for an id, the CSI_LAYOUT_UNKNOWN entry if out of range
+ */
+const csi_layout_t *csi_layout_get(uint8_t id);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,40 @@
+#include "csi_link.h"
+
+#include <string.h>
+
+void csi_link_init(csi_link_table_t *t, size_t capacity,
+                   const uint8_t match[6], uint64_t mask) {
+  memset(t, 0, sizeof(*t));
+  t->capacity = capacity > CSI_LINK_MAX ? CSI_LINK_MAX : (uint8_t)capacity;
+  t->mask = mask & CSI_LINK_MASK_ALL;
+  t->match = csi_link_key(match) & t->mask;
+}
+
+int csi_link_lookup(csi_link_table_t *t, const uint8_t mac[6]) {
+  uint64_t key = csi_link_key(mac);
+  if (t->count > 0 && t->key[t->last] == key)
+    return t->last;
+  if ((key & t->mask) != t->match) {
+    t->foreign++;
+    return -1;
+  }
+  for (uint8_t i = 0; i < t->count; i++) {
+    if (t->key[i] == key) {
+      t->last = i;
+      return i;
+    }
+  }
+  if (t->count == t->capacity) {
+    t->rejected++;
+    return -1;
+  }
+  t->key[t->count] = key;
+  t->last = t->count;
+  return t->count++;
+}
+
+void csi_link_mac(const csi_link_table_t *t, int link, uint8_t mac[6]) {
+  for (int i = 0; i < 6; i++) {
+    mac[i] = (uint8_t)(t->key[link] >> (8 * (5 - i)));
+  }
+}
@@ -0,0 +1,80 @@
+/* Transmitter links of one receiver
+
+   A receiver can take CSI from several csi_send boards at once, one link
+   per transmitter MAC. The table maps the MAC of a received frame to a
+   link index in [0, capacity), which the caller uses to pick the link's
+   ring, motion state and calibration. Links are assigned in the order
+   their first frame arrives and kept until csi_link_init() is called
+   again; frames of a transmitter that arrives when the table is full are
+   counted and rejected.
+
+   Only MACs that match `match` on the bits set in `mask` get a link, so
+   the other stations and access points a promiscuous radio hears do not
+   take up entries. A MAC is packed into a 48-bit key, first byte in the
+   top bits, so the comparison is a single integer compare. Lookup checks
+   the link of the previous frame first, then scans the table: the table
+   is small and the transmitters take turns, a hash would not pay off.
+
+   The lookup runs in the Wi-Fi task's CSI callback, the table is not
+   safe to use from several tasks.
+
+   The module has no ESP-IDF dependencies and builds on any host.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest table; a receiver sizes its per-link state for its own capacity
+#define CSI_LINK_MAX 16
+// Mask of a whole MAC
+#define CSI_LINK_MASK_ALL 0xFFFFFFFFFFFFull
+
+typedef struct {
+  uint64_t key[CSI_LINK_MAX];
+  uint8_t count;
+  uint8_t capacity;
+  uint8_t last; /**< link of the previous hit */
+  uint64_t match;
+  uint64_t mask;
+  uint32_t foreign;  /**< frames from MACs outside the mask */
+  uint32_t rejected; /**< frames of admitted MACs the table had no room for */
+} csi_link_table_t;
+
+/**
+ * @brief Pack a MAC into a table key
+ */
+static inline uint64_t csi_link_key(const uint8_t mac[6]) {
+  return (uint64_t)mac[0] << 40 | (uint64_t)mac[1] << 32 |
+         (uint64_t)mac[2] << 24 | (uint64_t)mac[3] << 16 |
+         (uint64_t)mac[4] << 8 | mac[5];
+}
+
+/**
+ * @brief Empty the table
+ * @param[in] capacity links, at most CSI_LINK_MAX
+ * @param[in] match MAC the admitted ones share on the `mask` bits
+ * @param[in] mask csi_link_key() of the bits compared, CSI_LINK_MASK_ALL
+ *            for a single transmitter
+ */
+void csi_link_init(csi_link_table_t *t, size_t capacity,
+                   const uint8_t match[6], uint64_t mask);
+
+/**
+ * @brief Link of a frame from `mac`, assigning a new one if there is room
+ * @return link index, -1 if the MAC is foreign or the table full
+ */
+int csi_link_lookup(csi_link_table_t *t, const uint8_t mac[6]);
+
+/**
+ * @brief MAC of link `link`, which must be below t->count
+ */
+void csi_link_mac(const csi_link_table_t *t, int link, uint8_t mac[6]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,163 @@
+#include "csi_link_bench.h"
+
+// Only in firmware built with the bench, always on a host
+#if CSI_LINK_BENCH || !defined(ESP_PLATFORM)
+
+#include "csi_link.h"
+#include "csi_ring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#define BENCH_UNIT "cycles"
+
+typedef uint32_t bench_time_t;
+
+static bench_time_t bench_now(void) { return esp_cpu_get_cycle_count(); }
+#else
+#include <time.h>
+#define BENCH_UNIT "ns"
+
+typedef uint64_t bench_time_t;
+
+static bench_time_t bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+// HT20 frame, see csi_layout.h
+#define FRAME_LEN 114
+// Frames queued per link before the consumer side empties the rings, well
+// below CSI_RING_FRAMES so no frame is dropped while timed
+#define BATCH (CSI_RING_FRAMES / 2)
+
+// Keeps the compiler from dropping a timed loop whose result is unused
+static volatile int bench_sink;
+
+static const uint8_t sender_mac[6] = {0x1a, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+// Transmitters share the first five bytes, as csi_send boards do
+static void link_macs(uint8_t (*macs)[6], int links) {
+  for (int i = 0; i < links; i++) {
+    memcpy(macs[i], sender_mac, 6);
+    macs[i][5] = (uint8_t)i;
+  }
+}
+
+static void table_init(csi_link_table_t *t, int links) {
+  csi_link_init(t, (size_t)links, sender_mac, CSI_LINK_MASK_ALL & ~0xFFull);
+}
+
+// Time per frame of csi_link_lookup() over `repeat` rounds of all links
+static double time_lookup(int links, int repeat, uint8_t (*macs)[6]) {
+  csi_link_table_t table;
+  table_init(&table, links);
+  int sum = 0;
+  bench_time_t start = bench_now();
+  for (int r = 0; r < repeat; r++) {
+    for (int l = 0; l < links; l++) {
+      sum += csi_link_lookup(&table, macs[l]);
+    }
+  }
+  bench_time_t elapsed = bench_now() - start;
+  bench_sink = sum;
+  return (double)elapsed / ((double)repeat * links);
+}
+
+// Time per frame of a MAC outside the mask, against a full table
+static double time_foreign(int links, int repeat, uint8_t (*macs)[6]) {
+  csi_link_table_t table;
+  table_init(&table, links);
+  for (int l = 0; l < links; l++) {
+    csi_link_lookup(&table, macs[l]);
+  }
+  uint8_t foreign[6] = {0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56};
+  int sum = 0;
+  bench_time_t start = bench_now();
+  for (int r = 0; r < repeat; r++) {
+    foreign[5] = (uint8_t)r;
+    sum += csi_link_lookup(&table, foreign);
+  }
+  bench_time_t elapsed = bench_now() - start;
+  bench_sink = sum;
+  return (double)elapsed / repeat;
+}
+
+// Time per frame of the callback's dispatch: lookup, claim a slot in the
+// link's ring, copy the frame and commit. The rings are emptied between
+// batches, outside the timing.
+static double time_dispatch(int links, int repeat, uint8_t (*macs)[6],
+                            csi_ring_t *rings, const int8_t *frame) {
+  csi_link_table_t table;
+  table_init(&table, links);
+  for (int l = 0; l < links; l++) {
+    csi_ring_init(&rings[l]);
+  }
+  bench_time_t elapsed = 0;
+  int frames = 0;
+  for (int done = 0; done < repeat; done += BATCH) {
+    bench_time_t start = bench_now();
+    for (int b = 0; b < BATCH; b++) {
+      for (int l = 0; l < links; l++) {
+        int link = csi_link_lookup(&table, macs[l]);
+        if (link < 0)
+          continue;
+        csi_ring_slot_t *slot = csi_ring_claim(&rings[link]);
+        if (!slot)
+          continue;
+        memcpy(slot->data, frame, FRAME_LEN);
+        slot->len = FRAME_LEN;
+        slot->rssi = -40;
+        slot->probe = false;
+        csi_ring_commit(&rings[link]);
+      }
+    }
+    elapsed += bench_now() - start;
+    frames += BATCH * links;
+    for (int l = 0; l < links; l++) {
+      csi_ring_pop(&rings[l], csi_ring_count(&rings[l]));
+    }
+  }
+  bench_sink = (int)atomic_load(&rings[0].dropped);
+  return (double)elapsed / frames;
+}
+
+int csi_link_bench_run(int repeat) {
+  static const int link_counts[] = {1, 4, 16};
+  uint8_t macs[CSI_LINK_MAX][6];
+  int8_t frame[FRAME_LEN];
+  for (int i = 0; i < FRAME_LEN; i++) {
+    frame[i] = (int8_t)(i * 7 - 64);
+  }
+
+  int skipped = 0;
+  printf("csi_link: %d frames per link per timing, time per frame\n",
+         repeat);
+  for (size_t i = 0; i < sizeof(link_counts) / sizeof(link_counts[0]); i++) {
+    int links = link_counts[i];
+    link_macs(macs, links);
+    csi_ring_t *rings = malloc((size_t)links * sizeof(csi_ring_t));
+    if (!rings) {
+      printf("%2d link(s): skipped, %u B of rings do not fit\n", links,
+             (unsigned)(links * sizeof(csi_ring_t)));
+      skipped++;
+      continue;
+    }
+    double lookup = time_lookup(links, repeat, macs);
+    double foreign = time_foreign(links, repeat, macs);
+    double dispatch = time_dispatch(links, repeat, macs, rings, frame);
+    printf("%2d link(s): lookup %8.1f %s, foreign %8.1f %s, dispatch %8.1f "
+           "%s\n",
+           links, lookup, BENCH_UNIT, foreign, BENCH_UNIT, dispatch,
+           BENCH_UNIT);
+    free(rings);
+  }
+  return skipped;
+}
+
+#endif
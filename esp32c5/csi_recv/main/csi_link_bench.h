@@ -0,0 +1,34 @@
+/* Timings for the per-frame link lookup and dispatch
+
+   Feeds HT20 frames from 1, 4 and 16 transmitters, taking turns, through
+   the steps the CSI callback runs for every frame: csi_link_lookup(),
+   then claiming a slot in the link's ring, copying the frame in and
+   committing it. It prints the time per frame for the lookup alone and
+   for the whole dispatch, CPU cycles on the device and nanoseconds on a
+   host, plus the lookup of a frame from a foreign MAC. Set CSI_LINK_BENCH
+   to 1 below to build it into the firmware and run it at boot, or build
+   host/csi_link_bench to run it on Linux. Left at 0, the firmware image
+   does not carry it.
+
+   The rings are allocated for the duration of the run only; a link count
+   whose rings do not fit in memory is skipped.
+*/
+#pragma once
+
+#ifndef CSI_LINK_BENCH
+#define CSI_LINK_BENCH 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Time every link count over `repeat` frames per link
+ * @return number of link counts skipped for lack of memory
+ */
+int csi_link_bench_run(int repeat);
+
+#ifdef __cplusplus
+}
+#endif
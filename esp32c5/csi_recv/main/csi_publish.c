@@ -0,0 +1,256 @@
+#include "csi_publish.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+_Static_assert(CSI_RING_SLOT_SIZE <= CSI_CODEC_MAX_LEN,
+               "every ring slot can be coded");
+
+void csi_publish_init(csi_publish_t *p, const csi_publish_config_t *config) {
+  memset(p, 0, sizeof(*p));
+  p->config = *config;
+  if (p->config.subcarrier_count > CSI_PUBLISH_MAX_SUBCARRIERS)
+    p->config.subcarrier_count = CSI_PUBLISH_MAX_SUBCARRIERS;
+  publish_sched_init(&p->sched, config->sched);
+  csi_backlog_init(&p->backlog, config->backlog_buf, config->backlog_size);
+}
+
+void csi_publish_link_init(csi_publish_link_t *link, uint8_t id) {
+  memset(link, 0, sizeof(*link));
+  csi_ring_init(&link->q);
+  motion_init(&link->motion);
+  csi_codec_init(&link->codec);
+  link->id = id;
+}
+
+static uint8_t motion_confidence_u8(const csi_publish_link_t *link) {
+  return (uint8_t)lrintf(link->motion.confidence * 255);
+}
+
+// Hand published frames back to the CSI callback
+static void release(csi_publish_link_t *link, size_t frames) {
+  csi_ring_pop(&link->q, frames);
+  link->analysed -= frames;
+}
+
+// Messages are enqueued when the plan says so and none are held, so they
+// arrive in order; the message id, 0 if it went to the backlog, -1 if it
+// is too large for the transport
+static int publish_data(csi_publish_t *p, const uint8_t *data, size_t len,
+                        const publish_plan_t *plan) {
+  if (p->config.max_message && len > p->config.max_message) {
+    p->sched.oversize++;
+    return -1;
+  }
+  if (plan->enqueue && p->backlog.count == 0) {
+    int msg_id = p->config.transport.enqueue(p->config.transport.ctx, data,
+                                             len, plan->qos);
+    if (msg_id >= 0) {
+      p->sent++;
+      return msg_id;
+    }
+  }
+  csi_backlog_push(&p->backlog, data, len);
+  return 0;
+}
+
+// Send up to backlog_flush held messages, oldest first, as long as the
+// outbox stays clear of the first pressure level
+static void flush_backlog(csi_publish_t *p) {
+  const csi_publish_transport_t *t = &p->config.transport;
+  const uint8_t *data;
+  size_t len;
+  uint32_t limit = p->sched.config.outbox_bytes[PUBLISH_LEVEL_BATCH] / 2;
+  for (unsigned i = 0; i < p->config.backlog_flush &&
+                       t->outbox_size(t->ctx) < limit &&
+                       (data = csi_backlog_front(&p->backlog, &len)) != NULL;
+       i++) {
+    if (t->enqueue(t->ctx, data, len, 1) < 0)
+      break;
+    csi_backlog_pop(&p->backlog);
+    p->sent++;
+  }
+}
+
+// Appends one printf field, false if it does not fit in `remaining`
+static bool text_append(char **out, size_t *remaining, const char *fmt,
+                        int value) {
+  int written = snprintf(*out, *remaining, fmt, value);
+  if (written < 0 || (size_t)written >= *remaining)
+    return false;
+  *out += written;
+  *remaining -= (size_t)written;
+  return true;
+}
+
+// Legacy text payload: "i0,q0,...,motion,rssi". The backend reads it as
+// rows of an HT20 frame and it has no layout byte, so it only carries HT20
+// frames: frames of other layouts at the front are dropped and counted in
+// unsendable, and a batch ends at the next one. It cannot name the link
+// either, csi_publish_tick() only publishes link 0 in this format. 0 if
+// there were only frames to drop, -1 if the frames do not fit in
+// text_buffer; they are dropped with the message.
+static int publish_text(csi_publish_t *p, csi_publish_link_t *link,
+                        size_t frames, const publish_plan_t *plan) {
+  size_t skipped = 0;
+  while (skipped < frames &&
+         csi_ring_peek(&link->q, skipped)->layout != CSI_LAYOUT_HT20)
+    skipped++;
+  p->unsendable += skipped;
+  release(link, skipped);
+  frames -= skipped;
+
+  size_t batch = 0;
+  while (batch < frames &&
+         csi_ring_peek(&link->q, batch)->layout == CSI_LAYOUT_HT20)
+    batch++;
+  if (batch == 0)
+    return 0;
+  frames = batch;
+
+  char *out = p->text_buffer;
+  size_t remaining = sizeof(p->text_buffer);
+  bool fits = true;
+
+  // Format straight out of the ring slots, they are released afterwards
+  for (size_t f = 0; f < frames && fits; f++) {
+    const csi_ring_slot_t *slot = csi_ring_peek(&link->q, f);
+    for (int i = 0; i < slot->len && fits; i++) {
+      fits = text_append(&out, &remaining, "%d,", slot->data[i]);
+    }
+  }
+  release(link, frames);
+  fits = fits && text_append(&out, &remaining, "%d,", link->motion.motion) &&
+         text_append(&out, &remaining, "%d", link->last_rssi);
+  if (!fits)
+    return -1;
+
+  return publish_data(p, (const uint8_t *)p->text_buffer,
+                      (size_t)(out - p->text_buffer), plan);
+}
+
+// Binary payload. A batch ends early at the first frame whose length,
+// layout, first word validity or probe sequence number presence differs
+// from the ones before it.
+static int publish_frames(csi_publish_t *p, csi_publish_link_t *link,
+                          size_t frames, const publish_plan_t *plan,
+                          int64_t timestamp_us) {
+  bool coded = p->config.format == CSI_PUBLISH_FORMAT_CODED;
+  const csi_ring_slot_t *front = csi_ring_front(&link->q);
+  bool probe = front->probe;
+  csi_frame_header_t hdr = {
+      .flags = (link->motion.motion ? CSI_FRAME_FLAG_MOTION : 0) |
+               (probe ? CSI_FRAME_FLAG_SEQ : 0) |
+               (coded ? CSI_FRAME_FLAG_CODED : 0) |
+               (front->first_word_invalid ? CSI_FRAME_FLAG_FIRST_WORD_INVALID
+                                          : 0),
+      .rssi = link->last_rssi,
+      .motion_confidence = motion_confidence_u8(link),
+      .layout = front->layout,
+      .link = link->id,
+      .seq = link->seq++,
+      .timestamp_us = timestamp_us,
+  };
+  csi_frame_writer_t writer;
+  csi_frame_begin(&writer, p->frame_buffer, sizeof(p->frame_buffer), &hdr);
+
+  size_t packed = 0;
+  while (packed < frames) {
+    const csi_ring_slot_t *slot = csi_ring_peek(&link->q, packed);
+    if (slot->probe != probe || slot->layout != front->layout ||
+        slot->first_word_invalid != front->first_word_invalid)
+      break;
+    if (!(coded ? csi_frame_add_coded(&writer, &link->codec, slot->data,
+                                      slot->len, slot->probe_seq)
+                : csi_frame_add(&writer, slot->data, slot->len,
+                                slot->probe_seq)))
+      break;
+    packed++;
+  }
+
+  if (packed == 0) {
+    p->unsendable++;
+    release(link, 1);
+    return -1;
+  }
+
+  size_t len = csi_frame_finish(&writer);
+  release(link, packed);
+  return publish_data(p, p->frame_buffer, len, plan);
+}
+
+// The stream is link 0's
+static int publish_stream(csi_publish_t *p, const csi_publish_link_t *link,
+                          const publish_plan_t *plan, int64_t timestamp_us) {
+  uint8_t channels[1 + CSI_PUBLISH_MAX_SUBCARRIERS] = {
+      CSI_STREAM_CHANNEL_BREATHING};
+  size_t n = 1 + p->config.subcarrier_count;
+  if (p->config.subcarrier_count)
+    memcpy(&channels[1], p->config.subcarriers, p->config.subcarrier_count);
+  csi_stream_header_t hdr = {
+      .flags = link->motion.motion ? CSI_STREAM_FLAG_MOTION : 0,
+      .rssi = link->last_rssi,
+      .seq = p->stream_seq++,
+      .timestamp_us = timestamp_us,
+      .motion_confidence = motion_confidence_u8(link),
+      .link = link->id,
+  };
+  size_t len = csi_stream_write(p->config.stream, &hdr, channels, n,
+                                p->stream_buffer, sizeof(p->stream_buffer));
+  if (len == 0)
+    return -1;
+  return publish_data(p, p->stream_buffer, len, plan);
+}
+
+publish_plan_t csi_publish_tick(csi_publish_t *p,
+                                csi_publish_link_t *const links[],
+                                size_t count, bool link_up,
+                                uint32_t free_heap, int64_t timestamp_us) {
+  const csi_publish_config_t *c = &p->config;
+  publish_plan_t plan = publish_sched_update(
+      &p->sched, link_up, c->transport.outbox_size(c->transport.ctx),
+      free_heap);
+  if (c->mode == CSI_PUBLISH_MODE_DECIMATED) {
+    plan.raw = false;
+    plan.decimated = true;
+  }
+  bool text = c->format == CSI_PUBLISH_FORMAT_TEXT;
+
+  for (size_t i = 0; i < count; i++) {
+    csi_publish_link_t *link = links[i];
+    if (c->mode != CSI_PUBLISH_MODE_RAW) {
+      release(link, link->analysed);
+      continue;
+    }
+    // Raw frames wait in the ring on the ticks of a batch level that send
+    // nothing; the decimated stream covers them while they are sent. The
+    // plan's frame budget holds for every link.
+    if (plan.raw && !plan.decimated && (!text || i == 0)) {
+      if (i == 0 && c->stream)
+        c->stream->samples = 0;
+      // A message holds one layout, so a tick may take several of them
+      size_t frames = link->analysed;
+      if (frames > plan.frames)
+        frames = plan.frames;
+      // A failed publish ends this link's turn only, the other links still
+      // get theirs
+      int msg_id = 0;
+      while (frames > 0 && msg_id != -1) {
+        size_t queued = link->analysed;
+        msg_id = text ? publish_text(p, link, frames, &plan)
+                      : publish_frames(p, link, frames, &plan, timestamp_us);
+        frames -= queued - link->analysed;
+      }
+      p->failed += msg_id == -1;
+    }
+    if (plan.decimated || (text && i > 0))
+      release(link, link->analysed);
+  }
+  if (plan.decimated && c->stream && count > 0 &&
+      c->stream->samples >= c->stream_samples)
+    p->failed += publish_stream(p, links[0], &plan, timestamp_us) == -1;
+  if (plan.flush)
+    flush_backlog(p);
+  return plan;
+}
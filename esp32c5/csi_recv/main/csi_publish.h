@@ -0,0 +1,169 @@
+/* Publishing the analysed CSI of a receiver's links
+
+   Every publish tick the receiver calls csi_publish_tick(), which plans the
+   tick with publish_sched.h and turns what the analysis task has been
+   through into csi/data messages:
+
+   - raw frames: each link's analysed frames as binary batches
+     (csi_frame.h), one layout and probe sequence presence per message,
+     numbered per link and coded per link when CSI_PUBLISH_FORMAT_CODED is
+     set, or link 0's HT20 frames as the legacy comma-separated text;
+   - the decimated stream (csi_stream.h) of link 0, in
+     CSI_PUBLISH_MODE_DECIMATED or when the scheduler falls back to it.
+
+   Messages go to the transport when the plan allows it and nothing is
+   held, otherwise to the backlog (csi_backlog.h), which is flushed oldest
+   first on the ticks that allow it. Frames are released from the links'
+   rings once they are published or given up; on the ticks of a batch
+   level that send nothing they stay queued.
+
+   The transport is two callbacks: app_main.c enqueues into esp-mqtt or
+   sends UDP datagrams, host/csi_replay writes to a file, a host broker or
+   a socket. Both run the same code from here.
+
+   Each link carries what its messages need: its ring, the analysis cursor,
+   the motion state and last RSSI, its message sequence and its coder. The
+   caller analyses frames [0, analysed) of the ring before the tick.
+
+   The module has no ESP-IDF dependencies and builds on any host.
+*/
+#pragma once
+
+#include "csi_backlog.h"
+#include "csi_codec.h"
+#include "csi_frame.h"
+#include "csi_layout.h"
+#include "csi_ring.h"
+#include "csi_stream.h"
+#include "motion.h"
+#include "publish_sched.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest amplitude channel list of the decimated stream
+#define CSI_PUBLISH_MAX_SUBCARRIERS 16
+// Largest raw message: a full batch of coded frames of any layout
+#define CSI_PUBLISH_FRAME_BUFFER                                               \
+  (CSI_FRAME_HEADER_SIZE +                                                     \
+   PUBLISH_SCHED_MAX_FRAMES *                                                  \
+       (CSI_FRAME_CODED_SEQ_SIZE + CSI_CODEC_BOUND(CSI_RING_SLOT_SIZE)))
+// Largest text message: a full batch of HT20 frames at 5 characters per
+// sample ("-128,"), then the motion flag, the RSSI and the terminator
+#define CSI_PUBLISH_TEXT_BUFFER                                                \
+  (PUBLISH_SCHED_MAX_FRAMES * CSI_LAYOUT_HT20_LEN * 5 + 8)
+#define CSI_PUBLISH_STREAM_BUFFER                                              \
+  (CSI_STREAM_HEADER_SIZE + 1 + CSI_PUBLISH_MAX_SUBCARRIERS +                  \
+   2 * CSI_STREAM_MAX_SAMPLES * (1 + CSI_PUBLISH_MAX_SUBCARRIERS))
+
+typedef enum {
+  CSI_PUBLISH_MODE_NONE,      /**< analysed frames are released unsent */
+  CSI_PUBLISH_MODE_RAW,       /**< raw frames, the stream as the fallback */
+  CSI_PUBLISH_MODE_DECIMATED, /**< only the decimated stream */
+} csi_publish_mode_t;
+
+typedef enum {
+  CSI_PUBLISH_FORMAT_TEXT,   /**< "i0,q0,...,motion,rssi", link 0 HT20 */
+  CSI_PUBLISH_FORMAT_BINARY, /**< csi_frame.h */
+  CSI_PUBLISH_FORMAT_CODED,  /**< csi_frame.h with csi_codec.h frames */
+} csi_publish_format_t;
+
+typedef struct {
+  /**
+   * Hand one csi/data message to the transport
+   * @return its message id, >= 0, or -1 if it was not taken; the message
+   *         then stays in the backlog, or goes there
+   */
+  int (*enqueue)(void *ctx, const uint8_t *data, size_t len, int qos);
+  /** Bytes queued in the transport and not yet acknowledged */
+  uint32_t (*outbox_size)(void *ctx);
+  void *ctx;
+} csi_publish_transport_t;
+
+typedef struct {
+  csi_publish_mode_t mode;
+  csi_publish_format_t format;
+  // Link 0's decimated stream, NULL if it is not kept; required in
+  // CSI_PUBLISH_MODE_DECIMATED
+  csi_stream_t *stream;
+  size_t stream_samples; /**< samples per stream message */
+  // Band view subcarriers whose amplitudes the stream carries after the
+  // breathing signal, such as sc_rank.selected; read at every message
+  const uint8_t *subcarriers;
+  size_t subcarrier_count; /**< at most CSI_PUBLISH_MAX_SUBCARRIERS */
+  // Largest message the transport takes, 0 for no limit; larger ones are
+  // counted in sched.oversize and dropped
+  size_t max_message;
+  uint8_t *backlog_buf;
+  size_t backlog_size;
+  unsigned backlog_flush; /**< held messages sent per tick at most */
+  const publish_sched_config_t *sched; /**< NULL for the defaults */
+  csi_publish_transport_t transport;
+} csi_publish_config_t;
+
+typedef struct {
+  // Written by the CSI callback, drained by csi_publish_tick()
+  csi_ring_t q;
+  // Frames [0, analysed) at the front of q have been through the analysis
+  // stages and are waiting to be published
+  size_t analysed;
+  uint8_t id; /**< last MAC byte, the link byte of its messages */
+  // Running RSSI and subcarrier power statistics, see motion.h
+  motion_t motion;
+  int8_t last_rssi;
+  uint32_t seq; /**< of the next raw message */
+  // Reference frames of the receivers' decoder of this link
+  csi_codec_t codec;
+} csi_publish_link_t;
+
+typedef struct {
+  csi_publish_config_t config;
+  // Pressure level of the publish path, updated every tick
+  publish_sched_t sched;
+  csi_backlog_t backlog;
+  uint32_t stream_seq; /**< of the next stream message */
+  // Counters, from csi_publish_init()
+  uint32_t sent;      /**< messages the transport took, held ones included */
+  uint32_t failed;    /**< messages or frames given up in csi_publish_tick() */
+  // Frames no message could hold, or of a layout the format cannot carry,
+  // dropped
+  uint32_t unsendable;
+  // The format is fixed at init, so raw messages of either share one buffer
+  union {
+    uint8_t frame_buffer[CSI_PUBLISH_FRAME_BUFFER];
+    char text_buffer[CSI_PUBLISH_TEXT_BUFFER];
+  };
+  uint8_t stream_buffer[CSI_PUBLISH_STREAM_BUFFER];
+} csi_publish_t;
+
+/**
+ * @brief Start at PUBLISH_LEVEL_NORMAL with an empty backlog
+ */
+void csi_publish_init(csi_publish_t *p, const csi_publish_config_t *config);
+
+/**
+ * @brief Empty ring, motion state, sequence and coder
+ */
+void csi_publish_link_init(csi_publish_link_t *link, uint8_t id);
+
+/**
+ * @brief Plan one publish tick and publish the analysed frames of `links`
+ * @param[in] link_up the transport is connected, see publish_sched_update()
+ * @param[in] free_heap bytes, see publish_sched_update()
+ * @param[in] timestamp_us of the messages of this tick
+ * @return the tick's plan; failed counts the messages that could not be
+ *         built or were too large, and the frames dropped with them
+ */
+publish_plan_t csi_publish_tick(csi_publish_t *p,
+                                csi_publish_link_t *const links[],
+                                size_t count, bool link_up,
+                                uint32_t free_heap, int64_t timestamp_us);
+
+#ifdef __cplusplus
+}
+#endif
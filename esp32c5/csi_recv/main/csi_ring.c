@@ -0,0 +1,80 @@
+#include "csi_ring.h"
+
+#include <string.h>
+
+_Static_assert((CSI_RING_FRAMES & (CSI_RING_FRAMES - 1)) == 0,
+               "CSI_RING_FRAMES must be a power of two");
+
+#define RING_MASK (CSI_RING_FRAMES - 1)
+
+void csi_ring_init(csi_ring_t *ring) {
+  atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+  atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+  atomic_store_explicit(&ring->dropped, 0, memory_order_relaxed);
+  ring->high_water = 0;
+}
+
+csi_ring_slot_t *csi_ring_claim(csi_ring_t *ring) {
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+  if (head - tail >= CSI_RING_FRAMES) {
+    atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    return NULL;
+  }
+  return &ring->slots[head & RING_MASK];
+}
+
+void csi_ring_commit(csi_ring_t *ring) {
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+  if (head + 1 - tail > ring->high_water)
+    ring->high_water = head + 1 - tail;
+  // Publish the slot contents before the consumer can see the new head
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+bool csi_ring_push(csi_ring_t *ring, const int8_t *data, size_t len) {
+  if (len > CSI_RING_SLOT_SIZE) {
+    atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    return false;
+  }
+
+  csi_ring_slot_t *slot = csi_ring_claim(ring);
+  if (!slot)
+    return false;
+  memcpy(slot->data, data, len);
+  slot->len = (uint16_t)len;
+  csi_ring_commit(ring);
+  return true;
+}
+
+size_t csi_ring_count(csi_ring_t *ring) {
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  return head - tail;
+}
+
+const csi_ring_slot_t *csi_ring_peek(csi_ring_t *ring, size_t offset) {
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+  if (offset >= head - tail)
+    return NULL;
+  return &ring->slots[(tail + offset) & RING_MASK];
+}
+
+const csi_ring_slot_t *csi_ring_front(csi_ring_t *ring) {
+  return csi_ring_peek(ring, 0);
+}
+
+void csi_ring_pop(csi_ring_t *ring, size_t count) {
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+  if (count > head - tail)
+    count = head - tail;
+  // Hand the slots back only after the consumer is done reading them
+  atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+}
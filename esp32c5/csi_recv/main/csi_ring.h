@@ -0,0 +1,96 @@
+/* Frame-oriented single-producer/single-consumer CSI ring buffer
+
+   The Wi-Fi CSI callback is the only producer and the analysis task is the
+   only consumer. Head and tail are free-running counters, so a full ring and
+   an empty ring are told apart without wasting a slot, and neither side ever
+   moves data that is already queued.
+*/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of frame slots, must be a power of two
+#define CSI_RING_FRAMES 32
+// Largest frame (info->len) a slot can hold, HT40 with STBC is 384 bytes
+#define CSI_RING_SLOT_SIZE 384
+
+typedef struct {
+  uint16_t len;
+  int8_t rssi;
+  uint8_t agc_gain;
+  uint8_t fft_gain;
+  uint8_t layout; /**< csi_layout_id_t */
+  bool first_word_invalid;
+  uint32_t timestamp; /**< rx_ctrl timestamp, us */
+  bool probe;         /**< probe_seq and probe_tx_us are valid */
+  uint32_t probe_seq;
+  uint32_t probe_tx_us; /**< sender timestamp, low 32 bits */
+  int8_t data[CSI_RING_SLOT_SIZE];
+} csi_ring_slot_t;
+
+typedef struct {
+  csi_ring_slot_t slots[CSI_RING_FRAMES];
+  atomic_uint head;    /**< next slot the producer writes */
+  atomic_uint tail;    /**< next slot the consumer reads */
+  atomic_uint dropped; /**< frames rejected because the ring was full */
+  unsigned high_water; /**< most frames ever queued, producer side */
+} csi_ring_t;
+
+/**
+ * @brief Reset the ring to empty and clear the drop counter
+ */
+void csi_ring_init(csi_ring_t *ring);
+
+/**
+ * @brief Copy one frame into the ring (producer side)
+ * @param[in] data raw CSI bytes
+ * @param[in] len number of bytes, at most CSI_RING_SLOT_SIZE
+ * @return false if the ring is full or the frame is too long; the frame is
+ *         counted as dropped in that case
+ */
+bool csi_ring_push(csi_ring_t *ring, const int8_t *data, size_t len);
+
+/**
+ * @brief Reserve the next free slot for in-place filling (producer side)
+ * @return NULL if the ring is full; the frame is counted as dropped
+ */
+csi_ring_slot_t *csi_ring_claim(csi_ring_t *ring);
+
+/**
+ * @brief Make the slot returned by csi_ring_claim() visible to the consumer
+ */
+void csi_ring_commit(csi_ring_t *ring);
+
+/**
+ * @brief Number of frames currently queued
+ */
+size_t csi_ring_count(csi_ring_t *ring);
+
+/**
+ * @brief Oldest queued frame (consumer side), NULL when empty
+ *
+ * The slot stays valid and untouched by the producer until csi_ring_pop() is
+ * called, so it can be read in place without copying.
+ */
+const csi_ring_slot_t *csi_ring_front(csi_ring_t *ring);
+
+/**
+ * @brief Frame `offset` positions behind the front, NULL past the end
+ */
+const csi_ring_slot_t *csi_ring_peek(csi_ring_t *ring, size_t offset);
+
+/**
+ * @brief Release `count` frames from the front back to the producer
+ */
+void csi_ring_pop(csi_ring_t *ring, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
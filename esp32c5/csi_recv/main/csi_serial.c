@@ -0,0 +1,187 @@
+#include "csi_serial.h"
+
+#include <string.h>
+
+//------------------------------------------------------COBS
+// Encoding------------------------------------------------------
+// Incremental encoder, so the header, I/Q and CRC are encoded straight from
+// where they are without being copied together first
+typedef struct {
+  uint8_t *out;
+  size_t code_pos; /**< where the current block's length byte goes */
+  size_t pos;
+  uint8_t code;
+} cobs_encoder_t;
+
+static void cobs_begin(cobs_encoder_t *c, uint8_t *out) {
+  c->out = out;
+  c->code_pos = 0;
+  c->pos = 1;
+  c->code = 1;
+}
+
+static void cobs_close_block(cobs_encoder_t *c) {
+  c->out[c->code_pos] = c->code;
+  c->code_pos = c->pos++;
+  c->code = 1;
+}
+
+static void cobs_put(cobs_encoder_t *c, const uint8_t *in, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (in[i] == 0) {
+      cobs_close_block(c);
+      continue;
+    }
+    c->out[c->pos++] = in[i];
+    if (++c->code == 0xFF)
+      cobs_close_block(c);
+  }
+}
+
+static size_t cobs_finish(cobs_encoder_t *c) {
+  c->out[c->code_pos] = c->code;
+  c->out[c->pos++] = 0;
+  return c->pos;
+}
+
+// Returns the decoded length, or SIZE_MAX on a malformed frame
+static size_t cobs_decode(const uint8_t *in, size_t len, uint8_t *out,
+                          size_t cap) {
+  size_t i = 0;
+  size_t o = 0;
+  while (i < len) {
+    uint8_t code = in[i++];
+    if (code == 0 || i + code - 1 > len || o + code - 1 > cap)
+      return SIZE_MAX;
+    memcpy(out + o, in + i, code - 1);
+    i += code - 1;
+    o += code - 1;
+    if (code != 0xFF && i < len) {
+      if (o >= cap)
+        return SIZE_MAX;
+      out[o++] = 0;
+    }
+  }
+  return o;
+}
+
+//------------------------------------------------------Frame
+// Encoding------------------------------------------------------
+#ifdef ESP_PLATFORM
+#include "esp_rom_crc.h"
+
+uint32_t csi_serial_crc32(uint32_t crc, const uint8_t *buf, size_t len) {
+  return esp_rom_crc32_le(crc, buf, len);
+}
+#else
+uint32_t csi_serial_crc32(uint32_t crc, const uint8_t *buf, size_t len) {
+  // Nibble table for the reflected polynomial 0xEDB88320
+  static const uint32_t table[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+      0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+      0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= buf[i];
+    crc = (crc >> 4) ^ table[crc & 0xF];
+    crc = (crc >> 4) ^ table[crc & 0xF];
+  }
+  return ~crc;
+}
+#endif
+
+size_t csi_serial_encode(const csi_trace_meta_t *meta, const int8_t *iq,
+                         uint8_t *out) {
+  if (meta->len > CSI_TRACE_MAX_LEN)
+    return 0;
+
+  uint8_t hdr[CSI_TRACE_RECORD_HEADER_SIZE];
+  csi_trace_pack_meta(meta, hdr);
+  uint32_t crc = csi_serial_crc32(0, hdr, sizeof(hdr));
+  crc = csi_serial_crc32(crc, (const uint8_t *)iq, meta->len);
+  uint8_t tail[4] = {(uint8_t)crc, (uint8_t)(crc >> 8), (uint8_t)(crc >> 16),
+                     (uint8_t)(crc >> 24)};
+
+  cobs_encoder_t c;
+  cobs_begin(&c, out);
+  cobs_put(&c, hdr, sizeof(hdr));
+  cobs_put(&c, (const uint8_t *)iq, meta->len);
+  cobs_put(&c, tail, sizeof(tail));
+  return cobs_finish(&c);
+}
+
+bool csi_serial_decode(const uint8_t *frame, size_t len,
+                       csi_trace_record_t *rec) {
+  uint8_t buf[CSI_SERIAL_MAX_RECORD];
+  size_t n = cobs_decode(frame, len, buf, sizeof(buf));
+  if (n == SIZE_MAX || n < CSI_TRACE_RECORD_HEADER_SIZE + 4)
+    return false;
+
+  csi_trace_unpack_meta(buf, &rec->meta);
+  if (rec->meta.len != n - CSI_TRACE_RECORD_HEADER_SIZE - 4)
+    return false;
+
+  const uint8_t *tail = buf + n - 4;
+  uint32_t crc = (uint32_t)tail[0] | (uint32_t)tail[1] << 8 |
+                 (uint32_t)tail[2] << 16 | (uint32_t)tail[3] << 24;
+  if (csi_serial_crc32(0, buf, n - 4) != crc)
+    return false;
+
+  memcpy(rec->data, buf + CSI_TRACE_RECORD_HEADER_SIZE, rec->meta.len);
+  return true;
+}
+
+//------------------------------------------------------Writer
+// Task------------------------------------------------------
+#ifdef ESP_PLATFORM
+#include "driver/uart.h"
+#include "driver/uart_vfs.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/stream_buffer.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#define CSI_SERIAL_UART CONFIG_ESP_CONSOLE_UART_NUM
+#define CSI_SERIAL_TASK_STACK_SIZE 3072
+#define CSI_SERIAL_TASK_PRIORITY 4
+
+static StreamBufferHandle_t serial_stream = NULL;
+// Only the Wi-Fi task encodes, so one scratch frame is enough
+static uint8_t serial_frame[CSI_SERIAL_MAX_FRAME];
+static unsigned serial_dropped = 0;
+
+static void csi_serial_writer(void *arg) {
+  static uint8_t chunk[1024];
+  while (true) {
+    size_t len = xStreamBufferReceive(serial_stream, chunk, sizeof(chunk),
+                                      portMAX_DELAY);
+    if (len > 0)
+      uart_write_bytes(CSI_SERIAL_UART, chunk, len);
+  }
+}
+
+void csi_serial_start(void) {
+  // Logs go through the same driver and land between two writes. A frame
+  // split by a log line fails its CRC and the receiver resyncs at the next
+  // delimiter.
+  ESP_ERROR_CHECK(uart_driver_install(CSI_SERIAL_UART, 256, 4096, 0, NULL, 0));
+  uart_vfs_dev_use_driver(CSI_SERIAL_UART);
+
+  serial_stream = xStreamBufferCreate(CSI_SERIAL_BUFFER_SIZE, 1);
+  xTaskCreate(csi_serial_writer, "csi_serial", CSI_SERIAL_TASK_STACK_SIZE,
+              NULL, CSI_SERIAL_TASK_PRIORITY, NULL);
+}
+
+bool csi_serial_send(const csi_trace_meta_t *meta, const int8_t *iq) {
+  size_t len = csi_serial_encode(meta, iq, serial_frame);
+  if (len == 0 || xStreamBufferSpacesAvailable(serial_stream) < len) {
+    serial_dropped++;
+    return false;
+  }
+  xStreamBufferSend(serial_stream, serial_frame, len, 0);
+  return true;
+}
+
+unsigned csi_serial_dropped(void) { return serial_dropped; }
+#endif
@@ -0,0 +1,81 @@
+/* Binary serial CSI stream
+
+   Replaces the per-byte ets_printf() text output of the CSI_Q_ENABLE == 0
+   path. Every frame is one CSI trace record (csi_trace.h) followed by a
+   little-endian CRC-32 (IEEE, as zlib.crc32) of the record, COBS-encoded
+   and terminated by a 0x00 byte:
+
+     COBS(record header | I/Q | crc32) 0x00
+
+   COBS removes every zero byte from the frame, so a receiver resyncs at the
+   next 0x00 after a lost byte or an interleaved log line, and the CRC
+   rejects the damaged frame. host/csi_serial_decode turns a capture back
+   into a trace file.
+
+   On the device csi_serial_send() only encodes into a FreeRTOS stream
+   buffer; a writer task drains it to the console UART, so the Wi-Fi task
+   never waits on the serial port. Frames that do not fit are dropped and
+   counted. The encoder itself has no ESP-IDF dependencies.
+*/
+#pragma once
+
+#include "csi_trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_SERIAL_MAX_RECORD                                                 \
+  (CSI_TRACE_RECORD_HEADER_SIZE + CSI_TRACE_MAX_LEN + 4)
+// COBS adds one byte per 254 plus one, then the 0x00 delimiter
+#define CSI_SERIAL_MAX_FRAME                                                  \
+  (CSI_SERIAL_MAX_RECORD + CSI_SERIAL_MAX_RECORD / 254 + 2)
+// Stream buffer between the Wi-Fi task and the writer task
+#define CSI_SERIAL_BUFFER_SIZE (16 * 1024)
+
+/**
+ * @brief CRC-32 (IEEE 802.3), continuing from `crc` (0 to start)
+ */
+uint32_t csi_serial_crc32(uint32_t crc, const uint8_t *buf, size_t len);
+
+/**
+ * @brief Encode one frame, including the trailing 0x00
+ * @param[in] meta record header; meta->len bytes are read from `iq`
+ * @param[out] out at least CSI_SERIAL_MAX_FRAME bytes
+ * @return frame length, 0 if meta->len exceeds CSI_TRACE_MAX_LEN
+ */
+size_t csi_serial_encode(const csi_trace_meta_t *meta, const int8_t *iq,
+                         uint8_t *out);
+
+/**
+ * @brief Decode one frame (without the 0x00 delimiter) and check its CRC
+ * @return false on a malformed COBS block, a length mismatch or a bad CRC
+ */
+bool csi_serial_decode(const uint8_t *frame, size_t len,
+                       csi_trace_record_t *rec);
+
+#ifdef ESP_PLATFORM
+/**
+ * @brief Take over the console UART and start the writer task
+ */
+void csi_serial_start(void);
+
+/**
+ * @brief Queue one frame for the writer task without blocking
+ * @return false if the stream buffer is full; the frame is counted as
+ *         dropped
+ */
+bool csi_serial_send(const csi_trace_meta_t *meta, const int8_t *iq);
+
+/**
+ * @brief Frames dropped because the stream buffer was full
+ */
+unsigned csi_serial_dropped(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
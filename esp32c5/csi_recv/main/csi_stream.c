@@ -0,0 +1,84 @@
+#include "csi_stream.h"
+
+#include <string.h>
+
+static void put_le(uint8_t *p, uint64_t v, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    p[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+static int16_t sat_s16(int32_t v) {
+  return (int16_t)(v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v);
+}
+
+bool csi_stream_init(csi_stream_t *s, int factor, int fs) {
+  if (factor < 1 || factor > CSI_STREAM_MAX_FACTOR)
+    return false;
+  memset(s, 0, sizeof(*s));
+  csi_dsp_decim_design(s->coef, factor, CSI_STREAM_PHASES);
+  csi_dsp_decim_init(&s->decim, s->coef, s->acc, factor, CSI_STREAM_PHASES,
+                     CSI_STREAM_CHANNELS);
+  s->rate_centihz = (uint16_t)(fs * 100 / factor);
+  return true;
+}
+
+bool csi_stream_push(csi_stream_t *s, int32_t breathing, const int8_t *band) {
+  int16_t x[CSI_STREAM_CHANNELS];
+  uint16_t mag[CSI_LAYOUT_BAND_SUBCARRIERS];
+  // breathing_push() counts in 1/128 raw units, magnitudes in 1/256
+  x[0] = sat_s16(breathing > 0 ? 2 * breathing : 0);
+  csi_dsp_magnitude(band, mag, CSI_LAYOUT_BAND_SUBCARRIERS);
+  for (int k = 0; k < CSI_LAYOUT_BAND_SUBCARRIERS; k++) {
+    x[1 + k] = sat_s16(mag[k]);
+  }
+
+  if (s->samples == CSI_STREAM_MAX_SAMPLES) {
+    // Nobody wrote a message in time, keep the newest samples
+    memmove(s->out[0], s->out[1], sizeof(s->out[0]) * (s->samples - 1));
+    s->samples--;
+    s->overflows++;
+  }
+  if (!csi_dsp_decim_push(&s->decim, x, s->out[s->samples]))
+    return false;
+  s->samples++;
+  return true;
+}
+
+size_t csi_stream_message_size(size_t samples, size_t channels) {
+  return CSI_STREAM_HEADER_SIZE + channels + 2 * samples * channels;
+}
+
+size_t csi_stream_write(csi_stream_t *s, const csi_stream_header_t *hdr,
+                        const uint8_t *channels, size_t n, uint8_t *buf,
+                        size_t cap) {
+  size_t len = csi_stream_message_size(s->samples, n);
+  if (s->samples == 0 || n == 0 || n > CSI_STREAM_CHANNELS || len > cap)
+    return 0;
+
+  buf[0] = CSI_STREAM_MAGIC;
+  buf[1] = CSI_STREAM_VERSION;
+  buf[2] = hdr->flags;
+  buf[3] = (uint8_t)hdr->rssi;
+  put_le(buf + 4, hdr->seq, 4);
+  put_le(buf + 8, (uint64_t)hdr->timestamp_us, 8);
+  put_le(buf + 16, s->samples, 2);
+  buf[18] = (uint8_t)n;
+  buf[19] = hdr->motion_confidence;
+  put_le(buf + 20, s->rate_centihz, 2);
+  buf[22] = hdr->link;
+  buf[23] = 0;
+  memcpy(buf + CSI_STREAM_HEADER_SIZE, channels, n);
+
+  uint8_t *p = buf + CSI_STREAM_HEADER_SIZE + n;
+  for (int i = 0; i < s->samples; i++) {
+    for (size_t c = 0; c < n; c++) {
+      int col = channels[c] == CSI_STREAM_CHANNEL_BREATHING ? 0
+                                                            : 1 + channels[c];
+      put_le(p, (uint16_t)s->out[i][col], 2);
+      p += 2;
+    }
+  }
+  s->samples = 0;
+  return len;
+}
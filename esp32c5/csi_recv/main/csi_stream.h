@@ -0,0 +1,120 @@
+/* Decimated CSI streams for MQTT
+
+   Breathing lives below 0.5 Hz, so the raw 100 Hz frames carry far more
+   than the backend needs. In the decimated publish mode the receiver
+   reduces every frame to a few per-frame values and sends them low-passed
+   and decimated to 100 / factor Hz (csi_dsp_decim_*):
+
+   - the breathing signal, |first difference of the complex mean of the
+     selected subcarriers| as breathing.c stores it, which is the input of
+     both the on-board and the backend estimator;
+   - the amplitude of every band view subcarrier (csi_layout.h).
+
+   All channels are decimated on every frame, so a message can carry any
+   subset, such as the subcarriers sc_rank.h currently selects, without a
+   filter transient when the subset changes. The low-pass is flat up to
+   0.2 * the output rate and attenuates everything that would alias into
+   the breathing band by 80 dB or more.
+
+   Samples are int16 in 1/256 of a raw CSI unit, saturated. Message layout,
+   little-endian, on the same topic as csi_frame.h messages:
+
+   offset  size  field
+        0     1  magic (CSI_STREAM_MAGIC)
+        1     1  version (CSI_STREAM_VERSION)
+        2     1  flags, bit 0 = motion detected
+        3     1  rssi (int8, dBm)
+        4     4  sequence number
+        8     8  timestamp (us since boot)
+       16     2  sample count
+       18     1  channel count
+       19     1  motion confidence, 0-255
+       20     2  sample rate, centihertz
+       22     1  link, as in csi_frame.h
+       23     1  reserved, zero
+       24     -  one id per channel: CSI_STREAM_CHANNEL_BREATHING, or a
+                 band view position for that subcarrier's amplitude
+        -     -  samples, int16, sample-major (all channels of sample 0
+                 first)
+
+   The module has no ESP-IDF dependencies and builds on any host.
+*/
+#pragma once
+
+#include "csi_dsp.h"
+#include "csi_layout.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_STREAM_MAGIC 0xC6
+#define CSI_STREAM_VERSION 1
+#define CSI_STREAM_HEADER_SIZE 24
+#define CSI_STREAM_FLAG_MOTION 0x01
+#define CSI_STREAM_CHANNEL_BREATHING 0xFF
+// Breathing signal plus every band view subcarrier
+#define CSI_STREAM_CHANNELS (1 + CSI_LAYOUT_BAND_SUBCARRIERS)
+#define CSI_STREAM_PHASES 8
+#define CSI_STREAM_MAX_FACTOR 25
+// Output samples held until the next message
+#define CSI_STREAM_MAX_SAMPLES 32
+
+typedef struct {
+  q15_t coef[CSI_STREAM_MAX_FACTOR * CSI_STREAM_PHASES];
+  int32_t acc[CSI_STREAM_PHASES * CSI_STREAM_CHANNELS];
+  csi_dsp_decim_t decim;
+  uint16_t rate_centihz;
+  // Output samples not yet written to a message, channel 0 the breathing
+  // signal, channel 1 + k the amplitude of band view position k
+  int16_t out[CSI_STREAM_MAX_SAMPLES][CSI_STREAM_CHANNELS];
+  uint8_t samples;
+  uint32_t overflows; /**< samples lost because no message was written */
+} csi_stream_t;
+
+typedef struct {
+  uint8_t flags;
+  int8_t rssi;
+  uint32_t seq;
+  int64_t timestamp_us;
+  uint8_t motion_confidence;
+  uint8_t link; /**< transmitter, see csi_frame.h */
+} csi_stream_header_t;
+
+/**
+ * @brief Reset and design the low-pass for `factor` input frames per output
+ *        sample, at `fs` frames per second
+ * @return false if factor is 0 or above CSI_STREAM_MAX_FACTOR
+ */
+bool csi_stream_init(csi_stream_t *s, int factor, int fs);
+
+/**
+ * @brief Add one frame
+ * @param[in] breathing breathing.c's difference for the frame, as returned
+ *            by breathing_push(), or a negative value if there is none
+ * @param[in] band the frame's band view
+ * @return true if a new output sample is pending
+ */
+bool csi_stream_push(csi_stream_t *s, int32_t breathing, const int8_t *band);
+
+/**
+ * @brief Bytes a message of `samples` samples of `channels` channels takes
+ */
+size_t csi_stream_message_size(size_t samples, size_t channels);
+
+/**
+ * @brief Write the pending samples of the channels listed in `channels` as
+ *        one message and clear them
+ * @return message length, 0 if nothing is pending or `cap` is too small
+ */
+size_t csi_stream_write(csi_stream_t *s, const csi_stream_header_t *hdr,
+                        const uint8_t *channels, size_t n, uint8_t *buf,
+                        size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,85 @@
+#include "csi_trace.h"
+
+#include <string.h>
+
+static void put_le(uint8_t *p, uint64_t v, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    p[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+static uint64_t get_le(const uint8_t *p, int bytes) {
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; i++) {
+    v |= (uint64_t)p[i] << (8 * i);
+  }
+  return v;
+}
+
+void csi_trace_pack_meta(const csi_trace_meta_t *meta, uint8_t *out) {
+  memset(out, 0, CSI_TRACE_RECORD_HEADER_SIZE);
+  put_le(out, (uint64_t)meta->timestamp_us, 8);
+  out[8] = (uint8_t)meta->rssi;
+  out[9] = meta->rate;
+  out[10] = (uint8_t)meta->noise_floor;
+  out[11] = meta->agc_gain;
+  out[12] = (uint8_t)meta->fft_gain;
+  out[13] = meta->channel;
+  out[14] = meta->first_word_invalid;
+  out[15] = meta->second;
+  put_le(out + 16, meta->len, 2);
+}
+
+void csi_trace_unpack_meta(const uint8_t *in, csi_trace_meta_t *meta) {
+  meta->timestamp_us = (int64_t)get_le(in, 8);
+  meta->rssi = (int8_t)in[8];
+  meta->rate = in[9];
+  meta->noise_floor = (int8_t)in[10];
+  meta->agc_gain = in[11];
+  meta->fft_gain = (int8_t)in[12];
+  meta->channel = in[13];
+  meta->first_word_invalid = in[14];
+  meta->second = in[15];
+  meta->len = (uint16_t)get_le(in + 16, 2);
+}
+
+bool csi_trace_write_header(FILE *fp) {
+  uint8_t hdr[CSI_TRACE_FILE_HEADER_SIZE] = {0};
+  memcpy(hdr, CSI_TRACE_MAGIC, 4);
+  put_le(hdr + 4, CSI_TRACE_VERSION, 2);
+  put_le(hdr + 6, CSI_TRACE_RECORD_HEADER_SIZE, 2);
+  return fwrite(hdr, sizeof(hdr), 1, fp) == 1;
+}
+
+bool csi_trace_write(FILE *fp, const csi_trace_record_t *rec) {
+  if (rec->meta.len > CSI_TRACE_MAX_LEN)
+    return false;
+
+  uint8_t hdr[CSI_TRACE_RECORD_HEADER_SIZE];
+  csi_trace_pack_meta(&rec->meta, hdr);
+  return fwrite(hdr, sizeof(hdr), 1, fp) == 1 &&
+         fwrite(rec->data, 1, rec->meta.len, fp) == rec->meta.len;
+}
+
+bool csi_trace_read_header(FILE *fp) {
+  uint8_t hdr[CSI_TRACE_FILE_HEADER_SIZE];
+  if (fread(hdr, sizeof(hdr), 1, fp) != 1)
+    return false;
+  return memcmp(hdr, CSI_TRACE_MAGIC, 4) == 0 &&
+         get_le(hdr + 4, 2) == CSI_TRACE_VERSION &&
+         get_le(hdr + 6, 2) == CSI_TRACE_RECORD_HEADER_SIZE;
+}
+
+int csi_trace_read(FILE *fp, csi_trace_record_t *rec) {
+  uint8_t hdr[CSI_TRACE_RECORD_HEADER_SIZE];
+  size_t got = fread(hdr, 1, sizeof(hdr), fp);
+  if (got == 0)
+    return 0;
+  if (got != sizeof(hdr))
+    return -1;
+
+  csi_trace_unpack_meta(hdr, &rec->meta);
+  if (rec->meta.len > CSI_TRACE_MAX_LEN)
+    return -1;
+  return fread(rec->data, 1, rec->meta.len, fp) == rec->meta.len ? 1 : -1;
+}
@@ -0,0 +1,103 @@
+/* CSI trace file format
+
+   A trace is a 16-byte file header followed by one record per received
+   frame. All multi-byte fields are little-endian.
+
+   File header
+   offset  size  field
+        0     4  magic "CSIT"
+        4     2  version (CSI_TRACE_VERSION)
+        6     2  record header size (CSI_TRACE_RECORD_HEADER_SIZE)
+        8     8  reserved, zero
+
+   Record
+   offset  size  field
+        0     8  timestamp (us, rx_ctrl timestamp unwrapped to 64 bits)
+        8     1  rssi (int8, dBm)
+        9     1  rate
+       10     1  noise floor (int8, dBm)
+       11     1  AGC gain
+       12     1  FFT gain (int8)
+       13     1  channel
+       14     1  first_word_invalid
+       15     1  secondary channel, rx_ctrl.second (0 in older traces)
+       16     2  I/Q length in bytes
+       18     2  reserved, zero
+       20     -  raw int8 I/Q, as in wifi_csi_info_t.buf
+
+   The binary serial mode (csi_serial.h) sends the same records, so a
+   capture decoded by host/csi_serial_decode is a trace as-is.
+   backend/csi_trace.py reads and writes the format and converts the text
+   CSI_DATA serial output.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_TRACE_MAGIC "CSIT"
+#define CSI_TRACE_VERSION 1
+#define CSI_TRACE_FILE_HEADER_SIZE 16
+#define CSI_TRACE_RECORD_HEADER_SIZE 20
+#define CSI_TRACE_MAX_LEN 384
+
+typedef struct {
+  int64_t timestamp_us;
+  int8_t rssi;
+  uint8_t rate;
+  int8_t noise_floor;
+  uint8_t agc_gain;
+  int8_t fft_gain;
+  uint8_t channel;
+  uint8_t first_word_invalid;
+  uint8_t second; /**< 0 none, 1 above, 2 below */
+  uint16_t len;
+} csi_trace_meta_t;
+
+typedef struct {
+  csi_trace_meta_t meta;
+  int8_t data[CSI_TRACE_MAX_LEN];
+} csi_trace_record_t;
+
+/**
+ * @brief Encode a record header into CSI_TRACE_RECORD_HEADER_SIZE bytes
+ */
+void csi_trace_pack_meta(const csi_trace_meta_t *meta, uint8_t *out);
+
+/**
+ * @brief Decode a record header
+ */
+void csi_trace_unpack_meta(const uint8_t *in, csi_trace_meta_t *meta);
+
+/**
+ * @brief Write the file header
+ */
+bool csi_trace_write_header(FILE *fp);
+
+/**
+ * @brief Append one record
+ * @return false on a write error or len > CSI_TRACE_MAX_LEN
+ */
+bool csi_trace_write(FILE *fp, const csi_trace_record_t *rec);
+
+/**
+ * @brief Read and validate the file header
+ * @return false on bad magic or an unsupported version
+ */
+bool csi_trace_read_header(FILE *fp);
+
+/**
+ * @brief Read the next record
+ * @return 1 on success, 0 at the end of the trace, -1 on a truncated or
+ *         oversized record
+ */
+int csi_trace_read(FILE *fp, csi_trace_record_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
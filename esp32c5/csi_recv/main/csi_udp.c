@@ -0,0 +1,85 @@
+#include "csi_udp.h"
+
+#include <string.h>
+
+static void put_u16(uint8_t *p, size_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+void csi_udp_init(csi_udp_t *u, const uint8_t mac[6], int redundancy,
+                  uint16_t boot) {
+  memset(u, 0, sizeof(*u));
+  memcpy(u->mac, mac, 6);
+  u->boot = boot ? boot : 1;
+  if (redundancy < 0)
+    redundancy = 0;
+  u->redundancy = redundancy > CSI_UDP_MAX_REDUNDANCY ? CSI_UDP_MAX_REDUNDANCY
+                                                      : (uint8_t)redundancy;
+}
+
+size_t csi_udp_datagram_size(size_t len) {
+  return CSI_UDP_HEADER_SIZE + 2 + len;
+}
+
+size_t csi_udp_pack(csi_udp_t *u, const void *msg, size_t len, uint8_t *out,
+                    size_t cap) {
+  size_t size = csi_udp_datagram_size(len);
+  if (len > 0xFFFF || size > cap)
+    return 0;
+
+  // The most recent messages that still fit, within the redundancy
+  size_t repeat = 0;
+  size_t total = size;
+  while (repeat < u->redundancy && repeat < u->history_count) {
+    size_t more = 2 + u->history_len[u->history_count - 1 - repeat];
+    if (total + more > CSI_UDP_MAX_DATAGRAM || total + more > cap)
+      break;
+    total += more;
+    repeat++;
+  }
+
+  uint32_t seq = u->seq++;
+  out[0] = CSI_UDP_MAGIC;
+  out[1] = CSI_UDP_VERSION;
+  out[2] = 0;
+  out[3] = (uint8_t)(1 + repeat);
+  memcpy(out + 4, u->mac, 6);
+  put_u16(out + 10, u->boot);
+  put_u32(out + 12, seq);
+  uint8_t *p = out + CSI_UDP_HEADER_SIZE;
+  for (size_t i = u->history_count - repeat; i < u->history_count; i++) {
+    put_u16(p, u->history_len[i]);
+    memcpy(p + 2, u->history[i], u->history_len[i]);
+    p += 2 + u->history_len[i];
+  }
+  put_u16(p, len);
+  memcpy(p + 2, msg, len);
+  u->sent++;
+  u->repeated += (uint32_t)repeat;
+
+  // Keep this one for the next datagrams. One too large to repeat breaks
+  // the run of consecutive sequence numbers, so the history starts over.
+  if (u->redundancy == 0)
+    return total;
+  if (len > CSI_UDP_MAX_REPEAT) {
+    u->history_count = 0;
+    return total;
+  }
+  if (u->history_count == u->redundancy) {
+    memmove(u->history[0], u->history[1],
+            (u->redundancy - 1) * sizeof(u->history[0]));
+    memmove(u->history_len, u->history_len + 1,
+            (u->redundancy - 1) * sizeof(u->history_len[0]));
+    u->history_count--;
+  }
+  memcpy(u->history[u->history_count], msg, len);
+  u->history_len[u->history_count++] = (uint16_t)len;
+  return total;
+}
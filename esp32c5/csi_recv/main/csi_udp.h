@@ -0,0 +1,95 @@
+/* csi/data messages over UDP
+
+   With CSI_TRANSPORT_UDP the receiver sends its csi/data messages
+   (csi_frame.h or csi_stream.h) straight to the backend as UDP datagrams
+   instead of through the MQTT broker, which saves the broker's queueing
+   and two TCP hops on the way to the dashboards. Every message gets a
+   sequence number of its own, in the order it is sent, so the backend can
+   tell lost, repeated and late messages apart whatever they carry.
+
+   UDP does not resend, so a datagram can also repeat the previous
+   messages, up to `redundancy` of them, as long as the datagram stays
+   within CSI_UDP_MAX_DATAGRAM. A lost datagram is then made up by the
+   next one, at the cost of one message period of delay for what it
+   carried, without a round trip. Messages too large to repeat are sent
+   alone and start the repetition over.
+
+   The sequence numbers start over at 0 when the receiver restarts. A boot
+   id, drawn anew at every start, tells the backend so even when the device
+   comes back before its old sequence number could look like a restart.
+
+   Datagram layout, little-endian:
+
+   offset  size  field
+        0     1  magic (CSI_UDP_MAGIC)
+        1     1  version (CSI_UDP_VERSION)
+        2     1  flags, zero
+        3     1  message count, 1 + the repeated ones
+        4     6  device MAC, as in the csi/data/<mac> topic
+       10     2  boot id, nonzero; zero from receivers without one
+       12     4  sequence number of the last message
+       16     -  messages, oldest first, each a u16 length and the
+                 message; the sequence numbers before the last one count
+                 down by one
+
+   The module has no ESP-IDF dependencies and builds on any host.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_UDP_MAGIC 0xC7
+#define CSI_UDP_VERSION 1
+#define CSI_UDP_HEADER_SIZE 16
+// Ethernet MTU less the IP and UDP headers: datagrams with repeated
+// messages are never fragmented. A single message may be larger.
+#define CSI_UDP_MAX_DATAGRAM 1472
+#define CSI_UDP_MAX_REDUNDANCY 3
+// Largest message that can be repeated
+#define CSI_UDP_MAX_REPEAT (CSI_UDP_MAX_DATAGRAM - CSI_UDP_HEADER_SIZE - 2)
+
+typedef struct {
+  uint8_t mac[6];
+  uint8_t redundancy;
+  uint16_t boot; /**< boot id, the same in every datagram of this start */
+  uint32_t seq;  /**< of the next message */
+  // The last messages sent, oldest first, with consecutive sequence numbers
+  uint8_t history[CSI_UDP_MAX_REDUNDANCY][CSI_UDP_MAX_REPEAT];
+  uint16_t history_len[CSI_UDP_MAX_REDUNDANCY];
+  uint8_t history_count;
+  uint32_t sent;     /**< messages */
+  uint32_t repeated; /**< repeated copies sent */
+} csi_udp_t;
+
+/**
+ * @brief Start at sequence number 0
+ * @param[in] redundancy previous messages to repeat in every datagram, at
+ *            most CSI_UDP_MAX_REDUNDANCY
+ * @param[in] boot id of this start, e.g. random; 0 is taken as 1
+ */
+void csi_udp_init(csi_udp_t *u, const uint8_t mac[6], int redundancy,
+                  uint16_t boot);
+
+/**
+ * @brief Bytes of a datagram carrying a single message of `len` bytes
+ */
+size_t csi_udp_datagram_size(size_t len);
+
+/**
+ * @brief Write the datagram for the next message, with as many repeated
+ *        ones as fit, and take its sequence number
+ * @return datagram length, 0 if `cap` is too small or the message longer
+ *         than 0xFFFF; the sequence number is not used then
+ */
+size_t csi_udp_pack(csi_udp_t *u, const void *msg, size_t len, uint8_t *out,
+                    size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
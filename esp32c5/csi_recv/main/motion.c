@@ -0,0 +1,94 @@
+#include "motion.h"
+
+#include <math.h>
+#include <string.h>
+
+#define MOTION_RSSI_MIN_FRAMES 5
+
+void motion_init(motion_t *m) { memset(m, 0, sizeof(*m)); }
+
+static void rssi_update(motion_t *m, int8_t rssi) {
+  if (m->rssi_count == MOTION_RSSI_WINDOW) {
+    int8_t old = m->rssi[m->rssi_index];
+    m->rssi_sum -= old;
+    m->rssi_sumsq -= old * old;
+  } else {
+    m->rssi_count++;
+  }
+  m->rssi[m->rssi_index] = rssi;
+  m->rssi_index = (m->rssi_index + 1) % MOTION_RSSI_WINDOW;
+  m->rssi_sum += rssi;
+  m->rssi_sumsq += rssi * rssi;
+
+  // n * sumsq - sum^2 is exact in integers, so no cancellation drift
+  int32_t n = (int32_t)m->rssi_count;
+  m->rssi_variance =
+      (float)(n * m->rssi_sumsq - m->rssi_sum * m->rssi_sum) / (float)(n * n);
+}
+
+static void power_update(motion_t *m, const int8_t *iq, size_t len) {
+  size_t subcarriers = len / 2;
+  if (subcarriers > MOTION_MAX_SUBCARRIERS)
+    subcarriers = MOTION_MAX_SUBCARRIERS;
+  if (subcarriers != m->subcarriers) {
+    m->subcarriers = (uint16_t)subcarriers;
+    m->power_frames = 0;
+  }
+
+  float var_sum = 0;
+  float mean_sq_sum = 0;
+  for (size_t k = 0; k < subcarriers; k++) {
+    int16_t im = iq[2 * k];
+    int16_t re = iq[2 * k + 1];
+    float power = (float)(im * im + re * re);
+
+    if (m->power_frames == 0) {
+      m->power_mean[k] = power;
+      m->power_var[k] = 0;
+    } else {
+      float delta = power - m->power_mean[k];
+      m->power_mean[k] += MOTION_POWER_ALPHA * delta;
+      m->power_var[k] = (1 - MOTION_POWER_ALPHA) *
+                        (m->power_var[k] + MOTION_POWER_ALPHA * delta * delta);
+    }
+    var_sum += m->power_var[k];
+    mean_sq_sum += m->power_mean[k] * m->power_mean[k];
+  }
+  if (m->power_frames < MOTION_POWER_WARMUP)
+    m->power_frames++;
+  m->power_variation = mean_sq_sum > 0 ? var_sum / mean_sq_sum : 0;
+}
+
+bool motion_push(motion_t *m, int8_t rssi, const int8_t *iq, size_t len) {
+  rssi_update(m, rssi);
+  if (iq && len >= 2)
+    power_update(m, iq, len);
+
+  bool rssi_ready = m->rssi_count >= MOTION_RSSI_MIN_FRAMES;
+  bool power_ready = m->power_frames >= MOTION_POWER_WARMUP;
+  if (!rssi_ready && !power_ready) {
+    m->motion = false;
+    m->score = 0;
+    m->confidence = 0;
+    return false;
+  }
+
+  float score = rssi_ready ? m->rssi_variance / MOTION_RSSI_REF : 0;
+  if (power_ready && m->power_variation / MOTION_POWER_REF > score)
+    score = m->power_variation / MOTION_POWER_REF;
+  m->score = score;
+
+  // Hysteresis: only a sustained run of frames flips the state
+  bool against = m->motion ? score < MOTION_SCORE_OFF : score > MOTION_SCORE_ON;
+  m->streak = against ? m->streak + 1 : 0;
+  if (m->streak >= (m->motion ? MOTION_HOLD_FRAMES : MOTION_ENTER_FRAMES)) {
+    m->motion = !m->motion;
+    m->streak = 0;
+  }
+
+  const float mid = 0.5f * (MOTION_SCORE_ON + MOTION_SCORE_OFF);
+  const float spread = 0.25f * (MOTION_SCORE_ON - MOTION_SCORE_OFF);
+  float p = 1.0f / (1.0f + expf(-(score - mid) / spread));
+  m->confidence = m->motion ? p : 1.0f - p;
+  return m->motion;
+}
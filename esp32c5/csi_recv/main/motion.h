@@ -0,0 +1,86 @@
+/* Per-frame motion detection from RSSI and CSI amplitude
+
+   Two features are kept up to date in O(1) per statistic for every frame:
+
+   - RSSI variance over a sliding window of MOTION_RSSI_WINDOW frames, from a
+     running sum and sum of squares (exact, integer arithmetic).
+   - Subcarrier power fluctuation: an exponentially weighted Welford mean and
+     variance of |h|^2 per subcarrier, pooled as sum(var) / sum(mean^2).
+     Power is used instead of amplitude to avoid a square root per
+     subcarrier; for small fluctuations its relative variance is 4x that of
+     the amplitude, which MOTION_POWER_REF absorbs.
+
+   Each feature is divided by its reference level and the larger one is the
+   motion score. The decision has hysteresis: motion starts once the score
+   stays above MOTION_SCORE_ON for MOTION_ENTER_FRAMES frames and ends once it
+   stays below MOTION_SCORE_OFF for MOTION_HOLD_FRAMES frames. The confidence
+   is a logistic of the score around the middle of the two thresholds, taken
+   for whichever state is currently reported.
+
+   The module has no ESP-IDF dependencies and builds on any host.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MOTION_RSSI_WINDOW 20
+#define MOTION_MAX_SUBCARRIERS 192
+// Weight of the newest frame in the power statistics, ~0.3 s at 100 Hz
+#define MOTION_POWER_ALPHA (1.0f / 32)
+#define MOTION_POWER_WARMUP 64
+// Feature levels that map to a score of 1
+#define MOTION_RSSI_REF 1.0f   /**< dB^2 */
+// Receiver noise alone gives about 2 / SNR, 0.02 at 20 dB
+#define MOTION_POWER_REF 0.06f /**< pooled relative variance of |h|^2 */
+#define MOTION_SCORE_ON 1.0f
+#define MOTION_SCORE_OFF 0.6f
+#define MOTION_ENTER_FRAMES 5
+#define MOTION_HOLD_FRAMES 50
+
+typedef struct {
+  // Sliding RSSI window
+  int8_t rssi[MOTION_RSSI_WINDOW];
+  unsigned rssi_index;
+  unsigned rssi_count;
+  int32_t rssi_sum;
+  int32_t rssi_sumsq;
+
+  // Exponentially weighted per-subcarrier power statistics
+  float power_mean[MOTION_MAX_SUBCARRIERS];
+  float power_var[MOTION_MAX_SUBCARRIERS];
+  uint16_t subcarriers;
+  unsigned power_frames;
+
+  // Decision state
+  unsigned streak; /**< frames in a row arguing for the other state */
+  bool motion;
+  float score;
+  float confidence;
+  float rssi_variance;
+  float power_variation;
+} motion_t;
+
+/**
+ * @brief Reset all statistics; no motion is reported until warmed up
+ */
+void motion_init(motion_t *m);
+
+/**
+ * @brief Feed one frame and update the decision
+ * @param[in] rssi frame RSSI, dBm
+ * @param[in] iq raw CSI bytes (interleaved int8 imag/real), may be NULL
+ * @param[in] len number of bytes; a change in subcarrier count restarts the
+ *            power statistics
+ * @return the current decision, same as m->motion
+ */
+bool motion_push(motion_t *m, int8_t rssi, const int8_t *iq, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
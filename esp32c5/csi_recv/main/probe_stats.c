@@ -0,0 +1,75 @@
+#include "probe_stats.h"
+
+#include <string.h>
+
+void probe_stats_init(probe_stats_t *s) { memset(s, 0, sizeof(*s)); }
+
+static unsigned gap_bucket(uint32_t gap) {
+  if (gap < 4)
+    return gap - 1;
+  if (gap < 8)
+    return 3;
+  if (gap < 16)
+    return 4;
+  return 5;
+}
+
+void probe_stats_push(probe_stats_t *s, uint32_t seq, uint32_t tx_us,
+                      uint32_t rx_us) {
+  if (s->started) {
+    // Signed distance, so the comparison survives the counter wrapping
+    int32_t delta = (int32_t)(seq - s->last_seq);
+    if (delta == 0) {
+      s->duplicates++;
+      return;
+    }
+    if (delta < 0 && delta > -PROBE_STATS_RESTART_GAP) {
+      // Late frame for a sequence number already counted as lost
+      s->reordered++;
+      if (s->lost > 0) {
+        s->lost--;
+        s->received++;
+      }
+      return;
+    }
+    if (delta < 0) {
+      s->restarts++;
+      s->started = false;
+    } else {
+      if (delta > 1) {
+        s->lost += (unsigned)delta - 1;
+        s->gaps[gap_bucket((uint32_t)delta - 1)]++;
+      }
+
+      // Transit time difference; the clock offset cancels out
+      int32_t d = (int32_t)((rx_us - s->last_rx_us) - (tx_us - s->last_tx_us));
+      float abs_d = d < 0 ? -(float)d : (float)d;
+      s->jitter_us += (abs_d - s->jitter_us) / 16;
+
+      uint32_t interval = rx_us - s->last_rx_us;
+      if (interval > s->max_interval_us)
+        s->max_interval_us = interval;
+    }
+  }
+
+  s->started = true;
+  s->last_seq = seq;
+  s->last_tx_us = tx_us;
+  s->last_rx_us = rx_us;
+  s->received++;
+}
+
+float probe_stats_loss_rate(const probe_stats_t *s) {
+  unsigned sent = s->received + s->lost;
+  return sent ? (float)s->lost / sent : 0.0f;
+}
+
+void probe_stats_reset_period(probe_stats_t *s) {
+  s->received = 0;
+  s->lost = 0;
+  s->duplicates = 0;
+  s->reordered = 0;
+  s->restarts = 0;
+  memset(s->gaps, 0, sizeof(s->gaps));
+  s->max_interval_us = 0;
+}
@@ -0,0 +1,79 @@
+/* Link statistics from the sequence-numbered ESP-NOW probes (csi_probe.h)
+
+   Every CSI frame measured on a probe carries the sender's sequence number
+   and timestamp. From them, per reporting period:
+
+   - loss: sequence numbers skipped, with a histogram of gap lengths, since a
+     burst of lost frames hurts the breathing estimate more than the same
+     number of scattered ones;
+   - duplicates, which are dropped, and reordered frames, which move a
+     probe from lost to received;
+   - inter-arrival jitter as in RFC 3550: the smoothed absolute change in
+     transit time (receive minus send timestamp), so the offset between the
+     two clocks cancels out;
+   - the longest gap between two received frames.
+
+   A sequence number that jumps backwards by more than
+   PROBE_STATS_RESTART_GAP is taken as a sender reboot and restarts the
+   sequence tracking instead of counting loss.
+
+   The module has no ESP-IDF dependencies and builds on any host.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Gap length buckets: 1, 2, 3, 4-7, 8-15, 16+ lost frames in a row
+#define PROBE_STATS_GAP_BUCKETS 6
+#define PROBE_STATS_RESTART_GAP 1000
+
+typedef struct {
+  // Sequence tracking, kept across periods
+  bool started;
+  uint32_t last_seq;   /**< highest sequence number seen */
+  uint32_t last_tx_us; /**< sender timestamp of last_seq */
+  uint32_t last_rx_us;
+  float jitter_us;
+
+  // Counters for the current period
+  unsigned received;
+  unsigned lost;
+  unsigned duplicates; /**< sequence number seen just before */
+  unsigned reordered;  /**< older than last_seq, possibly filling a gap */
+  unsigned restarts;
+  unsigned gaps[PROBE_STATS_GAP_BUCKETS];
+  uint32_t max_interval_us;
+} probe_stats_t;
+
+/**
+ * @brief Reset all state
+ */
+void probe_stats_init(probe_stats_t *s);
+
+/**
+ * @brief Account for one frame measured on a probe
+ * @param[in] seq probe sequence number
+ * @param[in] tx_us sender timestamp, low 32 bits
+ * @param[in] rx_us receiver timestamp (rx_ctrl.timestamp)
+ */
+void probe_stats_push(probe_stats_t *s, uint32_t seq, uint32_t tx_us,
+                      uint32_t rx_us);
+
+/**
+ * @brief Fraction of the probes sent this period that were lost
+ */
+float probe_stats_loss_rate(const probe_stats_t *s);
+
+/**
+ * @brief Clear the per-period counters, keeping the sequence tracking
+ */
+void probe_stats_reset_period(probe_stats_t *s);
+
+#ifdef __cplusplus
+}
+#endif
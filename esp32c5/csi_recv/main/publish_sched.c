@@ -0,0 +1,116 @@
+#include "publish_sched.h"
+
+#include <string.h>
+
+// Settling takes at most settle_ticks << MAX_BACKOFF ticks
+#define MAX_BACKOFF 3
+
+static const char *level_names[PUBLISH_LEVELS] = {
+    "normal", "batch", "qos0", "decimated", "hold",
+};
+
+void publish_sched_default_config(publish_sched_config_t *config) {
+  static const publish_sched_config_t defaults = {
+      .outbox_bytes = {0, 8 * 1024, 16 * 1024, 32 * 1024, 48 * 1024},
+      .free_heap = {0, 0, 64 * 1024, 48 * 1024, 32 * 1024},
+      .settle_ticks = 50,
+  };
+  *config = defaults;
+}
+
+void publish_sched_init(publish_sched_t *s,
+                        const publish_sched_config_t *config) {
+  memset(s, 0, sizeof(*s));
+  if (config)
+    s->config = *config;
+  else
+    publish_sched_default_config(&s->config);
+  s->heap_min = UINT32_MAX;
+}
+
+// Highest level whose thresholds are reached
+static publish_level_t level_for(const publish_sched_config_t *c,
+                                 uint64_t outbox_bytes, uint64_t free_heap) {
+  for (int level = PUBLISH_LEVELS - 1; level > PUBLISH_LEVEL_NORMAL; level--) {
+    if ((c->outbox_bytes[level] && outbox_bytes >= c->outbox_bytes[level]) ||
+        (c->free_heap[level] && free_heap < c->free_heap[level]))
+      return (publish_level_t)level;
+  }
+  return PUBLISH_LEVEL_NORMAL;
+}
+
+publish_plan_t publish_sched_update(publish_sched_t *s, bool link_up,
+                                    uint32_t outbox_bytes, uint32_t free_heap) {
+  s->outbox_bytes = outbox_bytes;
+  s->free_heap = free_heap;
+  if (outbox_bytes > s->outbox_peak)
+    s->outbox_peak = outbox_bytes;
+  if (free_heap < s->heap_min)
+    s->heap_min = free_heap;
+
+  publish_level_t target = level_for(&s->config, outbox_bytes, free_heap);
+  uint32_t settle = (uint32_t)s->config.settle_ticks << s->backoff;
+  if (target > s->level) {
+    // Pressure is back soon after a step down: settle longer next time
+    if (s->left_tick && s->ticks - (s->left_tick - 1) < 2 * settle)
+      s->backoff += s->backoff < MAX_BACKOFF;
+    else
+      s->backoff = 0;
+    s->level = target;
+    s->calm_ticks = 0;
+    s->transitions++;
+  } else if (s->level > PUBLISH_LEVEL_NORMAL &&
+             level_for(&s->config, 2 * (uint64_t)outbox_bytes,
+                       (uint64_t)free_heap * 3 / 4) < s->level) {
+    if (++s->calm_ticks >= settle) {
+      s->level--;
+      s->calm_ticks = 0;
+      s->left_tick = s->ticks + 1;
+      s->transitions++;
+    }
+  } else {
+    s->calm_ticks = 0;
+  }
+  s->level_ticks[s->level]++;
+  uint32_t tick = s->ticks++;
+
+  publish_plan_t plan = {
+      .frames = PUBLISH_SCHED_FRAMES,
+      .enqueue = link_up,
+      .qos = 1,
+  };
+  switch (s->level) {
+  case PUBLISH_LEVEL_NORMAL:
+    plan.raw = true;
+    break;
+  case PUBLISH_LEVEL_QOS0:
+    plan.qos = 0;
+    // fall through
+  case PUBLISH_LEVEL_BATCH:
+    plan.raw = tick % 2 == 0;
+    plan.frames = PUBLISH_SCHED_MAX_FRAMES;
+    break;
+  case PUBLISH_LEVEL_HOLD:
+    plan.enqueue = false;
+    // fall through
+  case PUBLISH_LEVEL_DECIMATED:
+  default:
+    plan.decimated = true;
+    plan.qos = 0;
+    break;
+  }
+  plan.flush = plan.enqueue;
+  return plan;
+}
+
+const char *publish_sched_level_name(publish_level_t level) {
+  return level < PUBLISH_LEVELS ? level_names[level] : "?";
+}
+
+void publish_sched_reset_period(publish_sched_t *s) {
+  s->outbox_peak = s->outbox_bytes;
+  s->heap_min = s->free_heap;
+  s->transitions = 0;
+  s->oversize = 0;
+  memset(s->level_ticks, 0, sizeof(s->level_ticks));
+}
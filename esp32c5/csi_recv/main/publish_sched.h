@@ -0,0 +1,133 @@
+/* Publish scheduling under MQTT backpressure
+
+   csi/data messages are enqueued into the esp-mqtt outbox and sent by the
+   client's task, so a slow or stalled broker shows up as outbox bytes that
+   are not acknowledged, and in the end as heap running out. Once per
+   publish tick the receiver passes the outbox size and the free heap to
+   publish_sched_update(), which moves between pressure levels:
+
+   - PUBLISH_LEVEL_NORMAL: QoS 1 messages of PUBLISH_SCHED_FRAMES frames
+     every tick;
+   - PUBLISH_LEVEL_BATCH: QoS 1, messages twice as large every other tick,
+     which halves the per-message overhead and the acknowledgements;
+   - PUBLISH_LEVEL_QOS0: as BATCH, at QoS 0, so sent messages leave the
+     outbox without waiting for an acknowledgement;
+   - PUBLISH_LEVEL_DECIMATED: raw frames are dropped, only the decimated
+     stream (csi_stream.h) is sent, at QoS 0;
+   - PUBLISH_LEVEL_HOLD: no csi/data or csi/br message is enqueued. The
+     decimated stream goes to the backlog (csi_backlog.h), which drops its
+     oldest messages when full; telemetry is still sent.
+
+   Every level is entered as soon as the outbox reaches its threshold or
+   the free heap falls below its threshold, several levels at once if need
+   be. A level is left one step at a time, after settle_ticks ticks in a
+   row with the outbox under half the threshold and the free heap a third
+   above it. When a level is entered again soon after it was left, as when
+   the link only keeps up at that level, the next settling takes twice as
+   long, up to 8 times settle_ticks, so the levels do not flap.
+
+   Held messages are sent oldest first at every level but HOLD, while the
+   outbox is below half the BATCH threshold; new messages queue behind
+   them, so they keep their order.
+
+   So the data that is given up under load is chosen explicitly: first
+   the acknowledgements, then the raw frames, then the oldest decimated
+   samples. The outbox stays near the HOLD threshold instead of growing
+   until an allocation fails.
+
+   The module has no ESP-IDF dependencies and builds on any host.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Frames per raw message at PUBLISH_LEVEL_NORMAL, one publish tick at 100 Hz
+#define PUBLISH_SCHED_FRAMES 10
+// Largest raw message, in frames
+#define PUBLISH_SCHED_MAX_FRAMES (2 * PUBLISH_SCHED_FRAMES)
+
+typedef enum {
+  PUBLISH_LEVEL_NORMAL,
+  PUBLISH_LEVEL_BATCH,
+  PUBLISH_LEVEL_QOS0,
+  PUBLISH_LEVEL_DECIMATED,
+  PUBLISH_LEVEL_HOLD,
+  PUBLISH_LEVELS
+} publish_level_t;
+
+typedef struct {
+  // Entry thresholds per level, index 0 unused; 0 disables a threshold
+  uint32_t outbox_bytes[PUBLISH_LEVELS];
+  uint32_t free_heap[PUBLISH_LEVELS];
+  uint16_t settle_ticks;
+} publish_sched_config_t;
+
+// What to publish on this tick
+typedef struct {
+  bool raw;       /**< encode raw frames on this tick */
+  size_t frames;  /**< frames per raw message */
+  bool decimated; /**< publish the decimated stream instead of raw frames */
+  bool enqueue;   /**< enqueue; otherwise messages go to the backlog */
+  int qos;
+  bool flush;     /**< held messages may be sent, see csi_publish_tick() */
+} publish_plan_t;
+
+typedef struct {
+  publish_sched_config_t config;
+  publish_level_t level;
+  uint16_t calm_ticks;
+  uint8_t backoff;    /**< settling takes settle_ticks << backoff ticks */
+  uint32_t left_tick; /**< 1 + tick of the last step down, 0 if none */
+  uint32_t ticks;
+  // Metrics, kept until publish_sched_reset_period()
+  uint32_t outbox_bytes; /**< at the last update */
+  uint32_t outbox_peak;
+  uint32_t free_heap; /**< at the last update */
+  uint32_t heap_min;
+  uint32_t level_ticks[PUBLISH_LEVELS];
+  uint32_t transitions;
+  uint32_t oversize; /**< messages too large for the client's buffer */
+} publish_sched_t;
+
+/**
+ * @brief Default thresholds: the outbox at 8, 16, 32 and 48 KB, free heap
+ *        below 64, 48 and 32 KB from QOS0 up, 50 ticks to settle
+ */
+void publish_sched_default_config(publish_sched_config_t *config);
+
+/**
+ * @brief Start at PUBLISH_LEVEL_NORMAL
+ * @param[in] config thresholds, NULL for the defaults
+ */
+void publish_sched_init(publish_sched_t *s,
+                        const publish_sched_config_t *config);
+
+/**
+ * @brief Account for one publish tick and plan it
+ * @param[in] link_up the broker is connected; if not, nothing is enqueued
+ *            and the tick's messages go to the backlog, at any level
+ * @param[in] outbox_bytes esp_mqtt_client_get_outbox_size()
+ * @param[in] free_heap esp_get_free_heap_size()
+ */
+publish_plan_t publish_sched_update(publish_sched_t *s, bool link_up,
+                                    uint32_t outbox_bytes, uint32_t free_heap);
+
+/**
+ * @brief Short name of a level, such as "qos0"
+ */
+const char *publish_sched_level_name(publish_level_t level);
+
+/**
+ * @brief Start a new reporting period of the metrics
+ */
+void publish_sched_reset_period(publish_sched_t *s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,125 @@
+#include "sc_rank.h"
+#include "breathing.h"
+
+#include <string.h>
+
+#define SC_N CSI_LAYOUT_BAND_SUBCARRIERS
+
+_Static_assert(BR_SC_LAST - BR_SC_FIRST == SC_RANK_K,
+               "the initial selection is the fixed breathing band");
+
+// b0, b1, b2, a1, a2 per section, from scipy.signal.butter(output="sos") at
+// the decimated rate of 10 Hz
+static const float band_sos[SC_RANK_BAND_SECTIONS][5] = {
+    // butter(2, [0.15, 0.5], "band", fs=10)
+    {0.01043241337109341f, 0.02086482674218682f, 0.01043241337109341f,
+     -1.7304945831048948f, 0.7992966334636966f},
+    {1.0f, -2.0f, 1.0f, -1.905772844034958f, 0.9167135199814352f},
+};
+static const float noise_sos[SC_RANK_NOISE_SECTIONS][5] = {
+    // butter(2, 1.0, "high", fs=10)
+    {0.6389455251590224f, -1.2778910503180447f, 0.6389455251590224f,
+     -1.1429805025399011f, 0.41280159809618877f},
+};
+
+void sc_rank_init(sc_rank_t *r) {
+  memset(r, 0, sizeof(*r));
+  for (int i = 0; i < SC_RANK_K; i++) {
+    r->selected[i] = (uint8_t)(BR_SC_FIRST + i);
+  }
+}
+
+// States for a constant input x, as scipy.signal.sosfilt_zi() * x
+static void filter_start(const float (*sos)[5], int sections,
+                         float (*z)[2][SC_N], int k, float x) {
+  for (int s = 0; s < sections; s++) {
+    const float *c = sos[s];
+    float y = x * (c[0] + c[1] + c[2]) / (1 + c[3] + c[4]);
+    z[s][0][k] = y - c[0] * x;
+    z[s][1][k] = c[2] * x - c[4] * y;
+    x = y;
+  }
+}
+
+// One sample of subcarrier k through the cascade, transposed direct form II
+static float filter(const float (*sos)[5], int sections, float (*z)[2][SC_N],
+                    int k, float x) {
+  for (int s = 0; s < sections; s++) {
+    const float *c = sos[s];
+    float y = c[0] * x + z[s][0][k];
+    z[s][0][k] = c[1] * x - c[3] * y + z[s][1][k];
+    z[s][1][k] = c[2] * x - c[4] * y;
+    x = y;
+  }
+  return x;
+}
+
+static float score(const sc_rank_t *r, int k) {
+  return r->e_band[k] / (r->e_noise[k] + 1);
+}
+
+static bool rerank(sc_rank_t *r) {
+  float scores[SC_N];
+  for (int k = 0; k < SC_N; k++) {
+    scores[k] = score(r, k);
+  }
+
+  // K passes of a selection, the lower position first among equal scores
+  bool taken[SC_N] = {0};
+  float best_sum = 0;
+  for (int i = 0; i < SC_RANK_K; i++) {
+    int best = -1;
+    for (int k = 0; k < SC_N; k++) {
+      if (!taken[k] && (best < 0 || scores[k] > scores[best]))
+        best = k;
+    }
+    taken[best] = true;
+    best_sum += scores[best];
+  }
+
+  float current_sum = 0;
+  bool same = true;
+  for (int i = 0; i < SC_RANK_K; i++) {
+    current_sum += scores[r->selected[i]];
+    same &= taken[r->selected[i]];
+  }
+  if (same || best_sum <= SC_RANK_SWITCH * current_sum)
+    return false;
+
+  for (int k = 0, i = 0; k < SC_N; k++) {
+    if (taken[k])
+      r->selected[i++] = (uint8_t)k;
+  }
+  r->reranks++;
+  return true;
+}
+
+bool sc_rank_push(sc_rank_t *r, const int8_t *band) {
+  for (int k = 0; k < SC_N; k++) {
+    int32_t im = band[2 * k], re = band[2 * k + 1];
+    r->acc[k] += (uint32_t)(im * im + re * re);
+  }
+  if (++r->count < SC_RANK_DECIMATE)
+    return false;
+
+  const float alpha = 1.0f / (1 << SC_RANK_ALPHA_SHIFT);
+  for (int k = 0; k < SC_N; k++) {
+    float x = (float)r->acc[k];
+    if (r->samples == 0) {
+      filter_start(band_sos, SC_RANK_BAND_SECTIONS, r->z_band, k, x);
+      filter_start(noise_sos, SC_RANK_NOISE_SECTIONS, r->z_noise, k, x);
+    }
+    float b = filter(band_sos, SC_RANK_BAND_SECTIONS, r->z_band, k, x);
+    float n = filter(noise_sos, SC_RANK_NOISE_SECTIONS, r->z_noise, k, x);
+    r->e_band[k] += alpha * (b * b - r->e_band[k]);
+    r->e_noise[k] += alpha * (n * n - r->e_noise[k]);
+    r->acc[k] = 0;
+  }
+  r->count = 0;
+  r->samples++;
+
+  if (r->samples < SC_RANK_WARMUP ||
+      (r->samples - SC_RANK_WARMUP) % SC_RANK_PERIOD != 0)
+    return false;
+  return rerank(r);
+}
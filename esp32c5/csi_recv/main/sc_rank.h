@@ -0,0 +1,72 @@
+/* Adaptive subcarrier selection for the breathing estimate
+
+   How strongly breathing shows on a subcarrier depends on where the chest
+   reflection lands in the multipath, so a fixed band can sit in a fade while
+   other subcarriers carry a clear signal. This module ranks the 53 band view
+   subcarriers (csi_layout.h) online:
+
+   - each frame adds the power re^2 + im^2 of every subcarrier to a sum,
+     and every SC_RANK_DECIMATE frames the sums form one sample at 10 Hz;
+   - two small IIR filters split every subcarrier's samples into the
+     breathing band (0.15-0.5 Hz band-pass) and noise (1 Hz high-pass);
+   - the energies of both are tracked with weight 2^-SC_RANK_ALPHA_SHIFT,
+     a time constant of 6.4 s, and a subcarrier's score is their ratio.
+
+   Every SC_RANK_PERIOD samples after SC_RANK_WARMUP, the SC_RANK_K best
+   subcarriers replace the current selection, but only if their summed score
+   is SC_RANK_SWITCH times that of the current one, so the selection does
+   not flip between near-equal candidates. Per frame the cost is 53 integer
+   multiply-adds; the filters run at a tenth of the frame rate.
+
+   backend/breathing.py:SubcarrierRanker implements the same algorithm. The
+   module has no ESP-IDF dependencies and builds on any host.
+*/
+#pragma once
+
+#include "csi_layout.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SC_RANK_K 10
+#define SC_RANK_DECIMATE 10 // 100 Hz frames to 10 Hz samples
+#define SC_RANK_ALPHA_SHIFT 6
+#define SC_RANK_PERIOD 100 // samples between re-ranks, 10 s
+#define SC_RANK_WARMUP 150 // samples before the first re-rank, 15 s
+#define SC_RANK_SWITCH 1.25f
+#define SC_RANK_BAND_SECTIONS 2
+#define SC_RANK_NOISE_SECTIONS 1
+
+typedef struct {
+  uint32_t acc[CSI_LAYOUT_BAND_SUBCARRIERS]; /**< power summed this block */
+  uint8_t count;                             /**< frames in acc */
+  uint32_t samples;                          /**< decimated samples seen */
+
+  // Transposed direct form II states, per section and subcarrier
+  float z_band[SC_RANK_BAND_SECTIONS][2][CSI_LAYOUT_BAND_SUBCARRIERS];
+  float z_noise[SC_RANK_NOISE_SECTIONS][2][CSI_LAYOUT_BAND_SUBCARRIERS];
+  float e_band[CSI_LAYOUT_BAND_SUBCARRIERS];
+  float e_noise[CSI_LAYOUT_BAND_SUBCARRIERS];
+
+  uint8_t selected[SC_RANK_K]; /**< band view positions, ascending */
+  uint32_t reranks;            /**< times the selection changed */
+} sc_rank_t;
+
+/**
+ * @brief Reset, selecting the fixed band [BR_SC_FIRST, BR_SC_FIRST + K)
+ */
+void sc_rank_init(sc_rank_t *r);
+
+/**
+ * @brief Add one frame's band view
+ * @return true if r->selected changed
+ */
+bool sc_rank_push(sc_rank_t *r, const int8_t *band);
+
+#ifdef __cplusplus
+}
+#endif
@@ -17,16 +17,17 @@
  * Have fun building!
  */
 
+#include "csi_probe.h"
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "esp_netif.h"
 #include "esp_now.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "nvs_flash.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 
 #define CONFIG_LESS_INTERFERENCE_CHANNEL 149
 #define CONFIG_WIFI_BAND_MODE WIFI_BAND_MODE_5G_ONLY
@@ -37,8 +38,11 @@
 #define CONFIG_ESP_NOW_PHYMODE WIFI_PHY_MODE_HT20
 #define CONFIG_ESP_NOW_RATE WIFI_PHY_RATE_MCS0_LGI
 #define CONFIG_SEND_FREQUENCY 100
+// Give every board in a room its own id: a receiver takes several
+// transmitters, one link each, told apart by the last MAC byte
+#define CONFIG_CSI_SEND_ID 0x00
 static const uint8_t CONFIG_CSI_SEND_MAC[] = {0x1a, 0x00, 0x00,
-                                              0x00, 0x00, 0x00};
+                                              0x00, 0x00, CONFIG_CSI_SEND_ID};
 static const char *TAG = "csi_send";
 
 static void wifi_init() {
@@ -74,6 +78,27 @@ static void wifi_init() {
   (esp_wifi_set_mac(WIFI_IF_STA, CONFIG_CSI_SEND_MAC));
 }
 
+static esp_now_peer_info_t probe_peer;
+static uint32_t probe_seq = 0;
+
+// Periodic esp_timer callbacks are scheduled on absolute deadlines, so the
+// probe rate does not drift with send latency the way a sleep loop does
+static void probe_send(void *arg) {
+  csi_probe_t probe = {
+      .frequency = CONFIG_SEND_FREQUENCY,
+      .seq = probe_seq++,
+      .timestamp_us = esp_timer_get_time(),
+  };
+  uint8_t payload[CSI_PROBE_SIZE];
+  csi_probe_pack(&probe, payload);
+
+  esp_err_t ret = esp_now_send(probe_peer.peer_addr, payload, sizeof(payload));
+  if (ret != ESP_OK) {
+    ESP_LOGW(TAG, "free_heap: %ld <%s> ESP-NOW send error",
+             esp_get_free_heap_size(), esp_err_to_name(ret));
+  }
+}
+
 static void wifi_esp_now_init(esp_now_peer_info_t peer) {
   ESP_ERROR_CHECK(esp_now_init());
   ESP_ERROR_CHECK(esp_now_set_pmk((uint8_t *)"pmk1234567890123"));
@@ -132,12 +157,11 @@ void app_main() {
   ESP_LOGI(TAG, "================ END OF GROUP INFO ================");
   // END OF YOUR CODE
 
-  for (uint8_t count = 0;; ++count) {
-    esp_err_t ret = esp_now_send(peer.peer_addr, &count, sizeof(uint8_t));
-    if (ret != ESP_OK) {
-      ESP_LOGW(TAG, "free_heap: %ld <%s> ESP-NOW send error",
-               esp_get_free_heap_size(), esp_err_to_name(ret));
-    }
-    usleep(1000 * 1000 / CONFIG_SEND_FREQUENCY);
-  }
+  probe_peer = peer;
+  const esp_timer_create_args_t timer_args = {.callback = &probe_send,
+                                              .name = "probe_timer"};
+  esp_timer_handle_t timer;
+  ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer));
+  ESP_ERROR_CHECK(
+      esp_timer_start_periodic(timer, 1000 * 1000 / CONFIG_SEND_FREQUENCY));
 }
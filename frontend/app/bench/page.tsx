@@ -0,0 +1,231 @@
+"use client"
+
+import { useCallback, useEffect, useRef, useState } from "react"
+import { Card, CardContent, CardDescription, CardHeader, CardTitle } from "@/components/ui/card"
+import { Input } from "@/components/ui/input"
+import { Button } from "@/components/ui/button"
+import { BreathingRateChart } from "@/components/breathing-rate-chart"
+import { SubcarrierChart } from "@/components/subcarrier-chart"
+import { useLiveStore } from "@/hooks/use-live-store"
+import { LiveStore } from "@/lib/live-store"
+import type { CSIData } from "@/types/csi-data"
+
+// Synthetic load for the live charts: one topic publishing `rate` results a
+// second, each with `traces` subcarriers, fed through LiveStore.push() as the
+// dashboard does and drawn over a `window` second span. Reports the interval
+// between animation frames, the time spent drawing the subcarrier chart and
+// the cost of push().
+
+const TOPIC = "csi/data/bench"
+
+interface BenchConfig {
+  rate: number
+  traces: number
+  windowSeconds: number
+  seconds: number
+}
+
+interface BenchStats {
+  elapsed: number
+  samples: number
+  frames: number
+  frameP50: number
+  frameP95: number
+  frameP99: number
+  frameMax: number
+  // Frames over 1.5x the median interval, i.e. at least one missed vsync
+  longFrames: number
+  drawMean: number
+  drawP95: number
+  pushUs: number
+}
+
+function percentile(sorted: number[], p: number): number {
+  if (sorted.length === 0) return NaN
+  return sorted[Math.min(Math.floor((sorted.length * p) / 100), sorted.length - 1)]
+}
+
+function syntheticEntry(t: number, traces: number): CSIData {
+  const CSIs = new Array<number>(2 * traces)
+  for (let k = 0; k < traces; k++) {
+    // Breathing-like amplitude swing, a different phase per subcarrier
+    const amplitude = 30 + 8 * Math.sin(2 * Math.PI * 0.25 * t + k * 0.3) + 2 * Math.random()
+    const phase = k * 0.7 + t
+    CSIs[2 * k] = Math.round(amplitude * Math.cos(phase))
+    CSIs[2 * k + 1] = Math.round(amplitude * Math.sin(phase))
+  }
+  return {
+    timestamp: new Date(t * 1000).toISOString(),
+    topic: TOPIC,
+    device_id: "bench",
+    rssi: -45 + 3 * Math.sin(t / 7),
+    motion_detect: Math.floor(t / 5) % 2,
+    motion_confidence: 0.5,
+    breathing_rate: 15 + 2 * Math.sin(t / 20),
+    CSIs,
+  }
+}
+
+export default function Bench() {
+  const [config, setConfig] = useState<BenchConfig>({ rate: 100, traces: 53, windowSeconds: 60, seconds: 20 })
+  const [store, setStore] = useState(() => new LiveStore(1, 1))
+  const [running, setRunning] = useState(false)
+  const [stats, setStats] = useState<BenchStats | null>(null)
+  useLiveStore(store, 2)
+
+  const frames = useRef<number[]>([])
+  const draws = useRef<number[]>([])
+  const stopRef = useRef<(() => void) | null>(null)
+
+  const onDraw = useCallback((ms: number) => {
+    draws.current.push(ms)
+  }, [])
+
+  const start = () => {
+    const { rate, traces, windowSeconds, seconds } = config
+    const benchStore = new LiveStore(Math.ceil(rate * windowSeconds), traces)
+    setStore(benchStore)
+    frames.current = []
+    draws.current = []
+    setStats(null)
+    setRunning(true)
+
+    const begin = performance.now()
+    const epoch = Date.now() / 1000
+    let produced = 0
+    let pushMs = 0
+
+    const report = () => {
+      const frameSorted = [...frames.current].sort((a, b) => a - b)
+      const drawSorted = [...draws.current].sort((a, b) => a - b)
+      const median = percentile(frameSorted, 50)
+      setStats({
+        elapsed: (performance.now() - begin) / 1000,
+        samples: produced,
+        frames: frameSorted.length,
+        frameP50: median,
+        frameP95: percentile(frameSorted, 95),
+        frameP99: percentile(frameSorted, 99),
+        frameMax: frameSorted[frameSorted.length - 1] ?? NaN,
+        longFrames: frameSorted.filter((f) => f > 1.5 * median).length,
+        drawMean: drawSorted.reduce((a, b) => a + b, 0) / Math.max(drawSorted.length, 1),
+        drawP95: percentile(drawSorted, 95),
+        pushUs: (pushMs * 1000) / Math.max(produced, 1),
+      })
+    }
+
+    // Producer: every sample due by now, pushed in one batch like a server batch
+    const producer = setInterval(() => {
+      const due = Math.floor(((performance.now() - begin) / 1000) * rate)
+      if (due <= produced) return
+      const batch: CSIData[] = []
+      for (let i = produced; i < due; i++) batch.push(syntheticEntry(epoch + i / rate, traces))
+      const t0 = performance.now()
+      benchStore.push(batch)
+      pushMs += performance.now() - t0
+      produced = due
+    }, 10)
+
+    let frame = 0
+    let last = 0
+    const tick = (now: number) => {
+      if (last) frames.current.push(now - last)
+      last = now
+      frame = requestAnimationFrame(tick)
+    }
+    frame = requestAnimationFrame(tick)
+
+    const reporter = setInterval(report, 500)
+    const stop = () => {
+      clearInterval(producer)
+      clearInterval(reporter)
+      clearTimeout(timeout)
+      cancelAnimationFrame(frame)
+      report()
+      setRunning(false)
+      stopRef.current = null
+    }
+    const timeout = setTimeout(stop, seconds * 1000)
+    stopRef.current = stop
+  }
+
+  useEffect(() => () => stopRef.current?.(), [])
+
+  const field = (key: keyof BenchConfig, label: string) => (
+    <div className="w-full md:w-1/4">
+      <label className="text-sm font-medium mb-2 block">{label}</label>
+      <Input
+        type="number"
+        value={config[key]}
+        disabled={running}
+        onChange={(e) => setConfig({ ...config, [key]: Math.max(Number(e.target.value) || 1, 1) })}
+      />
+    </div>
+  )
+
+  const stream = store.stream(TOPIC)
+
+  return (
+    <main className="container mx-auto p-4">
+      <h1 className="text-3xl font-bold mb-6">Live Chart Benchmark</h1>
+
+      <Card className="mb-6">
+        <CardHeader>
+          <CardTitle>Synthetic Load</CardTitle>
+          <CardDescription>
+            Feeds synthetic results through the dashboard&apos;s live store and charts, then reports frame times
+          </CardDescription>
+        </CardHeader>
+        <CardContent>
+          <div className="flex flex-col md:flex-row gap-4 mb-4">
+            {field("rate", "Results per second")}
+            {field("traces", "Subcarrier traces")}
+            {field("windowSeconds", "Window (s)")}
+            {field("seconds", "Duration (s)")}
+          </div>
+          <div className="flex items-center gap-4">
+            <Button onClick={start} disabled={running}>
+              Run
+            </Button>
+            <Button variant="outline" onClick={() => stopRef.current?.()} disabled={!running}>
+              Stop
+            </Button>
+            <span className="text-sm text-muted-foreground">
+              {config.rate * config.windowSeconds} points per trace, {config.traces + 1} traces
+            </span>
+          </div>
+          {stats && (
+            <div className="grid grid-cols-2 md:grid-cols-4 gap-2 mt-4 text-sm">
+              <span>
+                {stats.samples} results in {stats.elapsed.toFixed(1)} s
+              </span>
+              <span>{stats.frames} frames</span>
+              <span>
+                frame p50 {stats.frameP50.toFixed(1)} ms, p95 {stats.frameP95.toFixed(1)} ms
+              </span>
+              <span>
+                p99 {stats.frameP99.toFixed(1)} ms, max {stats.frameMax.toFixed(1)} ms
+              </span>
+              <span>{stats.longFrames} long frames</span>
+              <span>
+                draw mean {stats.drawMean.toFixed(2)} ms, p95 {stats.drawP95.toFixed(2)} ms
+              </span>
+              <span>push {stats.pushUs.toFixed(1)} us per result</span>
+            </div>
+          )}
+        </CardContent>
+      </Card>
+
+      <div className="grid gap-4">
+        <SubcarrierChart
+          buffer={stream?.csi}
+          topic={TOPIC}
+          windowSeconds={config.windowSeconds}
+          className="h-[400px] w-full"
+          onDraw={onDraw}
+        />
+        <BreathingRateChart buffer={stream?.metrics} topic={TOPIC} windowSeconds={config.windowSeconds} />
+      </div>
+    </main>
+  )
+}
@@ -10,15 +10,34 @@ import { CSIDataTable } from "@/components/csi-data-table"
 import { ConnectionStatus } from "@/components/connection-status"
 import { MotionDetectionChart } from "@/components/motion-detection-chart"
 import { BreathingRateChart } from "@/components/breathing-rate-chart"
+import { SubcarrierChart } from "@/components/subcarrier-chart"
 import { useToast } from "@/hooks/use-toast"
+import { useLiveStore } from "@/hooks/use-live-store"
+import { decodeBinaryBatch, historyToBuffer, type QueryResultMessage } from "@/lib/ws-protocol"
+import { LiveStore } from "@/lib/live-store"
 import { ChevronDown, ChevronUp } from "lucide-react"
-import type { CSIData } from "@/types/csi-data"
+import type { LinkTelemetry } from "@/types/csi-data"
 import { Tabs, TabsContent, TabsList, TabsTrigger } from "@/components/ui/tabs"
 import { Select, SelectContent, SelectItem, SelectTrigger, SelectValue } from "@/components/ui/select"
 
+// Steps per history query, about one per pixel of the charts
+const HISTORY_POINTS = 500
+const HISTORY_REFRESH_MS = 10000
+const HISTORY_RANGES = [
+  { value: "3600", label: "Last hour" },
+  { value: "21600", label: "Last 6 hours" },
+  { value: "86400", label: "Last 24 hours" },
+  { value: "604800", label: "Last 7 days" },
+]
+// Span of the live charts
+const LIVE_WINDOW_S = 60
+
 export default function Home() {
   const [isConnected, setIsConnected] = useState(false)
-  const [csiData, setCsiData] = useState<CSIData[]>([])
+  // Live data is written into the store's buffers, not React state; the
+  // charts draw from them and the rest of the page re-renders at 4 Hz
+  const [store] = useState(() => new LiveStore())
+  const storeVersion = useLiveStore(store)
   const [ws, setWs] = useState<WebSocket | null>(null)
   const [brokerAddress, setBrokerAddress] = useState("192.168.46.44")
   const [topicFilter, setTopicFilter] = useState("")
@@ -26,30 +45,37 @@ export default function Home() {
   const [selectedTopic, setSelectedTopic] = useState<string | null>(null)
   const [selectedSubcarrier, setSelectedSubcarrier] = useState(0)
   const [showTable, setShowTable] = useState(true)
+  const [telemetry, setTelemetry] = useState<Record<string, LinkTelemetry>>({})
+  // "live" or a history range in seconds
+  const [historyRange, setHistoryRange] = useState("live")
+  const [historyResult, setHistoryResult] = useState<QueryResultMessage | null>(null)
   const { toast } = useToast()
 
   // Filter data based on search term
   const filteredData = useMemo(() => {
-    if (!searchTerm) return csiData
-    return csiData.filter((item) => item.topic && item.topic.toLowerCase().includes(searchTerm.toLowerCase()))
-  }, [csiData, searchTerm])
+    const latest = store.latest()
+    if (!searchTerm) return latest
+    return latest.filter((item) => item.topic && item.topic.toLowerCase().includes(searchTerm.toLowerCase()))
+  }, [store, storeVersion, searchTerm])
 
   // Get unique topics from data
-  const topics = useMemo(() => {
-    const topicSet = new Set<string>()
-    csiData.forEach((item) => {
-      if (item.topic) {
-        topicSet.add(item.topic)
-      }
-    })
-    return Array.from(topicSet)
-  }, [csiData])
+  const topics = useMemo(() => store.topics(), [store, store.topicsVersion])
+
+  const liveStream = store.stream(selectedTopic)
+
+  // History is kept per device, the one publishing on the selected topic
+  const selectedDevice = selectedTopic ? liveStream?.deviceId : undefined
+
+  const historyBuffer = useMemo(() => (historyResult ? historyToBuffer(historyResult) : null), [historyResult])
 
   const connectWebSocket = useCallback(() => {
     const newWs = new WebSocket("ws://localhost:8765")
+    newWs.binaryType = "arraybuffer"
 
     newWs.onopen = () => {
       setWs(newWs)
+      // Ask for compact binary batches instead of JSON
+      newWs.send(JSON.stringify({ type: "set_format", binary: true }))
       toast({
         title: "Connected",
         description: "Successfully connected to the WebSocket server",
@@ -59,30 +85,35 @@ export default function Home() {
     
     newWs.onmessage = (event) => {
       try {
-        const message = JSON.parse(event.data);
-    
-        if (message.type === "data") {
-          // Single data update
-          setCsiData((prevData) => {
-            const newData = [...prevData, message.payload];
-            // Keep only the last 100 records
-            return newData.length > 100 ? newData.slice(-100) : newData;
-          });
-          console.log("Received data:", message.payload);
-          
+        const message =
+          event.data instanceof ArrayBuffer ? decodeBinaryBatch(event.data) : JSON.parse(event.data);
+
+        if (message.type === "batch" && Array.isArray(message.data)) {
+          // Updates coalesced by the server, written in place
+          store.push(message.data);
+
         } else if (message.type === "initial_data" && Array.isArray(message.data)) {
-          // Initial data load
-          setCsiData(message.data);
-          console.log("Received initial data:", message.data);
-          
+          store.clear();
+          store.push(message.data);
+
         } else if (message.type === "connection_status") {
           setIsConnected(message.connected);
           // Update topic filter if it's provided
           if (message.topic_filter) {
             setTopicFilter(message.topic_filter);
           }
-          console.log("Connection status updated:", message.connected);
-          
+
+        } else if (message.type === "query_result") {
+          if (message.error) {
+            console.warn("History query failed:", message.error);
+          } else {
+            setHistoryResult(message);
+          }
+
+        } else if (message.type === "telemetry") {
+          // Latest link report per device
+          setTelemetry((prev) => ({ ...prev, [message.device_id]: message }));
+
         } else {
           console.warn("Unknown message type:", message.type);
         }
@@ -120,13 +151,36 @@ export default function Home() {
         newWs.close()
       }
     }
-  }, [toast])
+  }, [toast, store])
 
   useEffect(() => {
     const cleanup = connectWebSocket()
     return cleanup
   }, [connectWebSocket])
 
+  // Re-query the selected range while a history view is shown
+  useEffect(() => {
+    setHistoryResult(null)
+    if (historyRange === "live" || !selectedDevice || !ws) return
+
+    const query = () => {
+      if (ws.readyState !== WebSocket.OPEN) return
+      const end = Date.now() / 1000
+      ws.send(
+        JSON.stringify({
+          type: "query",
+          device_id: selectedDevice,
+          start: end - Number(historyRange),
+          end,
+          points: HISTORY_POINTS,
+        }),
+      )
+    }
+    query()
+    const timer = setInterval(query, HISTORY_REFRESH_MS)
+    return () => clearInterval(timer)
+  }, [historyRange, selectedDevice, ws])
+
   const handleConnect = () => {
     if (ws && ws.readyState === WebSocket.OPEN) {
       ws.send(
@@ -163,7 +217,7 @@ export default function Home() {
 
   const handleTopicFilterChange = (e: React.KeyboardEvent<HTMLInputElement>) => {
     if (e.key === "Enter" && ws && ws.readyState === WebSocket.OPEN) {
-      const newFilter = e.currentTarget.value || "csi/data"
+      const newFilter = e.currentTarget.value || "csi/data/#"
       ws.send(
         JSON.stringify({
           type: "set_topic_filter",
@@ -183,6 +237,10 @@ export default function Home() {
     setSelectedTopic(value === "all" ? null : value)
   }
 
+  const handleHistoryRangeChange = (value: string) => {
+    setHistoryRange(value)
+  }
+
   const handleSubcarrierChange = (value: string) => {
     setSelectedSubcarrier(Number.parseInt(value, 10))
   }
@@ -203,12 +261,7 @@ export default function Home() {
     }, 0)
   }
 
-  // Debug function to log data structure
-  useEffect(() => {
-    if (csiData.length > 0) {
-      console.log("Current data structure:", csiData[0])
-    }
-  }, [csiData])
+  const showHistory = historyRange !== "live" && !!selectedDevice
 
   return (
     <main className="container mx-auto p-4">
@@ -240,6 +293,19 @@ export default function Home() {
                 <ConnectionStatus isConnected={isConnected} />
                 {isConnected && <span className="text-sm text-muted-foreground">Topic filter: {topicFilter}</span>}
               </div>
+
+              {Object.values(telemetry).map((t) => (
+                <span key={t.device_id} className="text-sm text-muted-foreground">
+                  {t.device_id}: {(t.loss_rate * 100).toFixed(1)}% probes lost, jitter {t.jitter_us.toFixed(0)} us,
+                  max gap {(t.max_interval_us / 1000).toFixed(0)} ms
+                  {t.startup_ms && t.startup_ms.first_publish > 0 &&
+                    `, first frame published ${(t.startup_ms.first_publish / 1000).toFixed(1)} s after boot`}
+                  {!!t.backlog_dropped && `, ${t.backlog_dropped} held messages dropped`}
+                  {t.publish &&
+                    t.publish.level !== "normal" &&
+                    `, publishing at level ${t.publish.level} (outbox ${(t.publish.outbox_peak / 1024).toFixed(0)} KB peak)`}
+                </span>
+              ))}
             </div>
           </CardContent>
         </Card>
@@ -256,7 +322,7 @@ export default function Home() {
                   placeholder="Enter topic filter"
                   onKeyDown={handleTopicFilterChange}
                   disabled={!isConnected}
-                  defaultValue={"csi/data"}
+                  defaultValue={"csi/data/#"}
                 />
                 <div className="absolute inset-y-0 right-0 flex items-center pr-3 pointer-events-none text-muted-foreground">
                   Press Enter
@@ -308,6 +374,22 @@ export default function Home() {
                   </SelectContent>
                 </Select>
               </div>
+              <div className="w-full md:w-1/2">
+                <label className="text-sm font-medium mb-2 block">Time Range</label>
+                <Select onValueChange={handleHistoryRangeChange} defaultValue="live" disabled={!selectedDevice}>
+                  <SelectTrigger>
+                    <SelectValue placeholder="Live" />
+                  </SelectTrigger>
+                  <SelectContent>
+                    <SelectItem value="live">Live</SelectItem>
+                    {HISTORY_RANGES.map((range) => (
+                      <SelectItem key={range.value} value={range.value}>
+                        {range.label}
+                      </SelectItem>
+                    ))}
+                  </SelectContent>
+                </Select>
+              </div>
             </div>
           </CardContent>
         </Card>
@@ -330,10 +412,21 @@ export default function Home() {
           <CardTitle>Data Visualization</CardTitle>
         </CardHeader>
         <CardContent>
-          <MotionDetectionChart data={filteredData} topic={selectedTopic || undefined} />
+          <MotionDetectionChart
+            buffer={showHistory ? historyBuffer : liveStream?.metrics}
+            topic={selectedTopic || undefined}
+            windowSeconds={showHistory ? 0 : LIVE_WINDOW_S}
+          />
+        </CardContent>
+        <CardContent>
+          <BreathingRateChart
+            buffer={showHistory ? historyBuffer : liveStream?.metrics}
+            topic={selectedTopic || undefined}
+            windowSeconds={showHistory ? 0 : LIVE_WINDOW_S}
+          />
         </CardContent>
         <CardContent>
-          <BreathingRateChart data={filteredData} topic={selectedTopic || undefined} />
+          <SubcarrierChart buffer={liveStream?.csi} topic={selectedTopic || undefined} windowSeconds={LIVE_WINDOW_S} />
         </CardContent>
       </Card>
     </main>
@@ -0,0 +1,193 @@
+"use client"
+
+import { useEffect, useRef } from "react"
+import type { RingBuffer } from "@/lib/ring-buffer"
+import { Envelope, fillEnvelope, strokeEnvelope } from "@/lib/canvas-plot"
+
+export interface ChartSeries {
+  channel: number
+  // A CSS color, or the name of a theme variable such as "--chart-4"
+  color: string
+  label?: string
+}
+
+interface CanvasChartProps {
+  buffer: RingBuffer | null | undefined
+  series: ChartSeries[]
+  // Span of the x axis, ending at the newest sample; 0 shows every sample
+  windowSeconds?: number
+  // Fixed y range; either bound is taken from the visible data when unset
+  yMin?: number
+  yMax?: number
+  yLabels?: (value: number) => string
+  stepped?: boolean
+  className?: string
+  // Called after every redraw with its duration, for benchmarks
+  onDraw?: (ms: number) => void
+}
+
+const MARGIN = { left: 44, right: 8, top: 8, bottom: 20 }
+
+function resolveColor(element: Element, color: string): string {
+  if (!color.startsWith("--")) return color
+  return `hsl(${getComputedStyle(element).getPropertyValue(color).trim()})`
+}
+
+function clockTime(t: number): string {
+  return new Date(t * 1000).toLocaleTimeString()
+}
+
+// Line chart drawn on a canvas from a RingBuffer. It redraws on the next
+// animation frame after the buffer changes, at most once per frame, without
+// a React render. All series are reduced to a few points per pixel column in
+// one pass over the samples, so many thousands of points and dozens of
+// series stay cheap.
+export function CanvasChart({ className, ...props }: CanvasChartProps) {
+  const canvasRef = useRef<HTMLCanvasElement | null>(null)
+  const propsRef = useRef(props)
+  const dirty = useRef(true)
+
+  // Latest props for the draw loop; a render forces one redraw
+  useEffect(() => {
+    propsRef.current = props
+    dirty.current = true
+  })
+
+  useEffect(() => {
+    const canvas = canvasRef.current
+    if (!canvas) return
+    const ctx = canvas.getContext("2d")
+    if (!ctx) return
+
+    let frame = 0
+    let env: Envelope | null = null
+    let drawnBuffer: RingBuffer | null | undefined = null
+    let drawnVersion = -1
+
+    const resize = () => {
+      const dpr = window.devicePixelRatio || 1
+      canvas.width = Math.round(canvas.clientWidth * dpr)
+      canvas.height = Math.round(canvas.clientHeight * dpr)
+      dirty.current = true
+    }
+    const observer = new ResizeObserver(resize)
+    observer.observe(canvas)
+    resize()
+
+    const draw = () => {
+      const { buffer, series, windowSeconds = 0, yMin, yMax, yLabels, stepped, onDraw } = propsRef.current
+      const start = performance.now()
+      const dpr = window.devicePixelRatio || 1
+      const width = canvas.width / dpr
+      const height = canvas.height / dpr
+      ctx.setTransform(dpr, 0, 0, dpr, 0, 0)
+      ctx.clearRect(0, 0, width, height)
+
+      const plotWidth = Math.max(Math.floor(width - MARGIN.left - MARGIN.right), 1)
+      const plotHeight = Math.max(height - MARGIN.top - MARGIN.bottom, 1)
+      const muted = resolveColor(canvas, "--muted-foreground")
+      ctx.font = "11px sans-serif"
+      ctx.fillStyle = muted
+
+      if (!buffer || buffer.length === 0) {
+        ctx.textAlign = "center"
+        ctx.fillText("No data available", width / 2, height / 2)
+        onDraw?.(performance.now() - start)
+        return
+      }
+
+      const t1 = buffer.time(buffer.length - 1)
+      const t0 = windowSeconds > 0 ? t1 - windowSeconds : buffer.time(0)
+      if (!env || env.width !== plotWidth || env.series !== series.length) {
+        env = new Envelope(plotWidth, series.length)
+      }
+      const columns = env
+      fillEnvelope(
+        columns,
+        buffer,
+        series.map((s) => s.channel),
+        t0,
+        t1,
+      )
+      const [dataLo, dataHi] = yMin === undefined || yMax === undefined ? columns.range() : [yMin, yMax]
+      const lo = yMin ?? (Number.isNaN(dataLo) ? 0 : dataLo)
+      let hi = yMax ?? (Number.isNaN(dataHi) ? 1 : dataHi)
+      if (hi <= lo) hi = lo + 1
+      const yScale = plotHeight / (hi - lo)
+      const y = (v: number) => MARGIN.top + plotHeight - (v - lo) * yScale
+
+      // Grid and axis labels
+      ctx.strokeStyle = resolveColor(canvas, "--border")
+      ctx.lineWidth = 1
+      ctx.textAlign = "right"
+      ctx.textBaseline = "middle"
+      ctx.beginPath()
+      for (let k = 0; k <= 2; k++) {
+        const v = lo + ((hi - lo) * k) / 2
+        const py = Math.round(y(v)) + 0.5
+        ctx.moveTo(MARGIN.left, py)
+        ctx.lineTo(MARGIN.left + plotWidth, py)
+        ctx.fillText(yLabels ? yLabels(v) : v.toFixed(Math.abs(hi - lo) < 10 ? 1 : 0), MARGIN.left - 4, py)
+      }
+      ctx.stroke()
+      ctx.textBaseline = "alphabetic"
+      ctx.textAlign = "left"
+      ctx.fillText(clockTime(t0), MARGIN.left, height - 4)
+      ctx.textAlign = "right"
+      ctx.fillText(clockTime(t1), MARGIN.left + plotWidth, height - 4)
+
+      ctx.save()
+      ctx.beginPath()
+      ctx.rect(MARGIN.left, MARGIN.top, plotWidth, plotHeight)
+      ctx.clip()
+      ctx.lineWidth = 1.5
+      ctx.lineJoin = "round"
+      series.forEach((s, i) => {
+        ctx.strokeStyle = resolveColor(canvas, s.color)
+        ctx.beginPath()
+        strokeEnvelope(ctx, columns, i, MARGIN.left, y, stepped)
+        ctx.stroke()
+      })
+      ctx.restore()
+      onDraw?.(performance.now() - start)
+    }
+
+    const tick = () => {
+      const { buffer } = propsRef.current
+      if (dirty.current || buffer !== drawnBuffer || (buffer && buffer.version !== drawnVersion)) {
+        dirty.current = false
+        drawnBuffer = buffer
+        drawnVersion = buffer ? buffer.version : -1
+        draw()
+      }
+      frame = requestAnimationFrame(tick)
+    }
+    frame = requestAnimationFrame(tick)
+
+    return () => {
+      cancelAnimationFrame(frame)
+      observer.disconnect()
+    }
+  }, [])
+
+  return <canvas ref={canvasRef} className={className ?? "h-[300px] w-full"} />
+}
+
+// Color legend for the series of a CanvasChart
+export function ChartLegend({ series }: { series: ChartSeries[] }) {
+  return (
+    <div className="flex flex-wrap gap-x-4 gap-y-1 text-sm text-muted-foreground">
+      {series
+        .filter((s) => s.label)
+        .map((s) => (
+          <span key={s.channel} className="flex items-center gap-1">
+            <span
+              className="inline-block h-2 w-4 rounded-sm"
+              style={{ background: s.color.startsWith("--") ? `hsl(var(${s.color}))` : s.color }}
+            />
+            {s.label}
+          </span>
+        ))}
+    </div>
+  )
+}
@@ -56,7 +56,12 @@ export function CSIDataTable({ data }: CSIDataTableProps) {
                   <TableCell>{item.topic || "N/A"}</TableCell>
                   <TableCell>{item.device_id || "N/A"}</TableCell>
                   <TableCell>{item.rssi || "N/A"}</TableCell>
-                  <TableCell>{item.motion_detect}</TableCell>
+                  <TableCell>
+                    {item.motion_detect}
+                    {item.motion_confidence != null && (
+                      <span className="text-muted-foreground"> ({Math.round(item.motion_confidence * 100)}%)</span>
+                    )}
+                  </TableCell>
                   <TableCell>
                     {item.CSIs ? (
                       <span>{item.CSIs.slice(0, 10)}</span>
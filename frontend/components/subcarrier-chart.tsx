@@ -0,0 +1,52 @@
+"use client"
+
+import { useMemo } from "react"
+import { Card, CardContent, CardDescription, CardHeader, CardTitle } from "@/components/ui/card"
+import { CanvasChart, ChartLegend, type ChartSeries } from "@/components/canvas-chart"
+import type { RingBuffer } from "@/lib/ring-buffer"
+
+interface SubcarrierChartProps {
+  // CSI buffer of a LiveStore stream: one amplitude channel per subcarrier
+  buffer: RingBuffer | null | undefined
+  topic?: string
+  windowSeconds?: number
+  // Traces drawn, the first subcarriers of the buffer
+  traces?: number
+  className?: string
+  onDraw?: (ms: number) => void
+}
+
+export function SubcarrierChart({ buffer, topic, windowSeconds = 0, traces, className, onDraw }: SubcarrierChartProps) {
+  const count = Math.min(traces ?? buffer?.channels ?? 0, buffer?.channels ?? 0)
+  const series = useMemo<ChartSeries[]>(
+    () =>
+      Array.from({ length: count }, (_, k) => ({
+        channel: k,
+        color: `hsl(${Math.round((k * 360) / count)}, 70%, 50%)`,
+        label: count <= 12 ? `SC ${k}` : undefined,
+      })),
+    [count],
+  )
+
+  return (
+    <Card>
+      <CardHeader>
+        <CardTitle>Subcarrier Amplitudes</CardTitle>
+        <CardDescription>
+          {topic ? `CSI amplitude per subcarrier for topic: ${topic}` : "CSI amplitude per subcarrier"}
+        </CardDescription>
+        <ChartLegend series={series} />
+      </CardHeader>
+      <CardContent>
+        <CanvasChart
+          buffer={buffer}
+          series={series}
+          windowSeconds={windowSeconds}
+          yMin={0}
+          className={className}
+          onDraw={onDraw}
+        />
+      </CardContent>
+    </Card>
+  )
+}
@@ -0,0 +1,22 @@
+import * as React from "react"
+import type { LiveStore } from "@/lib/live-store"
+
+// Re-renders the caller at most `hz` times a second, and only when the store
+// changed. Charts draw from the store's buffers on their own; this is for the
+// parts of the page that need React state, like the table and topic list.
+export function useLiveStore(store: LiveStore, hz = 4) {
+  const [, setVersion] = React.useState(store.version)
+
+  React.useEffect(() => {
+    let seen = store.version
+    const timer = setInterval(() => {
+      if (store.version !== seen) {
+        seen = store.version
+        setVersion(seen)
+      }
+    }, 1000 / hz)
+    return () => clearInterval(timer)
+  }, [store, hz])
+
+  return store.version
+}
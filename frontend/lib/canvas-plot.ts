@@ -0,0 +1,124 @@
+import type { RingBuffer } from "@/lib/ring-buffer"
+
+// The path calls strokeEnvelope() makes, a subset of CanvasRenderingContext2D
+export interface PathSink {
+  moveTo(x: number, y: number): void
+  lineTo(x: number, y: number): void
+}
+
+// Samples of several series reduced per pixel column to the first, lowest,
+// highest and last value. Drawing those four points per column looks the
+// same as drawing every sample, so the cost of stroking depends on the chart
+// width, not on how many samples it shows. Index series * width + column.
+export class Envelope {
+  readonly width: number
+  readonly series: number
+  readonly first: Float32Array
+  readonly last: Float32Array
+  readonly lo: Float32Array
+  readonly hi: Float32Array
+  // 1 where a NaN sample broke the line before the column's first value
+  readonly gap: Uint8Array
+
+  constructor(width: number, series: number) {
+    this.width = width
+    this.series = series
+    const size = width * series
+    this.first = new Float32Array(size)
+    this.last = new Float32Array(size)
+    this.lo = new Float32Array(size)
+    this.hi = new Float32Array(size)
+    this.gap = new Uint8Array(size)
+  }
+
+  // Smallest and largest value of all series, [NaN, NaN] if there are none
+  range(): [number, number] {
+    let lo = Infinity
+    let hi = -Infinity
+    for (let k = 0; k < this.lo.length; k++) {
+      if (this.lo[k] < lo) lo = this.lo[k]
+      if (this.hi[k] > hi) hi = this.hi[k]
+    }
+    return lo <= hi ? [lo, hi] : [NaN, NaN]
+  }
+}
+
+// Fills `env` from the given channels of `buffer` between t0 and t1, in one
+// pass over the samples; each sample's channels are adjacent in memory, so
+// dozens of series cost little more than one
+export function fillEnvelope(env: Envelope, buffer: RingBuffer, channels: number[], t0: number, t1: number) {
+  const { width, first, last, lo, hi, gap } = env
+  const n = Math.min(channels.length, env.series)
+  first.fill(NaN)
+  lo.fill(NaN)
+  hi.fill(NaN)
+  gap.fill(0)
+  const broken = new Uint8Array(n)
+
+  const scale = t1 > t0 ? width / (t1 - t0) : 0
+  const { times, values, capacity } = buffer
+  const stride = buffer.channels
+  const begin = buffer.lowerBound(t0)
+  let slot = buffer.slot(begin)
+  for (let i = begin; i < buffer.length; i++, slot = slot + 1 === capacity ? 0 : slot + 1) {
+    const t = times[slot]
+    if (t > t1) break
+    // t >= t0, so truncation is the floor
+    let c = ((t - t0) * scale) | 0
+    if (c >= width) c = width - 1
+    const base = slot * stride
+    for (let j = 0, k = c; j < n; j++, k += width) {
+      const v = values[base + channels[j]]
+      // NaN
+      if (v !== v) {
+        broken[j] = 1
+        continue
+      }
+      const f = first[k]
+      if (f !== f) {
+        first[k] = last[k] = lo[k] = hi[k] = v
+        gap[k] = broken[j]
+      } else {
+        last[k] = v
+        if (v < lo[k]) lo[k] = v
+        else if (v > hi[k]) hi[k] = v
+      }
+      // A break inside a column is too short to see
+      broken[j] = 0
+    }
+  }
+}
+
+// Adds series `s` of `env` to a path from x0; columns without samples are
+// bridged by the line, NaN samples break it
+export function strokeEnvelope(
+  path: PathSink,
+  env: Envelope,
+  s: number,
+  x0: number,
+  y: (value: number) => number,
+  stepped = false,
+) {
+  const { width, first, last, lo, hi, gap } = env
+  let penDown = false
+  let previous = 0
+  for (let c = 0, k = s * width; c < width; c++, k++) {
+    const f = first[k]
+    if (f !== f) continue
+    const x = x0 + c + 0.5
+    if (!penDown || gap[k]) {
+      path.moveTo(x, y(f))
+    } else {
+      if (stepped) path.lineTo(x, y(previous))
+      path.lineTo(x, y(f))
+    }
+    // A column of one value is a single point
+    if (lo[k] !== hi[k]) {
+      path.lineTo(x, y(lo[k]))
+      path.lineTo(x, y(hi[k]))
+      path.lineTo(x, y(last[k]))
+    }
+    penDown = true
+    previous = last[k]
+  }
+}
@@ -0,0 +1,136 @@
+import type { CSIData } from "@/types/csi-data"
+import { RingBuffer } from "@/lib/ring-buffer"
+
+// Channels of LiveStream.metrics
+export const METRIC_RSSI = 0
+export const METRIC_MOTION = 1
+export const METRIC_CONFIDENCE = 2
+export const METRIC_BREATHING = 3
+const METRIC_CHANNELS = 4
+
+// The server forwards the first 20 CSI values of every message, the I/Q of
+// 10 subcarriers
+export const DEFAULT_CSI_TRACES = 10
+// 10 minutes of 10 messages/s, or one minute at 100 Hz
+export const DEFAULT_CAPACITY = 6000
+const TABLE_ENTRIES = 100
+
+export interface LiveStream {
+  deviceId?: string
+  metrics: RingBuffer
+  // Amplitude of every subcarrier
+  csi: RingBuffer
+}
+
+function numberOr(value: unknown): number {
+  return typeof value === "number" ? value : value === true ? 1 : value === false ? 0 : NaN
+}
+
+// Live data of every topic, plus the newest entries for the table. push()
+// only writes into preallocated buffers; charts redraw from them on the next
+// animation frame and React state is refreshed at a low rate (useLiveStore).
+export class LiveStore {
+  readonly capacity: number
+  readonly csiTraces: number
+  // Bumped on every push, and when a topic appears
+  version = 0
+  topicsVersion = 0
+  private streams = new Map<string, LiveStream>()
+  // Entries of every topic, for topic = null
+  private all: LiveStream
+  private recent: CSIData[] = new Array(TABLE_ENTRIES)
+  private recentCount = 0
+
+  constructor(capacity = DEFAULT_CAPACITY, csiTraces = DEFAULT_CSI_TRACES) {
+    this.capacity = capacity
+    this.csiTraces = csiTraces
+    this.all = this.newStream()
+  }
+
+  private newStream(deviceId?: string): LiveStream {
+    return {
+      deviceId,
+      metrics: new RingBuffer(this.capacity, METRIC_CHANNELS),
+      csi: new RingBuffer(this.capacity, this.csiTraces),
+    }
+  }
+
+  clear() {
+    this.streams.clear()
+    this.all = this.newStream()
+    this.recentCount = 0
+    this.version++
+    this.topicsVersion++
+  }
+
+  push(entries: CSIData[]) {
+    for (const entry of entries) {
+      const topic = entry.topic ?? ""
+      let stream = this.streams.get(topic)
+      if (!stream) {
+        stream = this.newStream(entry.device_id)
+        this.streams.set(topic, stream)
+        this.topicsVersion++
+      }
+      const t = entry.timestamp ? Date.parse(entry.timestamp) / 1000 : Date.now() / 1000
+      this.pushMetrics(stream.metrics, t, entry)
+      this.pushMetrics(this.all.metrics, t, entry)
+      if (entry.CSIs && entry.CSIs.length >= 2) {
+        this.pushCsi(stream.csi, t, entry.CSIs)
+        this.pushCsi(this.all.csi, t, entry.CSIs)
+      } else if (entry.amplitudes && entry.amplitudes.length) {
+        this.pushAmplitudes(stream.csi, t, entry.amplitudes)
+        this.pushAmplitudes(this.all.csi, t, entry.amplitudes)
+      }
+      this.recent[this.recentCount % TABLE_ENTRIES] = entry
+      this.recentCount++
+    }
+    this.version++
+  }
+
+  private pushMetrics(buffer: RingBuffer, t: number, entry: CSIData) {
+    buffer.pushWith(t, (values, offset) => {
+      values[offset + METRIC_RSSI] = numberOr(entry.rssi)
+      values[offset + METRIC_MOTION] = numberOr(entry.motion_detect)
+      values[offset + METRIC_CONFIDENCE] = numberOr(entry.motion_confidence)
+      values[offset + METRIC_BREATHING] = numberOr(entry.breathing_rate)
+    })
+  }
+
+  private pushCsi(buffer: RingBuffer, t: number, csi: number[]) {
+    const traces = Math.min(csi.length >> 1, this.csiTraces)
+    buffer.pushWith(t, (values, offset) => {
+      for (let k = 0; k < traces; k++) {
+        values[offset + k] = Math.hypot(csi[2 * k], csi[2 * k + 1])
+      }
+      for (let k = traces; k < this.csiTraces; k++) values[offset + k] = NaN
+    })
+  }
+
+  // Decimated publish mode: the amplitudes themselves, one per subcarrier
+  private pushAmplitudes(buffer: RingBuffer, t: number, amplitudes: number[]) {
+    const traces = Math.min(amplitudes.length, this.csiTraces)
+    buffer.pushWith(t, (values, offset) => {
+      for (let k = 0; k < traces; k++) values[offset + k] = amplitudes[k]
+      for (let k = traces; k < this.csiTraces; k++) values[offset + k] = NaN
+    })
+  }
+
+  topics(): string[] {
+    return Array.from(this.streams.keys()).filter((topic) => topic !== "")
+  }
+
+  stream(topic: string | null): LiveStream | undefined {
+    return topic === null ? this.all : this.streams.get(topic)
+  }
+
+  // Newest entries, oldest first
+  latest(): CSIData[] {
+    const n = Math.min(this.recentCount, TABLE_ENTRIES)
+    const out = new Array<CSIData>(n)
+    for (let i = 0; i < n; i++) {
+      out[i] = this.recent[(this.recentCount - n + i) % TABLE_ENTRIES]
+    }
+    return out
+  }
+}
@@ -0,0 +1,76 @@
+// Fixed-capacity time series in preallocated typed arrays. Pushing never
+// allocates: once full, the oldest sample is overwritten in place. Each
+// sample has a time (seconds) and `channels` values, NaN where missing.
+// Index 0 is the oldest sample held, length - 1 the newest.
+export class RingBuffer {
+  readonly capacity: number
+  readonly channels: number
+  readonly times: Float64Array
+  readonly values: Float32Array
+  length = 0
+  // Bumped on every change, so renderers can skip frames without new data
+  version = 0
+  // Slot the next sample goes to
+  private head = 0
+
+  constructor(capacity: number, channels = 1) {
+    this.capacity = capacity
+    this.channels = channels
+    this.times = new Float64Array(capacity)
+    this.values = new Float32Array(capacity * channels)
+  }
+
+  clear() {
+    this.length = 0
+    this.head = 0
+    this.version++
+  }
+
+  // Copies up to `channels` values; channels beyond values.length are NaN
+  push(t: number, values: ArrayLike<number>) {
+    const base = this.head * this.channels
+    const n = Math.min(values.length, this.channels)
+    for (let c = 0; c < n; c++) this.values[base + c] = values[c]
+    for (let c = n; c < this.channels; c++) this.values[base + c] = NaN
+    this.commit(t)
+  }
+
+  // Writes the next sample's values through `fill(values, offset)` and
+  // commits it, for producers that compute values in place
+  pushWith(t: number, fill: (values: Float32Array, offset: number) => void) {
+    fill(this.values, this.head * this.channels)
+    this.commit(t)
+  }
+
+  private commit(t: number) {
+    this.times[this.head] = t
+    this.head = this.head + 1 === this.capacity ? 0 : this.head + 1
+    if (this.length < this.capacity) this.length++
+    this.version++
+  }
+
+  slot(i: number): number {
+    const s = this.head - this.length + i
+    return s < 0 ? s + this.capacity : s
+  }
+
+  time(i: number): number {
+    return this.times[this.slot(i)]
+  }
+
+  value(i: number, channel = 0): number {
+    return this.values[this.slot(i) * this.channels + channel]
+  }
+
+  // Index of the first sample at or after t; samples are pushed in time order
+  lowerBound(t: number): number {
+    let lo = 0
+    let hi = this.length
+    while (lo < hi) {
+      const mid = (lo + hi) >>> 1
+      if (this.time(mid) < t) lo = mid + 1
+      else hi = mid
+    }
+    return lo
+  }
+}
@@ -0,0 +1,72 @@
+import type { CSIData } from "@/types/csi-data"
+import { RingBuffer } from "@/lib/ring-buffer"
+import { METRIC_BREATHING, METRIC_CONFIDENCE, METRIC_MOTION, METRIC_RSSI } from "@/lib/live-store"
+
+// Binary batch layout (see backend/fanout.py):
+//   "CSIB" | u32 JSON length | JSON {type: "batch", data: [...]} | int8 CSIs
+// Each JSON entry carries csi_len, the number of int8 CSI values it owns.
+const BINARY_MAGIC = "CSIB"
+const HEADER_SIZE = 8
+
+export interface BatchMessage {
+  type: "batch"
+  data: CSIData[]
+}
+
+export function decodeBinaryBatch(buffer: ArrayBuffer): BatchMessage {
+  const view = new DataView(buffer)
+  const magic = String.fromCharCode(view.getUint8(0), view.getUint8(1), view.getUint8(2), view.getUint8(3))
+  if (magic !== BINARY_MAGIC) {
+    throw new Error(`Unknown binary message ${magic}`)
+  }
+
+  const jsonLength = view.getUint32(4, true)
+  const meta = JSON.parse(new TextDecoder().decode(new Uint8Array(buffer, HEADER_SIZE, jsonLength)))
+
+  let offset = HEADER_SIZE + jsonLength
+  const data = meta.data.map((entry: CSIData & { csi_len: number }) => {
+    const { csi_len, ...rest } = entry
+    const CSIs = Array.from(new Int8Array(buffer, offset, csi_len))
+    offset += csi_len
+    return { ...rest, CSIs }
+  })
+
+  return { type: "batch", data }
+}
+
+// History query (see backend/rollup.py): min/max/mean of every metric per
+// step of resolution_s seconds, null where a step has no results
+export interface HistorySeries {
+  min: (number | null)[]
+  max: (number | null)[]
+  mean: (number | null)[]
+}
+
+export interface QueryResultMessage {
+  type: "query_result"
+  id: number | null
+  device_id: string
+  error?: string
+  start: number
+  end: number
+  resolution_s: number
+  t: number[]
+  series: Record<"rssi" | "motion_detect" | "motion_confidence" | "breathing_rate", HistorySeries>
+}
+
+// History as a LiveStore metrics buffer, one sample per step; motion is the
+// step's maximum, so a step shows motion if any result in it did
+export function historyToBuffer(result: QueryResultMessage): RingBuffer {
+  const { series } = result
+  const buffer = new RingBuffer(Math.max(result.t.length, 1), 4)
+  const value = (v: number | null) => (v === null ? NaN : v)
+  result.t.forEach((t, i) => {
+    buffer.pushWith(t, (values, offset) => {
+      values[offset + METRIC_RSSI] = value(series.rssi.mean[i])
+      values[offset + METRIC_MOTION] = value(series.motion_detect.max[i])
+      values[offset + METRIC_CONFIDENCE] = value(series.motion_confidence.mean[i])
+      values[offset + METRIC_BREATHING] = value(series.breathing_rate.mean[i])
+    })
+  })
+  return buffer
+}
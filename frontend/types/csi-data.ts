@@ -9,11 +9,86 @@ export interface CSIData {
   topic?: string
   device_id?: string
   rssi?: number
+  motion_detect?: number
+  motion_confidence?: number | null
+  // Device timestamp of the csi/data message, us (uptime on a board)
+  device_timestamp_us?: number | null
+  // Transmitter of the message (csi_link.h), 0 for a single one. Motion
+  // and breathing_rate are fused over every link in `links`
+  link?: number
+  breathing_quality?: number | null
+  // Heart rate in BPM and its spectral-peak confidence, 0 (noise) to 1,
+  // from raw frames; absent in the decimated publish mode
+  heart_rate?: number | null
+  heart_confidence?: number | null
+  links?: LinkResult[]
   snr?: number
   signal_quality?: string
+  // Subcarrier amplitudes of a decimated-mode message, which has no CSIs
+  amplitudes?: number[]
   subcarriers?: Subcarrier[]
   temperature?: number
   humidity?: number
   raw_payload?: string
   [key: string]: any // Allow for dynamic properties
 }
+
+// What one transmitter's link of a device sees, see backend/ingest.py
+export interface LinkResult {
+  link: number
+  rssi: number
+  motion_detect: number
+  motion_confidence: number | null
+  breathing_rate: number | null
+  breathing_quality: number | null
+  heart_rate?: number | null
+  heart_confidence?: number | null
+}
+
+// Probe loss and jitter reported by a csi_recv board every 10 s
+export interface LinkTelemetry {
+  device_id: string
+  received: number
+  lost: number
+  loss_rate: number
+  duplicates: number
+  reordered: number
+  restarts: number
+  jitter_us: number
+  max_interval_us: number
+  gaps: number[]
+  queue_dropped: number
+  // Messages held on the device while the broker was unreachable
+  backlog?: number
+  backlog_dropped?: number
+  reconnects?: number
+  // Startup milestones, ms since boot, 0 until reached
+  startup_ms?: {
+    radio: number
+    first_frame: number
+    ip: number
+    mqtt: number
+    first_publish: number
+  }
+  // Publish scheduler state over the period (publish_sched.h)
+  publish?: {
+    level: "normal" | "batch" | "qos0" | "decimated" | "hold"
+    outbox: number
+    outbox_peak: number
+    heap_min: number
+    transitions: number
+    oversize: number
+    // Ticks spent at each level, in the order of `level`
+    ticks: number[]
+  }
+  // Probe figures per transmitter; the top-level ones are link 0's
+  links?: {
+    id: number
+    received: number
+    lost: number
+    jitter_us: number
+    queue_dropped: number
+  }[]
+  // Frames of transmitters beyond the receiver's link table
+  link_rejected?: number
+}